@@ -0,0 +1,78 @@
+#include "src/bus/c/bus.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Streams large frames over a direct TCP channel on localhost. NATS (on
+// localhost:4222) is only used to discover the publisher's endpoint.
+
+#define FRAME_SIZE (4 * 1024 * 1024)
+#define FRAME_COUNT 200
+
+static atomic_int received = 0;
+static atomic_size_t received_bytes = 0;
+
+void frame_callback(const char* topic, const void* data, size_t size) {
+    (void)topic;
+    (void)data;
+    atomic_fetch_add(&received, 1);
+    atomic_fetch_add(&received_bytes, size);
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(void) {
+    printf("=== Direct Channel Example ===\n\n");
+
+    zetabus_t* bus = zetabus_create("nats://localhost:4222");
+    if (!bus) {
+        fprintf(stderr, "Failed to create zetabus\n");
+        return 1;
+    }
+
+    zetabus_publisher_t* publisher = zetabus_publisher_create(bus, "example.camera");
+    if (!publisher || zetabus_publisher_enable_direct(publisher) != 0) {
+        fprintf(stderr, "Failed to create direct publisher\n");
+        zetabus_destroy(bus);
+        return 1;
+    }
+
+    zetabus_subscriber_t* subscriber = zetabus_subscriber_create_direct(bus, "example.camera", frame_callback);
+    if (!subscriber) {
+        fprintf(stderr, "Failed to create direct subscriber\n");
+        zetabus_publisher_destroy(publisher);
+        zetabus_destroy(bus);
+        return 1;
+    }
+
+    // Give discovery a moment to connect the subscriber
+    usleep(200000);
+
+    char* frame = (char*)calloc(1, FRAME_SIZE);
+    if (!frame) return 1;
+
+    double start = now_s();
+    for (int i = 0; i < FRAME_COUNT; i++) {
+        zetabus_publish(publisher, frame, FRAME_SIZE);
+    }
+    while (atomic_load(&received) < FRAME_COUNT && now_s() - start < 10.0) {
+        usleep(1000);
+    }
+    double elapsed = now_s() - start;
+
+    printf("Received %d/%d frames, %.1f MB/s\n", atomic_load(&received), FRAME_COUNT,
+           (double)atomic_load(&received_bytes) / elapsed / 1e6);
+
+    free(frame);
+    zetabus_subscriber_destroy(subscriber);
+    zetabus_publisher_destroy(publisher);
+    zetabus_destroy(bus);
+    return 0;
+}
@@ -0,0 +1,226 @@
+#include "bus.h"
+#include "bus_internal.h"
+#include "../../clock/c/clock.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Envelope layout (little-endian): a header of magic, version and entry count,
+// then per entry the publisher's send time (zeta_clock_now_ns), the payload
+// size and the payload.
+// Entries are packed without padding, so readers must not assume alignment.
+#define ENVELOPE_MAGIC 0x564e455aU // "ZENV"
+#define ENVELOPE_VERSION 1
+#define ENVELOPE_HEADER_SIZE 12
+#define ENTRY_HEADER_SIZE 12
+
+struct zetabus_batch_s {
+    zetabus_publisher_t* publisher;
+    size_t max_count;
+    size_t max_bytes;
+    uint64_t linger_ns;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t linger_thread;
+    bool running;
+
+    // Envelope being filled
+    uint8_t* buf;
+    size_t len;
+    size_t cap;
+    uint32_t count;
+    uint64_t deadline_ns; // Monotonic time the first entry must go out by
+};
+
+static void store_u32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static void store_u64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint32_t load_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t load_u64(const uint8_t* p) {
+    return (uint64_t)load_u32(p) | ((uint64_t)load_u32(p + 4) << 32);
+}
+
+// Envelope reading
+
+uint32_t zetabus_envelope_count(const void* data, size_t size) {
+    const uint8_t* p = (const uint8_t*)data;
+    if (size < ENVELOPE_HEADER_SIZE || load_u32(p) != ENVELOPE_MAGIC || p[4] != ENVELOPE_VERSION) return 0;
+
+    // Only a message whose entries exactly fill it is an envelope
+    uint32_t count = load_u32(p + 8);
+    size_t offset = ENVELOPE_HEADER_SIZE;
+    for (uint32_t i = 0; i < count; i++) {
+        if (size - offset < ENTRY_HEADER_SIZE) return 0;
+        size_t entry_size = load_u32(p + offset + 8);
+        if (size - offset - ENTRY_HEADER_SIZE < entry_size) return 0;
+        offset += ENTRY_HEADER_SIZE + entry_size;
+    }
+    return offset == size ? count : 0;
+}
+
+const void* zetabus_envelope_begin(const void* data) {
+    return (const uint8_t*)data + ENVELOPE_HEADER_SIZE;
+}
+
+const void* zetabus_envelope_next(const void** cursor, uint64_t* sent_ns, size_t* size) {
+    const uint8_t* p = (const uint8_t*)*cursor;
+    *sent_ns = load_u64(p);
+    *size = load_u32(p + 8);
+    *cursor = p + ENTRY_HEADER_SIZE + *size;
+    return p + ENTRY_HEADER_SIZE;
+}
+
+// Batching publisher
+
+// Send the envelope being filled, if any (lock held)
+static int flush_locked(zetabus_batch_t* batch) {
+    if (batch->count == 0) return 0;
+
+    store_u32(batch->buf, ENVELOPE_MAGIC);
+    batch->buf[4] = ENVELOPE_VERSION;
+    memset(batch->buf + 5, 0, 3);
+    store_u32(batch->buf + 8, batch->count);
+    int ret = zetabus_publisher_send(batch->publisher, batch->buf, batch->len, true);
+
+    batch->len = ENVELOPE_HEADER_SIZE;
+    batch->count = 0;
+    return ret;
+}
+
+// Linger thread: sends an envelope that neither filled up nor got flushed by
+// a later publish once its first entry has waited linger_ns.
+static void* batch_linger_thread(void* arg) {
+    zetabus_batch_t* batch = (zetabus_batch_t*)arg;
+
+    pthread_mutex_lock(&batch->lock);
+    while (batch->running) {
+        if (batch->count == 0) {
+            pthread_cond_wait(&batch->cond, &batch->lock);
+            continue;
+        }
+
+        if (zeta_clock_monotonic_ns() < batch->deadline_ns) {
+            // The condition variable waits on CLOCK_MONOTONIC, the deadline's clock
+            struct timespec deadline = {
+                .tv_sec = (time_t)(batch->deadline_ns / 1000000000ULL),
+                .tv_nsec = (long)(batch->deadline_ns % 1000000000ULL)
+            };
+            pthread_cond_timedwait(&batch->cond, &batch->lock, &deadline);
+            continue;
+        }
+        flush_locked(batch); // Failures are dropped, as for any asynchronous send
+    }
+    pthread_mutex_unlock(&batch->lock);
+    return NULL;
+}
+
+zetabus_batch_t* zetabus_batch_create(zetabus_publisher_t* publisher, uint32_t max_count,
+                                      size_t max_bytes, uint32_t linger_us) {
+    if (max_count == 0 || max_bytes <= ENVELOPE_HEADER_SIZE + ENTRY_HEADER_SIZE) return NULL;
+
+    zetabus_batch_t* batch = (zetabus_batch_t*)calloc(1, sizeof(zetabus_batch_t));
+    if (!batch) return NULL;
+
+    batch->publisher = publisher;
+    batch->max_count = max_count;
+    batch->max_bytes = max_bytes;
+    batch->linger_ns = (uint64_t)linger_us * 1000ULL;
+    batch->cap = max_bytes;
+    batch->buf = (uint8_t*)malloc(batch->cap);
+    if (!batch->buf) {
+        free(batch);
+        return NULL;
+    }
+    batch->len = ENVELOPE_HEADER_SIZE;
+
+    pthread_mutex_init(&batch->lock, NULL);
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&batch->cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    batch->running = true;
+
+    if (pthread_create(&batch->linger_thread, NULL, batch_linger_thread, batch) != 0) {
+        pthread_cond_destroy(&batch->cond);
+        pthread_mutex_destroy(&batch->lock);
+        free(batch->buf);
+        free(batch);
+        return NULL;
+    }
+
+    return batch;
+}
+
+void zetabus_batch_destroy(zetabus_batch_t* batch) {
+    if (!batch) return;
+
+    pthread_mutex_lock(&batch->lock);
+    batch->running = false;
+    pthread_cond_signal(&batch->cond);
+    pthread_mutex_unlock(&batch->lock);
+    pthread_join(batch->linger_thread, NULL);
+
+    // Whatever is still lingering goes out now
+    flush_locked(batch);
+
+    pthread_cond_destroy(&batch->cond);
+    pthread_mutex_destroy(&batch->lock);
+    free(batch->buf);
+    free(batch);
+}
+
+int zetabus_batch_publish(zetabus_batch_t* batch, const void* data, size_t size) {
+    if (size > UINT32_MAX - ENTRY_HEADER_SIZE) return -1;
+    // The recorder stamps received_ns from the same clock, so the two compare
+    uint64_t sent_ns = zeta_clock_now_ns();
+    size_t entry = ENTRY_HEADER_SIZE + size;
+
+    pthread_mutex_lock(&batch->lock);
+
+    // Close the current envelope first if this entry would overflow it
+    int ret = 0;
+    if (batch->count > 0 && batch->len + entry > batch->max_bytes) {
+        ret = flush_locked(batch);
+    }
+
+    // A payload larger than max_bytes travels alone in an envelope of its own
+    if (batch->len + entry > batch->cap) {
+        uint8_t* buf = (uint8_t*)realloc(batch->buf, batch->len + entry);
+        if (!buf) {
+            pthread_mutex_unlock(&batch->lock);
+            return -1;
+        }
+        batch->buf = buf;
+        batch->cap = batch->len + entry;
+    }
+
+    uint8_t* p = batch->buf + batch->len;
+    store_u64(p, sent_ns);
+    store_u32(p + 8, (uint32_t)size);
+    if (size > 0) memcpy(p + ENTRY_HEADER_SIZE, data, size);
+    batch->len += entry;
+    batch->count++;
+
+    if (batch->count >= batch->max_count || batch->len >= batch->max_bytes || batch->linger_ns == 0) {
+        int flushed = flush_locked(batch);
+        if (ret == 0) ret = flushed;
+    } else if (batch->count == 1) {
+        batch->deadline_ns = zeta_clock_monotonic_ns() + batch->linger_ns;
+        pthread_cond_signal(&batch->cond);
+    }
+
+    pthread_mutex_unlock(&batch->lock);
+    return ret;
+}
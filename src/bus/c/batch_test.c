@@ -0,0 +1,222 @@
+#include "bus.h"
+#include "bus_internal.h"
+#include "../../clock/c/clock.h"
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Batching runs over a multicast bus on loopback, so no broker is needed
+static char g_url[128];
+
+#define MAX_RECEIVED 4096
+
+typedef struct {
+    atomic_int count;
+    int values[MAX_RECEIVED];
+    uint64_t sent_ns[MAX_RECEIVED];
+    size_t sizes[MAX_RECEIVED];
+} received_t;
+
+static received_t g_ex;
+static atomic_int g_plain_count;
+static atomic_int g_plain_bad;
+
+static void on_message(const zetabus_message_t* message, void* closure) {
+    received_t* received = (received_t*)closure;
+    int i = atomic_load(&received->count);
+    if (i < MAX_RECEIVED) {
+        int value = 0;
+        if (message->size >= sizeof(value)) memcpy(&value, message->data, sizeof(value));
+        received->values[i] = value;
+        received->sent_ns[i] = message->sent_ns;
+        received->sizes[i] = message->size;
+    }
+    atomic_store(&received->count, i + 1);
+}
+
+static void on_plain(const char* topic, const void* data, size_t size) {
+    if (size != sizeof(int)) atomic_fetch_add(&g_plain_bad, 1);
+    atomic_fetch_add(&g_plain_count, 1);
+}
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static int wait_for(atomic_int* count, int target, int timeout_ms) {
+    for (int i = 0; i < timeout_ms && atomic_load(count) < target; i++) {
+        sleep_ms(1);
+    }
+    return atomic_load(count);
+}
+
+static void reset(void) {
+    atomic_store(&g_ex.count, 0);
+    atomic_store(&g_plain_count, 0);
+    atomic_store(&g_plain_bad, 0);
+}
+
+// Test that envelopes are unpacked in order with per-message send times
+void test_unpack_in_order(void) {
+    printf("Running test_unpack_in_order...\n");
+    reset();
+
+    zetabus_t* pub_bus = zetabus_create(g_url);
+    zetabus_t* sub_bus = zetabus_create(g_url);
+    assert(pub_bus && sub_bus);
+
+    zetabus_subscriber_t* ex = zetabus_subscriber_create_ex(sub_bus, "robot.imu", on_message, &g_ex);
+    zetabus_subscriber_t* plain = zetabus_subscriber_create(sub_bus, "robot.>", on_plain);
+    zetabus_publisher_t* pub = zetabus_publisher_create(pub_bus, "robot.imu");
+    assert(ex && plain && pub);
+    assert(zetabus_publisher_enable_batching(pub, 50, 64 * 1024, 100000) == 0);
+    assert(zetabus_publisher_enable_batching(pub, 50, 64 * 1024, 100000) != 0);
+
+    uint64_t start = zeta_clock_now_ns();
+    for (int i = 0; i < 200; i++) {
+        assert(zetabus_publish(pub, &i, sizeof(i)) == 0);
+    }
+    uint64_t end = zeta_clock_now_ns();
+
+    // 200 messages at 50 per envelope fill exactly four envelopes
+    assert(wait_for(&g_ex.count, 200, 1000) == 200);
+    assert(wait_for(&g_plain_count, 200, 1000) == 200);
+    assert(atomic_load(&g_plain_bad) == 0);
+    for (int i = 0; i < 200; i++) {
+        assert(g_ex.values[i] == i);
+        assert(g_ex.sizes[i] == sizeof(int));
+        assert(g_ex.sent_ns[i] >= start && g_ex.sent_ns[i] <= end);
+        if (i > 0) assert(g_ex.sent_ns[i] >= g_ex.sent_ns[i - 1]);
+    }
+
+    zetabus_publisher_destroy(pub);
+    zetabus_subscriber_destroy(ex);
+    zetabus_subscriber_destroy(plain);
+    zetabus_destroy(pub_bus);
+    zetabus_destroy(sub_bus);
+
+    printf("test_unpack_in_order PASSED\n");
+}
+
+// Test that a partial envelope goes out after the linger time, and on destroy
+void test_linger_and_destroy_flush(void) {
+    printf("Running test_linger_and_destroy_flush...\n");
+    reset();
+
+    zetabus_t* pub_bus = zetabus_create(g_url);
+    zetabus_t* sub_bus = zetabus_create(g_url);
+    zetabus_subscriber_t* ex = zetabus_subscriber_create_ex(sub_bus, "robot.odom", on_message, &g_ex);
+    zetabus_publisher_t* pub = zetabus_publisher_create(pub_bus, "robot.odom");
+    assert(ex && pub);
+    assert(zetabus_publisher_enable_batching(pub, 1000, 64 * 1024, 20000) == 0);
+
+    for (int i = 0; i < 3; i++) {
+        assert(zetabus_publish(pub, &i, sizeof(i)) == 0);
+    }
+    sleep_ms(5);
+    assert(atomic_load(&g_ex.count) == 0); // Still lingering
+    assert(wait_for(&g_ex.count, 3, 1000) == 3);
+
+    // An unfilled envelope is sent when the publisher goes away
+    int last = 42;
+    assert(zetabus_publish(pub, &last, sizeof(last)) == 0);
+    zetabus_publisher_destroy(pub);
+    assert(wait_for(&g_ex.count, 4, 1000) == 4);
+    assert(g_ex.values[3] == 42);
+
+    zetabus_subscriber_destroy(ex);
+    zetabus_destroy(pub_bus);
+    zetabus_destroy(sub_bus);
+
+    printf("test_linger_and_destroy_flush PASSED\n");
+}
+
+// Test byte limits: an envelope closes before overflowing, and a payload
+// larger than the limit travels alone
+void test_byte_limit(void) {
+    printf("Running test_byte_limit...\n");
+    reset();
+
+    zetabus_t* pub_bus = zetabus_create(g_url);
+    zetabus_t* sub_bus = zetabus_create(g_url);
+    zetabus_subscriber_t* ex = zetabus_subscriber_create_ex(sub_bus, "lidar.scan", on_message, &g_ex);
+    zetabus_publisher_t* pub = zetabus_publisher_create(pub_bus, "lidar.scan");
+    assert(ex && pub);
+    assert(zetabus_publisher_enable_batching(pub, 1000, 1024, 1000000) == 0);
+
+    uint8_t small[300];
+    memset(small, 1, sizeof(small));
+    uint8_t* big = (uint8_t*)calloc(1, 8000);
+    assert(zetabus_publish(pub, small, sizeof(small)) == 0);
+    assert(zetabus_publish(pub, small, sizeof(small)) == 0);
+    assert(zetabus_publish(pub, small, sizeof(small)) == 0); // Closes the first envelope
+    assert(zetabus_publish(pub, big, 8000) == 0);            // Closes the second, sent alone
+    assert(wait_for(&g_ex.count, 4, 1000) == 4);
+    assert(g_ex.sizes[0] == 300 && g_ex.sizes[2] == 300 && g_ex.sizes[3] == 8000);
+
+    free(big);
+    zetabus_publisher_destroy(pub);
+    zetabus_subscriber_destroy(ex);
+    zetabus_destroy(pub_bus);
+    zetabus_destroy(sub_bus);
+
+    printf("test_byte_limit PASSED\n");
+}
+
+// Test that unbatched messages are delivered untouched with no send time
+void test_unbatched_passthrough(void) {
+    printf("Running test_unbatched_passthrough...\n");
+    reset();
+
+    zetabus_t* bus = zetabus_create(g_url);
+    zetabus_subscriber_t* ex = zetabus_subscriber_create_ex(bus, "robot.cmd", on_message, &g_ex);
+    zetabus_publisher_t* pub = zetabus_publisher_create(bus, "robot.cmd");
+    assert(ex && pub);
+
+    int value = 7;
+    assert(zetabus_publish(pub, &value, sizeof(value)) == 0);
+    assert(wait_for(&g_ex.count, 1, 1000) == 1);
+    assert(g_ex.values[0] == 7 && g_ex.sent_ns[0] == 0);
+
+    // Something that merely starts like an envelope is not one
+    uint8_t fake[16] = { 0x5a, 0x45, 0x4e, 0x56, 1, 0, 0, 0, 5, 0, 0, 0 };
+    assert(zetabus_envelope_count(fake, sizeof(fake)) == 0);
+    assert(zetabus_publish(pub, fake, sizeof(fake)) == 0);
+    assert(wait_for(&g_ex.count, 2, 1000) == 2);
+    assert(g_ex.sizes[1] == sizeof(fake));
+
+    // A well-formed envelope published unbatched is unmarked, so it arrives whole
+    uint8_t real[28] = { 0x5a, 0x45, 0x4e, 0x56, 1, 0, 0, 0, 1, 0, 0, 0 };
+    real[20] = sizeof(value);
+    memcpy(real + 24, &value, sizeof(value));
+    assert(zetabus_envelope_count(real, sizeof(real)) == 1);
+    assert(zetabus_publish(pub, real, sizeof(real)) == 0);
+    assert(wait_for(&g_ex.count, 3, 1000) == 3);
+    assert(g_ex.sizes[2] == sizeof(real) && g_ex.sent_ns[2] == 0);
+
+    zetabus_publisher_destroy(pub);
+    zetabus_subscriber_destroy(ex);
+    zetabus_destroy(bus);
+
+    printf("test_unbatched_passthrough PASSED\n");
+}
+
+int main(void) {
+    printf("Running envelope batching tests...\n\n");
+
+    int port = 20000 + (int)(getpid() % 20000);
+    snprintf(g_url, sizeof(g_url), "udpm://239.255.76.69:%d?ttl=0&iface=127.0.0.1", port);
+
+    test_unpack_in_order();
+    test_linger_and_destroy_flush();
+    test_byte_limit();
+    test_unbatched_passthrough();
+
+    printf("\nAll tests PASSED!\n");
+    return 0;
+}
@@ -1,8 +1,26 @@
 #include "bus.h"
 #include "bus_internal.h"
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
+// Connection state callbacks (run on the NATS connection thread)
+
+static void _disconnected_handler(natsConnection* nc, void* closure) {
+    zetabus_t* bus = (zetabus_t*)closure;
+    atomic_store(&bus->connected, false);
+}
+
+static void _reconnected_handler(natsConnection* nc, void* closure) {
+    zetabus_t* bus = (zetabus_t*)closure;
+    atomic_store(&bus->connected, true);
+}
+
+static void _lean_state_handler(void* closure, bool connected) {
+    zetabus_t* bus = (zetabus_t*)closure;
+    atomic_store(&bus->connected, connected);
+}
+
 // Zetabus Creation and Destruction
 
 zetabus_t* zetabus_create(const char* url) {
@@ -10,25 +28,130 @@ zetabus_t* zetabus_create(const char* url) {
     if (!bus) return NULL;
 
     bus->url = strdup(url);
+    bus->broker_subs = NULL;
+    bus->trie = zetabus_trie_create();
+    if (!bus->trie) {
+        free(bus->url);
+        free(bus);
+        return NULL;
+    }
+    pthread_rwlock_init(&bus->trie_lock, NULL);
+    pthread_mutex_init(&bus->release_lock, NULL);
+    pthread_cond_init(&bus->released, NULL);
+    atomic_init(&bus->connected, false);
+    bus->udpm = NULL;
+    bus->lean = NULL;
+    bus->nc = NULL;
+    bus->opts = NULL;
+    
+    // Broker-less multicast bus
+    if (strncmp(url, ZETABUS_UDPM_SCHEME, strlen(ZETABUS_UDPM_SCHEME)) == 0) {
+        bus->udpm = zetabus_udpm_create(bus, url);
+        if (!bus->udpm) {
+            pthread_rwlock_destroy(&bus->trie_lock);
+            pthread_mutex_destroy(&bus->release_lock);
+            pthread_cond_destroy(&bus->released);
+            zetabus_trie_destroy(bus->trie);
+            free(bus->url);
+            free(bus);
+            return NULL;
+        }
+        atomic_store(&bus->connected, true);
+        return bus;
+    }
+    
+    // Lean protocol client instead of nats.c
+    if (strncmp(url, ZETABUS_LEAN_SCHEME, strlen(ZETABUS_LEAN_SCHEME)) == 0) {
+        bus->lean = zetabus_lean_connect(url + strlen(ZETABUS_LEAN_SCHEME), _lean_state_handler, bus);
+        if (!bus->lean) {
+            pthread_rwlock_destroy(&bus->trie_lock);
+            pthread_mutex_destroy(&bus->release_lock);
+            pthread_cond_destroy(&bus->released);
+            zetabus_trie_destroy(bus->trie);
+            free(bus->url);
+            free(bus);
+            return NULL;
+        }
+        atomic_store(&bus->connected, true);
+        return bus;
+    }
+    
     natsOptions_Create(&bus->opts);
     natsOptions_SetURL(bus->opts, url);
+    natsOptions_SetDisconnectedCB(bus->opts, _disconnected_handler, bus);
+    natsOptions_SetReconnectedCB(bus->opts, _reconnected_handler, bus);
+    natsOptions_SetMaxReconnect(bus->opts, -1); // Keep retrying so spools can drain
 
     natsConnection* nc = NULL;
     natsStatus s = natsConnection_Connect(&nc, bus->opts);
     if (s != NATS_OK) {
+        natsOptions_Destroy(bus->opts);
+        pthread_rwlock_destroy(&bus->trie_lock);
+        pthread_mutex_destroy(&bus->release_lock);
+        pthread_cond_destroy(&bus->released);
+        zetabus_trie_destroy(bus->trie);
         free(bus->url);
         free(bus);
         return NULL;
     }
 
     bus->nc = nc;
+    atomic_store(&bus->connected, true);
     return bus;
 }
 
+int zetabus_broker_publish(zetabus_t* bus, const char* subject, const void* data, size_t size,
+                           bool envelope) {
+    const char* reply = envelope ? ZETABUS_ENVELOPE_REPLY : NULL;
+    if (bus->lean) {
+        return zetabus_lean_publish(bus->lean, subject, reply, data, size);
+    }
+    if (size > INT_MAX) return -1;
+    
+    natsStatus s = reply ? natsConnection_PublishRequest(bus->nc, subject, reply, data, (int)size)
+                         : natsConnection_Publish(bus->nc, subject, data, (int)size);
+    return (s == NATS_OK) ? 0 : -1;
+}
+
+int zetabus_get_stats(zetabus_t* bus, zetabus_stats_t* stats) {
+    if (!bus || !stats) return -1;
+    
+    memset(stats, 0, sizeof(*stats));
+    if (bus->lean) {
+        zetabus_lean_stats_t lean;
+        zetabus_lean_get_stats(bus->lean, &lean);
+        stats->broker_errors = lean.server_errors;
+        stats->keepalive_timeouts = lean.keepalive_timeouts;
+        memcpy(stats->last_broker_error, lean.last_error, sizeof(stats->last_broker_error));
+    }
+    return 0;
+}
+
 void zetabus_destroy(zetabus_t* bus) {
     if (bus) {
-        natsConnection_Destroy(bus->nc);
-        natsOptions_Destroy(bus->opts);
+        // Joins the lean I/O thread, so no handler still holds a broker closure
+        zetabus_lean_close(bus->lean);
+        
+        zetabus_broker_sub_t* broker = bus->broker_subs;
+        while (broker) {
+            zetabus_broker_sub_t* next = broker->next;
+            if (broker->sub) {
+                natsSubscription_Unsubscribe(broker->sub);
+                natsSubscription_Destroy(broker->sub);
+            }
+            free(broker->pattern);
+            free(broker);
+            broker = next;
+        }
+        
+        // Stops the receive thread before the trie goes away
+        zetabus_udpm_destroy(bus->udpm);
+        if (bus->nc) natsConnection_Destroy(bus->nc);
+        if (bus->opts) natsOptions_Destroy(bus->opts);
+        pthread_rwlock_destroy(&bus->trie_lock);
+        pthread_mutex_destroy(&bus->release_lock);
+        pthread_cond_destroy(&bus->released);
+        zetabus_trie_destroy(bus->trie);
         free(bus->url);
         free(bus);
     }
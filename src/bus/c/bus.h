@@ -2,21 +2,118 @@
 #define ZETA_BUS_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 typedef struct zetabus_s zetabus_t;
 typedef struct zetabus_publisher_s zetabus_publisher_t;
 typedef struct zetabus_subscriber_s zetabus_subscriber_t;
 
+// A delivered message. sent_ns is when the publisher called zetabus_publish,
+// carried for batched publishers, and 0 when unknown. It is read from
+// zeta_clock_now_ns (CLOCK_MONOTONIC's epoch), like the recorder's
+// received_ns, so it only compares with times taken on the same host.
+typedef struct {
+    const char* topic;
+    const void* data;
+    size_t size;
+    uint64_t sent_ns;
+} zetabus_message_t;
+
+typedef void (*zetabus_message_callback_t)(const zetabus_message_t* message, void* closure);
+
 // Bus operations
+//
+// url selects the transport:
+//   nats://host:port   - through a NATS server (default)
+//   nats+lean://host:port - through a NATS server with the built-in lean
+//                        protocol client instead of nats.c: one epoll thread,
+//                        no per-message allocation on either path. No TLS,
+//                        auth or direct mode.
+//   udpm://group:port  - broker-less UDP multicast for best-effort, high-rate
+//                        topics. Options: ?ttl=0 (hops, 0 = this host only),
+//                        iface=<ipv4> (interface to send and join on), mtu=1400
+//                        (datagram size; larger messages are fragmented) and
+//                        nack=1 (repair lost fragments from the sender's recent
+//                        history). Every bus on the group sees every topic and
+//                        filters locally. Spooling is not available.
 zetabus_t* zetabus_create(const char* url);
 void zetabus_destroy(zetabus_t* bus);
 
+// Broker connection problems, counted rather than logged. Only nats+lean://
+// buses keep them; the others report zeros.
+typedef struct {
+    uint64_t broker_errors;      // -ERR replies from the NATS server
+    uint64_t keepalive_timeouts; // Connections dropped for unanswered PINGs
+    char last_broker_error[128]; // Text of the latest -ERR, "" before the first
+} zetabus_stats_t;
+
+int zetabus_get_stats(zetabus_t* bus, zetabus_stats_t* stats);
+
 // Publisher operations
 zetabus_publisher_t* zetabus_publisher_create(zetabus_t* bus, const char* topic);
 void zetabus_publisher_destroy(zetabus_publisher_t* publisher);
 int zetabus_publish(zetabus_publisher_t* publisher, const void* data, size_t size);
 
+// Spool publishes to an append-only file at spool_path while the broker link is
+// down, and drain them in order after reconnect at up to drain_rate messages per
+// second (0 = unlimited). Publishing never waits on the broker; records left in
+// the file by a previous run are drained first.
+int zetabus_publisher_enable_spool(zetabus_publisher_t* publisher, const char* spool_path, uint32_t drain_rate);
+
+// Cap the spool file at max_bytes (1 GiB by default, 0 = no limit). Once full,
+// publishes that would be spooled fail with -1 and are dropped, keeping the
+// oldest telemetry; drops are counted in the publisher's stats. The file only
+// shrinks once fully drained.
+int zetabus_publisher_set_spool_limit(zetabus_publisher_t* publisher, uint64_t max_bytes);
+
+// What a publisher has lost since it was created. The library does not log;
+// callers that want to report drops poll these counters.
+typedef struct {
+    uint64_t spool_refused;         // Publishes refused (-1) because the spool was full
+    uint64_t spool_discarded;       // Spooled records skipped as unreadable while draining
+    uint64_t spool_discarded_bytes; // Spool bytes skipped, including a damaged tail
+    uint64_t direct_dropped_peers;  // Direct subscribers disconnected for stalling
+} zetabus_publisher_stats_t;
+
+// Fill stats (zero for features the publisher does not use)
+int zetabus_publisher_get_stats(zetabus_publisher_t* publisher, zetabus_publisher_stats_t* stats);
+
+// Direct mode keeps the topic's data off the broker: the publisher listens on
+// a TCP port and advertises it over NATS, and subscribers created with
+// zetabus_subscriber_create_direct connect to it and receive frames straight
+// from the publisher. A direct topic is only delivered to direct subscribers.
+// Publishing never waits on a subscriber: one that takes no data for a second,
+// or falls 64 MB behind, is disconnected and counted in the publisher's stats.
+int zetabus_publisher_enable_direct(zetabus_publisher_t* publisher);
+
+// Batching packs small payloads into one envelope message, sent when it holds
+// max_count payloads or max_bytes bytes, or linger_us after its first payload
+// (0 sends every payload in an envelope of its own). Envelopes are marked by
+// their transport (over NATS, the reply subject "_ZETA.envelope"); subscribers
+// unpack marked messages transparently and get one callback per payload, with
+// its sent_ns.
+// Enable spooling before batching; direct topics cannot be batched.
+int zetabus_publisher_enable_batching(zetabus_publisher_t* publisher, uint32_t max_count, size_t max_bytes,
+                                      uint32_t linger_us);
+
+// Subscribers whose topics are covered by an existing subscription (e.g. "robot.>"
+// covering "robot.imu") share its broker subscription and are dispatched locally
+// through a subject trie. Callbacks run on the NATS delivery thread (the receive
+// thread for udpm:// buses), and may create and destroy subscribers, their own
+// included. Once zetabus_subscriber_destroy returns its callback is not called
+// again, except when it is called from a callback: a callback already running
+// on another thread may then still finish.
 zetabus_subscriber_t* zetabus_subscriber_create(zetabus_t* bus, const char* topic, void (*callback)(const char* topic, const void* data, size_t size));
+
+// As zetabus_subscriber_create, but the callback gets the message with its
+// send time and a caller-supplied closure
+zetabus_subscriber_t* zetabus_subscriber_create_ex(zetabus_t* bus, const char* topic,
+                                                   zetabus_message_callback_t callback, void* closure);
+
+// Receive a direct topic (see zetabus_publisher_enable_direct) from every
+// publisher advertising it. topic must not contain wildcards. Callbacks run on
+// a thread owned by the subscriber.
+zetabus_subscriber_t* zetabus_subscriber_create_direct(zetabus_t* bus, const char* topic, void (*callback)(const char* topic, const void* data, size_t size));
 void zetabus_subscriber_destroy(zetabus_subscriber_t* subscriber);
 
 #endif // ZETA_BUS_H
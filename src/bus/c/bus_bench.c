@@ -0,0 +1,133 @@
+#include "bus.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Benchmark for the broker transports
+//
+// For each bus URL given (e.g. nats://localhost:4222 and
+// nats+lean://localhost:4222), measures one-way publish throughput through the
+// server into a subscriber on the same bus, and the round-trip latency of one
+// message at a time.
+
+#define THROUGHPUT_MESSAGES 200000
+#define LATENCY_MESSAGES 10000
+
+static atomic_uint_fast64_t g_received;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void on_message(const char* topic, const void* data, size_t size) {
+    atomic_fetch_add(&g_received, 1);
+}
+
+// Wait up to timeout_ms for the receive count to reach target
+static int wait_received(uint64_t target, int timeout_ms) {
+    uint64_t deadline = now_ns() + (uint64_t)timeout_ms * 1000000ULL;
+    while (atomic_load(&g_received) < target) {
+        if (now_ns() > deadline) return -1;
+    }
+    return 0;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void bench_throughput(zetabus_publisher_t* pub, const char* url, size_t size) {
+    void* payload = calloc(1, size);
+    atomic_store(&g_received, 0);
+
+    size_t failed = 0;
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < THROUGHPUT_MESSAGES; i++) {
+        if (zetabus_publish(pub, payload, size) != 0) failed++;
+    }
+    uint64_t published = now_ns();
+    int ok = wait_received(THROUGHPUT_MESSAGES - failed, 10000);
+    uint64_t end = now_ns();
+
+    double pub_s = (double)(published - start) / 1e9;
+    double total_s = (double)(end - start) / 1e9;
+    printf("%-28s %7zu B  publish %9.0f msg/s  delivered %9.0f msg/s (%6.1f MB/s)%s\n",
+           url, size, THROUGHPUT_MESSAGES / pub_s, (double)atomic_load(&g_received) / total_s,
+           (double)atomic_load(&g_received) * (double)size / total_s / 1e6,
+           ok == 0 && failed == 0 ? "" : "  [messages lost]");
+    free(payload);
+}
+
+static void bench_latency(zetabus_publisher_t* pub, const char* url, size_t size) {
+    void* payload = calloc(1, size);
+    uint64_t* samples = (uint64_t*)malloc(LATENCY_MESSAGES * sizeof(uint64_t));
+    atomic_store(&g_received, 0);
+
+    size_t count = 0;
+    for (size_t i = 0; i < LATENCY_MESSAGES; i++) {
+        uint64_t start = now_ns();
+        if (zetabus_publish(pub, payload, size) != 0) continue;
+        if (wait_received(count + 1, 1000) != 0) break;
+        samples[count++] = now_ns() - start;
+    }
+
+    if (count > 0) {
+        qsort(samples, count, sizeof(uint64_t), compare_u64);
+        printf("%-28s %7zu B  round trip p50 %7.1f us  p99 %7.1f us  max %8.1f us\n",
+               url, size, samples[count / 2] / 1e3, samples[count * 99 / 100] / 1e3,
+               samples[count - 1] / 1e3);
+    }
+    free(samples);
+    free(payload);
+}
+
+static void bench(const char* url) {
+    zetabus_t* bus = zetabus_create(url);
+    if (!bus) {
+        fprintf(stderr, "Failed to connect to %s\n", url);
+        return;
+    }
+    zetabus_subscriber_t* sub = zetabus_subscriber_create(bus, "bench.data", on_message);
+    zetabus_publisher_t* pub = zetabus_publisher_create(bus, "bench.data");
+    if (!sub || !pub) {
+        fprintf(stderr, "Failed to set up %s\n", url);
+        zetabus_publisher_destroy(pub);
+        zetabus_subscriber_destroy(sub);
+        zetabus_destroy(bus);
+        return;
+    }
+
+    // Let the subscription reach the server before the first publish
+    struct timespec settle = { .tv_sec = 0, .tv_nsec = 100000000L };
+    nanosleep(&settle, NULL);
+
+    static const size_t sizes[] = { 16, 256, 4096, 65536 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        bench_throughput(pub, url, sizes[i]);
+    }
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        bench_latency(pub, url, sizes[i]);
+    }
+
+    zetabus_publisher_destroy(pub);
+    zetabus_subscriber_destroy(sub);
+    zetabus_destroy(bus);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <bus url>...\n", argv[0]);
+        return 1;
+    }
+    for (int i = 1; i < argc; i++) {
+        bench(argv[i]);
+    }
+    return 0;
+}
@@ -2,26 +2,132 @@
 #define ZETA_BUS_INTERNAL_H
 
 #include "bus.h"
+#include "nats_lean.h"
+#include "subject_trie.h"
 #include <nats/nats.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 // Internal struct definitions shared across implementation files
 
+typedef struct zetabus_spool_s zetabus_spool_t;
+typedef struct zetabus_udpm_s zetabus_udpm_t;
+typedef struct zetabus_direct_pub_s zetabus_direct_pub_t;
+typedef struct zetabus_direct_sub_s zetabus_direct_sub_t;
+typedef struct zetabus_batch_s zetabus_batch_t;
+
+#define ZETABUS_UDPM_SCHEME "udpm://"
+#define ZETABUS_LEAN_SCHEME "nats+lean://"
+
+// Broker subscription shared by every local subscriber whose topic it covers.
+// Entries live until the bus is destroyed so in-flight NATS callbacks never
+// see a freed closure; sub (lean_sid on lean buses) is cleared once the last
+// local subscriber is gone.
+typedef struct zetabus_broker_sub_s {
+    zetabus_t* bus;
+    char* pattern;
+    natsSubscription* sub;
+    uint64_t lean_sid;
+    size_t refcount;
+    struct zetabus_broker_sub_s* next;
+} zetabus_broker_sub_t;
+
 struct zetabus_s {
     natsConnection* nc;
     natsOptions* opts;
     char* url;
+    atomic_bool connected; // Maintained by the NATS disconnect/reconnect callbacks
+    zetabus_udpm_t* udpm;  // Set for udpm:// buses, which have no NATS connection
+    zetabus_lean_t* lean;  // Set for nats+lean:// buses, which use it instead of nc
+
+    // Local demultiplexing: subscribers are dispatched from the trie
+    zetabus_trie_t* trie;
+    pthread_rwlock_t trie_lock;
+    zetabus_broker_sub_t* broker_subs;
+
+    // Dispatches take the matching subscribers out of the trie and run their
+    // callbacks after letting go of trie_lock; a subscriber destroyed meanwhile
+    // waits on released until they are done with it
+    pthread_mutex_t release_lock;
+    pthread_cond_t released;
 };
 
 struct zetabus_publisher_s {
     zetabus_t* bus;
     char* topic;
+    zetabus_spool_t* spool; // NULL unless spooling is enabled
+    zetabus_direct_pub_t* direct; // NULL unless direct mode is enabled
+    zetabus_batch_t* batch; // NULL unless envelope batching is enabled
 };
 
 struct zetabus_subscriber_s {
     zetabus_t* bus;
     char* topic;
-    natsSubscription* sub;
+    zetabus_broker_sub_t* broker; // Broker subscription this subscriber receives through (NULL for udpm)
+    zetabus_direct_sub_t* direct; // Set for direct subscribers, which bypass the trie
     void (*callback)(const char* topic, const void* data, size_t size);
+    zetabus_message_callback_t callback_ex; // Set instead of callback by zetabus_subscriber_create_ex
+    void* closure;
+    atomic_size_t refs;    // The creator's, plus one per dispatch about to call it; freed at 0
+    atomic_bool removed;   // Destroyed: dispatches still holding it skip it
 };
 
+// Reply subject that marks a broker message as a batch envelope. Nothing ever
+// replies to it; receivers only unpack messages carrying it, so a payload that
+// happens to look like an envelope is still delivered as is.
+#define ZETABUS_ENVELOPE_REPLY "_ZETA.envelope"
+
+// Send a payload over the publisher's transport, bypassing batching (publisher.c).
+// envelope marks a batch envelope for the receiving side.
+int zetabus_publisher_send(zetabus_publisher_t* publisher, const void* data, size_t size, bool envelope);
+
+// Publish through the bus's broker connection, nats.c or lean (bus.c)
+int zetabus_broker_publish(zetabus_t* bus, const char* subject, const void* data, size_t size,
+                           bool envelope);
+
+// Disconnect spool (spool.c)
+zetabus_spool_t* zetabus_spool_create(zetabus_publisher_t* publisher, const char* path, uint32_t drain_rate);
+void zetabus_spool_destroy(zetabus_spool_t* spool);
+int zetabus_spool_publish(zetabus_spool_t* spool, const void* data, size_t size, bool envelope);
+void zetabus_spool_set_limit(zetabus_spool_t* spool, uint64_t max_bytes);
+void zetabus_spool_get_stats(zetabus_spool_t* spool, zetabus_publisher_stats_t* stats);
+
+// Deliver a message to every local subscriber of broker whose topic matches subject
+// (subscriber.c). broker is NULL for transports without broker subscriptions.
+// Envelopes, as marked by their transport, are unpacked into their entries.
+void zetabus_dispatch(zetabus_t* bus, zetabus_broker_sub_t* broker, const char* subject,
+                      const void* data, size_t size, bool envelope);
+
+// Envelope batching (batch.c)
+zetabus_batch_t* zetabus_batch_create(zetabus_publisher_t* publisher, uint32_t max_count,
+                                      size_t max_bytes, uint32_t linger_us);
+void zetabus_batch_destroy(zetabus_batch_t* batch);
+int zetabus_batch_publish(zetabus_batch_t* batch, const void* data, size_t size);
+
+// Number of entries if data is a well-formed envelope, else 0. Only meaningful
+// for messages their transport marked as envelopes. Entries are
+// walked from zetabus_envelope_begin with zetabus_envelope_next.
+uint32_t zetabus_envelope_count(const void* data, size_t size);
+const void* zetabus_envelope_begin(const void* data);
+const void* zetabus_envelope_next(const void** cursor, uint64_t* sent_ns, size_t* size);
+
+// Direct TCP data channels (direct.c)
+zetabus_direct_pub_t* zetabus_direct_pub_create(zetabus_publisher_t* publisher);
+void zetabus_direct_pub_destroy(zetabus_direct_pub_t* direct);
+int zetabus_direct_publish(zetabus_direct_pub_t* direct, const void* data, size_t size);
+void zetabus_direct_pub_get_stats(zetabus_direct_pub_t* direct, zetabus_publisher_stats_t* stats);
+zetabus_direct_sub_t* zetabus_direct_sub_create(zetabus_subscriber_t* subscriber);
+void zetabus_direct_sub_destroy(zetabus_direct_sub_t* direct);
+
+// UDP multicast transport (udpm.c)
+zetabus_udpm_t* zetabus_udpm_create(zetabus_t* bus, const char* url);
+void zetabus_udpm_destroy(zetabus_udpm_t* udpm);
+int zetabus_udpm_publish(zetabus_udpm_t* udpm, const char* topic, const void* data, size_t size,
+                         bool envelope);
+int zetabus_udpm_join(zetabus_udpm_t* udpm); // Start receiving, on the first subscriber
+#ifdef ZETABUS_TEST_HOOKS
+// Fault injection, only in the :bus_test_hooks build
+void zetabus_udpm_set_test_drop(zetabus_udpm_t* udpm, uint32_t drop_every); // Drop every Nth outgoing fragment
+#endif
+
 #endif // ZETA_BUS_INTERNAL_H
@@ -0,0 +1,654 @@
+#include "bus.h"
+#include "bus_internal.h"
+#include "../../clock/c/clock.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Direct TCP data channels
+//
+// NATS only carries discovery: a direct publisher listens on an ephemeral TCP
+// port and announces "host:port" on DIRECT_ANNOUNCE_PREFIX.<topic>, both when it
+// starts and whenever a subscriber asks on DIRECT_QUERY_PREFIX.<topic>. Each
+// subscriber connects to every announced endpoint. Messages then travel as
+// frames of a uint32 little-endian size followed by the payload, written with a
+// single non-blocking sendmsg from the caller's buffer and parsed in place on
+// the receiving side, so neither end allocates per message. What a subscriber's
+// socket does not take is queued for it and sent by the publisher thread, so a
+// slow subscriber never holds up the publisher or the other subscribers.
+
+#define DIRECT_ANNOUNCE_PREFIX "_ZETA.direct.announce."
+#define DIRECT_QUERY_PREFIX "_ZETA.direct.query."
+#define DIRECT_ENDPOINT_MAX 64
+#define DIRECT_MAX_PUBLISHERS 16
+#define DIRECT_POLL_MS 50
+#define DIRECT_STALL_TIMEOUT_MS 1000         // A subscriber that takes nothing this long is dropped,
+#define DIRECT_QUEUE_MAX (64u * 1024 * 1024) // as is one that falls this far behind
+#define DIRECT_RECV_BUF_INITIAL 65536
+#define DIRECT_MAX_FRAME (256u * 1024 * 1024)
+#define DIRECT_DRAIN_TIMEOUT_MS 1000
+#define DIRECT_CONNECT_TIMEOUT_MS 500 // An endpoint not connected by then is dropped
+
+// A connected subscriber. queue holds frame bytes its socket did not take yet.
+typedef struct {
+    int fd;
+    uint8_t* queue;
+    size_t queue_start;
+    size_t queue_end;
+    size_t queue_capacity;
+    uint64_t progress_ns; // When the queue last started or moved
+} direct_peer_t;
+
+struct zetabus_direct_pub_s {
+    zetabus_publisher_t* publisher;
+    int listen_fd;
+    int wake_fd; // Tells the thread a queue has started
+    char endpoint[DIRECT_ENDPOINT_MAX];
+    char* announce_subject;
+    natsSubscription* query_sub;
+
+    pthread_t thread; // Accepts subscribers and notices when they hang up
+    atomic_bool running;
+
+    pthread_mutex_t lock;
+    direct_peer_t* peers;
+    size_t peer_count;
+    size_t peer_capacity;
+    uint64_t dropped_peers; // Stalled subscribers disconnected
+};
+
+typedef struct {
+    int fd;
+    char endpoint[DIRECT_ENDPOINT_MAX];
+    bool connecting;      // Until the non-blocking connect completes...
+    uint64_t deadline_ns; // ...or this passes
+    uint8_t* buf;
+    size_t capacity;
+    size_t start;
+    size_t end;
+} direct_conn_t;
+
+struct zetabus_direct_sub_s {
+    zetabus_subscriber_t* subscriber;
+    natsSubscription* announce_sub;
+
+    pthread_t thread; // Connects to announced publishers and receives from them
+    atomic_bool running;
+
+    pthread_mutex_t lock;
+    char pending[DIRECT_MAX_PUBLISHERS][DIRECT_ENDPOINT_MAX];
+    size_t pending_count;
+
+    direct_conn_t conns[DIRECT_MAX_PUBLISHERS]; // Owned by the thread
+    size_t conn_count;
+};
+
+static char* make_subject(const char* prefix, const char* topic) {
+    size_t len = strlen(prefix) + strlen(topic) + 1;
+    char* subject = (char*)malloc(len);
+    if (subject) snprintf(subject, len, "%s%s", prefix, topic);
+    return subject;
+}
+
+// Stop a discovery subscription and wait out any callback still running on it
+static void stop_subscription(natsSubscription* sub) {
+    if (!sub) return;
+    if (natsSubscription_Drain(sub) != NATS_OK ||
+        natsSubscription_WaitForDrainCompletion(sub, DIRECT_DRAIN_TIMEOUT_MS) != NATS_OK) {
+        natsSubscription_Unsubscribe(sub);
+    }
+    natsSubscription_Destroy(sub);
+}
+
+static size_t iov_total(const struct iovec* iov, int iovcnt) {
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; i++) total += iov[i].iov_len;
+    return total;
+}
+
+// Publisher side
+
+static void remove_peer_locked(zetabus_direct_pub_t* direct, size_t index) {
+    close(direct->peers[index].fd);
+    free(direct->peers[index].queue);
+    direct->peers[index] = direct->peers[--direct->peer_count];
+}
+
+// Send what the peer has queued, as far as its socket takes it (-1 when the
+// peer is gone)
+static int flush_peer_locked(direct_peer_t* peer, uint64_t now) {
+    while (peer->queue_start < peer->queue_end) {
+        ssize_t n = send(peer->fd, peer->queue + peer->queue_start, peer->queue_end - peer->queue_start,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        peer->queue_start += (size_t)n;
+        peer->progress_ns = now;
+    }
+    peer->queue_start = peer->queue_end = 0;
+    return 0;
+}
+
+// Queue the unsent tail of a frame, skipping the first written bytes (-1 when
+// the peer is too far behind or memory runs out)
+static int queue_frame_locked(direct_peer_t* peer, const struct iovec* iov, int iovcnt, size_t written) {
+    size_t queued = peer->queue_end - peer->queue_start;
+    size_t total = iov_total(iov, iovcnt) - written;
+    if (queued > 0 && queued + total > DIRECT_QUEUE_MAX) return -1;
+
+    if (peer->queue_start > 0 && peer->queue_end + total > peer->queue_capacity) {
+        memmove(peer->queue, peer->queue + peer->queue_start, queued);
+        peer->queue_start = 0;
+        peer->queue_end = queued;
+    }
+    if (queued + total > peer->queue_capacity) {
+        size_t capacity = peer->queue_capacity ? peer->queue_capacity : DIRECT_RECV_BUF_INITIAL;
+        while (capacity < queued + total) capacity *= 2;
+        uint8_t* queue = (uint8_t*)realloc(peer->queue, capacity);
+        if (!queue) return -1;
+        peer->queue = queue;
+        peer->queue_capacity = capacity;
+    }
+
+    for (int i = 0; i < iovcnt; i++) {
+        size_t len = iov[i].iov_len;
+        if (written >= len) {
+            written -= len;
+            continue;
+        }
+        memcpy(peer->queue + peer->queue_end, (const uint8_t*)iov[i].iov_base + written, len - written);
+        peer->queue_end += len - written;
+        written = 0;
+    }
+    return 0;
+}
+
+static void _query_handler(natsConnection* nc, natsSubscription* sub, natsMsg* msg, void* closure) {
+    zetabus_direct_pub_t* direct = (zetabus_direct_pub_t*)closure;
+    natsConnection_Publish(nc, direct->announce_subject, direct->endpoint, (int)strlen(direct->endpoint));
+    natsMsg_Destroy(msg);
+}
+
+static void drop_stalled_peer_locked(zetabus_direct_pub_t* direct, size_t index) {
+    direct->dropped_peers++;
+    remove_peer_locked(direct, index);
+}
+
+static void* direct_pub_thread(void* arg) {
+    zetabus_direct_pub_t* direct = (zetabus_direct_pub_t*)arg;
+    struct pollfd* fds = NULL;
+    size_t fds_capacity = 0;
+
+    while (atomic_load(&direct->running)) {
+        pthread_mutex_lock(&direct->lock);
+        size_t count = direct->peer_count;
+        if (count + 2 > fds_capacity) {
+            struct pollfd* grown = (struct pollfd*)realloc(fds, (count + 2) * sizeof(struct pollfd));
+            if (!grown) {
+                pthread_mutex_unlock(&direct->lock);
+                poll(NULL, 0, DIRECT_POLL_MS);
+                continue;
+            }
+            fds = grown;
+            fds_capacity = count + 2;
+        }
+        fds[0] = (struct pollfd){ .fd = direct->listen_fd, .events = POLLIN };
+        fds[1] = (struct pollfd){ .fd = direct->wake_fd, .events = POLLIN };
+        for (size_t i = 0; i < count; i++) {
+            // Subscribers never write, so readable means they hung up
+            direct_peer_t* peer = &direct->peers[i];
+            short events = POLLIN | (peer->queue_start < peer->queue_end ? POLLOUT : 0);
+            fds[i + 2] = (struct pollfd){ .fd = peer->fd, .events = events };
+        }
+        pthread_mutex_unlock(&direct->lock);
+
+        int ready = poll(fds, count + 2, DIRECT_POLL_MS);
+        if (ready > 0 && (fds[1].revents & POLLIN)) {
+            uint64_t value;
+            if (read(direct->wake_fd, &value, sizeof(value)) < 0) { /* Nothing to drain */ }
+        }
+
+        pthread_mutex_lock(&direct->lock);
+        uint64_t now = zeta_clock_monotonic_ns();
+        for (size_t i = 2; ready > 0 && i < count + 2; i++) {
+            if (!fds[i].revents) continue;
+            for (size_t j = 0; j < direct->peer_count; j++) {
+                if (direct->peers[j].fd != fds[i].fd) continue;
+                if ((fds[i].revents & ~POLLOUT) || flush_peer_locked(&direct->peers[j], now) != 0) {
+                    remove_peer_locked(direct, j);
+                }
+                break;
+            }
+        }
+        size_t i = 0;
+        while (i < direct->peer_count) {
+            direct_peer_t* peer = &direct->peers[i];
+            if (peer->queue_start < peer->queue_end &&
+                now - peer->progress_ns > (uint64_t)DIRECT_STALL_TIMEOUT_MS * 1000000ULL) {
+                drop_stalled_peer_locked(direct, i);
+                continue;
+            }
+            i++;
+        }
+        pthread_mutex_unlock(&direct->lock);
+
+        if (ready > 0 && (fds[0].revents & POLLIN)) {
+            int fd = accept(direct->listen_fd, NULL, NULL);
+            if (fd < 0) continue;
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+            pthread_mutex_lock(&direct->lock);
+            if (direct->peer_count == direct->peer_capacity) {
+                size_t cap = direct->peer_capacity ? direct->peer_capacity * 2 : 4;
+                direct_peer_t* peers = (direct_peer_t*)realloc(direct->peers, cap * sizeof(direct_peer_t));
+                if (peers) {
+                    direct->peers = peers;
+                    direct->peer_capacity = cap;
+                }
+            }
+            if (direct->peer_count < direct->peer_capacity) {
+                direct->peers[direct->peer_count++] = (direct_peer_t){ .fd = fd };
+            } else {
+                close(fd);
+            }
+            pthread_mutex_unlock(&direct->lock);
+        }
+    }
+
+    free(fds);
+    return NULL;
+}
+
+// Address peers should use to reach us: the interface our NATS connection uses
+static void local_host(natsConnection* nc, char* host, size_t size) {
+    char* ip = NULL;
+    int port = 0;
+    if (natsConnection_GetLocalIPAndPort(nc, &ip, &port) == NATS_OK && ip && strchr(ip, ':') == NULL) {
+        snprintf(host, size, "%s", ip);
+    } else {
+        snprintf(host, size, "127.0.0.1");
+    }
+    free(ip);
+}
+
+zetabus_direct_pub_t* zetabus_direct_pub_create(zetabus_publisher_t* publisher) {
+    zetabus_t* bus = publisher->bus;
+    zetabus_direct_pub_t* direct = (zetabus_direct_pub_t*)calloc(1, sizeof(zetabus_direct_pub_t));
+    if (!direct) return NULL;
+    direct->publisher = publisher;
+
+    direct->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    direct->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (direct->listen_fd < 0 || direct->wake_fd < 0) {
+        if (direct->listen_fd >= 0) close(direct->listen_fd);
+        if (direct->wake_fd >= 0) close(direct->wake_fd);
+        free(direct);
+        return NULL;
+    }
+
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_ANY), .sin_port = 0 };
+    socklen_t addr_len = sizeof(addr);
+    char* query_subject = make_subject(DIRECT_QUERY_PREFIX, publisher->topic);
+    direct->announce_subject = make_subject(DIRECT_ANNOUNCE_PREFIX, publisher->topic);
+    if (!query_subject || !direct->announce_subject ||
+        bind(direct->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(direct->listen_fd, 16) != 0 ||
+        getsockname(direct->listen_fd, (struct sockaddr*)&addr, &addr_len) != 0) {
+        goto fail;
+    }
+
+    char host[INET_ADDRSTRLEN];
+    local_host(bus->nc, host, sizeof(host));
+    snprintf(direct->endpoint, sizeof(direct->endpoint), "%s:%u", host, (unsigned)ntohs(addr.sin_port));
+
+    pthread_mutex_init(&direct->lock, NULL);
+    atomic_init(&direct->running, true);
+    if (pthread_create(&direct->thread, NULL, direct_pub_thread, direct) != 0) {
+        pthread_mutex_destroy(&direct->lock);
+        goto fail;
+    }
+
+    // Answer subscribers that start after us, and tell the ones already waiting
+    if (natsConnection_Subscribe(&direct->query_sub, bus->nc, query_subject, _query_handler, direct) != NATS_OK) {
+        direct->query_sub = NULL;
+        zetabus_direct_pub_destroy(direct);
+        free(query_subject);
+        return NULL;
+    }
+    natsConnection_Publish(bus->nc, direct->announce_subject, direct->endpoint, (int)strlen(direct->endpoint));
+    free(query_subject);
+    return direct;
+
+fail:
+    close(direct->listen_fd);
+    close(direct->wake_fd);
+    free(query_subject);
+    free(direct->announce_subject);
+    free(direct);
+    return NULL;
+}
+
+void zetabus_direct_pub_destroy(zetabus_direct_pub_t* direct) {
+    if (!direct) return;
+
+    stop_subscription(direct->query_sub);
+    atomic_store(&direct->running, false);
+    pthread_join(direct->thread, NULL);
+
+    close(direct->listen_fd);
+    close(direct->wake_fd);
+    for (size_t i = 0; i < direct->peer_count; i++) {
+        close(direct->peers[i].fd);
+        free(direct->peers[i].queue);
+    }
+    pthread_mutex_destroy(&direct->lock);
+    free(direct->peers);
+    free(direct->announce_subject);
+    free(direct);
+}
+
+int zetabus_direct_publish(zetabus_direct_pub_t* direct, const void* data, size_t size) {
+    if (size > DIRECT_MAX_FRAME) return -1;
+
+    uint8_t header[4] = {
+        (uint8_t)size, (uint8_t)(size >> 8), (uint8_t)(size >> 16), (uint8_t)(size >> 24)
+    };
+
+    struct iovec iov[2] = {
+        { .iov_base = header, .iov_len = sizeof(header) },
+        { .iov_base = (void*)data, .iov_len = size }
+    };
+    size_t total = sizeof(header) + size;
+
+    pthread_mutex_lock(&direct->lock);
+    uint64_t now = zeta_clock_monotonic_ns();
+    bool wake = false;
+    size_t i = 0;
+    while (i < direct->peer_count) {
+        direct_peer_t* peer = &direct->peers[i];
+        if (peer->queue_start < peer->queue_end && flush_peer_locked(peer, now) != 0) {
+            remove_peer_locked(direct, i);
+            continue;
+        }
+
+        size_t written = 0;
+        if (peer->queue_start == peer->queue_end) {
+            // sendmsg is writev plus MSG_NOSIGNAL, so a dead peer is an error, not SIGPIPE
+            struct msghdr msg = { .msg_iov = iov, .msg_iovlen = 2 };
+            ssize_t n;
+            do {
+                n = sendmsg(peer->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+            } while (n < 0 && errno == EINTR);
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                remove_peer_locked(direct, i);
+                continue;
+            }
+            written = n > 0 ? (size_t)n : 0;
+            if (written == total) {
+                i++;
+                continue;
+            }
+            peer->progress_ns = now;
+            wake = true;
+        }
+
+        // The rest follows the peer's backlog; the publisher thread sends it
+        if (queue_frame_locked(peer, iov, 2, written) != 0) {
+            drop_stalled_peer_locked(direct, i);
+            continue;
+        }
+        i++;
+    }
+    pthread_mutex_unlock(&direct->lock);
+
+    if (wake) {
+        uint64_t one = 1;
+        if (write(direct->wake_fd, &one, sizeof(one)) < 0) { /* The thread still polls the queue soon */ }
+    }
+    return 0;
+}
+
+void zetabus_direct_pub_get_stats(zetabus_direct_pub_t* direct, zetabus_publisher_stats_t* stats) {
+    pthread_mutex_lock(&direct->lock);
+    stats->direct_dropped_peers = direct->dropped_peers;
+    pthread_mutex_unlock(&direct->lock);
+}
+
+// Subscriber side
+
+static void _announce_handler(natsConnection* nc, natsSubscription* sub, natsMsg* msg, void* closure) {
+    zetabus_direct_sub_t* direct = (zetabus_direct_sub_t*)closure;
+    int len = natsMsg_GetDataLength(msg);
+
+    if (len > 0 && len < DIRECT_ENDPOINT_MAX) {
+        pthread_mutex_lock(&direct->lock);
+        if (direct->pending_count < DIRECT_MAX_PUBLISHERS) {
+            memcpy(direct->pending[direct->pending_count], natsMsg_GetData(msg), (size_t)len);
+            direct->pending[direct->pending_count][len] = '\0';
+            direct->pending_count++;
+        }
+        pthread_mutex_unlock(&direct->lock);
+    }
+    natsMsg_Destroy(msg);
+}
+
+// Start connecting to a publisher without waiting: the thread's poll sees the
+// connection through (finish_connect) or gives up on it
+static int connect_endpoint(const char endpoint[DIRECT_ENDPOINT_MAX]) {
+    char host[DIRECT_ENDPOINT_MAX];
+    memcpy(host, endpoint, sizeof(host));
+    char* colon = strrchr(host, ':');
+    if (!colon) return -1;
+    *colon = '\0';
+
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons((uint16_t)atoi(colon + 1)) };
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) return -1;
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 && errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// The socket is writable: 0 if the connect succeeded, -1 if it failed
+static int finish_connect(direct_conn_t* conn) {
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &error, &len) != 0 || error != 0) return -1;
+
+    // Frames are read once poll says so, a blocking read at a time
+    int flags = fcntl(conn->fd, F_GETFL);
+    if (flags < 0 || fcntl(conn->fd, F_SETFL, flags & ~O_NONBLOCK) != 0) return -1;
+    int on = 1;
+    setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    conn->connecting = false;
+    return 0;
+}
+
+static void connect_pending(zetabus_direct_sub_t* direct) {
+    char pending[DIRECT_MAX_PUBLISHERS][DIRECT_ENDPOINT_MAX];
+    pthread_mutex_lock(&direct->lock);
+    size_t count = direct->pending_count;
+    memcpy(pending, direct->pending, count * DIRECT_ENDPOINT_MAX);
+    direct->pending_count = 0;
+    pthread_mutex_unlock(&direct->lock);
+
+    for (size_t i = 0; i < count && direct->conn_count < DIRECT_MAX_PUBLISHERS; i++) {
+        bool known = false;
+        for (size_t j = 0; j < direct->conn_count && !known; j++) {
+            known = strcmp(direct->conns[j].endpoint, pending[i]) == 0;
+        }
+        if (known) continue;
+
+        int fd = connect_endpoint(pending[i]);
+        if (fd < 0) continue;
+        direct_conn_t* conn = &direct->conns[direct->conn_count];
+        memset(conn, 0, sizeof(*conn));
+        conn->fd = fd;
+        memcpy(conn->endpoint, pending[i], sizeof(conn->endpoint));
+        conn->connecting = true;
+        conn->deadline_ns = zeta_clock_monotonic_ns() + (uint64_t)DIRECT_CONNECT_TIMEOUT_MS * 1000000ULL;
+        direct->conn_count++;
+    }
+}
+
+static void close_conn(zetabus_direct_sub_t* direct, size_t index) {
+    close(direct->conns[index].fd);
+    free(direct->conns[index].buf);
+    direct->conns[index] = direct->conns[--direct->conn_count];
+}
+
+// Read what is available and deliver every complete frame (0, or -1 when the
+// connection is done)
+static int receive_frames(zetabus_direct_sub_t* direct, direct_conn_t* conn) {
+    zetabus_subscriber_t* subscriber = direct->subscriber;
+
+    if (!conn->buf) {
+        conn->buf = (uint8_t*)malloc(DIRECT_RECV_BUF_INITIAL);
+        if (!conn->buf) return -1;
+        conn->capacity = DIRECT_RECV_BUF_INITIAL;
+    }
+
+    ssize_t n;
+    do {
+        n = recv(conn->fd, conn->buf + conn->end, conn->capacity - conn->end, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return -1;
+    conn->end += (size_t)n;
+
+    while (conn->end - conn->start >= 4) {
+        const uint8_t* p = conn->buf + conn->start;
+        uint32_t size = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+        if (size > DIRECT_MAX_FRAME) return -1;
+        if (conn->end - conn->start < 4 + (size_t)size) {
+            // Grow once for a frame larger than the buffer; it is reused after
+            if (4 + (size_t)size > conn->capacity) {
+                uint8_t* buf = (uint8_t*)malloc(4 + (size_t)size);
+                if (!buf) return -1;
+                memcpy(buf, conn->buf + conn->start, conn->end - conn->start);
+                free(conn->buf);
+                conn->buf = buf;
+                conn->capacity = 4 + (size_t)size;
+                conn->end -= conn->start;
+                conn->start = 0;
+            }
+            break;
+        }
+        subscriber->callback(subscriber->topic, p + 4, size);
+        conn->start += 4 + (size_t)size;
+    }
+
+    // Keep the partial frame at the front so the next read has room
+    if (conn->start == conn->end) {
+        conn->start = conn->end = 0;
+    } else if (conn->start > 0 && conn->end == conn->capacity) {
+        memmove(conn->buf, conn->buf + conn->start, conn->end - conn->start);
+        conn->end -= conn->start;
+        conn->start = 0;
+    }
+    return 0;
+}
+
+static void* direct_sub_thread(void* arg) {
+    zetabus_direct_sub_t* direct = (zetabus_direct_sub_t*)arg;
+    struct pollfd fds[DIRECT_MAX_PUBLISHERS];
+
+    while (atomic_load(&direct->running)) {
+        connect_pending(direct);
+
+        // Connections still being made wait to be writable, the rest to be readable
+        size_t count = direct->conn_count;
+        for (size_t i = 0; i < count; i++) {
+            short events = direct->conns[i].connecting ? POLLOUT : POLLIN;
+            fds[i] = (struct pollfd){ .fd = direct->conns[i].fd, .events = events };
+        }
+        int ready = poll(fds, count, DIRECT_POLL_MS);
+        uint64_t now = zeta_clock_monotonic_ns();
+
+        // Walk backwards so closing (swap with last) does not skip a connection
+        for (size_t i = count; i-- > 0;) {
+            direct_conn_t* conn = &direct->conns[i];
+            bool failed;
+            if (conn->connecting) {
+                failed = fds[i].revents ? finish_connect(conn) != 0 : now >= conn->deadline_ns;
+            } else {
+                failed = ready > 0 && fds[i].revents && receive_frames(direct, conn) != 0;
+            }
+            if (failed) close_conn(direct, i);
+        }
+    }
+
+    while (direct->conn_count > 0) {
+        close_conn(direct, direct->conn_count - 1);
+    }
+    return NULL;
+}
+
+zetabus_direct_sub_t* zetabus_direct_sub_create(zetabus_subscriber_t* subscriber) {
+    zetabus_t* bus = subscriber->bus;
+    zetabus_direct_sub_t* direct = (zetabus_direct_sub_t*)calloc(1, sizeof(zetabus_direct_sub_t));
+    if (!direct) return NULL;
+    direct->subscriber = subscriber;
+
+    char* announce_subject = make_subject(DIRECT_ANNOUNCE_PREFIX, subscriber->topic);
+    char* query_subject = make_subject(DIRECT_QUERY_PREFIX, subscriber->topic);
+    if (!announce_subject || !query_subject) goto fail;
+
+    pthread_mutex_init(&direct->lock, NULL);
+    atomic_init(&direct->running, true);
+    if (pthread_create(&direct->thread, NULL, direct_sub_thread, direct) != 0) {
+        pthread_mutex_destroy(&direct->lock);
+        goto fail;
+    }
+
+    if (natsConnection_Subscribe(&direct->announce_sub, bus->nc, announce_subject,
+                                 _announce_handler, direct) != NATS_OK) {
+        direct->announce_sub = NULL;
+        zetabus_direct_sub_destroy(direct);
+        free(announce_subject);
+        free(query_subject);
+        return NULL;
+    }
+
+    // Publishers that are already running answer with an announcement
+    natsConnection_Publish(bus->nc, query_subject, NULL, 0);
+    free(announce_subject);
+    free(query_subject);
+    return direct;
+
+fail:
+    free(announce_subject);
+    free(query_subject);
+    free(direct);
+    return NULL;
+}
+
+void zetabus_direct_sub_destroy(zetabus_direct_sub_t* direct) {
+    if (!direct) return;
+
+    stop_subscription(direct->announce_sub);
+    atomic_store(&direct->running, false);
+    pthread_join(direct->thread, NULL);
+    pthread_mutex_destroy(&direct->lock);
+    free(direct);
+}
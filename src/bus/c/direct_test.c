@@ -0,0 +1,333 @@
+#include "bus.h"
+#include "bus_internal.h"
+#include "fake_nats_server.h"
+#include <arpa/inet.h>
+#include <assert.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// Discovery runs through an in-process NATS server; frames travel over
+// loopback TCP straight from the publisher
+static char g_url[64];
+
+static const char* g_topic;
+static atomic_int g_early_count;
+static atomic_int g_late_count;
+static atomic_int g_bad;
+
+static char g_endpoint[64];
+static atomic_int g_announced;
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static uint64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+static int wait_for(atomic_int* count, int target, int timeout_ms) {
+    for (int i = 0; i < timeout_ms && atomic_load(count) < target; i++) {
+        sleep_ms(1);
+    }
+    return atomic_load(count);
+}
+
+// Payload byte i of a frame of size bytes is (i + size) & 0xff
+static void fill(uint8_t* buf, size_t size) {
+    for (size_t i = 0; i < size; i++) buf[i] = (uint8_t)(i + size);
+}
+
+static int check(const void* data, size_t size) {
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++) {
+        if (p[i] != (uint8_t)(i + size)) return -1;
+    }
+    return 0;
+}
+
+static void on_early(const char* topic, const void* data, size_t size) {
+    if (strcmp(topic, g_topic) != 0 || check(data, size) != 0) atomic_fetch_add(&g_bad, 1);
+    atomic_fetch_add(&g_early_count, 1);
+}
+
+static void on_late(const char* topic, const void* data, size_t size) {
+    if (check(data, size) != 0) atomic_fetch_add(&g_bad, 1);
+    atomic_fetch_add(&g_late_count, 1);
+}
+
+static void on_announce(const char* topic, const void* data, size_t size) {
+    if (size < sizeof(g_endpoint) && atomic_load(&g_announced) == 0) {
+        memcpy(g_endpoint, data, size);
+        g_endpoint[size] = '\0';
+        atomic_store(&g_announced, 1);
+    }
+}
+
+// A raw subscriber that connects to the publisher and never reads
+static int connect_stalled(const char* endpoint) {
+    char host[64];
+    snprintf(host, sizeof(host), "%s", endpoint);
+    char* colon = strrchr(host, ':');
+    assert(colon);
+    *colon = '\0';
+
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons((uint16_t)atoi(colon + 1)) };
+    assert(inet_pton(AF_INET, host, &addr.sin_addr) == 1);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(fd >= 0);
+    int small = 4096;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+    assert(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+    return fd;
+}
+
+// A listener with a full backlog, so connecting to it hangs: listen_fd and the
+// connections filling the backlog are returned in fds, its endpoint in endpoint
+static void make_unresponsive(int fds[4], char* endpoint, size_t len) {
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addr_len = sizeof(addr);
+    fds[0] = socket(AF_INET, SOCK_STREAM, 0);
+    assert(fds[0] >= 0);
+    assert(bind(fds[0], (struct sockaddr*)&addr, sizeof(addr)) == 0);
+    assert(listen(fds[0], 0) == 0);
+    assert(getsockname(fds[0], (struct sockaddr*)&addr, &addr_len) == 0);
+    for (int i = 1; i < 4; i++) {
+        fds[i] = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        assert(fds[i] >= 0);
+        connect(fds[i], (struct sockaddr*)&addr, sizeof(addr));
+    }
+    snprintf(endpoint, len, "127.0.0.1:%d", ntohs(addr.sin_port));
+
+    // Check that one more connection attempt gets nowhere
+    int probe = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    assert(probe >= 0);
+    assert(connect(probe, (struct sockaddr*)&addr, sizeof(addr)) != 0 && errno == EINPROGRESS);
+    struct pollfd pfd = { .fd = probe, .events = POLLOUT };
+    assert(poll(&pfd, 1, 200) == 0);
+    close(probe);
+}
+
+// Read what the publisher left in the socket; 0 once it hung up
+static int drain_until_closed(int fd, int timeout_ms) {
+    struct timeval timeout = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    char buf[65536];
+    for (;;) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n == 0) return 0;
+        if (n < 0) return errno == ECONNRESET ? 0 : -1;
+    }
+}
+
+void test_discovery_and_delivery(void) {
+    printf("Running test_discovery_and_delivery...\n");
+    g_topic = "cam.image";
+    atomic_store(&g_early_count, 0);
+    atomic_store(&g_late_count, 0);
+    atomic_store(&g_bad, 0);
+
+    zetabus_t* bus = zetabus_create(g_url);
+    assert(bus);
+
+    // One subscriber starts before the publisher, one after it
+    zetabus_subscriber_t* early = zetabus_subscriber_create_direct(bus, "cam.image", on_early);
+    assert(early);
+    zetabus_publisher_t* pub = zetabus_publisher_create(bus, "cam.image");
+    assert(zetabus_publisher_enable_direct(pub) == 0);
+    assert(zetabus_publisher_enable_spool(pub, "unused.spool", 0) != 0);
+    zetabus_subscriber_t* late = zetabus_subscriber_create_direct(bus, "cam.image", on_late);
+    assert(late);
+    assert(zetabus_subscriber_create_direct(bus, "cam.*", on_late) == NULL);
+
+    // Wait until both have connected, which a probe frame shows
+    const uint8_t probe[1] = { 1 };
+    for (int i = 0; i < 200 && (atomic_load(&g_early_count) == 0 || atomic_load(&g_late_count) == 0); i++) {
+        assert(zetabus_publish(pub, probe, sizeof(probe)) == 0);
+        sleep_ms(10);
+    }
+    sleep_ms(50);
+    int early_base = atomic_load(&g_early_count);
+    int late_base = atomic_load(&g_late_count);
+    assert(early_base > 0 && late_base > 0);
+
+    // Empty, small, and larger than the socket buffers
+    static const size_t sizes[] = { 0, 1, 100, 70000, 3 * 1024 * 1024, 5 };
+    uint8_t* buf = (uint8_t*)malloc(3 * 1024 * 1024);
+    assert(buf);
+    for (int round = 0; round < 20; round++) {
+        for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+            fill(buf, sizes[k]);
+            assert(zetabus_publish(pub, buf, sizes[k]) == 0);
+        }
+    }
+    assert(wait_for(&g_early_count, early_base + 120, 10000) == early_base + 120);
+    assert(wait_for(&g_late_count, late_base + 120, 10000) == late_base + 120);
+    assert(atomic_load(&g_bad) == 0);
+
+    // A subscriber that is gone stops receiving; the other keeps going
+    zetabus_subscriber_destroy(late);
+    sleep_ms(100);
+    for (int i = 0; i < 10; i++) {
+        fill(buf, 3);
+        assert(zetabus_publish(pub, buf, 3) == 0);
+    }
+    assert(wait_for(&g_early_count, early_base + 130, 5000) == early_base + 130);
+    assert(atomic_load(&g_late_count) == late_base + 120);
+
+    free(buf);
+    zetabus_publisher_destroy(pub);
+    zetabus_subscriber_destroy(early);
+    zetabus_destroy(bus);
+    printf("test_discovery_and_delivery PASSED\n");
+}
+
+void test_stalled_subscriber(void) {
+    printf("Running test_stalled_subscriber...\n");
+    g_topic = "cam.stall";
+    atomic_store(&g_early_count, 0);
+    atomic_store(&g_bad, 0);
+    atomic_store(&g_announced, 0);
+
+    zetabus_t* bus = zetabus_create(g_url);
+    assert(bus);
+    char announce_subject[128];
+    snprintf(announce_subject, sizeof(announce_subject), "_ZETA.direct.announce.cam.stall");
+    zetabus_subscriber_t* announce = zetabus_subscriber_create(bus, announce_subject, on_announce);
+    assert(announce);
+
+    zetabus_subscriber_t* healthy = zetabus_subscriber_create_direct(bus, "cam.stall", on_early);
+    assert(healthy);
+    zetabus_publisher_t* pub = zetabus_publisher_create(bus, "cam.stall");
+    assert(zetabus_publisher_enable_direct(pub) == 0);
+    assert(wait_for(&g_announced, 1, 5000) == 1);
+
+    // A peer that stops reading is dropped after a second without progress
+    int idle_fd = connect_stalled(g_endpoint);
+    const uint8_t probe[1] = { 1 };
+    for (int i = 0; i < 200 && atomic_load(&g_early_count) == 0; i++) {
+        assert(zetabus_publish(pub, probe, sizeof(probe)) == 0);
+        sleep_ms(10);
+    }
+    sleep_ms(50);
+    int base = atomic_load(&g_early_count);
+    assert(base > 0);
+
+    size_t size = 1024 * 1024;
+    uint8_t* buf = (uint8_t*)malloc(size);
+    assert(buf);
+    fill(buf, size);
+    for (int i = 0; i < 8; i++) {
+        assert(zetabus_publish(pub, buf, size) == 0);
+    }
+    assert(wait_for(&g_early_count, base + 8, 5000) == base + 8);
+    sleep_ms(1500);
+    assert(drain_until_closed(idle_fd, 1000) == 0);
+    close(idle_fd);
+    zetabus_publisher_stats_t stats;
+    assert(zetabus_publisher_get_stats(pub, &stats) == 0);
+    assert(stats.direct_dropped_peers == 1);
+
+    // Publishing never waits on a stalled peer, which is dropped once it falls
+    // too far behind
+    int backlog_fd = connect_stalled(g_endpoint);
+    sleep_ms(100);
+    uint64_t start = monotonic_ms();
+    uint64_t slowest = 0;
+    for (int i = 0; i < 100; i++) {
+        uint64_t before = monotonic_ms();
+        assert(zetabus_publish(pub, buf, size) == 0);
+        uint64_t took = monotonic_ms() - before;
+        if (took > slowest) slowest = took;
+    }
+    assert(slowest < 500);
+    assert(monotonic_ms() - start < 5000);
+    assert(wait_for(&g_early_count, base + 108, 10000) == base + 108);
+    assert(atomic_load(&g_bad) == 0);
+
+    assert(drain_until_closed(backlog_fd, 3000) == 0);
+    close(backlog_fd);
+    assert(zetabus_publisher_get_stats(pub, &stats) == 0);
+    assert(stats.direct_dropped_peers == 2);
+
+    // The healthy subscriber kept receiving throughout
+    for (int i = 0; i < 10; i++) {
+        assert(zetabus_publish(pub, buf, size) == 0);
+    }
+    assert(wait_for(&g_early_count, base + 118, 5000) == base + 118);
+
+    free(buf);
+    zetabus_publisher_destroy(pub);
+    zetabus_subscriber_destroy(healthy);
+    zetabus_subscriber_destroy(announce);
+    zetabus_destroy(bus);
+    printf("test_stalled_subscriber PASSED\n");
+}
+
+// Test that an endpoint that never answers does not hold up the others
+void test_unresponsive_endpoint(void) {
+    printf("Running test_unresponsive_endpoint...\n");
+    g_topic = "cam.hang";
+    atomic_store(&g_early_count, 0);
+    atomic_store(&g_bad, 0);
+
+    int hang[4];
+    char endpoint[64];
+    make_unresponsive(hang, endpoint, sizeof(endpoint));
+
+    zetabus_t* bus = zetabus_create(g_url);
+    assert(bus);
+    zetabus_subscriber_t* sub = zetabus_subscriber_create_direct(bus, "cam.hang", on_early);
+    assert(sub);
+
+    // The dead endpoint is announced first, then a live publisher
+    zetabus_publisher_t* fake = zetabus_publisher_create(bus, "_ZETA.direct.announce.cam.hang");
+    assert(fake && zetabus_publish(fake, endpoint, strlen(endpoint)) == 0);
+    zetabus_publisher_t* pub = zetabus_publisher_create(bus, "cam.hang");
+    assert(zetabus_publisher_enable_direct(pub) == 0);
+
+    // Well before a blocking connect to the dead endpoint would give up
+    uint64_t start = monotonic_ms();
+    const uint8_t probe[1] = { 1 };
+    for (int i = 0; i < 100 && atomic_load(&g_early_count) == 0; i++) {
+        assert(zetabus_publish(pub, probe, sizeof(probe)) == 0);
+        sleep_ms(10);
+    }
+    assert(atomic_load(&g_early_count) > 0);
+    assert(monotonic_ms() - start < 1000);
+    assert(atomic_load(&g_bad) == 0);
+
+    zetabus_publisher_destroy(pub);
+    zetabus_publisher_destroy(fake);
+    zetabus_subscriber_destroy(sub);
+    zetabus_destroy(bus);
+    for (int i = 0; i < 4; i++) close(hang[i]);
+    printf("test_unresponsive_endpoint PASSED\n");
+}
+
+int main(void) {
+    printf("Running direct channel tests...\n\n");
+
+    fake_nats_t* server = fake_nats_start();
+    assert(server);
+    snprintf(g_url, sizeof(g_url), "nats://%s", fake_nats_address(server));
+
+    test_discovery_and_delivery();
+    test_stalled_subscriber();
+    test_unresponsive_endpoint();
+
+    fake_nats_stop(server);
+    printf("\nAll tests PASSED!\n");
+    return 0;
+}
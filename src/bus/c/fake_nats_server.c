@@ -0,0 +1,412 @@
+#include "fake_nats_server.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FAKE_MAX_PUBS 65536
+#define FAKE_MAX_SUBS 64
+#define FAKE_MAX_LINE 4096
+#define FAKE_POLL_MS 50
+
+typedef struct {
+    char subject[256];
+    char sid[32];
+} fake_sub_t;
+
+struct fake_nats_s {
+    int listen_fd;
+    int wake_fds[2];
+    char address[32];
+    pthread_t thread;
+    atomic_bool running;
+    atomic_bool down;
+    atomic_bool answer_pings;
+    atomic_bool paused;
+
+    // Client socket writes and the subscription table (the server thread owns reads)
+    pthread_mutex_t lock;
+    int client_fd;
+    fake_sub_t subs[FAKE_MAX_SUBS];
+    size_t sub_count;
+    bool handshaking; // CONNECT seen, first PONG not yet sent
+
+    fake_nats_pub_t* pubs;
+    atomic_size_t pub_count;
+    atomic_uint connections;
+    atomic_uint pings;
+
+    char* rbuf;
+    size_t rlen;
+    size_t rcap;
+};
+
+static void write_client_locked(fake_nats_t* server, const void* data, size_t size) {
+    const char* p = (const char*)data;
+    while (server->client_fd >= 0 && size > 0) {
+        ssize_t n = send(server->client_fd, p, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return; // The read side notices the dead client
+        p += n;
+        size -= (size_t)n;
+    }
+}
+
+static void close_client_locked(fake_nats_t* server) {
+    if (server->client_fd >= 0) close(server->client_fd);
+    server->client_fd = -1;
+    server->sub_count = 0;
+    server->rlen = 0;
+}
+
+// NATS subject matching with * and > wildcards
+static bool subject_matches(const char* pattern, const char* subject) {
+    for (;;) {
+        const char* pattern_end = strchr(pattern, '.');
+        const char* subject_end = strchr(subject, '.');
+        size_t pattern_len = pattern_end ? (size_t)(pattern_end - pattern) : strlen(pattern);
+        size_t subject_len = subject_end ? (size_t)(subject_end - subject) : strlen(subject);
+        if (pattern_len == 1 && pattern[0] == '>') return subject_len > 0;
+        if (!(pattern_len == 1 && pattern[0] == '*') &&
+            (pattern_len != subject_len || memcmp(pattern, subject, pattern_len) != 0)) {
+            return false;
+        }
+        if (!pattern_end || !subject_end) return !pattern_end && !subject_end;
+        pattern = pattern_end + 1;
+        subject = subject_end + 1;
+    }
+}
+
+static void route_locked(fake_nats_t* server, const fake_nats_pub_t* pub) {
+    for (size_t i = 0; i < server->sub_count; i++) {
+        if (!subject_matches(server->subs[i].subject, pub->subject)) continue;
+        char line[FAKE_MAX_LINE];
+        int len = pub->reply ? snprintf(line, sizeof(line), "MSG %s %s %s %zu\r\n", pub->subject,
+                                        server->subs[i].sid, pub->reply, pub->size)
+                             : snprintf(line, sizeof(line), "MSG %s %s %zu\r\n", pub->subject,
+                                        server->subs[i].sid, pub->size);
+        write_client_locked(server, line, (size_t)len);
+        write_client_locked(server, pub->data, pub->size);
+        write_client_locked(server, "\r\n", 2);
+    }
+}
+
+// Handle every complete frame in the read buffer
+static void parse(fake_nats_t* server) {
+    size_t pos = 0;
+    while (pos < server->rlen) {
+        char* start = server->rbuf + pos;
+        char* nl = (char*)memchr(start, '\n', server->rlen - pos);
+        if (!nl) break;
+        size_t line_len = (size_t)(nl - start) + 1;
+
+        char line[FAKE_MAX_LINE];
+        size_t text_len = line_len - 1;
+        if (text_len > 0 && start[text_len - 1] == '\r') text_len--;
+        if (text_len >= sizeof(line)) text_len = sizeof(line) - 1;
+        memcpy(line, start, text_len);
+        line[text_len] = '\0';
+
+        char* tokens[5];
+        int count = 0;
+        for (char* save = NULL, *tok = strtok_r(line, " \t", &save); tok && count < 5;
+             tok = strtok_r(NULL, " \t", &save)) {
+            tokens[count++] = tok;
+        }
+        if (count == 0) {
+            pos += line_len;
+            continue;
+        }
+
+        if (strcmp(tokens[0], "PUB") == 0 && (count == 3 || count == 4)) {
+            size_t size = (size_t)strtoull(tokens[count - 1], NULL, 10);
+            if (server->rlen - pos < line_len + size + 2) break; // Payload still arriving
+
+            size_t index = atomic_load(&server->pub_count);
+            fake_nats_pub_t* pub = &server->pubs[index < FAKE_MAX_PUBS ? index : FAKE_MAX_PUBS - 1];
+            if (index < FAKE_MAX_PUBS) {
+                pub->subject = strdup(tokens[1]);
+                pub->reply = count == 4 ? strdup(tokens[2]) : NULL;
+                pub->data = malloc(size ? size : 1);
+                memcpy(pub->data, start + line_len, size);
+                pub->size = size;
+                pub->connection = atomic_load(&server->connections);
+                atomic_store(&server->pub_count, index + 1);
+
+                pthread_mutex_lock(&server->lock);
+                route_locked(server, pub);
+                pthread_mutex_unlock(&server->lock);
+            }
+            pos += line_len + size + 2;
+            continue;
+        }
+
+        pthread_mutex_lock(&server->lock);
+        if (strcmp(tokens[0], "CONNECT") == 0) {
+            server->handshaking = true;
+        } else if (strcmp(tokens[0], "PING") == 0) {
+            atomic_fetch_add(&server->pings, 1);
+            if (atomic_load(&server->answer_pings)) {
+                // The client counts itself connected once this PONG arrives
+                if (server->handshaking) atomic_fetch_add(&server->connections, 1);
+                server->handshaking = false;
+                write_client_locked(server, "PONG\r\n", 6);
+            }
+        } else if (strcmp(tokens[0], "SUB") == 0 && count >= 3 && server->sub_count < FAKE_MAX_SUBS) {
+            fake_sub_t* sub = &server->subs[server->sub_count++];
+            snprintf(sub->subject, sizeof(sub->subject), "%s", tokens[1]);
+            snprintf(sub->sid, sizeof(sub->sid), "%s", tokens[count - 1]);
+        } else if (strcmp(tokens[0], "UNSUB") == 0 && count >= 2) {
+            for (size_t i = 0; i < server->sub_count; i++) {
+                if (strcmp(server->subs[i].sid, tokens[1]) == 0) {
+                    server->subs[i] = server->subs[--server->sub_count];
+                    break;
+                }
+            }
+        }
+        pthread_mutex_unlock(&server->lock);
+        pos += line_len;
+    }
+
+    memmove(server->rbuf, server->rbuf + pos, server->rlen - pos);
+    server->rlen -= pos;
+}
+
+static void accept_client(fake_nats_t* server) {
+    int fd = accept(server->listen_fd, NULL, NULL);
+    if (fd < 0) return;
+    if (atomic_load(&server->down)) {
+        close(fd);
+        return;
+    }
+
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    // A new client replaces the old one, which a reconnecting client has abandoned
+    static const char info[] = "INFO {\"server_id\":\"fake\",\"max_payload\":1048576,\"proto\":1}\r\n";
+    pthread_mutex_lock(&server->lock);
+    close_client_locked(server);
+    server->client_fd = fd;
+    server->handshaking = false;
+    write_client_locked(server, info, sizeof(info) - 1);
+    pthread_mutex_unlock(&server->lock);
+}
+
+static void read_client(fake_nats_t* server) {
+    if (server->rlen == server->rcap) {
+        size_t cap = server->rcap * 2;
+        char* buf = (char*)realloc(server->rbuf, cap);
+        if (!buf) return;
+        server->rbuf = buf;
+        server->rcap = cap;
+    }
+
+    ssize_t n = recv(server->client_fd, server->rbuf + server->rlen, server->rcap - server->rlen, 0);
+    if (n < 0 && errno == EINTR) return;
+    if (n <= 0) {
+        pthread_mutex_lock(&server->lock);
+        close_client_locked(server);
+        pthread_mutex_unlock(&server->lock);
+        return;
+    }
+    server->rlen += (size_t)n;
+    parse(server);
+}
+
+static void* server_thread(void* arg) {
+    fake_nats_t* server = (fake_nats_t*)arg;
+
+    while (atomic_load(&server->running)) {
+        // A server taken down drops whatever the client sent that it had not read
+        if (atomic_load(&server->down) && server->client_fd >= 0) {
+            pthread_mutex_lock(&server->lock);
+            close_client_locked(server);
+            pthread_mutex_unlock(&server->lock);
+        }
+
+        // Only this thread replaces or closes client_fd, so it reads it unlocked
+        struct pollfd fds[3] = {
+            { .fd = server->listen_fd, .events = POLLIN },
+            { .fd = server->wake_fds[0], .events = POLLIN },
+            { .fd = server->client_fd, .events = POLLIN }
+        };
+        int nfds = server->client_fd >= 0 && !atomic_load(&server->paused) ? 3 : 2;
+        if (poll(fds, (nfds_t)nfds, FAKE_POLL_MS) <= 0) continue;
+
+        if (fds[1].revents & POLLIN) {
+            char drain[64];
+            if (read(server->wake_fds[0], drain, sizeof(drain)) < 0) { /* Nothing to drain */ }
+        }
+        if (nfds == 3 && fds[2].revents) read_client(server);
+        if (fds[0].revents & POLLIN) accept_client(server);
+    }
+    return NULL;
+}
+
+fake_nats_t* fake_nats_start(void) {
+    fake_nats_t* server = (fake_nats_t*)calloc(1, sizeof(fake_nats_t));
+    if (!server) return NULL;
+    server->client_fd = -1;
+    server->rcap = 65536;
+    server->rbuf = (char*)malloc(server->rcap);
+    server->pubs = (fake_nats_pub_t*)calloc(FAKE_MAX_PUBS, sizeof(fake_nats_pub_t));
+    server->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (!server->rbuf || !server->pubs || server->listen_fd < 0 || pipe(server->wake_fds) != 0) {
+        if (server->listen_fd >= 0) close(server->listen_fd);
+        free(server->pubs);
+        free(server->rbuf);
+        free(server);
+        return NULL;
+    }
+
+    // Accepted sockets inherit a small receive buffer, so pausing backs the
+    // client up quickly
+    int rcvbuf = 64 * 1024;
+    setsockopt(server->listen_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = 0 };
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    if (bind(server->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(server->listen_fd, 16) != 0 ||
+        getsockname(server->listen_fd, (struct sockaddr*)&addr, &addr_len) != 0) {
+        close(server->listen_fd);
+        close(server->wake_fds[0]);
+        close(server->wake_fds[1]);
+        free(server->pubs);
+        free(server->rbuf);
+        free(server);
+        return NULL;
+    }
+    snprintf(server->address, sizeof(server->address), "127.0.0.1:%u", (unsigned)ntohs(addr.sin_port));
+
+    pthread_mutex_init(&server->lock, NULL);
+    atomic_init(&server->running, true);
+    atomic_init(&server->down, false);
+    atomic_init(&server->answer_pings, true);
+    atomic_init(&server->paused, false);
+    atomic_init(&server->pub_count, 0);
+    atomic_init(&server->connections, 0);
+    atomic_init(&server->pings, 0);
+    if (pthread_create(&server->thread, NULL, server_thread, server) != 0) {
+        pthread_mutex_destroy(&server->lock);
+        close(server->listen_fd);
+        close(server->wake_fds[0]);
+        close(server->wake_fds[1]);
+        free(server->pubs);
+        free(server->rbuf);
+        free(server);
+        return NULL;
+    }
+    return server;
+}
+
+void fake_nats_stop(fake_nats_t* server) {
+    if (!server) return;
+
+    atomic_store(&server->running, false);
+    if (write(server->wake_fds[1], "x", 1) < 0) { /* The thread still wakes on its poll timeout */ }
+    pthread_join(server->thread, NULL);
+
+    close_client_locked(server);
+    close(server->listen_fd);
+    close(server->wake_fds[0]);
+    close(server->wake_fds[1]);
+    pthread_mutex_destroy(&server->lock);
+
+    size_t count = atomic_load(&server->pub_count);
+    for (size_t i = 0; i < count; i++) {
+        free(server->pubs[i].subject);
+        free(server->pubs[i].reply);
+        free(server->pubs[i].data);
+    }
+    free(server->pubs);
+    free(server->rbuf);
+    free(server);
+}
+
+const char* fake_nats_address(const fake_nats_t* server) {
+    return server->address;
+}
+
+void fake_nats_set_down(fake_nats_t* server, bool down) {
+    atomic_store(&server->down, down);
+    if (!down) return;
+
+    // Wakes the client at once; the server thread closes the socket
+    pthread_mutex_lock(&server->lock);
+    if (server->client_fd >= 0) shutdown(server->client_fd, SHUT_RDWR);
+    pthread_mutex_unlock(&server->lock);
+    if (write(server->wake_fds[1], "x", 1) < 0) { /* The thread still wakes on its poll timeout */ }
+}
+
+void fake_nats_set_answer_pings(fake_nats_t* server, bool answer) {
+    atomic_store(&server->answer_pings, answer);
+}
+
+void fake_nats_set_paused(fake_nats_t* server, bool paused) {
+    atomic_store(&server->paused, paused);
+    if (write(server->wake_fds[1], "x", 1) < 0) { /* The thread still wakes on its poll timeout */ }
+}
+
+int fake_nats_send(fake_nats_t* server, const void* data, size_t size, size_t piece, uint32_t gap_us) {
+    const char* p = (const char*)data;
+    if (piece == 0) piece = size;
+
+    // Held throughout so no PONG or MSG from the server thread lands mid-frame
+    pthread_mutex_lock(&server->lock);
+    int ret = server->client_fd >= 0 ? 0 : -1;
+    while (ret == 0 && size > 0) {
+        size_t len = size < piece ? size : piece;
+        write_client_locked(server, p, len);
+        p += len;
+        size -= len;
+        if (size > 0 && gap_us > 0) {
+            struct timespec ts = { .tv_sec = gap_us / 1000000, .tv_nsec = (long)(gap_us % 1000000) * 1000L };
+            nanosleep(&ts, NULL);
+        }
+    }
+    pthread_mutex_unlock(&server->lock);
+    return ret;
+}
+
+size_t fake_nats_pub_count(fake_nats_t* server) {
+    return atomic_load(&server->pub_count);
+}
+
+const fake_nats_pub_t* fake_nats_pub_at(fake_nats_t* server, size_t index) {
+    return index < atomic_load(&server->pub_count) ? &server->pubs[index] : NULL;
+}
+
+uint32_t fake_nats_connections(fake_nats_t* server) {
+    return atomic_load(&server->connections);
+}
+
+uint32_t fake_nats_subs(fake_nats_t* server) {
+    pthread_mutex_lock(&server->lock);
+    uint32_t count = (uint32_t)server->sub_count;
+    pthread_mutex_unlock(&server->lock);
+    return count;
+}
+
+uint32_t fake_nats_pings(fake_nats_t* server) {
+    return atomic_load(&server->pings);
+}
+
+size_t fake_nats_wait_pubs(fake_nats_t* server, size_t count, int timeout_ms) {
+    for (int i = 0; i < timeout_ms && fake_nats_pub_count(server) < count; i++) {
+        struct timespec ts = { .tv_sec = 0, .tv_nsec = 1000000L };
+        nanosleep(&ts, NULL);
+    }
+    return fake_nats_pub_count(server);
+}
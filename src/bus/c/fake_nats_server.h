@@ -0,0 +1,57 @@
+#ifndef ZETA_BUS_FAKE_NATS_SERVER_H
+#define ZETA_BUS_FAKE_NATS_SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// In-process NATS server for tests
+//
+// Listens on an ephemeral loopback port and serves one client connection at a
+// time on its own thread: answers the handshake and PINGs, records every PUB,
+// and routes PUBs to the client's own matching SUBs as MSG frames, so request/
+// reply through an inbox works against a subscriber on the same connection.
+// Tests can take the server down (dropping the client and refusing new ones),
+// stop it answering PINGs, or push raw bytes at the client.
+
+typedef struct fake_nats_s fake_nats_t;
+
+typedef struct {
+    char* subject;
+    char* reply; // NULL when the PUB had none
+    void* data;
+    size_t size;
+    uint32_t connection; // Which connection it arrived on, counting from 1
+} fake_nats_pub_t;
+
+fake_nats_t* fake_nats_start(void);
+void fake_nats_stop(fake_nats_t* server);
+
+// host:port for zetabus_lean_connect (prefix with nats+lean:// for zetabus_create)
+const char* fake_nats_address(const fake_nats_t* server);
+
+// While down the current client is disconnected and new connections are closed
+// before the INFO line
+void fake_nats_set_down(fake_nats_t* server, bool down);
+
+// Stop answering client PINGs, as a half-open connection would
+void fake_nats_set_answer_pings(fake_nats_t* server, bool answer);
+
+// Stop reading from the client, so its socket backs up
+void fake_nats_set_paused(fake_nats_t* server, bool paused);
+
+// Write raw protocol bytes to the current client in pieces of at most piece
+// bytes (0 = all at once), pausing gap_us between them
+int fake_nats_send(fake_nats_t* server, const void* data, size_t size, size_t piece, uint32_t gap_us);
+
+// Counters since start. Published messages are kept in arrival order.
+size_t fake_nats_pub_count(fake_nats_t* server);
+const fake_nats_pub_t* fake_nats_pub_at(fake_nats_t* server, size_t index);
+uint32_t fake_nats_connections(fake_nats_t* server); // Completed handshakes
+uint32_t fake_nats_subs(fake_nats_t* server);        // SUBs on the current connection
+uint32_t fake_nats_pings(fake_nats_t* server);       // PINGs received from clients
+
+// Poll until the server has recorded at least count PUBs (returns the count reached)
+size_t fake_nats_wait_pubs(fake_nats_t* server, size_t count, int timeout_ms);
+
+#endif // ZETA_BUS_FAKE_NATS_SERVER_H
@@ -0,0 +1,885 @@
+#include "nats_lean.h"
+#include "../../clock/c/clock.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LEAN_DEFAULT_PORT "4222"
+#define LEAN_READ_BUF_INITIAL (64 * 1024)
+#define LEAN_WRITE_BACKLOG_MAX (8 * 1024 * 1024) // Publishes wait beyond this
+#define LEAN_WRITE_BLOCK_MS 1000                 // and fail if it does not drain in time
+#define LEAN_MAX_LINE 4096                       // Longest protocol line we accept
+#define LEAN_MAX_SUBJECT 1024
+#define LEAN_CONNECT_TIMEOUT_MS 2000
+#define LEAN_RECONNECT_WAIT_MS 250
+#define LEAN_PING_INTERVAL_MS 5000 // Keepalive PING period
+#define LEAN_MAX_PINGS_OUT 2       // Unanswered PINGs before the connection counts as dead
+
+typedef struct {
+    uint64_t sid;
+    char* subject;
+    zetabus_lean_msg_fn handler;
+    void* closure;
+} lean_sub_t;
+
+typedef struct lean_request_s {
+    uint64_t token;
+    bool done;
+    void* data;
+    size_t size;
+    struct lean_request_s* next;
+} lean_request_t;
+
+struct zetabus_lean_s {
+    char host[256];
+    char port[16];
+    zetabus_lean_state_fn state_cb;
+    void* closure;
+    size_t max_payload;
+
+    int fd;
+    int epoll_fd;
+    int wake_fd;
+    pthread_t thread;
+    atomic_bool running;
+
+    // Read side, owned by the I/O thread
+    char* rbuf;
+    size_t rcap;
+    size_t rstart;
+    size_t rend;
+
+    // Write side: the backlog only holds what the socket did not take. Its
+    // first wfirst bytes finish a frame whose start is already on the wire.
+    pthread_mutex_t write_lock;
+    pthread_cond_t write_cond; // Signalled as the backlog drains
+    bool connected;
+    char* wbuf;
+    size_t wlen;
+    size_t wcap;
+    size_t wfirst;
+    bool want_write;
+
+    pthread_mutex_t sub_lock;
+    lean_sub_t* subs;
+    size_t sub_count;
+    size_t sub_capacity;
+    uint64_t next_sid;
+
+    // Requests share one wildcard inbox subscription; flushes count PONGs
+    char inbox_prefix[40];
+    pthread_mutex_t req_lock;
+    pthread_cond_t req_cond;
+    lean_request_t* requests;
+    uint64_t next_token;
+    uint64_t pings_sent;
+    uint64_t pongs_received;
+    uint64_t generation; // Bumped on disconnect to fail waiters
+    uint32_t ping_interval_ms;
+    uint32_t max_pings_out;
+    zetabus_lean_stats_t stats;
+};
+
+// Helpers
+
+static void deadline_after(struct timespec* ts, int timeout_ms) {
+    clock_gettime(CLOCK_REALTIME, ts);
+    uint64_t nsec = (uint64_t)ts->tv_nsec + (uint64_t)timeout_ms * 1000000ULL;
+    ts->tv_sec += (time_t)(nsec / 1000000000ULL);
+    ts->tv_nsec = (long)(nsec % 1000000000ULL);
+}
+
+static size_t iov_total(const struct iovec* iov, int iovcnt) {
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; i++) total += iov[i].iov_len;
+    return total;
+}
+
+static int wbuf_reserve(zetabus_lean_t* conn, size_t extra) {
+    if (conn->wlen + extra <= conn->wcap) return 0;
+    size_t cap = conn->wcap ? conn->wcap : 65536;
+    while (cap < conn->wlen + extra) cap *= 2;
+    char* buf = (char*)realloc(conn->wbuf, cap);
+    if (!buf) return -1;
+    conn->wbuf = buf;
+    conn->wcap = cap;
+    return 0;
+}
+
+// Length of the complete protocol frame we queued at p: a line, plus the
+// payload and its CRLF for a PUB
+static size_t frame_length(const char* p, size_t avail) {
+    const char* nl = (const char*)memchr(p, '\n', avail);
+    if (!nl) return avail;
+    size_t len = (size_t)(nl - p) + 1;
+    if (len > 4 && memcmp(p, "PUB ", 4) == 0) {
+        const char* last = nl > p && nl[-1] == '\r' ? nl - 1 : nl;
+        while (last > p + 4 && last[-1] != ' ') last--;
+        len += (size_t)strtoull(last, NULL, 10) + 2;
+    }
+    return len < avail ? len : avail;
+}
+
+static void set_want_write(zetabus_lean_t* conn, bool want) {
+    if (conn->want_write == want) return;
+    conn->want_write = want;
+    struct epoll_event ev = { .events = EPOLLIN | (want ? EPOLLOUT : 0), .data.fd = conn->fd };
+    epoll_ctl(conn->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+}
+
+// Write a frame, straight to the socket when nothing is queued ahead of it
+// (write_lock held)
+static int send_locked(zetabus_lean_t* conn, const struct iovec* iov, int iovcnt) {
+    if (!conn->connected) return -1;
+
+    size_t total = iov_total(iov, iovcnt);
+    size_t written = 0;
+    if (conn->wlen == 0) {
+        // sendmsg is writev plus MSG_NOSIGNAL, so a dead peer is an error, not SIGPIPE
+        struct msghdr msg = { .msg_iov = (struct iovec*)iov, .msg_iovlen = (size_t)iovcnt };
+        ssize_t n;
+        do {
+            n = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+        } while (n < 0 && errno == EINTR);
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) return -1;
+        written = n > 0 ? (size_t)n : 0;
+        if (written == total) return 0;
+        conn->wfirst = written > 0 ? total - written : 0;
+    }
+
+    // Part of a frame already went out, so the rest must follow whatever the backlog.
+    // Otherwise wait for room, except on the I/O thread, which is what drains it.
+    if (written == 0 && conn->wlen + total > LEAN_WRITE_BACKLOG_MAX) {
+        if (pthread_equal(pthread_self(), conn->thread)) return -1;
+        struct timespec deadline;
+        deadline_after(&deadline, LEAN_WRITE_BLOCK_MS);
+        while (conn->connected && conn->wlen > 0 && conn->wlen + total > LEAN_WRITE_BACKLOG_MAX) {
+            if (pthread_cond_timedwait(&conn->write_cond, &conn->write_lock, &deadline) == ETIMEDOUT) return -1;
+        }
+        if (!conn->connected) return -1;
+    }
+    if (wbuf_reserve(conn, total - written) != 0) return -1;
+    for (int i = 0; i < iovcnt; i++) {
+        size_t len = iov[i].iov_len;
+        const char* base = (const char*)iov[i].iov_base;
+        if (written >= len) {
+            written -= len;
+            continue;
+        }
+        memcpy(conn->wbuf + conn->wlen, base + written, len - written);
+        conn->wlen += len - written;
+        written = 0;
+    }
+    set_want_write(conn, true);
+    return 0;
+}
+
+static int send_str(zetabus_lean_t* conn, const char* s) {
+    struct iovec iov = { .iov_base = (void*)s, .iov_len = strlen(s) };
+    pthread_mutex_lock(&conn->write_lock);
+    int ret = send_locked(conn, &iov, 1);
+    pthread_mutex_unlock(&conn->write_lock);
+    return ret;
+}
+
+static void flush_backlog(zetabus_lean_t* conn) {
+    pthread_mutex_lock(&conn->write_lock);
+    while (conn->connected && conn->wlen > 0) {
+        ssize_t n = send(conn->fd, conn->wbuf, conn->wlen, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break; // EAGAIN waits for the next EPOLLOUT; errors surface as EPOLLERR
+        }
+        // Find where the first frame not yet started now begins
+        size_t pos = conn->wfirst;
+        while (pos < (size_t)n) pos += frame_length(conn->wbuf + pos, conn->wlen - pos);
+        conn->wfirst = pos - (size_t)n;
+        memmove(conn->wbuf, conn->wbuf + n, conn->wlen - (size_t)n);
+        conn->wlen -= (size_t)n;
+    }
+    if (conn->connected && conn->wlen == 0) set_want_write(conn, false);
+    pthread_cond_broadcast(&conn->write_cond);
+    pthread_mutex_unlock(&conn->write_lock);
+}
+
+// Connection setup (blocking, before the socket joins epoll)
+
+static int wait_fd(int fd, short events, int timeout_ms) {
+    struct pollfd pfd = { .fd = fd, .events = events };
+    int ret;
+    do {
+        ret = poll(&pfd, 1, timeout_ms);
+    } while (ret < 0 && errno == EINTR);
+    return ret > 0 ? 0 : -1;
+}
+
+// Read one protocol line into buf during the handshake
+static int read_line_blocking(int fd, char* buf, size_t size) {
+    size_t len = 0;
+    while (len + 1 < size) {
+        if (wait_fd(fd, POLLIN, LEAN_CONNECT_TIMEOUT_MS) != 0) return -1;
+        ssize_t n = recv(fd, buf + len, 1, 0);
+        if (n <= 0) return -1;
+        if (buf[len++] == '\n') {
+            buf[len] = '\0';
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int write_all_blocking(int fd, const char* s, size_t len) {
+    while (len > 0) {
+        if (wait_fd(fd, POLLOUT, LEAN_CONNECT_TIMEOUT_MS) != 0) return -1;
+        ssize_t n = send(fd, s, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        s += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int open_socket(zetabus_lean_t* conn) {
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo* res = NULL;
+    if (getaddrinfo(conn->host, conn->port, &hints, &res) != 0) return -1;
+
+    int fd = -1;
+    for (struct addrinfo* ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) continue;
+        int ret = connect(fd, ai->ai_addr, ai->ai_addrlen);
+        int err = 0;
+        socklen_t err_len = sizeof(err);
+        if (ret != 0 && (errno != EINPROGRESS || wait_fd(fd, POLLOUT, LEAN_CONNECT_TIMEOUT_MS) != 0 ||
+                         getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len) != 0 || err != 0)) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    if (fd < 0) return -1;
+
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return fd;
+}
+
+// INFO, CONNECT, then a PING whose PONG confirms the server accepted us
+static int handshake(zetabus_lean_t* conn, int fd) {
+    char line[LEAN_MAX_LINE];
+    if (read_line_blocking(fd, line, sizeof(line)) != 0 || strncmp(line, "INFO ", 5) != 0) return -1;
+
+    const char* max_payload = strstr(line, "\"max_payload\":");
+    conn->max_payload = max_payload ? (size_t)strtoull(max_payload + 14, NULL, 10) : 0;
+
+    static const char connect_line[] =
+        "CONNECT {\"verbose\":false,\"pedantic\":false,\"lang\":\"c\",\"version\":\"zeta-lean\","
+        "\"protocol\":1,\"echo\":true,\"headers\":false}\r\nPING\r\n";
+    if (write_all_blocking(fd, connect_line, sizeof(connect_line) - 1) != 0) return -1;
+
+    for (;;) {
+        if (read_line_blocking(fd, line, sizeof(line)) != 0) return -1;
+        if (strncmp(line, "PONG", 4) == 0) return 0;
+        if (strncmp(line, "-ERR", 4) == 0) return -1;
+        if (strncmp(line, "PING", 4) == 0 && write_all_blocking(fd, "PONG\r\n", 6) != 0) return -1;
+    }
+}
+
+// Bring a new socket online and replay our subscriptions (I/O thread or connect)
+static int establish(zetabus_lean_t* conn) {
+    int fd = open_socket(conn);
+    if (fd < 0) return -1;
+    if (handshake(conn, fd) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+    if (epoll_ctl(conn->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    // Flushes attempted while disconnected counted PINGs that never went out
+    pthread_mutex_lock(&conn->req_lock);
+    conn->pongs_received = conn->pings_sent;
+    pthread_mutex_unlock(&conn->req_lock);
+
+    // Replay our subscriptions ahead of the publishes the last connection
+    // left queued, then let the I/O thread send it all
+    pthread_mutex_lock(&conn->sub_lock);
+    pthread_mutex_lock(&conn->write_lock);
+    size_t replay = 0;
+    for (size_t i = 0; i < conn->sub_count; i++) {
+        replay += (size_t)snprintf(NULL, 0, "SUB %s %llu\r\n", conn->subs[i].subject,
+                                   (unsigned long long)conn->subs[i].sid);
+    }
+    if (wbuf_reserve(conn, replay) != 0) {
+        pthread_mutex_unlock(&conn->write_lock);
+        pthread_mutex_unlock(&conn->sub_lock);
+        close(fd);
+        return -1;
+    }
+    memmove(conn->wbuf + replay, conn->wbuf, conn->wlen);
+    size_t pos = 0;
+    for (size_t i = 0; i < conn->sub_count; i++) {
+        char line[LEAN_MAX_SUBJECT + 48];
+        int len = snprintf(line, sizeof(line), "SUB %s %llu\r\n", conn->subs[i].subject,
+                           (unsigned long long)conn->subs[i].sid);
+        memcpy(conn->wbuf + pos, line, (size_t)len);
+        pos += (size_t)len;
+    }
+    conn->wlen += replay;
+    conn->wfirst = 0;
+    conn->fd = fd;
+    conn->connected = true;
+    conn->want_write = false;
+    if (conn->wlen > 0) set_want_write(conn, true);
+    pthread_mutex_unlock(&conn->write_lock);
+    pthread_mutex_unlock(&conn->sub_lock);
+
+    conn->rstart = 0;
+    conn->rend = 0;
+    return 0;
+}
+
+// Keep the queued PUBs for the next connection. The frame cut off mid-write
+// is lost with the socket, SUBs are replayed from the table, and PINGs and
+// PONGs belonged to the old connection.
+static void keep_publishes_locked(zetabus_lean_t* conn) {
+    size_t kept = 0;
+    size_t pos = conn->wfirst;
+    while (pos < conn->wlen) {
+        size_t len = frame_length(conn->wbuf + pos, conn->wlen - pos);
+        if (len > 4 && memcmp(conn->wbuf + pos, "PUB ", 4) == 0) {
+            memmove(conn->wbuf + kept, conn->wbuf + pos, len);
+            kept += len;
+        }
+        pos += len;
+    }
+    conn->wlen = kept;
+    conn->wfirst = 0;
+}
+
+static void drop_connection(zetabus_lean_t* conn) {
+    pthread_mutex_lock(&conn->write_lock);
+    conn->connected = false;
+    close(conn->fd); // Also leaves the epoll set
+    conn->fd = -1;
+    keep_publishes_locked(conn);
+    conn->want_write = false;
+    pthread_cond_broadcast(&conn->write_cond);
+    pthread_mutex_unlock(&conn->write_lock);
+
+    // PINGs in flight died with the socket
+    pthread_mutex_lock(&conn->req_lock);
+    conn->generation++;
+    conn->pongs_received = conn->pings_sent;
+    pthread_cond_broadcast(&conn->req_cond);
+    pthread_mutex_unlock(&conn->req_lock);
+
+    if (conn->state_cb) conn->state_cb(conn->closure, false);
+}
+
+// Protocol parsing
+
+static void deliver(zetabus_lean_t* conn, uint64_t sid, const char* subject, const char* reply,
+                    const void* data, size_t size) {
+    zetabus_lean_msg_fn handler = NULL;
+    void* closure = NULL;
+
+    pthread_mutex_lock(&conn->sub_lock);
+    for (size_t i = 0; i < conn->sub_count; i++) {
+        if (conn->subs[i].sid == sid) {
+            handler = conn->subs[i].handler;
+            closure = conn->subs[i].closure;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&conn->sub_lock);
+
+    // Called unlocked so handlers may publish or subscribe
+    if (handler) handler(closure, subject, reply, data, size);
+}
+
+static void reply_handler(void* closure, const char* subject, const char* reply, const void* data, size_t size) {
+    zetabus_lean_t* conn = (zetabus_lean_t*)closure;
+    uint64_t token = strtoull(subject + strlen(conn->inbox_prefix), NULL, 10);
+
+    pthread_mutex_lock(&conn->req_lock);
+    for (lean_request_t* req = conn->requests; req; req = req->next) {
+        if (req->token == token && !req->done) {
+            req->data = malloc(size ? size : 1);
+            if (req->data) {
+                memcpy(req->data, data, size);
+                req->size = size;
+            }
+            req->done = true;
+            pthread_cond_broadcast(&conn->req_cond);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&conn->req_lock);
+}
+
+// Split a MSG line in place: subject sid [reply] size
+static int parse_msg_args(char* args, char* end, char** tokens, int max_tokens) {
+    int count = 0;
+    char* p = args;
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+        if (p == end) break;
+        if (count == max_tokens) return -1;
+        tokens[count++] = p;
+        while (p < end && *p != ' ' && *p != '\t') p++;
+        *p = '\0'; // Overwrites the separator, or the '\r' after the last token
+        p++;
+    }
+    return count;
+}
+
+// Consume every complete frame in the read buffer (-1 on protocol error)
+static int parse(zetabus_lean_t* conn) {
+    while (conn->rstart < conn->rend) {
+        char* line = conn->rbuf + conn->rstart;
+        size_t avail = conn->rend - conn->rstart;
+        char* nl = (char*)memchr(line, '\n', avail);
+        if (!nl) return avail > LEAN_MAX_LINE ? -1 : 0;
+        size_t line_len = (size_t)(nl - line) + 1;
+        char* line_end = nl > line && nl[-1] == '\r' ? nl - 1 : nl;
+
+        if (line_len > 4 && strncmp(line, "MSG ", 4) == 0) {
+            // Parse a copy of the bounds first: tokens are terminated in place only
+            // once the payload is known to be complete
+            const char* last = line_end;
+            while (last > line + 4 && last[-1] != ' ' && last[-1] != '\t') last--;
+            size_t size = (size_t)strtoull(last, NULL, 10);
+            if (avail < line_len + size + 2) return 0; // Payload still arriving
+
+            char* tokens[4];
+            int count = parse_msg_args(line + 4, line_end, tokens, 4);
+            if (count != 3 && count != 4) return -1;
+            uint64_t sid = strtoull(tokens[1], NULL, 10);
+            const char* reply = count == 4 ? tokens[2] : NULL;
+            deliver(conn, sid, tokens[0], reply, line + line_len, size);
+            conn->rstart += line_len + size + 2;
+            continue;
+        }
+
+        if (strncmp(line, "PING", 4) == 0) {
+            send_str(conn, "PONG\r\n");
+        } else if (strncmp(line, "PONG", 4) == 0) {
+            pthread_mutex_lock(&conn->req_lock);
+            conn->pongs_received++;
+            pthread_cond_broadcast(&conn->req_cond);
+            pthread_mutex_unlock(&conn->req_lock);
+        } else if (strncmp(line, "-ERR", 4) == 0) {
+            // Fatal errors are followed by the server closing the socket
+            const char* text = line + 4;
+            while (text < line_end && *text == ' ') text++;
+            pthread_mutex_lock(&conn->req_lock);
+            conn->stats.server_errors++;
+            snprintf(conn->stats.last_error, sizeof(conn->stats.last_error), "%.*s",
+                     (int)(line_end - text), text);
+            pthread_mutex_unlock(&conn->req_lock);
+        } else if (strncmp(line, "+OK", 3) != 0 && strncmp(line, "INFO", 4) != 0) {
+            return -1;
+        }
+        conn->rstart += line_len;
+    }
+    conn->rstart = 0;
+    conn->rend = 0;
+    return 0;
+}
+
+// Read until the socket is drained (-1 when the connection is gone)
+static int read_and_parse(zetabus_lean_t* conn) {
+    for (;;) {
+        if (conn->rend == conn->rcap) {
+            if (conn->rstart > 0) {
+                memmove(conn->rbuf, conn->rbuf + conn->rstart, conn->rend - conn->rstart);
+                conn->rend -= conn->rstart;
+                conn->rstart = 0;
+            } else {
+                // A message larger than the buffer; the buffer keeps the size
+                char* buf = (char*)realloc(conn->rbuf, conn->rcap * 2);
+                if (!buf) return -1;
+                conn->rbuf = buf;
+                conn->rcap *= 2;
+            }
+        }
+
+        ssize_t n = recv(conn->fd, conn->rbuf + conn->rend, conn->rcap - conn->rend, 0);
+        if (n == 0) return -1;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        conn->rend += (size_t)n;
+        if (parse(conn) != 0) return -1;
+    }
+}
+
+// I/O thread
+
+// Send a keepalive PING, or fail (-1) when too many went unanswered, which is
+// how a half-open connection shows
+static int keepalive(zetabus_lean_t* conn) {
+    pthread_mutex_lock(&conn->req_lock);
+    bool dead = conn->pings_sent - conn->pongs_received >= conn->max_pings_out;
+    if (dead) {
+        conn->stats.keepalive_timeouts++;
+    } else {
+        conn->pings_sent++;
+    }
+    pthread_mutex_unlock(&conn->req_lock);
+
+    if (dead) return -1;
+    send_str(conn, "PING\r\n");
+    return 0;
+}
+
+static void* io_thread(void* arg) {
+    zetabus_lean_t* conn = (zetabus_lean_t*)arg;
+    struct epoll_event events[8];
+    bool connected = true;
+    uint64_t last_ping_ns = zeta_clock_monotonic_ns();
+
+    while (atomic_load(&conn->running)) {
+        if (!connected) {
+            if (establish(conn) == 0) {
+                connected = true;
+                last_ping_ns = zeta_clock_monotonic_ns();
+                if (conn->state_cb) conn->state_cb(conn->closure, true);
+                continue;
+            }
+        }
+
+        int timeout_ms = LEAN_RECONNECT_WAIT_MS;
+        if (connected) {
+            pthread_mutex_lock(&conn->req_lock);
+            uint64_t interval_ns = (uint64_t)conn->ping_interval_ms * 1000000ULL;
+            pthread_mutex_unlock(&conn->req_lock);
+
+            uint64_t now = zeta_clock_monotonic_ns();
+            if (now - last_ping_ns >= interval_ns) {
+                if (keepalive(conn) != 0) {
+                    drop_connection(conn);
+                    connected = false;
+                    continue;
+                }
+                last_ping_ns = now;
+            }
+            timeout_ms = (int)((last_ping_ns + interval_ns - now + 999999ULL) / 1000000ULL);
+        }
+
+        int n = epoll_wait(conn->epoll_fd, events, 8, timeout_ms);
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == conn->wake_fd) {
+                uint64_t value;
+                if (read(conn->wake_fd, &value, sizeof(value)) < 0) { /* Nothing to drain */ }
+                continue;
+            }
+            if (!connected) continue;
+            if (events[i].events & EPOLLOUT) flush_backlog(conn);
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                if (read_and_parse(conn) != 0) {
+                    drop_connection(conn);
+                    connected = false;
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+// Public API
+
+static void parse_host_port(zetabus_lean_t* conn, const char* host_port) {
+    const char* colon = strrchr(host_port, ':');
+    size_t host_len = colon ? (size_t)(colon - host_port) : strlen(host_port);
+    if (host_len >= sizeof(conn->host)) host_len = sizeof(conn->host) - 1;
+    memcpy(conn->host, host_port, host_len);
+    conn->host[host_len] = '\0';
+    snprintf(conn->port, sizeof(conn->port), "%s", colon ? colon + 1 : LEAN_DEFAULT_PORT);
+
+    // Strip a trailing path
+    char* slash = strchr(conn->port, '/');
+    if (slash) *slash = '\0';
+}
+
+zetabus_lean_t* zetabus_lean_connect(const char* host_port, zetabus_lean_state_fn state_cb, void* closure) {
+    if (!host_port || strchr(host_port, '@')) return NULL; // No auth support
+
+    zetabus_lean_t* conn = (zetabus_lean_t*)calloc(1, sizeof(zetabus_lean_t));
+    if (!conn) return NULL;
+    parse_host_port(conn, host_port);
+    conn->state_cb = state_cb;
+    conn->closure = closure;
+    conn->fd = -1;
+    conn->next_sid = 1;
+    conn->ping_interval_ms = LEAN_PING_INTERVAL_MS;
+    conn->max_pings_out = LEAN_MAX_PINGS_OUT;
+
+    pthread_mutex_init(&conn->write_lock, NULL);
+    pthread_cond_init(&conn->write_cond, NULL);
+    pthread_mutex_init(&conn->sub_lock, NULL);
+    pthread_mutex_init(&conn->req_lock, NULL);
+    pthread_cond_init(&conn->req_cond, NULL);
+
+    conn->rbuf = (char*)malloc(LEAN_READ_BUF_INITIAL);
+    conn->rcap = LEAN_READ_BUF_INITIAL;
+    conn->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    conn->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (!conn->rbuf || conn->epoll_fd < 0 || conn->wake_fd < 0) goto fail;
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = conn->wake_fd };
+    if (epoll_ctl(conn->epoll_fd, EPOLL_CTL_ADD, conn->wake_fd, &ev) != 0) goto fail;
+
+    // Replies for every request arrive on one wildcard inbox
+    uint64_t nonce = 0;
+    int urandom = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    if (urandom >= 0) {
+        if (read(urandom, &nonce, sizeof(nonce)) != sizeof(nonce)) nonce = 0;
+        close(urandom);
+    }
+    if (nonce == 0) nonce = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+    snprintf(conn->inbox_prefix, sizeof(conn->inbox_prefix), "_INBOX.%016llx.", (unsigned long long)nonce);
+    char inbox[sizeof(conn->inbox_prefix) + 1];
+    snprintf(inbox, sizeof(inbox), "%s*", conn->inbox_prefix);
+    if (zetabus_lean_subscribe(conn, inbox, reply_handler, conn) == 0) goto fail;
+
+    if (establish(conn) != 0) goto fail;
+
+    atomic_init(&conn->running, true);
+    if (pthread_create(&conn->thread, NULL, io_thread, conn) != 0) {
+        close(conn->fd);
+        goto fail;
+    }
+    return conn;
+
+fail:
+    for (size_t i = 0; i < conn->sub_count; i++) free(conn->subs[i].subject);
+    free(conn->subs);
+    if (conn->epoll_fd >= 0) close(conn->epoll_fd);
+    if (conn->wake_fd >= 0) close(conn->wake_fd);
+    pthread_cond_destroy(&conn->req_cond);
+    pthread_mutex_destroy(&conn->req_lock);
+    pthread_mutex_destroy(&conn->sub_lock);
+    pthread_mutex_destroy(&conn->write_lock);
+    pthread_cond_destroy(&conn->write_cond);
+    free(conn->rbuf);
+    free(conn);
+    return NULL;
+}
+
+void zetabus_lean_close(zetabus_lean_t* conn) {
+    if (!conn) return;
+
+    atomic_store(&conn->running, false);
+    uint64_t one = 1;
+    if (write(conn->wake_fd, &one, sizeof(one)) < 0) { /* The thread still wakes on its timeout */ }
+    pthread_join(conn->thread, NULL);
+
+    // Best effort: hand the server what is still queued
+    if (conn->connected && conn->wlen > 0) {
+        (void)write_all_blocking(conn->fd, conn->wbuf, conn->wlen);
+    }
+    if (conn->fd >= 0) close(conn->fd);
+    close(conn->epoll_fd);
+    close(conn->wake_fd);
+
+    for (size_t i = 0; i < conn->sub_count; i++) free(conn->subs[i].subject);
+    free(conn->subs);
+    pthread_cond_destroy(&conn->req_cond);
+    pthread_mutex_destroy(&conn->req_lock);
+    pthread_mutex_destroy(&conn->sub_lock);
+    pthread_mutex_destroy(&conn->write_lock);
+    pthread_cond_destroy(&conn->write_cond);
+    free(conn->rbuf);
+    free(conn->wbuf);
+    free(conn);
+}
+
+int zetabus_lean_publish(zetabus_lean_t* conn, const char* subject, const char* reply,
+                         const void* data, size_t size) {
+    if (!conn || !subject || (size > 0 && !data)) return -1;
+    if (conn->max_payload > 0 && size > conn->max_payload) return -1;
+
+    char line[2 * LEAN_MAX_SUBJECT + 48];
+    int len = reply ? snprintf(line, sizeof(line), "PUB %s %s %zu\r\n", subject, reply, size)
+                    : snprintf(line, sizeof(line), "PUB %s %zu\r\n", subject, size);
+    if (len < 0 || (size_t)len >= sizeof(line)) return -1;
+
+    struct iovec iov[3] = {
+        { .iov_base = line, .iov_len = (size_t)len },
+        { .iov_base = (void*)data, .iov_len = size },
+        { .iov_base = (void*)"\r\n", .iov_len = 2 }
+    };
+    pthread_mutex_lock(&conn->write_lock);
+    int ret = send_locked(conn, iov, 3);
+    pthread_mutex_unlock(&conn->write_lock);
+    return ret;
+}
+
+uint64_t zetabus_lean_subscribe(zetabus_lean_t* conn, const char* subject,
+                                zetabus_lean_msg_fn handler, void* closure) {
+    if (!conn || !subject || !handler || strlen(subject) > LEAN_MAX_SUBJECT) return 0;
+
+    pthread_mutex_lock(&conn->sub_lock);
+    if (conn->sub_count == conn->sub_capacity) {
+        size_t cap = conn->sub_capacity ? conn->sub_capacity * 2 : 8;
+        lean_sub_t* subs = (lean_sub_t*)realloc(conn->subs, cap * sizeof(lean_sub_t));
+        if (!subs) {
+            pthread_mutex_unlock(&conn->sub_lock);
+            return 0;
+        }
+        conn->subs = subs;
+        conn->sub_capacity = cap;
+    }
+    lean_sub_t* sub = &conn->subs[conn->sub_count];
+    sub->subject = strdup(subject);
+    if (!sub->subject) {
+        pthread_mutex_unlock(&conn->sub_lock);
+        return 0;
+    }
+    sub->sid = conn->next_sid++;
+    sub->handler = handler;
+    sub->closure = closure;
+    conn->sub_count++;
+
+    // While disconnected the SUB is sent on reconnect
+    char line[LEAN_MAX_SUBJECT + 48];
+    int len = snprintf(line, sizeof(line), "SUB %s %llu\r\n", subject, (unsigned long long)sub->sid);
+    struct iovec iov = { .iov_base = line, .iov_len = (size_t)len };
+    pthread_mutex_lock(&conn->write_lock);
+    if (conn->connected) send_locked(conn, &iov, 1);
+    pthread_mutex_unlock(&conn->write_lock);
+
+    uint64_t sid = sub->sid;
+    pthread_mutex_unlock(&conn->sub_lock);
+    return sid;
+}
+
+int zetabus_lean_unsubscribe(zetabus_lean_t* conn, uint64_t sid) {
+    if (!conn || sid == 0) return -1;
+
+    pthread_mutex_lock(&conn->sub_lock);
+    size_t i = 0;
+    while (i < conn->sub_count && conn->subs[i].sid != sid) i++;
+    if (i == conn->sub_count) {
+        pthread_mutex_unlock(&conn->sub_lock);
+        return -1;
+    }
+    free(conn->subs[i].subject);
+    conn->subs[i] = conn->subs[--conn->sub_count];
+
+    char line[48];
+    int len = snprintf(line, sizeof(line), "UNSUB %llu\r\n", (unsigned long long)sid);
+    struct iovec iov = { .iov_base = line, .iov_len = (size_t)len };
+    pthread_mutex_lock(&conn->write_lock);
+    if (conn->connected) send_locked(conn, &iov, 1);
+    pthread_mutex_unlock(&conn->write_lock);
+    pthread_mutex_unlock(&conn->sub_lock);
+    return 0;
+}
+
+int zetabus_lean_request(zetabus_lean_t* conn, const char* subject, const void* data, size_t size,
+                         int timeout_ms, void** reply, size_t* reply_size) {
+    if (!conn || !subject || !reply || !reply_size) return -1;
+
+    lean_request_t req = {0};
+    pthread_mutex_lock(&conn->req_lock);
+    req.token = ++conn->next_token;
+    req.next = conn->requests;
+    conn->requests = &req;
+    uint64_t generation = conn->generation;
+    pthread_mutex_unlock(&conn->req_lock);
+
+    char reply_subject[sizeof(conn->inbox_prefix) + 24];
+    snprintf(reply_subject, sizeof(reply_subject), "%s%llu", conn->inbox_prefix, (unsigned long long)req.token);
+    int ret = zetabus_lean_publish(conn, subject, reply_subject, data, size);
+
+    struct timespec deadline;
+    deadline_after(&deadline, timeout_ms);
+    pthread_mutex_lock(&conn->req_lock);
+    while (ret == 0 && !req.done && conn->generation == generation) {
+        if (pthread_cond_timedwait(&conn->req_cond, &conn->req_lock, &deadline) == ETIMEDOUT) break;
+    }
+    for (lean_request_t** p = &conn->requests; *p; p = &(*p)->next) {
+        if (*p == &req) {
+            *p = req.next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&conn->req_lock);
+
+    if (ret != 0 || !req.done || !req.data) {
+        free(req.data);
+        return -1;
+    }
+    *reply = req.data;
+    *reply_size = req.size;
+    return 0;
+}
+
+int zetabus_lean_flush(zetabus_lean_t* conn, int timeout_ms) {
+    if (!conn) return -1;
+
+    // PONGs come back in PING order, so ours is the pings_sent-th one
+    pthread_mutex_lock(&conn->req_lock);
+    uint64_t target = ++conn->pings_sent;
+    uint64_t generation = conn->generation;
+    pthread_mutex_unlock(&conn->req_lock);
+
+    if (send_str(conn, "PING\r\n") != 0) return -1;
+
+    struct timespec deadline;
+    deadline_after(&deadline, timeout_ms);
+    pthread_mutex_lock(&conn->req_lock);
+    int ret = 0;
+    while (conn->pongs_received < target) {
+        if (conn->generation != generation ||
+            pthread_cond_timedwait(&conn->req_cond, &conn->req_lock, &deadline) == ETIMEDOUT) {
+            ret = -1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&conn->req_lock);
+    return ret;
+}
+
+void zetabus_lean_set_keepalive(zetabus_lean_t* conn, uint32_t interval_ms, uint32_t max_pings_out) {
+    if (!conn || interval_ms == 0 || max_pings_out == 0) return;
+
+    pthread_mutex_lock(&conn->req_lock);
+    conn->ping_interval_ms = interval_ms;
+    conn->max_pings_out = max_pings_out;
+    pthread_mutex_unlock(&conn->req_lock);
+
+    // Rearm the I/O thread's timer with the new period
+    uint64_t one = 1;
+    if (write(conn->wake_fd, &one, sizeof(one)) < 0) { /* Applies from the next wakeup */ }
+}
+
+void zetabus_lean_get_stats(zetabus_lean_t* conn, zetabus_lean_stats_t* stats) {
+    pthread_mutex_lock(&conn->req_lock);
+    *stats = conn->stats;
+    pthread_mutex_unlock(&conn->req_lock);
+}
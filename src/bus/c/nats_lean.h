@@ -0,0 +1,72 @@
+#ifndef ZETA_BUS_NATS_LEAN_H
+#define ZETA_BUS_NATS_LEAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Lean NATS protocol client
+//
+// A minimal core-NATS client for the bus hot path: one epoll I/O thread per
+// connection parses server frames in place in a reusable read buffer and
+// calls message handlers inline, without a per-message allocation or a thread
+// hop. Publishes go out with a single writev of the PUB line, the caller's
+// payload and the trailer, and are only copied when the socket is backed up.
+// Supports PUB/SUB/UNSUB, request/reply through one shared inbox, PING/PONG
+// keepalive and reconnecting with re-subscription. No TLS, auth, headers or
+// JetStream.
+//
+// The client PINGs the server every 5 seconds and treats a connection with 2
+// PINGs unanswered as dead, so a half-open link is noticed. After reconnecting
+// it replays its subscriptions, then sends the publishes the dropped
+// connection still had queued; only a frame cut off mid-write (and whatever
+// the kernel had buffered) is lost with the old socket.
+
+typedef struct zetabus_lean_s zetabus_lean_t;
+
+// Called on the I/O thread. subject and data point into the read buffer and
+// are only valid during the call.
+typedef void (*zetabus_lean_msg_fn)(void* closure, const char* subject, const char* reply,
+                                    const void* data, size_t size);
+
+// Called on the I/O thread when the connection drops (false) or comes back (true)
+typedef void (*zetabus_lean_state_fn)(void* closure, bool connected);
+
+// Connect to host:port (blocks until the server answered the first PING)
+zetabus_lean_t* zetabus_lean_connect(const char* host_port, zetabus_lean_state_fn state_cb, void* closure);
+void zetabus_lean_close(zetabus_lean_t* conn);
+
+// What went wrong on the connection so far. The client does not log; callers
+// poll these to report server errors and dead links.
+typedef struct {
+    uint64_t server_errors;      // -ERR lines received
+    uint64_t keepalive_timeouts; // Connections dropped for unanswered PINGs
+    char last_error[128];        // Text of the latest -ERR, "" before the first
+} zetabus_lean_stats_t;
+
+void zetabus_lean_get_stats(zetabus_lean_t* conn, zetabus_lean_stats_t* stats);
+
+// Change the keepalive PING period and how many unanswered PINGs drop the
+// connection (defaults 5000 ms and 2)
+void zetabus_lean_set_keepalive(zetabus_lean_t* conn, uint32_t interval_ms, uint32_t max_pings_out);
+
+// Fails (-1) while disconnected. When the socket is backed up past the write
+// backlog limit, waits up to a second for it to drain (fails at once on the
+// I/O thread).
+int zetabus_lean_publish(zetabus_lean_t* conn, const char* subject, const char* reply,
+                         const void* data, size_t size);
+
+// Returns the subscription id, or 0 on failure. The handler may still be
+// called once for a message already being delivered when unsubscribe returns.
+uint64_t zetabus_lean_subscribe(zetabus_lean_t* conn, const char* subject,
+                                zetabus_lean_msg_fn handler, void* closure);
+int zetabus_lean_unsubscribe(zetabus_lean_t* conn, uint64_t sid);
+
+// Send a request and wait for the first reply. *reply is malloc'd; free it.
+int zetabus_lean_request(zetabus_lean_t* conn, const char* subject, const void* data, size_t size,
+                         int timeout_ms, void** reply, size_t* reply_size);
+
+// Round trip a PING so everything published before has reached the server
+int zetabus_lean_flush(zetabus_lean_t* conn, int timeout_ms);
+
+#endif // ZETA_BUS_NATS_LEAN_H
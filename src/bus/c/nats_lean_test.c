@@ -0,0 +1,338 @@
+#include "nats_lean.h"
+#include "fake_nats_server.h"
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// The lean client against an in-process NATS server on loopback, which can
+// split frames, drop the client, stop reading or stop answering PINGs
+
+#define MAX_RECEIVED 64
+
+typedef struct {
+    atomic_int count;
+    char subjects[MAX_RECEIVED][64];
+    char replies[MAX_RECEIVED][64];
+    char data[MAX_RECEIVED][64];
+    size_t sizes[MAX_RECEIVED];
+    atomic_int large_ok;
+} received_t;
+
+static atomic_int g_connected;
+static atomic_int g_state_changes;
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static int wait_for(atomic_int* value, int target, int timeout_ms) {
+    for (int i = 0; i < timeout_ms && atomic_load(value) != target; i++) {
+        sleep_ms(1);
+    }
+    return atomic_load(value);
+}
+
+static void on_state(void* closure, bool connected) {
+    atomic_store(&g_connected, connected ? 1 : 0);
+    atomic_fetch_add(&g_state_changes, 1);
+}
+
+static void on_message(void* closure, const char* subject, const char* reply, const void* data, size_t size) {
+    received_t* received = (received_t*)closure;
+    int i = atomic_load(&received->count);
+    if (i < MAX_RECEIVED) {
+        snprintf(received->subjects[i], sizeof(received->subjects[i]), "%s", subject);
+        snprintf(received->replies[i], sizeof(received->replies[i]), "%s", reply ? reply : "");
+        size_t copy = size < sizeof(received->data[i]) - 1 ? size : sizeof(received->data[i]) - 1;
+        memcpy(received->data[i], data, copy);
+        received->data[i][copy] = '\0';
+        received->sizes[i] = size;
+    }
+    if (size > 1000) {
+        const uint8_t* p = (const uint8_t*)data;
+        int ok = 1;
+        for (size_t j = 0; j < size && ok; j++) ok = p[j] == (uint8_t)(j * 7);
+        atomic_store(&received->large_ok, ok);
+    }
+    atomic_store(&received->count, i + 1);
+}
+
+// Answers requests on svc.echo with the request payload
+static void on_echo(void* closure, const char* subject, const char* reply, const void* data, size_t size) {
+    zetabus_lean_t* conn = *(zetabus_lean_t**)closure;
+    if (reply) zetabus_lean_publish(conn, reply, NULL, data, size);
+}
+
+static zetabus_lean_t* connect_to(fake_nats_t* server) {
+    atomic_store(&g_connected, 1);
+    atomic_store(&g_state_changes, 0);
+    zetabus_lean_t* conn = zetabus_lean_connect(fake_nats_address(server), on_state, NULL);
+    assert(conn);
+    return conn;
+}
+
+void test_publish_subscribe(void) {
+    printf("Running test_publish_subscribe...\n");
+
+    fake_nats_t* server = fake_nats_start();
+    assert(server);
+    zetabus_lean_t* conn = connect_to(server);
+    static received_t received;
+    atomic_store(&received.count, 0);
+    atomic_store(&received.large_ok, 0);
+    assert(zetabus_lean_subscribe(conn, "robot.>", on_message, &received) != 0);
+    assert(zetabus_lean_flush(conn, 2000) == 0);
+
+    assert(zetabus_lean_publish(conn, "robot.imu", NULL, "hello", 5) == 0);
+    assert(zetabus_lean_publish(conn, "other.topic", NULL, "skip", 4) == 0);
+    assert(zetabus_lean_publish(conn, "robot.empty", NULL, NULL, 0) == 0);
+
+    // Larger than the initial read buffer, so it grows mid-message
+    size_t large = 200 * 1024;
+    uint8_t* buf = (uint8_t*)malloc(large);
+    assert(buf);
+    for (size_t i = 0; i < large; i++) buf[i] = (uint8_t)(i * 7);
+    assert(zetabus_lean_publish(conn, "robot.cloud", NULL, buf, large) == 0);
+    free(buf);
+
+    assert(wait_for(&received.count, 3, 2000) == 3);
+    assert(strcmp(received.subjects[0], "robot.imu") == 0);
+    assert(strcmp(received.data[0], "hello") == 0);
+    assert(strcmp(received.subjects[1], "robot.empty") == 0 && received.sizes[1] == 0);
+    assert(received.sizes[2] == large && atomic_load(&received.large_ok));
+    assert(fake_nats_pub_count(server) == 4);
+
+    zetabus_lean_close(conn);
+    fake_nats_stop(server);
+    printf("test_publish_subscribe PASSED\n");
+}
+
+void test_split_frames(void) {
+    printf("Running test_split_frames...\n");
+
+    fake_nats_t* server = fake_nats_start();
+    assert(server);
+    zetabus_lean_t* conn = connect_to(server);
+    static received_t received;
+    atomic_store(&received.count, 0);
+    uint64_t sid = zetabus_lean_subscribe(conn, "split", on_message, &received);
+    assert(sid != 0);
+    assert(zetabus_lean_flush(conn, 2000) == 0);
+
+    // One byte per read, across the MSG line, the payload and the trailer
+    char frame[256];
+    int len = snprintf(frame, sizeof(frame), "MSG split %llu 10\r\nhello\r\nbus\r\n", (unsigned long long)sid);
+    assert(fake_nats_send(server, frame, (size_t)len, 1, 2000) == 0);
+    assert(wait_for(&received.count, 1, 2000) == 1);
+    assert(received.sizes[0] == 10 && strcmp(received.data[0], "hello\r\nbus") == 0);
+
+    // Two frames and a server PING in one write, then a reply subject split in
+    // odd-sized pieces
+    len = snprintf(frame, sizeof(frame), "MSG split %llu 3\r\nabc\r\nPING\r\nMSG split %llu 0\r\n\r\n",
+                   (unsigned long long)sid, (unsigned long long)sid);
+    assert(fake_nats_send(server, frame, (size_t)len, 0, 0) == 0);
+    len = snprintf(frame, sizeof(frame), "MSG split %llu _INBOX.x 4\r\nwxyz\r\n", (unsigned long long)sid);
+    assert(fake_nats_send(server, frame, (size_t)len, 7, 2000) == 0);
+    assert(wait_for(&received.count, 4, 2000) == 4);
+    assert(strcmp(received.data[1], "abc") == 0);
+    assert(received.sizes[2] == 0);
+    assert(strcmp(received.data[3], "wxyz") == 0 && strcmp(received.replies[3], "_INBOX.x") == 0);
+
+    // Still in sync: the client answered the PING and keeps working
+    assert(zetabus_lean_flush(conn, 2000) == 0);
+    assert(atomic_load(&g_state_changes) == 0);
+
+    // Server errors are counted, and the latest one kept
+    const char* err = "-ERR 'Permissions Violation for Publish to split'\r\n";
+    assert(fake_nats_send(server, err, strlen(err), 5, 1000) == 0);
+    assert(zetabus_lean_flush(conn, 2000) == 0);
+    zetabus_lean_stats_t stats;
+    zetabus_lean_get_stats(conn, &stats);
+    assert(stats.server_errors == 1 && stats.keepalive_timeouts == 0);
+    assert(strcmp(stats.last_error, "'Permissions Violation for Publish to split'") == 0);
+
+    zetabus_lean_close(conn);
+    fake_nats_stop(server);
+    printf("test_split_frames PASSED\n");
+}
+
+void test_request_and_flush(void) {
+    printf("Running test_request_and_flush...\n");
+
+    fake_nats_t* server = fake_nats_start();
+    assert(server);
+    static zetabus_lean_t* conn;
+    conn = connect_to(server);
+    assert(zetabus_lean_subscribe(conn, "svc.echo", on_echo, &conn) != 0);
+
+    for (int i = 0; i < 10; i++) {
+        char request[32];
+        int len = snprintf(request, sizeof(request), "ping %d", i);
+        void* reply = NULL;
+        size_t reply_size = 0;
+        assert(zetabus_lean_request(conn, "svc.echo", request, (size_t)len, 2000, &reply, &reply_size) == 0);
+        assert(reply_size == (size_t)len && memcmp(reply, request, reply_size) == 0);
+        free(reply);
+    }
+
+    // Nobody answers this one
+    void* reply = NULL;
+    size_t reply_size = 0;
+    assert(zetabus_lean_request(conn, "svc.none", "x", 1, 100, &reply, &reply_size) != 0);
+
+    // A flush returns once the server has everything published before it
+    size_t before = fake_nats_pub_count(server);
+    for (int i = 0; i < 1000; i++) {
+        assert(zetabus_lean_publish(conn, "bulk", NULL, &i, sizeof(i)) == 0);
+    }
+    assert(zetabus_lean_flush(conn, 2000) == 0);
+    assert(fake_nats_pub_count(server) == before + 1000);
+
+    zetabus_lean_close(conn);
+    fake_nats_stop(server);
+    printf("test_request_and_flush PASSED\n");
+}
+
+void test_reconnect_replays_subscriptions(void) {
+    printf("Running test_reconnect_replays_subscriptions...\n");
+
+    fake_nats_t* server = fake_nats_start();
+    assert(server);
+    zetabus_lean_t* conn = connect_to(server);
+    static received_t received;
+    atomic_store(&received.count, 0);
+    assert(zetabus_lean_subscribe(conn, "a.*", on_message, &received) != 0);
+    uint64_t gone = zetabus_lean_subscribe(conn, "b", on_message, &received);
+    assert(gone != 0);
+    assert(zetabus_lean_unsubscribe(conn, gone) == 0);
+    assert(zetabus_lean_flush(conn, 2000) == 0);
+    assert(fake_nats_subs(server) == 2); // The request inbox and a.*
+
+    fake_nats_set_down(server, true);
+    assert(wait_for(&g_connected, 0, 2000) == 0);
+    assert(zetabus_lean_publish(conn, "a.x", NULL, "lost", 4) != 0);
+    assert(zetabus_lean_flush(conn, 100) != 0);
+
+    // Subscribed while down: sent with the replay
+    assert(zetabus_lean_subscribe(conn, "c", on_message, &received) != 0);
+
+    fake_nats_set_down(server, false);
+    assert(wait_for(&g_connected, 1, 5000) == 1);
+    assert(fake_nats_connections(server) == 2);
+    assert(zetabus_lean_flush(conn, 2000) == 0);
+    assert(fake_nats_subs(server) == 3);
+
+    assert(zetabus_lean_publish(conn, "a.x", NULL, "back", 4) == 0);
+    assert(zetabus_lean_publish(conn, "b", NULL, "none", 4) == 0);
+    assert(zetabus_lean_publish(conn, "c", NULL, "new", 3) == 0);
+    assert(wait_for(&received.count, 2, 2000) == 2);
+    assert(strcmp(received.data[0], "back") == 0);
+    assert(strcmp(received.data[1], "new") == 0);
+
+    zetabus_lean_close(conn);
+    fake_nats_stop(server);
+    printf("test_reconnect_replays_subscriptions PASSED\n");
+}
+
+void test_backlog_survives_reconnect(void) {
+    printf("Running test_backlog_survives_reconnect...\n");
+
+    fake_nats_t* server = fake_nats_start();
+    assert(server);
+    zetabus_lean_t* conn = connect_to(server);
+
+    // With the server not reading, the socket fills and publishes queue up
+    fake_nats_set_paused(server, true);
+    enum { COUNT = 4000, SIZE = 1024 };
+    uint8_t payload[SIZE];
+    for (int i = 0; i < COUNT; i++) {
+        memset(payload, (int)(i & 0xff), sizeof(payload));
+        memcpy(payload, &i, sizeof(i));
+        assert(zetabus_lean_publish(conn, "queued", NULL, payload, sizeof(payload)) == 0);
+    }
+
+    // The connection dies with its socket buffers; the queued publishes follow
+    // the reconnect
+    fake_nats_set_down(server, true);
+    assert(wait_for(&g_connected, 0, 2000) == 0);
+    fake_nats_set_paused(server, false);
+    fake_nats_set_down(server, false);
+    assert(wait_for(&g_connected, 1, 5000) == 1);
+    assert(zetabus_lean_flush(conn, 5000) == 0);
+
+    // Every message that arrived is whole and in order, and the newest ones
+    // arrived on the new connection
+    size_t count = fake_nats_pub_count(server);
+    size_t replayed = 0;
+    int last = -1;
+    for (size_t i = 0; i < count; i++) {
+        const fake_nats_pub_t* pub = fake_nats_pub_at(server, i);
+        assert(strcmp(pub->subject, "queued") == 0 && pub->size == SIZE);
+        int value;
+        memcpy(&value, pub->data, sizeof(value));
+        assert(value > last);
+        for (size_t j = sizeof(value); j < SIZE; j++) {
+            assert(((const uint8_t*)pub->data)[j] == (uint8_t)(value & 0xff));
+        }
+        last = value;
+        if (pub->connection == 2) replayed++;
+    }
+    assert(last == COUNT - 1);
+    assert(replayed > 0);
+
+    zetabus_lean_close(conn);
+    fake_nats_stop(server);
+    printf("test_backlog_survives_reconnect PASSED\n");
+}
+
+void test_keepalive_detects_dead_server(void) {
+    printf("Running test_keepalive_detects_dead_server...\n");
+
+    fake_nats_t* server = fake_nats_start();
+    assert(server);
+    zetabus_lean_t* conn = connect_to(server);
+    zetabus_lean_set_keepalive(conn, 50, 2);
+
+    // A server that answers keeps the connection up
+    uint32_t pings = fake_nats_pings(server);
+    for (int i = 0; i < 2000 && fake_nats_pings(server) < pings + 4; i++) {
+        sleep_ms(1);
+    }
+    assert(fake_nats_pings(server) >= pings + 4);
+    assert(atomic_load(&g_state_changes) == 0);
+
+    // A server that goes quiet without closing the socket is given up on
+    fake_nats_set_answer_pings(server, false);
+    assert(wait_for(&g_connected, 0, 2000) == 0);
+    fake_nats_set_answer_pings(server, true);
+    assert(wait_for(&g_connected, 1, 5000) == 1);
+    assert(fake_nats_connections(server) == 2);
+    assert(zetabus_lean_flush(conn, 2000) == 0);
+
+    zetabus_lean_stats_t stats;
+    zetabus_lean_get_stats(conn, &stats);
+    assert(stats.keepalive_timeouts == 1 && stats.server_errors == 0);
+
+    zetabus_lean_close(conn);
+    fake_nats_stop(server);
+    printf("test_keepalive_detects_dead_server PASSED\n");
+}
+
+int main(void) {
+    printf("Running lean NATS client tests...\n\n");
+
+    test_publish_subscribe();
+    test_split_frames();
+    test_request_and_flush();
+    test_reconnect_replays_subscriptions();
+    test_backlog_survives_reconnect();
+    test_keepalive_detects_dead_server();
+
+    printf("\nAll tests PASSED!\n");
+    return 0;
+}
@@ -10,6 +10,9 @@ zetabus_publisher_t* zetabus_publisher_create(zetabus_t* bus, const char* topic)
     if (!pub) return NULL;
     
     pub->bus = bus;
+    pub->spool = NULL;
+    pub->direct = NULL;
+    pub->batch = NULL;
     pub->topic = strdup(topic);
     if (!pub->topic) {
         free(pub);
@@ -21,6 +24,10 @@ zetabus_publisher_t* zetabus_publisher_create(zetabus_t* bus, const char* topic)
 
 void zetabus_publisher_destroy(zetabus_publisher_t* pub) {
     if (pub) {
+        // Flushes the last envelope through the spool or broker
+        zetabus_batch_destroy(pub->batch);
+        zetabus_direct_pub_destroy(pub->direct);
+        zetabus_spool_destroy(pub->spool);
         free(pub->topic);
         free(pub);
     }
@@ -29,6 +36,63 @@ void zetabus_publisher_destroy(zetabus_publisher_t* pub) {
 int zetabus_publish(zetabus_publisher_t* pub, const void* data, size_t size) {
     if (!pub || !pub->bus || !data) return -1;
     
-    natsStatus s = natsConnection_Publish(pub->bus->nc, pub->topic, data, size);
-    return (s == NATS_OK) ? 0 : -1;
-}
\ No newline at end of file
+    if (pub->batch) {
+        return zetabus_batch_publish(pub->batch, data, size);
+    }
+    
+    return zetabus_publisher_send(pub, data, size, false);
+}
+
+int zetabus_publisher_send(zetabus_publisher_t* pub, const void* data, size_t size, bool envelope) {
+    if (pub->bus->udpm) {
+        return zetabus_udpm_publish(pub->bus->udpm, pub->topic, data, size, envelope);
+    }
+    
+    if (pub->direct) {
+        return zetabus_direct_publish(pub->direct, data, size);
+    }
+    
+    if (pub->spool) {
+        return zetabus_spool_publish(pub->spool, data, size, envelope);
+    }
+    
+    return zetabus_broker_publish(pub->bus, pub->topic, data, size, envelope);
+}
+
+int zetabus_publisher_enable_spool(zetabus_publisher_t* pub, const char* spool_path, uint32_t drain_rate) {
+    if (!pub || !spool_path || pub->spool || pub->direct || pub->batch || pub->bus->udpm) return -1;
+    
+    pub->spool = zetabus_spool_create(pub, spool_path, drain_rate);
+    return pub->spool ? 0 : -1;
+}
+
+int zetabus_publisher_set_spool_limit(zetabus_publisher_t* pub, uint64_t max_bytes) {
+    if (!pub || !pub->spool) return -1;
+    
+    zetabus_spool_set_limit(pub->spool, max_bytes);
+    return 0;
+}
+
+int zetabus_publisher_get_stats(zetabus_publisher_t* pub, zetabus_publisher_stats_t* stats) {
+    if (!pub || !stats) return -1;
+    
+    memset(stats, 0, sizeof(*stats));
+    if (pub->spool) zetabus_spool_get_stats(pub->spool, stats);
+    if (pub->direct) zetabus_direct_pub_get_stats(pub->direct, stats);
+    return 0;
+}
+
+int zetabus_publisher_enable_direct(zetabus_publisher_t* pub) {
+    if (!pub || pub->direct || pub->spool || pub->batch || pub->bus->udpm || pub->bus->lean) return -1;
+    
+    pub->direct = zetabus_direct_pub_create(pub);
+    return pub->direct ? 0 : -1;
+}
+
+int zetabus_publisher_enable_batching(zetabus_publisher_t* pub, uint32_t max_count, size_t max_bytes,
+                                      uint32_t linger_us) {
+    if (!pub || pub->batch || pub->direct) return -1;
+    
+    pub->batch = zetabus_batch_create(pub, max_count, max_bytes, linger_us);
+    return pub->batch ? 0 : -1;
+}
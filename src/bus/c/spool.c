@@ -0,0 +1,339 @@
+#include "bus.h"
+#include "bus_internal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SPOOL_POLL_NS 50000000ULL // How often the drain thread rechecks the link
+#define SPOOL_READ_ATTEMPTS 3     // Reads of a record before it is given up as unreadable
+#define SPOOL_DEFAULT_MAX_BYTES (1ULL << 30)
+#define SPOOL_RECORD_ENVELOPE 0x80000000U
+
+// Spool file layout: a sequence of records, each a uint32 payload size followed
+// by the payload. The size's top bit marks a batch envelope. Records are only ever appended; once the drain thread has
+// published everything the file is truncated back to zero.
+struct zetabus_spool_s {
+    zetabus_publisher_t* publisher;
+    char* path;
+    int fd;
+    uint32_t drain_rate;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t drain_thread;
+    bool running;
+
+    uint64_t read_offset;  // Next record to drain
+    uint64_t write_offset; // End of the last complete record
+    uint64_t max_bytes;    // Spool file size limit, 0 for none
+    uint64_t refused;      // Publishes refused because the spool was full
+    uint64_t discarded;    // Records given up as unreadable while draining
+    uint64_t discarded_bytes;
+
+    void* drain_buf;
+    size_t drain_cap;
+};
+
+static int write_full_at(int fd, struct iovec* iov, int iovcnt, uint64_t offset) {
+    while (iovcnt > 0) {
+        ssize_t n = pwritev(fd, iov, iovcnt, (off_t)offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        offset += (uint64_t)n;
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+    return 0;
+}
+
+static int read_full_at(int fd, void* buf, size_t size, uint64_t offset) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, (char*)buf + done, size - done, (off_t)(offset + done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        done += (size_t)n;
+    }
+    return 0;
+}
+
+// Find the end of the complete records left by a previous run and cut off a
+// record torn by a crash mid-append.
+static uint64_t recover_write_offset(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) return 0;
+
+    uint64_t offset = 0;
+    uint64_t file_size = (uint64_t)st.st_size;
+    while (offset + sizeof(uint32_t) <= file_size) {
+        uint32_t size;
+        if (read_full_at(fd, &size, sizeof(size), offset) != 0) break;
+        size &= ~SPOOL_RECORD_ENVELOPE;
+        if (offset + sizeof(uint32_t) + size > file_size) break;
+        offset += sizeof(uint32_t) + size;
+    }
+
+    if (offset != file_size) {
+        (void)ftruncate(fd, (off_t)offset);
+    }
+    return offset;
+}
+
+// Drop the already drained prefix so a restart does not publish it twice
+static void compact(zetabus_spool_t* spool) {
+    size_t tmp_len = strlen(spool->path) + 5;
+    char* tmp_path = (char*)malloc(tmp_len);
+    char* buf = (char*)malloc(65536);
+    if (!tmp_path || !buf) goto done;
+    snprintf(tmp_path, tmp_len, "%s.tmp", spool->path);
+
+    int out = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) goto done;
+
+    uint64_t offset = spool->read_offset;
+    uint64_t written = 0;
+    bool ok = true;
+    while (ok && offset < spool->write_offset) {
+        size_t chunk = spool->write_offset - offset < 65536 ? (size_t)(spool->write_offset - offset) : 65536;
+        struct iovec iov = { .iov_base = buf, .iov_len = chunk };
+        ok = read_full_at(spool->fd, buf, chunk, offset) == 0 &&
+             write_full_at(out, &iov, 1, written) == 0;
+        offset += chunk;
+        written += chunk;
+    }
+    close(out);
+
+    if (!ok || rename(tmp_path, spool->path) != 0) {
+        unlink(tmp_path);
+    }
+
+done:
+    free(tmp_path);
+    free(buf);
+}
+
+static void wait_locked(zetabus_spool_t* spool, uint64_t timeout_ns) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    uint64_t nsec = (uint64_t)deadline.tv_nsec + timeout_ns;
+    deadline.tv_sec += (time_t)(nsec / 1000000000ULL);
+    deadline.tv_nsec = (long)(nsec % 1000000000ULL);
+    pthread_cond_timedwait(&spool->cond, &spool->lock, &deadline);
+}
+
+// Drain thread: replays spooled records in order once the bus is connected,
+// paced to drain_rate so a reconnect does not flood the link.
+static void* spool_drain_thread(void* arg) {
+    zetabus_spool_t* spool = (zetabus_spool_t*)arg;
+    zetabus_publisher_t* pub = spool->publisher;
+    uint64_t interval_ns = spool->drain_rate > 0 ? 1000000000ULL / spool->drain_rate : 0;
+    uint32_t failures = 0;
+
+    pthread_mutex_lock(&spool->lock);
+    while (spool->running) {
+        if (spool->read_offset == spool->write_offset || !atomic_load(&pub->bus->connected)) {
+            wait_locked(spool, SPOOL_POLL_NS);
+            continue;
+        }
+
+        uint64_t offset = spool->read_offset;
+        uint64_t end = spool->write_offset;
+        pthread_mutex_unlock(&spool->lock);
+
+        // Records below write_offset are immutable, so read them unlocked
+        uint32_t size = 0;
+        bool sized = read_full_at(spool->fd, &size, sizeof(size), offset) == 0;
+        bool envelope = (size & SPOOL_RECORD_ENVELOPE) != 0;
+        size &= ~SPOOL_RECORD_ENVELOPE;
+        sized = sized && offset + sizeof(uint32_t) + size <= end;
+        bool ok = sized;
+        bool retry = false;
+        if (ok && size > spool->drain_cap) {
+            void* buf = realloc(spool->drain_buf, size);
+            if (buf) {
+                spool->drain_buf = buf;
+                spool->drain_cap = size;
+            } else {
+                retry = true;
+            }
+        }
+        if (ok && !retry) {
+            ok = read_full_at(spool->fd, spool->drain_buf, size, offset + sizeof(uint32_t)) == 0;
+        }
+        if (ok && !retry) {
+            retry = zetabus_broker_publish(pub->bus, pub->topic, spool->drain_buf, size, envelope) != 0; // Link dropped again
+        }
+
+        pthread_mutex_lock(&spool->lock);
+        if (ok && retry) {
+            wait_locked(spool, SPOOL_POLL_NS);
+            continue;
+        }
+
+        // A record that stays unreadable would wedge the publisher in spooling
+        // mode forever, so after a few attempts skip it. Without a readable size
+        // the next record cannot be found, and the rest of the spool goes too.
+        if (!ok && ++failures < SPOOL_READ_ATTEMPTS) {
+            wait_locked(spool, SPOOL_POLL_NS);
+            continue;
+        }
+        failures = 0;
+        uint64_t next = sized ? offset + sizeof(uint32_t) + size : spool->write_offset;
+        if (!ok) {
+            spool->discarded++;
+            spool->discarded_bytes += next - offset;
+        }
+        spool->read_offset = next;
+        if (spool->read_offset >= spool->write_offset) {
+            if (ftruncate(spool->fd, 0) == 0) {
+                spool->read_offset = 0;
+                spool->write_offset = 0;
+            } else {
+                spool->read_offset = spool->write_offset;
+            }
+        }
+
+        if (interval_ns > 0) {
+            pthread_mutex_unlock(&spool->lock);
+            struct timespec ts = {
+                .tv_sec = (time_t)(interval_ns / 1000000000ULL),
+                .tv_nsec = (long)(interval_ns % 1000000000ULL)
+            };
+            nanosleep(&ts, NULL);
+            pthread_mutex_lock(&spool->lock);
+        }
+    }
+    pthread_mutex_unlock(&spool->lock);
+
+    return NULL;
+}
+
+zetabus_spool_t* zetabus_spool_create(zetabus_publisher_t* publisher, const char* path, uint32_t drain_rate) {
+    zetabus_spool_t* spool = (zetabus_spool_t*)calloc(1, sizeof(zetabus_spool_t));
+    if (!spool) return NULL;
+
+    spool->publisher = publisher;
+    spool->drain_rate = drain_rate;
+    spool->max_bytes = SPOOL_DEFAULT_MAX_BYTES;
+    spool->path = strdup(path);
+    spool->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (!spool->path || spool->fd < 0) {
+        if (spool->fd >= 0) close(spool->fd);
+        free(spool->path);
+        free(spool);
+        return NULL;
+    }
+
+    spool->read_offset = 0;
+    spool->write_offset = recover_write_offset(spool->fd);
+
+    pthread_mutex_init(&spool->lock, NULL);
+    pthread_cond_init(&spool->cond, NULL);
+    spool->running = true;
+
+    if (pthread_create(&spool->drain_thread, NULL, spool_drain_thread, spool) != 0) {
+        pthread_cond_destroy(&spool->cond);
+        pthread_mutex_destroy(&spool->lock);
+        close(spool->fd);
+        free(spool->path);
+        free(spool);
+        return NULL;
+    }
+
+    return spool;
+}
+
+void zetabus_spool_destroy(zetabus_spool_t* spool) {
+    if (!spool) return;
+
+    pthread_mutex_lock(&spool->lock);
+    spool->running = false;
+    pthread_cond_signal(&spool->cond);
+    pthread_mutex_unlock(&spool->lock);
+    pthread_join(spool->drain_thread, NULL);
+
+    // Undrained records stay on disk for the next run
+    bool empty = spool->read_offset == spool->write_offset;
+    if (!empty && spool->read_offset > 0) {
+        compact(spool);
+    }
+    close(spool->fd);
+    if (empty) {
+        unlink(spool->path);
+    }
+
+    pthread_cond_destroy(&spool->cond);
+    pthread_mutex_destroy(&spool->lock);
+    free(spool->drain_buf);
+    free(spool->path);
+    free(spool);
+}
+
+int zetabus_spool_publish(zetabus_spool_t* spool, const void* data, size_t size, bool envelope) {
+    if (size >= SPOOL_RECORD_ENVELOPE) return -1;
+
+    pthread_mutex_lock(&spool->lock);
+
+    // Publish directly only when nothing is queued ahead of us, so ordering holds
+    if (spool->read_offset == spool->write_offset && atomic_load(&spool->publisher->bus->connected)) {
+        if (zetabus_broker_publish(spool->publisher->bus, spool->publisher->topic, data, size, envelope) == 0) {
+            pthread_mutex_unlock(&spool->lock);
+            return 0;
+        }
+    }
+
+    // Full: refuse the newest message and keep the oldest telemetry
+    if (spool->max_bytes > 0 && spool->write_offset + sizeof(uint32_t) + size > spool->max_bytes) {
+        spool->refused++;
+        pthread_mutex_unlock(&spool->lock);
+        return -1;
+    }
+
+    uint32_t record_size = (uint32_t)size | (envelope ? SPOOL_RECORD_ENVELOPE : 0);
+    struct iovec iov[2] = {
+        { .iov_base = &record_size, .iov_len = sizeof(record_size) },
+        { .iov_base = (void*)data, .iov_len = size }
+    };
+    int ret = write_full_at(spool->fd, iov, 2, spool->write_offset);
+    if (ret == 0) {
+        spool->write_offset += sizeof(record_size) + size;
+        pthread_cond_signal(&spool->cond);
+    } else {
+        // Drop the partial record so the next append overwrites it
+        (void)ftruncate(spool->fd, (off_t)spool->write_offset);
+    }
+
+    pthread_mutex_unlock(&spool->lock);
+    return ret;
+}
+
+void zetabus_spool_set_limit(zetabus_spool_t* spool, uint64_t max_bytes) {
+    pthread_mutex_lock(&spool->lock);
+    spool->max_bytes = max_bytes;
+    pthread_mutex_unlock(&spool->lock);
+}
+
+void zetabus_spool_get_stats(zetabus_spool_t* spool, zetabus_publisher_stats_t* stats) {
+    pthread_mutex_lock(&spool->lock);
+    stats->spool_refused = spool->refused;
+    stats->spool_discarded = spool->discarded;
+    stats->spool_discarded_bytes = spool->discarded_bytes;
+    pthread_mutex_unlock(&spool->lock);
+}
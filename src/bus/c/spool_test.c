@@ -0,0 +1,271 @@
+#include "bus.h"
+#include "bus_internal.h"
+#include "fake_nats_server.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// The bus runs over the lean client against an in-process NATS server, which
+// the tests take down and bring back to drive the spool
+static char g_spool_path[256];
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static int wait_connected(zetabus_t* bus, bool connected, int timeout_ms) {
+    for (int i = 0; i < timeout_ms && atomic_load(&bus->connected) != connected; i++) {
+        sleep_ms(1);
+    }
+    return atomic_load(&bus->connected) == connected;
+}
+
+static zetabus_t* create_bus(fake_nats_t* server) {
+    char url[64];
+    snprintf(url, sizeof(url), "nats+lean://%s", fake_nats_address(server));
+    return zetabus_create(url);
+}
+
+// Server PUBs from first on must carry the values 0, 1, 2, ... in order
+static void check_in_order(fake_nats_t* server, size_t first, int count) {
+    for (int i = 0; i < count; i++) {
+        const fake_nats_pub_t* pub = fake_nats_pub_at(server, first + (size_t)i);
+        assert(pub);
+        assert(strcmp(pub->subject, "spool.test") == 0);
+        int value = -1;
+        assert(pub->size == sizeof(value));
+        memcpy(&value, pub->data, sizeof(value));
+        assert(value == i);
+    }
+}
+
+static void write_record(int fd, int value) {
+    uint32_t size = sizeof(value);
+    assert(write(fd, &size, sizeof(size)) == sizeof(size));
+    assert(write(fd, &value, sizeof(value)) == sizeof(value));
+}
+
+void test_replay_in_order(void) {
+    printf("Running test_replay_in_order...\n");
+    unlink(g_spool_path);
+
+    fake_nats_t* server = fake_nats_start();
+    assert(server);
+    zetabus_t* bus = create_bus(server);
+    assert(bus);
+    zetabus_publisher_t* pub = zetabus_publisher_create(bus, "spool.test");
+    assert(zetabus_publisher_enable_spool(pub, g_spool_path, 0) == 0);
+
+    // Connected: straight to the broker
+    int value = 0;
+    for (; value < 100; value++) {
+        assert(zetabus_publish(pub, &value, sizeof(value)) == 0);
+    }
+    assert(fake_nats_wait_pubs(server, 100, 2000) == 100);
+
+    // Disconnected: spooled, and publishing still succeeds
+    fake_nats_set_down(server, true);
+    assert(wait_connected(bus, false, 2000));
+    for (; value < 600; value++) {
+        assert(zetabus_publish(pub, &value, sizeof(value)) == 0);
+    }
+    sleep_ms(100);
+    assert(fake_nats_pub_count(server) == 100);
+    assert(access(g_spool_path, F_OK) == 0);
+
+    // Reconnected: the spool drains first, then new publishes follow it in order
+    fake_nats_set_down(server, false);
+    assert(wait_connected(bus, true, 5000));
+    for (; value < 700; value++) {
+        assert(zetabus_publish(pub, &value, sizeof(value)) == 0);
+    }
+    assert(fake_nats_wait_pubs(server, 700, 5000) == 700);
+    check_in_order(server, 0, 700);
+
+    // Fully drained, so nothing is left on disk
+    zetabus_publisher_destroy(pub);
+    assert(access(g_spool_path, F_OK) != 0);
+
+    zetabus_destroy(bus);
+    fake_nats_stop(server);
+    printf("test_replay_in_order PASSED\n");
+}
+
+void test_restart_recovery(void) {
+    printf("Running test_restart_recovery...\n");
+    unlink(g_spool_path);
+
+    fake_nats_t* server = fake_nats_start();
+    assert(server);
+    zetabus_t* bus = create_bus(server);
+    assert(bus);
+
+    // A run that crashed mid-append left complete records and a torn one
+    int fd = open(g_spool_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    int value = 0;
+    for (; value < 50; value++) {
+        write_record(fd, value);
+    }
+    uint32_t torn_size = 100;
+    assert(write(fd, &torn_size, sizeof(torn_size)) == sizeof(torn_size));
+    assert(write(fd, "torn", 4) == 4);
+    close(fd);
+
+    // The next run cuts off the torn record and appends after the complete ones
+    fake_nats_set_down(server, true);
+    assert(wait_connected(bus, false, 2000));
+    zetabus_publisher_t* pub = zetabus_publisher_create(bus, "spool.test");
+    assert(zetabus_publisher_enable_spool(pub, g_spool_path, 0) == 0);
+    for (; value < 100; value++) {
+        assert(zetabus_publish(pub, &value, sizeof(value)) == 0);
+    }
+
+    // A clean shutdown while still disconnected keeps everything for the next run
+    zetabus_publisher_destroy(pub);
+    assert(access(g_spool_path, F_OK) == 0);
+    pub = zetabus_publisher_create(bus, "spool.test");
+    assert(zetabus_publisher_enable_spool(pub, g_spool_path, 0) == 0);
+    for (; value < 150; value++) {
+        assert(zetabus_publish(pub, &value, sizeof(value)) == 0);
+    }
+    assert(fake_nats_pub_count(server) == 0);
+
+    fake_nats_set_down(server, false);
+    assert(wait_connected(bus, true, 5000));
+    assert(fake_nats_wait_pubs(server, 150, 5000) == 150);
+
+    // Destroyed partway through a paced drain, the rest survives the restart
+    fake_nats_set_down(server, true);
+    assert(wait_connected(bus, false, 2000));
+    for (; value < 250; value++) {
+        assert(zetabus_publish(pub, &value, sizeof(value)) == 0);
+    }
+    zetabus_publisher_destroy(pub);
+    pub = zetabus_publisher_create(bus, "spool.test");
+    assert(zetabus_publisher_enable_spool(pub, g_spool_path, 500) == 0);
+    fake_nats_set_down(server, false);
+    assert(wait_connected(bus, true, 5000));
+    sleep_ms(50);
+    zetabus_publisher_destroy(pub);
+    size_t drained = fake_nats_pub_count(server);
+    assert(drained < 250);
+
+    pub = zetabus_publisher_create(bus, "spool.test");
+    assert(zetabus_publisher_enable_spool(pub, g_spool_path, 0) == 0);
+    assert(fake_nats_wait_pubs(server, 250, 5000) == 250);
+    check_in_order(server, 0, 250);
+    zetabus_publisher_destroy(pub);
+    assert(access(g_spool_path, F_OK) != 0);
+
+    zetabus_destroy(bus);
+    fake_nats_stop(server);
+    printf("test_restart_recovery PASSED\n");
+}
+
+void test_size_limit(void) {
+    printf("Running test_size_limit...\n");
+    unlink(g_spool_path);
+
+    fake_nats_t* server = fake_nats_start();
+    assert(server);
+    zetabus_t* bus = create_bus(server);
+    assert(bus);
+    zetabus_publisher_t* pub = zetabus_publisher_create(bus, "spool.test");
+    assert(zetabus_publisher_set_spool_limit(pub, 1024) == -1); // No spool yet
+    assert(zetabus_publisher_enable_spool(pub, g_spool_path, 0) == 0);
+
+    // Room for 40 records of a 4 byte size and a 4 byte payload
+    assert(zetabus_publisher_set_spool_limit(pub, 40 * 8) == 0);
+    fake_nats_set_down(server, true);
+    assert(wait_connected(bus, false, 2000));
+    int value = 0;
+    for (; value < 40; value++) {
+        assert(zetabus_publish(pub, &value, sizeof(value)) == 0);
+    }
+
+    // Full: newer messages are refused and counted, the spooled ones are kept
+    for (int i = 0; i < 20; i++) {
+        assert(zetabus_publish(pub, &value, sizeof(value)) == -1);
+    }
+    zetabus_publisher_stats_t stats;
+    assert(zetabus_publisher_get_stats(pub, &stats) == 0);
+    assert(stats.spool_refused == 20 && stats.spool_discarded == 0);
+
+    fake_nats_set_down(server, false);
+    assert(wait_connected(bus, true, 5000));
+    assert(fake_nats_wait_pubs(server, 40, 5000) == 40);
+
+    // Drained, the file is emptied and the spool takes messages again
+    struct stat st;
+    for (int i = 0; i < 1000 && stat(g_spool_path, &st) == 0 && st.st_size > 0; i++) {
+        sleep_ms(1);
+    }
+    for (; value < 60; value++) {
+        assert(zetabus_publish(pub, &value, sizeof(value)) == 0);
+    }
+    assert(fake_nats_wait_pubs(server, 60, 5000) == 60);
+    check_in_order(server, 0, 60);
+    assert(zetabus_publisher_get_stats(pub, &stats) == 0);
+    assert(stats.spool_refused == 20 && stats.spool_discarded_bytes == 0);
+
+    zetabus_publisher_destroy(pub);
+    zetabus_destroy(bus);
+    fake_nats_stop(server);
+    printf("test_size_limit PASSED\n");
+}
+
+// Test that spooled envelopes keep their mark, and plain messages stay unmarked
+void test_spooled_envelope(void) {
+    printf("Running test_spooled_envelope...\n");
+    unlink(g_spool_path);
+
+    fake_nats_t* server = fake_nats_start();
+    assert(server);
+    zetabus_t* bus = create_bus(server);
+    assert(bus);
+    zetabus_publisher_t* pub = zetabus_publisher_create(bus, "spool.test");
+    assert(zetabus_publisher_enable_spool(pub, g_spool_path, 0) == 0);
+
+    fake_nats_set_down(server, true);
+    assert(wait_connected(bus, false, 2000));
+    int value = 1;
+    assert(zetabus_spool_publish(pub->spool, &value, sizeof(value), true) == 0);
+    assert(zetabus_spool_publish(pub->spool, &value, sizeof(value), false) == 0);
+
+    fake_nats_set_down(server, false);
+    assert(wait_connected(bus, true, 5000));
+    assert(fake_nats_wait_pubs(server, 2, 5000) == 2);
+    const fake_nats_pub_t* marked = fake_nats_pub_at(server, 0);
+    const fake_nats_pub_t* plain = fake_nats_pub_at(server, 1);
+    assert(marked->reply && strcmp(marked->reply, ZETABUS_ENVELOPE_REPLY) == 0);
+    assert(marked->size == sizeof(value));
+    assert(!plain->reply && plain->size == sizeof(value));
+
+    zetabus_publisher_destroy(pub);
+    zetabus_destroy(bus);
+    fake_nats_stop(server);
+    printf("test_spooled_envelope PASSED\n");
+}
+
+int main(void) {
+    printf("Running spool tests...\n\n");
+
+    const char* dir = getenv("TEST_TMPDIR");
+    snprintf(g_spool_path, sizeof(g_spool_path), "%s/spool_test_%d.spool", dir ? dir : "/tmp", (int)getpid());
+
+    test_replay_in_order();
+    test_restart_recovery();
+    test_size_limit();
+    test_spooled_envelope();
+
+    unlink(g_spool_path);
+    printf("\nAll tests PASSED!\n");
+    return 0;
+}
@@ -0,0 +1,323 @@
+#include "subject_trie.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_CHILD_CAPACITY 4
+
+typedef struct {
+    void** items;
+    size_t count;
+    size_t capacity;
+} handler_list_t;
+
+typedef struct trie_node_s trie_node_t;
+
+struct trie_node_s {
+    char* token;
+    size_t token_len;
+    uint32_t hash;
+
+    // Literal children in an open-addressing table (linear probing)
+    trie_node_t** children;
+    size_t child_count;
+    size_t child_capacity;
+
+    trie_node_t* star;          // '*' child
+    handler_list_t handlers;    // Patterns ending at this node
+    handler_list_t gt_handlers; // Patterns ending in '>' below this node
+};
+
+struct zetabus_trie_s {
+    trie_node_t root;
+};
+
+// Token helpers
+
+static size_t token_length(const char* p) {
+    const char* dot = strchr(p, '.');
+    return dot ? (size_t)(dot - p) : strlen(p);
+}
+
+static uint32_t token_hash(const char* token, size_t len) {
+    uint32_t h = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)token[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static bool token_is(const char* p, size_t len, char c) {
+    return len == 1 && p[0] == c;
+}
+
+// Handler lists
+
+static int list_add(handler_list_t* list, void* handler) {
+    if (list->count == list->capacity) {
+        size_t cap = list->capacity ? list->capacity * 2 : 2;
+        void** items = (void**)realloc(list->items, cap * sizeof(void*));
+        if (!items) return -1;
+        list->items = items;
+        list->capacity = cap;
+    }
+    list->items[list->count++] = handler;
+    return 0;
+}
+
+static int list_remove(handler_list_t* list, void* handler) {
+    for (size_t i = 0; i < list->count; i++) {
+        if (list->items[i] == handler) {
+            // Keep registration order stable for dispatch
+            memmove(&list->items[i], &list->items[i + 1], (list->count - i - 1) * sizeof(void*));
+            list->count--;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Nodes
+
+static trie_node_t* node_create(const char* token, size_t len, uint32_t hash) {
+    trie_node_t* node = (trie_node_t*)calloc(1, sizeof(trie_node_t));
+    if (!node) return NULL;
+    node->token = (char*)malloc(len + 1);
+    if (!node->token) {
+        free(node);
+        return NULL;
+    }
+    memcpy(node->token, token, len);
+    node->token[len] = '\0';
+    node->token_len = len;
+    node->hash = hash;
+    return node;
+}
+
+static void node_free_contents(trie_node_t* node) {
+    for (size_t i = 0; i < node->child_capacity; i++) {
+        if (node->children[i]) {
+            node_free_contents(node->children[i]);
+            free(node->children[i]);
+        }
+    }
+    if (node->star) {
+        node_free_contents(node->star);
+        free(node->star);
+    }
+    free(node->children);
+    free(node->handlers.items);
+    free(node->gt_handlers.items);
+    free(node->token);
+}
+
+static bool node_is_empty(const trie_node_t* node) {
+    return node->child_count == 0 && !node->star &&
+           node->handlers.count == 0 && node->gt_handlers.count == 0;
+}
+
+static size_t child_slot(const trie_node_t* node, const char* token, size_t len, uint32_t hash) {
+    size_t mask = node->child_capacity - 1;
+    size_t i = hash & mask;
+    while (node->children[i]) {
+        trie_node_t* child = node->children[i];
+        if (child->hash == hash && child->token_len == len && memcmp(child->token, token, len) == 0) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static trie_node_t* child_find(const trie_node_t* node, const char* token, size_t len) {
+    if (node->child_count == 0) return NULL;
+    return node->children[child_slot(node, token, len, token_hash(token, len))];
+}
+
+static int child_grow(trie_node_t* node) {
+    size_t cap = node->child_capacity ? node->child_capacity * 2 : INITIAL_CHILD_CAPACITY;
+    trie_node_t** old = node->children;
+    size_t old_cap = node->child_capacity;
+
+    node->children = (trie_node_t**)calloc(cap, sizeof(trie_node_t*));
+    if (!node->children) {
+        node->children = old;
+        return -1;
+    }
+    node->child_capacity = cap;
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old[i]) {
+            node->children[child_slot(node, old[i]->token, old[i]->token_len, old[i]->hash)] = old[i];
+        }
+    }
+    free(old);
+    return 0;
+}
+
+static trie_node_t* child_get_or_create(trie_node_t* node, const char* token, size_t len) {
+    uint32_t hash = token_hash(token, len);
+    if (node->child_count > 0) {
+        trie_node_t* existing = node->children[child_slot(node, token, len, hash)];
+        if (existing) return existing;
+    }
+
+    // Keep the load factor at or below 1/2
+    if ((node->child_count + 1) * 2 > node->child_capacity && child_grow(node) != 0) {
+        return NULL;
+    }
+    trie_node_t* child = node_create(token, len, hash);
+    if (!child) return NULL;
+    node->children[child_slot(node, token, len, hash)] = child;
+    node->child_count++;
+    return child;
+}
+
+static void child_delete(trie_node_t* node, trie_node_t* child) {
+    size_t mask = node->child_capacity - 1;
+    size_t i = child_slot(node, child->token, child->token_len, child->hash);
+    node->children[i] = NULL;
+    node->child_count--;
+
+    // Re-seat the rest of the probe cluster so lookups never stop early
+    for (size_t j = (i + 1) & mask; node->children[j]; j = (j + 1) & mask) {
+        trie_node_t* moved = node->children[j];
+        node->children[j] = NULL;
+        node->children[child_slot(node, moved->token, moved->token_len, moved->hash)] = moved;
+    }
+
+    node_free_contents(child);
+    free(child);
+}
+
+// Public API
+
+zetabus_trie_t* zetabus_trie_create(void) {
+    return (zetabus_trie_t*)calloc(1, sizeof(zetabus_trie_t));
+}
+
+void zetabus_trie_destroy(zetabus_trie_t* trie) {
+    if (trie) {
+        node_free_contents(&trie->root);
+        free(trie);
+    }
+}
+
+int zetabus_trie_insert(zetabus_trie_t* trie, const char* pattern, void* handler) {
+    if (!trie || !pattern || !*pattern) return -1;
+
+    trie_node_t* node = &trie->root;
+    const char* p = pattern;
+    for (;;) {
+        size_t len = token_length(p);
+        if (len == 0) return -1; // Empty token
+
+        bool last = p[len] == '\0';
+        if (token_is(p, len, '>')) {
+            if (!last) return -1; // '>' must be the final token
+            return list_add(&node->gt_handlers, handler);
+        }
+
+        if (token_is(p, len, '*')) {
+            if (!node->star) {
+                node->star = node_create(p, len, 0);
+                if (!node->star) return -1;
+            }
+            node = node->star;
+        } else {
+            node = child_get_or_create(node, p, len);
+            if (!node) return -1;
+        }
+
+        if (last) return list_add(&node->handlers, handler);
+        p += len + 1;
+    }
+}
+
+static int remove_at(trie_node_t* node, const char* p, void* handler) {
+    size_t len = token_length(p);
+    bool last = p[len] == '\0';
+
+    if (token_is(p, len, '>')) {
+        return last ? list_remove(&node->gt_handlers, handler) : -1;
+    }
+
+    trie_node_t* child = token_is(p, len, '*') ? node->star : child_find(node, p, len);
+    if (!child) return -1;
+
+    int ret = last ? list_remove(&child->handlers, handler) : remove_at(child, p + len + 1, handler);
+    if (ret == 0 && node_is_empty(child)) {
+        if (child == node->star) {
+            node_free_contents(child);
+            free(child);
+            node->star = NULL;
+        } else {
+            child_delete(node, child);
+        }
+    }
+    return ret;
+}
+
+int zetabus_trie_remove(zetabus_trie_t* trie, const char* pattern, void* handler) {
+    if (!trie || !pattern || !*pattern) return -1;
+    return remove_at(&trie->root, pattern, handler);
+}
+
+static size_t visit_list(const handler_list_t* list, zetabus_trie_visit_fn visit, void* ctx) {
+    for (size_t i = 0; i < list->count; i++) {
+        visit(list->items[i], ctx);
+    }
+    return list->count;
+}
+
+static size_t match_at(const trie_node_t* node, const char* p, zetabus_trie_visit_fn visit, void* ctx) {
+    // At least one token remains, so '>' registered here matches
+    size_t matched = visit_list(&node->gt_handlers, visit, ctx);
+
+    size_t len = token_length(p);
+    bool last = p[len] == '\0';
+
+    const trie_node_t* literal = child_find(node, p, len);
+    if (literal) {
+        matched += last ? visit_list(&literal->handlers, visit, ctx)
+                        : match_at(literal, p + len + 1, visit, ctx);
+    }
+    if (node->star) {
+        matched += last ? visit_list(&node->star->handlers, visit, ctx)
+                        : match_at(node->star, p + len + 1, visit, ctx);
+    }
+    return matched;
+}
+
+size_t zetabus_trie_match(const zetabus_trie_t* trie, const char* subject,
+                          zetabus_trie_visit_fn visit, void* ctx) {
+    if (!trie || !subject || !*subject) return 0;
+    return match_at(&trie->root, subject, visit, ctx);
+}
+
+bool zetabus_subject_covers(const char* broad, const char* narrow) {
+    const char* b = broad;
+    const char* n = narrow;
+    for (;;) {
+        size_t blen = token_length(b);
+        size_t nlen = token_length(n);
+
+        if (token_is(b, blen, '>')) return true;
+        if (token_is(n, nlen, '>')) return false;
+        if (!token_is(b, blen, '*')) {
+            if (token_is(n, nlen, '*')) return false;
+            if (blen != nlen || memcmp(b, n, blen) != 0) return false;
+        }
+
+        bool blast = b[blen] == '\0';
+        bool nlast = n[nlen] == '\0';
+        if (blast || nlast) return blast && nlast;
+        b += blen + 1;
+        n += nlen + 1;
+    }
+}
+
+bool zetabus_subject_matches(const char* pattern, const char* subject) {
+    // A literal subject is covered by pattern exactly when pattern matches it
+    return zetabus_subject_covers(pattern, subject);
+}
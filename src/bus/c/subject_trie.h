@@ -0,0 +1,38 @@
+#ifndef ZETA_BUS_SUBJECT_TRIE_H
+#define ZETA_BUS_SUBJECT_TRIE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Subject trie for local demultiplexing
+//
+// Subjects are '.'-separated tokens. Patterns may use '*' to match exactly one
+// token and a trailing '>' to match one or more tokens, as in NATS. Handlers
+// are opaque pointers; a subject is matched against every pattern with a
+// single walk whose cost depends on the subject depth, not the number of
+// registered patterns.
+
+typedef struct zetabus_trie_s zetabus_trie_t;
+
+typedef void (*zetabus_trie_visit_fn)(void* handler, void* ctx);
+
+zetabus_trie_t* zetabus_trie_create(void);
+void zetabus_trie_destroy(zetabus_trie_t* trie);
+
+// Register handler under pattern (0 on success)
+int zetabus_trie_insert(zetabus_trie_t* trie, const char* pattern, void* handler);
+
+// Unregister handler from pattern (0 on success, -1 if not found)
+int zetabus_trie_remove(zetabus_trie_t* trie, const char* pattern, void* handler);
+
+// Call visit for every handler whose pattern matches subject, returns the count
+size_t zetabus_trie_match(const zetabus_trie_t* trie, const char* subject,
+                          zetabus_trie_visit_fn visit, void* ctx);
+
+// True if every subject matched by narrow is also matched by broad
+bool zetabus_subject_covers(const char* broad, const char* narrow);
+
+// True if subject matches pattern (reference matcher, no trie)
+bool zetabus_subject_matches(const char* pattern, const char* subject);
+
+#endif // ZETA_BUS_SUBJECT_TRIE_H
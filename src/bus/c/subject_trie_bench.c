@@ -0,0 +1,78 @@
+#include "subject_trie.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Benchmark for local subject dispatch
+//
+// Registers N handlers (mostly per-topic, a few wildcards as a real node would
+// have) and measures the cost of dispatching one message by walking the trie
+// versus matching the subject against every registered pattern in turn.
+
+#define MESSAGES 200000
+#define SUBJECT_LEN 64
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void count_hit(void* handler, void* ctx) {
+    (void)handler;
+    (*(size_t*)ctx)++;
+}
+
+static void bench(size_t handlers) {
+    char (*patterns)[SUBJECT_LEN] = malloc(handlers * SUBJECT_LEN);
+    char (*subjects)[SUBJECT_LEN] = malloc(MESSAGES * SUBJECT_LEN);
+    zetabus_trie_t* trie = zetabus_trie_create();
+
+    for (size_t i = 0; i < handlers; i++) {
+        if (i % 100 == 99) {
+            snprintf(patterns[i], SUBJECT_LEN, "robot.r%zu.*.state", i % 8);
+        } else {
+            snprintf(patterns[i], SUBJECT_LEN, "robot.r%zu.s%zu.state", i % 8, i);
+        }
+        zetabus_trie_insert(trie, patterns[i], &patterns[i]);
+    }
+    srand(42);
+    for (size_t i = 0; i < MESSAGES; i++) {
+        size_t k = (size_t)rand() % handlers;
+        snprintf(subjects[i], SUBJECT_LEN, "robot.r%zu.s%zu.state", k % 8, k);
+    }
+
+    size_t trie_hits = 0;
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < MESSAGES; i++) {
+        zetabus_trie_match(trie, subjects[i], count_hit, &trie_hits);
+    }
+    double trie_ns = (double)(now_ns() - start) / MESSAGES;
+
+    size_t linear_hits = 0;
+    size_t linear_messages = handlers > 1000 ? MESSAGES / 20 : MESSAGES;
+    start = now_ns();
+    for (size_t i = 0; i < linear_messages; i++) {
+        for (size_t h = 0; h < handlers; h++) {
+            if (zetabus_subject_matches(patterns[h], subjects[i])) linear_hits++;
+        }
+    }
+    double linear_ns = (double)(now_ns() - start) / linear_messages;
+
+    printf("%8zu handlers: trie %9.1f ns/msg | linear %11.1f ns/msg | %6.1fx (hits/msg %.2f)\n",
+           handlers, trie_ns, linear_ns, linear_ns / trie_ns, (double)trie_hits / MESSAGES);
+
+    zetabus_trie_destroy(trie);
+    free(patterns);
+    free(subjects);
+}
+
+int main(void) {
+    size_t sizes[] = {10, 100, 1000, 10000};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        bench(sizes[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include "subject_trie.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_HITS 16
+
+typedef struct {
+    void* hits[MAX_HITS];
+    size_t count;
+} hits_t;
+
+static void record_hit(void* handler, void* ctx) {
+    hits_t* hits = (hits_t*)ctx;
+    assert(hits->count < MAX_HITS);
+    hits->hits[hits->count++] = handler;
+}
+
+static bool was_hit(const hits_t* hits, void* handler) {
+    for (size_t i = 0; i < hits->count; i++) {
+        if (hits->hits[i] == handler) return true;
+    }
+    return false;
+}
+
+static hits_t match(zetabus_trie_t* trie, const char* subject) {
+    hits_t hits = {0};
+    size_t n = zetabus_trie_match(trie, subject, record_hit, &hits);
+    assert(n == hits.count);
+    return hits;
+}
+
+// Test literal, '*' and '>' matching
+void test_wildcards(void) {
+    printf("Running test_wildcards...\n");
+    
+    zetabus_trie_t* trie = zetabus_trie_create();
+    assert(trie != NULL);
+    
+    int exact, star, tail, root_tail, both;
+    assert(zetabus_trie_insert(trie, "robot.imu.accel", &exact) == 0);
+    assert(zetabus_trie_insert(trie, "robot.*.accel", &star) == 0);
+    assert(zetabus_trie_insert(trie, "robot.>", &tail) == 0);
+    assert(zetabus_trie_insert(trie, ">", &root_tail) == 0);
+    assert(zetabus_trie_insert(trie, "*.imu.>", &both) == 0);
+    
+    hits_t hits = match(trie, "robot.imu.accel");
+    assert(hits.count == 5);
+    
+    hits = match(trie, "robot.lidar.accel");
+    assert(hits.count == 3);
+    assert(was_hit(&hits, &star) && was_hit(&hits, &tail) && was_hit(&hits, &root_tail));
+    
+    // '>' needs at least one more token
+    hits = match(trie, "robot");
+    assert(hits.count == 1 && was_hit(&hits, &root_tail));
+    
+    // '*' matches exactly one token
+    hits = match(trie, "robot.imu.accel.x");
+    assert(hits.count == 3);
+    assert(was_hit(&hits, &tail) && was_hit(&hits, &root_tail) && was_hit(&hits, &both));
+    
+    zetabus_trie_destroy(trie);
+    
+    printf("test_wildcards PASSED\n");
+}
+
+// Test removal, including nodes shared between patterns
+void test_remove(void) {
+    printf("Running test_remove...\n");
+    
+    zetabus_trie_t* trie = zetabus_trie_create();
+    int a, b, c;
+    assert(zetabus_trie_insert(trie, "x.y", &a) == 0);
+    assert(zetabus_trie_insert(trie, "x.y", &b) == 0);
+    assert(zetabus_trie_insert(trie, "x.*", &c) == 0);
+    
+    assert(match(trie, "x.y").count == 3);
+    assert(zetabus_trie_remove(trie, "x.y", &a) == 0);
+    assert(zetabus_trie_remove(trie, "x.y", &a) == -1);
+    assert(match(trie, "x.y").count == 2);
+    assert(zetabus_trie_remove(trie, "x.*", &c) == 0);
+    assert(zetabus_trie_remove(trie, "x.y", &b) == 0);
+    assert(match(trie, "x.y").count == 0);
+    assert(zetabus_trie_remove(trie, "x.z", &b) == -1);
+    
+    zetabus_trie_destroy(trie);
+    
+    printf("test_remove PASSED\n");
+}
+
+// Test many siblings (hash table growth and deletion)
+void test_many_topics(void) {
+    printf("Running test_many_topics...\n");
+    
+    const int count = 5000;
+    static int handlers[5000];
+    char topic[64];
+    
+    zetabus_trie_t* trie = zetabus_trie_create();
+    for (int i = 0; i < count; i++) {
+        snprintf(topic, sizeof(topic), "sensor.s%d.data", i);
+        assert(zetabus_trie_insert(trie, topic, &handlers[i]) == 0);
+    }
+    
+    // Remove every other topic, then check the survivors are still reachable
+    for (int i = 0; i < count; i += 2) {
+        snprintf(topic, sizeof(topic), "sensor.s%d.data", i);
+        assert(zetabus_trie_remove(trie, topic, &handlers[i]) == 0);
+    }
+    for (int i = 0; i < count; i++) {
+        snprintf(topic, sizeof(topic), "sensor.s%d.data", i);
+        hits_t hits = match(trie, topic);
+        if (i % 2) {
+            assert(hits.count == 1 && hits.hits[0] == &handlers[i]);
+        } else {
+            assert(hits.count == 0);
+        }
+    }
+    
+    zetabus_trie_destroy(trie);
+    
+    printf("test_many_topics PASSED\n");
+}
+
+// Test invalid patterns
+void test_invalid_patterns(void) {
+    printf("Running test_invalid_patterns...\n");
+    
+    zetabus_trie_t* trie = zetabus_trie_create();
+    int h;
+    assert(zetabus_trie_insert(trie, "", &h) != 0);
+    assert(zetabus_trie_insert(trie, "a..b", &h) != 0);
+    assert(zetabus_trie_insert(trie, "a.>.b", &h) != 0);
+    assert(zetabus_trie_insert(trie, "a.", &h) != 0);
+    zetabus_trie_destroy(trie);
+    
+    printf("test_invalid_patterns PASSED\n");
+}
+
+// Test pattern containment used to share broker subscriptions
+void test_covers(void) {
+    printf("Running test_covers...\n");
+    
+    assert(zetabus_subject_covers(">", "a.b.c"));
+    assert(zetabus_subject_covers("a.>", "a.b"));
+    assert(zetabus_subject_covers("a.>", "a.*.c"));
+    assert(zetabus_subject_covers("a.>", "a.>"));
+    assert(!zetabus_subject_covers("a.>", "a"));
+    assert(zetabus_subject_covers("a.*", "a.b"));
+    assert(zetabus_subject_covers("a.*", "a.*"));
+    assert(!zetabus_subject_covers("a.*", "a.>"));
+    assert(!zetabus_subject_covers("a.b", "a.*"));
+    assert(!zetabus_subject_covers("a.*.c", "a.b.*"));
+    assert(!zetabus_subject_covers("a.b", "a.b.c"));
+    assert(zetabus_subject_covers("a.b", "a.b"));
+    
+    assert(zetabus_subject_matches("a.*.c", "a.b.c"));
+    assert(!zetabus_subject_matches("a.*.c", "a.b.d"));
+    
+    printf("test_covers PASSED\n");
+}
+
+int main(void) {
+    printf("Starting subject trie tests...\n\n");
+    
+    test_wildcards();
+    test_remove();
+    test_many_topics();
+    test_invalid_patterns();
+    test_covers();
+    
+    printf("\nAll tests PASSED!\n");
+    return 0;
+}
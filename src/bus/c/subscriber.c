@@ -3,57 +3,333 @@
 #include <stdlib.h>
 #include <string.h>
 
-// NATS callback wrapper that converts to our callback signature
-static void _nats_message_handler(natsConnection* nc, natsSubscription* sub, natsMsg* msg, void* closure) {
-    zetabus_subscriber_t* subscriber = (zetabus_subscriber_t*)closure;
+#define DISPATCH_INLINE 16 // Matching subscribers held without allocating
+
+// Dispatches under way on this thread: a subscriber destroyed from a callback
+// cannot wait for them to let go of it
+static _Thread_local unsigned int tls_dispatching;
+
+typedef struct {
+    zetabus_broker_sub_t* broker;
+    zetabus_subscriber_t* inline_matched[DISPATCH_INLINE];
+    zetabus_subscriber_t** matched;
+    size_t count;
+    size_t cap;
+} dispatch_ctx_t;
+
+static void _deliver(zetabus_subscriber_t* subscriber, const char* subject, const void* data, size_t size,
+                     uint64_t sent_ns) {
+    if (subscriber->callback_ex) {
+        zetabus_message_t message = { .topic = subject, .data = data, .size = size, .sent_ns = sent_ns };
+        subscriber->callback_ex(&message, subscriber->closure);
+    } else {
+        subscriber->callback(subject, data, size);
+    }
+}
+
+// Take a reference to a matching subscriber (trie_lock held for reading)
+static void _collect_subscriber(void* handler, void* closure) {
+    zetabus_subscriber_t* subscriber = (zetabus_subscriber_t*)handler;
+    dispatch_ctx_t* ctx = (dispatch_ctx_t*)closure;
     
-    if (subscriber && subscriber->callback) {
-        const char* data = natsMsg_GetData(msg);
-        int data_len = natsMsg_GetDataLength(msg);
-        const char* subject = natsMsg_GetSubject(msg);
-        
-        subscriber->callback(subject, data, (size_t)data_len);
+    // Broker subscriptions may overlap (e.g. "a.*.c" and "a.b.*"); each subscriber
+    // only takes messages from its own one so it never sees a message twice
+    if (subscriber->broker != ctx->broker) return;
+    
+    if (ctx->count == ctx->cap) {
+        size_t cap = ctx->cap * 2;
+        zetabus_subscriber_t** grown = (zetabus_subscriber_t**)malloc(cap * sizeof(*grown));
+        if (!grown) return; // Out of memory: this subscriber misses the message
+        memcpy(grown, ctx->matched, ctx->count * sizeof(*grown));
+        if (ctx->matched != ctx->inline_matched) free(ctx->matched);
+        ctx->matched = grown;
+        ctx->cap = cap;
     }
+    atomic_fetch_add(&subscriber->refs, 1);
+    ctx->matched[ctx->count++] = subscriber;
+}
+
+static void _subscriber_free(zetabus_subscriber_t* subscriber) {
+    free(subscriber->topic);
+    free(subscriber);
+}
+
+void zetabus_dispatch(zetabus_t* bus, zetabus_broker_sub_t* broker, const char* subject,
+                      const void* data, size_t size, bool envelope) {
+    dispatch_ctx_t ctx = { .broker = broker, .cap = DISPATCH_INLINE };
+    ctx.matched = ctx.inline_matched;
+    
+    // Callbacks run unlocked, so they may create and destroy subscribers
+    pthread_rwlock_rdlock(&bus->trie_lock);
+    zetabus_trie_match(bus->trie, subject, _collect_subscriber, &ctx);
+    pthread_rwlock_unlock(&bus->trie_lock);
+    if (ctx.count == 0) return;
+    
+    uint32_t envelope_count = envelope ? zetabus_envelope_count(data, size) : 0;
+    tls_dispatching++;
+    for (size_t i = 0; i < ctx.count; i++) {
+        zetabus_subscriber_t* subscriber = ctx.matched[i];
+        if (envelope_count == 0) {
+            if (!atomic_load(&subscriber->removed)) _deliver(subscriber, subject, data, size, 0);
+            continue;
+        }
+        const void* cursor = zetabus_envelope_begin(data);
+        for (uint32_t j = 0; j < envelope_count && !atomic_load(&subscriber->removed); j++) {
+            uint64_t sent_ns;
+            size_t entry_size;
+            const void* entry = zetabus_envelope_next(&cursor, &sent_ns, &entry_size);
+            _deliver(subscriber, subject, entry, entry_size, sent_ns);
+        }
+    }
+    tls_dispatching--;
+    
+    // Subscribers destroyed from a callback are freed here, by the last reference
+    bool removed = false;
+    pthread_mutex_lock(&bus->release_lock);
+    for (size_t i = 0; i < ctx.count; i++) {
+        zetabus_subscriber_t* subscriber = ctx.matched[i];
+        if (atomic_load(&subscriber->removed)) removed = true;
+        if (atomic_fetch_sub(&subscriber->refs, 1) == 1) _subscriber_free(subscriber);
+    }
+    if (removed) pthread_cond_broadcast(&bus->released);
+    pthread_mutex_unlock(&bus->release_lock);
+    if (ctx.matched != ctx.inline_matched) free(ctx.matched);
+}
+
+// NATS callback wrapper that dispatches to every local subscriber matching the subject
+static void _nats_message_handler(natsConnection* nc, natsSubscription* sub, natsMsg* msg, void* closure) {
+    zetabus_broker_sub_t* broker = (zetabus_broker_sub_t*)closure;
+    const char* reply = natsMsg_GetReply(msg);
+    
+    zetabus_dispatch(broker->bus, broker, natsMsg_GetSubject(msg), natsMsg_GetData(msg),
+                     (size_t)natsMsg_GetDataLength(msg),
+                     reply && strcmp(reply, ZETABUS_ENVELOPE_REPLY) == 0);
     
     natsMsg_Destroy(msg);
 }
 
+static void _lean_message_handler(void* closure, const char* subject, const char* reply,
+                                  const void* data, size_t size) {
+    zetabus_broker_sub_t* broker = (zetabus_broker_sub_t*)closure;
+    zetabus_dispatch(broker->bus, broker, subject, data, size,
+                     reply && strcmp(reply, ZETABUS_ENVELOPE_REPLY) == 0);
+}
+
+static bool _broker_active(const zetabus_broker_sub_t* broker) {
+    return broker->sub || broker->lean_sid;
+}
+
+// Start the broker subscription for broker->pattern (0 on success)
+static int _broker_subscribe(zetabus_t* bus, zetabus_broker_sub_t* broker) {
+    if (bus->lean) {
+        broker->lean_sid = zetabus_lean_subscribe(bus->lean, broker->pattern, _lean_message_handler, broker);
+        return broker->lean_sid ? 0 : -1;
+    }
+    
+    natsStatus s = natsConnection_Subscribe(&broker->sub, bus->nc, broker->pattern,
+                                             _nats_message_handler, broker);
+    if (s != NATS_OK) {
+        broker->sub = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+// Handle of an idle broker subscription, detached under trie_lock and released after
+typedef struct {
+    natsSubscription* sub;
+    uint64_t lean_sid;
+} idle_broker_sub_t;
+
+static idle_broker_sub_t _broker_detach(zetabus_broker_sub_t* broker) {
+    idle_broker_sub_t idle = { .sub = broker->sub, .lean_sid = broker->lean_sid };
+    broker->sub = NULL;
+    broker->lean_sid = 0;
+    return idle;
+}
+
+static void _broker_release(zetabus_t* bus, idle_broker_sub_t idle) {
+    if (idle.lean_sid) {
+        zetabus_lean_unsubscribe(bus->lean, idle.lean_sid);
+    }
+    if (idle.sub) {
+        natsSubscription_Unsubscribe(idle.sub);
+        natsSubscription_Destroy(idle.sub);
+    }
+}
+
+// Find a live broker subscription covering topic, or start one (trie_lock held for writing)
+static zetabus_broker_sub_t* _acquire_broker_sub(zetabus_t* bus, const char* topic) {
+    zetabus_broker_sub_t* idle = NULL;
+    for (zetabus_broker_sub_t* broker = bus->broker_subs; broker; broker = broker->next) {
+        if (_broker_active(broker) && zetabus_subject_covers(broker->pattern, topic)) {
+            broker->refcount++;
+            return broker;
+        }
+        if (!_broker_active(broker) && strcmp(broker->pattern, topic) == 0) {
+            idle = broker;
+        }
+    }
+    
+    zetabus_broker_sub_t* broker = idle;
+    if (!broker) {
+        broker = (zetabus_broker_sub_t*)calloc(1, sizeof(zetabus_broker_sub_t));
+        if (!broker) return NULL;
+        broker->bus = bus;
+        broker->pattern = strdup(topic);
+        if (!broker->pattern) {
+            free(broker);
+            return NULL;
+        }
+        broker->next = bus->broker_subs;
+        bus->broker_subs = broker;
+    }
+    
+    // Messages arriving before we return wait on trie_lock
+    if (_broker_subscribe(bus, broker) != 0) {
+        return NULL;
+    }
+    
+    broker->refcount = 1;
+    return broker;
+}
+
+// Register a new subscriber with the multicast group or a broker subscription,
+// freeing it on failure
+static zetabus_subscriber_t* _subscriber_start(zetabus_subscriber_t* subscriber) {
+    zetabus_t* bus = subscriber->bus;
+    const char* topic = subscriber->topic;
+    atomic_init(&subscriber->refs, 1);
+    atomic_init(&subscriber->removed, false);
+    
+    // Multicast buses receive every topic on the group and filter through the trie
+    if (bus->udpm) {
+        pthread_rwlock_wrlock(&bus->trie_lock);
+        int ret = zetabus_udpm_join(bus->udpm) == 0 ? zetabus_trie_insert(bus->trie, topic, subscriber) : -1;
+        pthread_rwlock_unlock(&bus->trie_lock);
+        if (ret != 0) {
+            free(subscriber->topic);
+            free(subscriber);
+            return NULL;
+        }
+        return subscriber;
+    }
+    
+    pthread_rwlock_wrlock(&bus->trie_lock);
+    subscriber->broker = _acquire_broker_sub(bus, topic);
+    if (!subscriber->broker || zetabus_trie_insert(bus->trie, topic, subscriber) != 0) {
+        idle_broker_sub_t idle = {0};
+        if (subscriber->broker && --subscriber->broker->refcount == 0) {
+            idle = _broker_detach(subscriber->broker);
+        }
+        pthread_rwlock_unlock(&bus->trie_lock);
+        _broker_release(bus, idle);
+        free(subscriber->topic);
+        free(subscriber);
+        return NULL;
+    }
+    pthread_rwlock_unlock(&bus->trie_lock);
+    
+    return subscriber;
+}
+
 zetabus_subscriber_t* zetabus_subscriber_create(zetabus_t* bus, const char* topic, 
                                                   void (*callback)(const char* topic, const void* data, size_t size)) {
     if (!bus || !topic || !callback) return NULL;
     
-    zetabus_subscriber_t* subscriber = (zetabus_subscriber_t*)malloc(sizeof(zetabus_subscriber_t));
+    zetabus_subscriber_t* subscriber = (zetabus_subscriber_t*)calloc(1, sizeof(zetabus_subscriber_t));
     if (!subscriber) return NULL;
     
     subscriber->bus = bus;
     subscriber->topic = strdup(topic);
     subscriber->callback = callback;
-    subscriber->sub = NULL;
     
     if (!subscriber->topic) {
         free(subscriber);
         return NULL;
     }
     
-    // Subscribe with callback
-    natsStatus s = natsConnection_Subscribe(&subscriber->sub, bus->nc, topic, 
-                                             _nats_message_handler, subscriber);
-    if (s != NATS_OK) {
-        free(subscriber->topic);
+    return _subscriber_start(subscriber);
+}
+
+zetabus_subscriber_t* zetabus_subscriber_create_ex(zetabus_t* bus, const char* topic,
+                                                     zetabus_message_callback_t callback, void* closure) {
+    if (!bus || !topic || !callback) return NULL;
+    
+    zetabus_subscriber_t* subscriber = (zetabus_subscriber_t*)calloc(1, sizeof(zetabus_subscriber_t));
+    if (!subscriber) return NULL;
+    
+    subscriber->bus = bus;
+    subscriber->topic = strdup(topic);
+    subscriber->callback_ex = callback;
+    subscriber->closure = closure;
+    
+    if (!subscriber->topic) {
+        free(subscriber);
+        return NULL;
+    }
+    
+    return _subscriber_start(subscriber);
+}
+
+zetabus_subscriber_t* zetabus_subscriber_create_direct(zetabus_t* bus, const char* topic,
+                                                         void (*callback)(const char* topic, const void* data, size_t size)) {
+    // Direct channels are per topic, so wildcards have nothing to connect to
+    if (!bus || !topic || !callback || bus->udpm || bus->lean || strchr(topic, '*') || strchr(topic, '>')) return NULL;
+    
+    zetabus_subscriber_t* subscriber = (zetabus_subscriber_t*)calloc(1, sizeof(zetabus_subscriber_t));
+    if (!subscriber) return NULL;
+    
+    subscriber->bus = bus;
+    subscriber->topic = strdup(topic);
+    subscriber->callback = callback;
+    if (!subscriber->topic) {
         free(subscriber);
         return NULL;
     }
     
+    subscriber->direct = zetabus_direct_sub_create(subscriber);
+    if (!subscriber->direct) {
+        free(subscriber->topic);
+        free(subscriber);
+        return NULL;
+    }
     return subscriber;
 }
 
 void zetabus_subscriber_destroy(zetabus_subscriber_t* subscriber) {
-    if (subscriber) {
-        if (subscriber->sub) {
-            natsSubscription_Unsubscribe(subscriber->sub);
-            natsSubscription_Destroy(subscriber->sub);
-        }
+    if (subscriber && subscriber->direct) {
+        zetabus_direct_sub_destroy(subscriber->direct);
         free(subscriber->topic);
         free(subscriber);
+        return;
+    }
+    
+    if (subscriber) {
+        zetabus_t* bus = subscriber->bus;
+        idle_broker_sub_t idle = {0};
+        
+        // Once removed under the write lock no new dispatch can reach this subscriber
+        pthread_rwlock_wrlock(&bus->trie_lock);
+        zetabus_trie_remove(bus->trie, subscriber->topic, subscriber);
+        zetabus_broker_sub_t* broker = subscriber->broker;
+        if (broker && --broker->refcount == 0) {
+            idle = _broker_detach(broker);
+        }
+        pthread_rwlock_unlock(&bus->trie_lock);
+        
+        _broker_release(bus, idle);
+        
+        // Dispatches that took it before then skip it from here on. Those on
+        // other threads are waited for, so no callback runs once this returns;
+        // destroyed from a callback, the dispatch's last reference frees it.
+        pthread_mutex_lock(&bus->release_lock);
+        atomic_store(&subscriber->removed, true);
+        while (tls_dispatching == 0 && atomic_load(&subscriber->refs) > 1) {
+            pthread_cond_wait(&bus->released, &bus->release_lock);
+        }
+        bool last = atomic_fetch_sub(&subscriber->refs, 1) == 1;
+        pthread_mutex_unlock(&bus->release_lock);
+        if (last) _subscriber_free(subscriber);
     }
 }
@@ -0,0 +1,710 @@
+#include "bus.h"
+#include "bus_internal.h"
+#include "../../clock/c/clock.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// UDP multicast transport (udpm://group:port?ttl=0&iface=addr&mtu=1400&nack=1)
+//
+// Every message gets a per-sender sequence number and is split into fragments
+// that fit one datagram. Each fragment carries the topic, so receivers can
+// reassemble without extra state and filter through the subject trie. With
+// nack=1 senders keep the last UDPM_REPAIR_DEPTH messages and receivers ask
+// for missing fragments by unicast; without it, incomplete messages are dropped.
+
+#define UDPM_MAGIC 0x31555a5aU // "ZZU1"
+#define UDPM_TYPE_DATA 1
+#define UDPM_TYPE_NACK 2
+#define UDPM_FLAG_ENVELOPE 0x01 // DATA: the message is a batch envelope
+#define UDPM_HEADER_SIZE 28
+
+#define UDPM_DEFAULT_MTU 1400
+#define UDPM_MAX_MTU 65507
+#define UDPM_MAX_TOPIC 255
+#define UDPM_MAX_MESSAGE (64u * 1024 * 1024)
+
+#define UDPM_MAX_SENDERS 32
+#define UDPM_SLOTS_PER_SENDER 8
+#define UDPM_REPAIR_DEPTH 64
+#define UDPM_MAX_NACK_FRAGS 256
+
+#define UDPM_POLL_MS 5
+#define UDPM_NACK_DELAY_NS 3000000ULL         // Quiet time before asking for a repair
+#define UDPM_MAX_NACKS 3
+#define UDPM_REASSEMBLY_TIMEOUT_NS 100000000ULL // Give up on a message without repair
+
+// Wire header, all fields little-endian
+typedef struct {
+    uint32_t magic;
+    uint8_t type;
+    uint8_t flags;
+    uint16_t topic_len;
+    uint32_t sender_id;
+    uint32_t seq;
+    uint16_t frag_index;
+    uint16_t frag_count; // NACK: number of uint16 fragment indexes that follow (0 = all)
+    uint32_t total_size;
+    uint32_t frag_offset;
+} udpm_header_t;
+
+typedef struct {
+    bool active;
+    uint32_t seq;
+    uint16_t frag_count;     // 0 for a message we only know is missing
+    uint16_t frags_received;
+    uint32_t total_size;
+    uint8_t flags;
+    uint8_t* data;
+    uint8_t* have;           // Fragment bitmap
+    char topic[UDPM_MAX_TOPIC + 1];
+    uint64_t last_ns;
+    uint32_t nacks_sent;
+} udpm_reassembly_t;
+
+typedef struct {
+    bool active;
+    uint32_t id;
+    struct sockaddr_in addr; // Unicast address NACKs go to
+    uint64_t last_seen_ns;
+
+    bool have_seen;
+    uint32_t highest_seen;
+    bool have_delivered;
+    uint32_t max_delivered;
+    uint64_t delivered_window; // Bit i set: max_delivered - i was delivered
+
+    udpm_reassembly_t slots[UDPM_SLOTS_PER_SENDER];
+} udpm_sender_t;
+
+typedef struct {
+    bool used;
+    uint32_t seq;
+    uint8_t flags;
+    char topic[UDPM_MAX_TOPIC + 1];
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+} udpm_repair_t;
+
+struct zetabus_udpm_s {
+    zetabus_t* bus;
+    struct sockaddr_in group;
+    struct in_addr iface;
+    uint32_t mtu;
+    bool nack;
+
+    int send_fd;   // Publishes, sends NACKs, receives NACKs and repairs
+    int recv_fd;   // Bound to the group port
+    atomic_bool joined;
+
+    uint32_t sender_id;
+    pthread_mutex_t send_lock;
+    uint32_t next_seq;
+    udpm_repair_t repair[UDPM_REPAIR_DEPTH];
+#ifdef ZETABUS_TEST_HOOKS
+    atomic_uint test_drop_every;
+    uint32_t test_drop_counter;
+#endif
+
+    pthread_t thread;
+    atomic_bool running;
+    uint8_t* recv_buf;
+    udpm_sender_t senders[UDPM_MAX_SENDERS]; // Owned by the receive thread
+};
+
+// Serial number comparison that survives wraparound
+static int32_t seq_diff(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b);
+}
+
+// Header encoding
+
+static void put_u16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void put_u32(uint8_t* p, uint32_t v) { put_u16(p, (uint16_t)v); put_u16(p + 2, (uint16_t)(v >> 16)); }
+static uint16_t get_u16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t get_u32(const uint8_t* p) { return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16); }
+
+static void encode_header(uint8_t* p, const udpm_header_t* h) {
+    put_u32(p, h->magic);
+    p[4] = h->type;
+    p[5] = h->flags;
+    put_u16(p + 6, h->topic_len);
+    put_u32(p + 8, h->sender_id);
+    put_u32(p + 12, h->seq);
+    put_u16(p + 16, h->frag_index);
+    put_u16(p + 18, h->frag_count);
+    put_u32(p + 20, h->total_size);
+    put_u32(p + 24, h->frag_offset);
+}
+
+static int decode_header(const uint8_t* p, size_t len, udpm_header_t* h) {
+    if (len < UDPM_HEADER_SIZE) return -1;
+    h->magic = get_u32(p);
+    h->type = p[4];
+    h->flags = p[5];
+    h->topic_len = get_u16(p + 6);
+    h->sender_id = get_u32(p + 8);
+    h->seq = get_u32(p + 12);
+    h->frag_index = get_u16(p + 16);
+    h->frag_count = get_u16(p + 18);
+    h->total_size = get_u32(p + 20);
+    h->frag_offset = get_u32(p + 24);
+    return h->magic == UDPM_MAGIC ? 0 : -1;
+}
+
+// URL parsing
+
+static int parse_url(zetabus_udpm_t* udpm, const char* url) {
+    const char* p = url + strlen(ZETABUS_UDPM_SCHEME);
+    char host[64];
+    unsigned port = 0;
+    const char* colon = strchr(p, ':');
+    if (!colon || (size_t)(colon - p) >= sizeof(host)) return -1;
+    memcpy(host, p, (size_t)(colon - p));
+    host[colon - p] = '\0';
+
+    char* end = NULL;
+    port = (unsigned)strtoul(colon + 1, &end, 10);
+    if (end == colon + 1 || port == 0 || port > 65535) return -1;
+
+    memset(&udpm->group, 0, sizeof(udpm->group));
+    udpm->group.sin_family = AF_INET;
+    udpm->group.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, host, &udpm->group.sin_addr) != 1) return -1;
+    if (!IN_MULTICAST(ntohl(udpm->group.sin_addr.s_addr))) return -1;
+
+    udpm->iface.s_addr = htonl(INADDR_ANY);
+    udpm->mtu = UDPM_DEFAULT_MTU;
+    udpm->nack = false;
+    int ttl = 0;
+
+    // Query options: key=value pairs separated by '&'
+    if (*end == '?') {
+        const char* opt = end + 1;
+        while (*opt) {
+            const char* amp = strchr(opt, '&');
+            size_t len = amp ? (size_t)(amp - opt) : strlen(opt);
+            char kv[64];
+            if (len >= sizeof(kv)) return -1;
+            memcpy(kv, opt, len);
+            kv[len] = '\0';
+
+            char* eq = strchr(kv, '=');
+            if (!eq) return -1;
+            *eq = '\0';
+            const char* value = eq + 1;
+            if (strcmp(kv, "ttl") == 0) {
+                ttl = atoi(value);
+            } else if (strcmp(kv, "mtu") == 0) {
+                udpm->mtu = (uint32_t)strtoul(value, NULL, 10);
+            } else if (strcmp(kv, "nack") == 0) {
+                udpm->nack = atoi(value) != 0;
+            } else if (strcmp(kv, "iface") == 0) {
+                if (inet_pton(AF_INET, value, &udpm->iface) != 1) return -1;
+            } else {
+                return -1;
+            }
+            opt += len + (amp ? 1 : 0);
+        }
+    } else if (*end != '\0' && *end != '/') {
+        return -1;
+    }
+
+    if (udpm->mtu < UDPM_HEADER_SIZE + 64 || udpm->mtu > UDPM_MAX_MTU) return -1;
+    if (ttl < 0 || ttl > 255) return -1;
+    return ttl;
+}
+
+// Sending
+
+// Send the given fragments of a message (all of them when indexes is NULL)
+static int send_fragments(zetabus_udpm_t* udpm, const struct sockaddr_in* dest, uint32_t seq, uint8_t flags,
+                          const char* topic, const uint8_t* data, size_t size,
+                          const uint16_t* indexes, size_t index_count, bool repair) {
+    size_t topic_len = strlen(topic);
+    size_t frag_payload = udpm->mtu - UDPM_HEADER_SIZE - topic_len;
+    size_t frag_count = size == 0 ? 1 : (size + frag_payload - 1) / frag_payload;
+    if (frag_count > UINT16_MAX) return -1;
+
+    size_t n = indexes ? index_count : frag_count;
+    for (size_t i = 0; i < n; i++) {
+        size_t index = indexes ? indexes[i] : i;
+        if (index >= frag_count) continue;
+        size_t offset = index * frag_payload;
+        size_t len = size - offset < frag_payload ? size - offset : frag_payload;
+
+        uint8_t header[UDPM_HEADER_SIZE];
+        udpm_header_t h = {
+            .magic = UDPM_MAGIC,
+            .type = UDPM_TYPE_DATA,
+            .flags = flags,
+            .topic_len = (uint16_t)topic_len,
+            .sender_id = udpm->sender_id,
+            .seq = seq,
+            .frag_index = (uint16_t)index,
+            .frag_count = (uint16_t)frag_count,
+            .total_size = (uint32_t)size,
+            .frag_offset = (uint32_t)offset
+        };
+        encode_header(header, &h);
+
+#ifdef ZETABUS_TEST_HOOKS
+        if (!repair) {
+            uint32_t drop_every = atomic_load(&udpm->test_drop_every);
+            if (drop_every > 0 && ++udpm->test_drop_counter % drop_every == 0) continue;
+        }
+#endif
+
+        struct iovec iov[3] = {
+            { .iov_base = header, .iov_len = sizeof(header) },
+            { .iov_base = (void*)topic, .iov_len = topic_len },
+            { .iov_base = (void*)(data + offset), .iov_len = len }
+        };
+        struct msghdr msg = {
+            .msg_name = (void*)dest,
+            .msg_namelen = sizeof(*dest),
+            .msg_iov = iov,
+            .msg_iovlen = 3
+        };
+        ssize_t sent;
+        do {
+            sent = sendmsg(udpm->send_fd, &msg, 0);
+        } while (sent < 0 && errno == EINTR);
+        if (sent < 0) return -1;
+    }
+    return 0;
+}
+
+int zetabus_udpm_publish(zetabus_udpm_t* udpm, const char* topic, const void* data, size_t size,
+                         bool envelope) {
+    size_t topic_len = strlen(topic);
+    uint8_t flags = envelope ? UDPM_FLAG_ENVELOPE : 0;
+    if (topic_len == 0 || topic_len > UDPM_MAX_TOPIC || size > UDPM_MAX_MESSAGE) return -1;
+    if (UDPM_HEADER_SIZE + topic_len >= udpm->mtu) return -1;
+
+    pthread_mutex_lock(&udpm->send_lock);
+    uint32_t seq = udpm->next_seq++;
+
+    // Keep a copy for repairs before sending, so a fast NACK always finds it
+    if (udpm->nack) {
+        udpm_repair_t* entry = &udpm->repair[seq % UDPM_REPAIR_DEPTH];
+        entry->used = false;
+        if (size > entry->capacity) {
+            uint8_t* buf = (uint8_t*)realloc(entry->data, size);
+            if (buf) {
+                entry->data = buf;
+                entry->capacity = size;
+            }
+        }
+        if (size <= entry->capacity) {
+            if (size > 0) memcpy(entry->data, data, size);
+            memcpy(entry->topic, topic, topic_len + 1);
+            entry->seq = seq;
+            entry->flags = flags;
+            entry->size = size;
+            entry->used = true;
+        }
+    }
+
+    int ret = send_fragments(udpm, &udpm->group, seq, flags, topic, (const uint8_t*)data, size, NULL, 0, false);
+    pthread_mutex_unlock(&udpm->send_lock);
+    return ret;
+}
+
+static void handle_nack(zetabus_udpm_t* udpm, const udpm_header_t* h, const uint8_t* body, size_t body_len,
+                        const struct sockaddr_in* from) {
+    if (!udpm->nack || h->sender_id != udpm->sender_id) return;
+    if ((size_t)h->frag_count * 2 > body_len) return;
+
+    uint16_t indexes[UDPM_MAX_NACK_FRAGS];
+    size_t count = h->frag_count < UDPM_MAX_NACK_FRAGS ? h->frag_count : UDPM_MAX_NACK_FRAGS;
+    for (size_t i = 0; i < count; i++) {
+        indexes[i] = get_u16(body + 2 * i);
+    }
+
+    pthread_mutex_lock(&udpm->send_lock);
+    udpm_repair_t* entry = &udpm->repair[h->seq % UDPM_REPAIR_DEPTH];
+    if (entry->used && entry->seq == h->seq) {
+        send_fragments(udpm, from, entry->seq, entry->flags, entry->topic, entry->data, entry->size,
+                       count > 0 ? indexes : NULL, count, true);
+    }
+    pthread_mutex_unlock(&udpm->send_lock);
+}
+
+// Receiving
+
+static void slot_clear(udpm_reassembly_t* slot) {
+    free(slot->data);
+    free(slot->have);
+    memset(slot, 0, sizeof(*slot));
+}
+
+static bool was_delivered(const udpm_sender_t* sender, uint32_t seq) {
+    if (!sender->have_delivered) return false;
+    int32_t d = seq_diff(seq, sender->max_delivered);
+    if (d > 0) return false;
+    if (d <= -64) return true; // Too old to track, treat as a duplicate
+    return (sender->delivered_window >> (uint32_t)(-d)) & 1;
+}
+
+static void mark_delivered(udpm_sender_t* sender, uint32_t seq) {
+    if (!sender->have_delivered) {
+        sender->have_delivered = true;
+        sender->max_delivered = seq;
+        sender->delivered_window = 1;
+        return;
+    }
+    int32_t d = seq_diff(seq, sender->max_delivered);
+    if (d > 0) {
+        sender->delivered_window = d >= 64 ? 1 : (sender->delivered_window << d) | 1;
+        sender->max_delivered = seq;
+    } else if (d > -64) {
+        sender->delivered_window |= 1ULL << (uint32_t)(-d);
+    }
+}
+
+static udpm_sender_t* find_sender(zetabus_udpm_t* udpm, uint32_t id, const struct sockaddr_in* from, uint64_t now) {
+    udpm_sender_t* victim = &udpm->senders[0];
+    for (size_t i = 0; i < UDPM_MAX_SENDERS; i++) {
+        udpm_sender_t* sender = &udpm->senders[i];
+        if (sender->active && sender->id == id) {
+            sender->last_seen_ns = now;
+            return sender;
+        }
+        if (!sender->active) {
+            victim = sender;
+        } else if (victim->active && sender->last_seen_ns < victim->last_seen_ns) {
+            victim = sender;
+        }
+    }
+
+    // Evict the least recently heard sender
+    for (size_t i = 0; i < UDPM_SLOTS_PER_SENDER; i++) {
+        slot_clear(&victim->slots[i]);
+    }
+    memset(victim, 0, sizeof(*victim));
+    victim->active = true;
+    victim->id = id;
+    victim->addr = *from;
+    victim->last_seen_ns = now;
+    return victim;
+}
+
+static udpm_reassembly_t* find_slot(udpm_sender_t* sender, uint32_t seq, bool create, uint64_t now) {
+    udpm_reassembly_t* free_slot = NULL;
+    udpm_reassembly_t* oldest = NULL;
+    for (size_t i = 0; i < UDPM_SLOTS_PER_SENDER; i++) {
+        udpm_reassembly_t* slot = &sender->slots[i];
+        if (!slot->active) {
+            if (!free_slot) free_slot = slot;
+        } else if (slot->seq == seq) {
+            return slot;
+        } else if (!oldest || seq_diff(slot->seq, oldest->seq) < 0) {
+            oldest = slot;
+        }
+    }
+    if (!create) return NULL;
+
+    // Out of slots: the oldest incomplete message is the least likely to finish
+    udpm_reassembly_t* slot = free_slot ? free_slot : oldest;
+    slot_clear(slot);
+    slot->active = true;
+    slot->seq = seq;
+    slot->last_ns = now;
+    return slot;
+}
+
+static void deliver(zetabus_udpm_t* udpm, const char* topic, uint8_t flags, const void* data, size_t size) {
+    zetabus_dispatch(udpm->bus, NULL, topic, data, size, (flags & UDPM_FLAG_ENVELOPE) != 0);
+}
+
+static void send_nack(zetabus_udpm_t* udpm, udpm_sender_t* sender, udpm_reassembly_t* slot) {
+    uint8_t packet[UDPM_HEADER_SIZE + 2 * UDPM_MAX_NACK_FRAGS];
+    size_t count = 0;
+    for (size_t i = 0; i < slot->frag_count && count < UDPM_MAX_NACK_FRAGS; i++) {
+        if (!(slot->have[i / 8] & (1u << (i % 8)))) {
+            put_u16(packet + UDPM_HEADER_SIZE + 2 * count, (uint16_t)i);
+            count++;
+        }
+    }
+
+    udpm_header_t h = {
+        .magic = UDPM_MAGIC,
+        .type = UDPM_TYPE_NACK,
+        .sender_id = sender->id,
+        .seq = slot->seq,
+        .frag_count = (uint16_t)count
+    };
+    encode_header(packet, &h);
+    (void)sendto(udpm->send_fd, packet, UDPM_HEADER_SIZE + 2 * count, 0,
+                 (const struct sockaddr*)&sender->addr, sizeof(sender->addr));
+}
+
+// Placeholder slots for messages of which not a single fragment arrived
+static void note_gap(udpm_sender_t* sender, uint32_t seq, uint64_t now) {
+    if (sender->have_seen) {
+        int32_t gap = seq_diff(seq, sender->highest_seen);
+        if (gap <= 0) return;
+
+        // Only chase the most recent few; older ones would evict each other
+        uint32_t missing = (uint32_t)(gap - 1);
+        if (missing > UDPM_SLOTS_PER_SENDER / 2) missing = UDPM_SLOTS_PER_SENDER / 2;
+        for (uint32_t s = seq - missing; s != seq; s++) {
+            if (!was_delivered(sender, s)) {
+                find_slot(sender, s, true, now);
+            }
+        }
+    }
+    sender->have_seen = true;
+    sender->highest_seen = seq;
+}
+
+static void handle_data(zetabus_udpm_t* udpm, const udpm_header_t* h, const uint8_t* body, size_t body_len,
+                        const struct sockaddr_in* from, uint64_t now) {
+    if (!atomic_load(&udpm->joined)) return;
+    if (h->topic_len == 0 || h->topic_len > UDPM_MAX_TOPIC || h->topic_len > body_len) return;
+    if (h->frag_count == 0 || h->frag_index >= h->frag_count || h->total_size > UDPM_MAX_MESSAGE) return;
+
+    size_t payload_len = body_len - h->topic_len;
+    if ((uint64_t)h->frag_offset + payload_len > h->total_size) return;
+    const uint8_t* payload = body + h->topic_len;
+
+    udpm_sender_t* sender = find_sender(udpm, h->sender_id, from, now);
+    if (was_delivered(sender, h->seq)) return;
+    if (udpm->nack) note_gap(sender, h->seq, now);
+
+    char topic[UDPM_MAX_TOPIC + 1];
+    memcpy(topic, body, h->topic_len);
+    topic[h->topic_len] = '\0';
+
+    // Single-fragment messages are dispatched straight from the receive buffer
+    if (h->frag_count == 1) {
+        if (payload_len != h->total_size) return;
+        udpm_reassembly_t* placeholder = find_slot(sender, h->seq, false, now);
+        if (placeholder) slot_clear(placeholder);
+        mark_delivered(sender, h->seq);
+        deliver(udpm, topic, h->flags, payload, payload_len);
+        return;
+    }
+
+    udpm_reassembly_t* slot = find_slot(sender, h->seq, true, now);
+    if (slot->frag_count == 0) {
+        slot->data = (uint8_t*)malloc(h->total_size);
+        slot->have = (uint8_t*)calloc(((size_t)h->frag_count + 7) / 8, 1);
+        if (!slot->data || !slot->have) {
+            slot_clear(slot);
+            return;
+        }
+        slot->frag_count = h->frag_count;
+        slot->total_size = h->total_size;
+        slot->flags = h->flags;
+        memcpy(slot->topic, topic, (size_t)h->topic_len + 1);
+    } else if (slot->frag_count != h->frag_count || slot->total_size != h->total_size ||
+               slot->flags != h->flags) {
+        return;
+    }
+
+    uint8_t bit = (uint8_t)(1u << (h->frag_index % 8));
+    if (slot->have[h->frag_index / 8] & bit) return;
+    slot->have[h->frag_index / 8] |= bit;
+    memcpy(slot->data + h->frag_offset, payload, payload_len);
+    slot->frags_received++;
+    slot->last_ns = now;
+
+    if (slot->frags_received == slot->frag_count) {
+        mark_delivered(sender, slot->seq);
+        deliver(udpm, slot->topic, slot->flags, slot->data, slot->total_size);
+        slot_clear(slot);
+    }
+}
+
+// Ask for repairs of stalled messages and expire the ones that cannot finish
+static void check_timers(zetabus_udpm_t* udpm, uint64_t now) {
+    for (size_t i = 0; i < UDPM_MAX_SENDERS; i++) {
+        udpm_sender_t* sender = &udpm->senders[i];
+        if (!sender->active) continue;
+        for (size_t j = 0; j < UDPM_SLOTS_PER_SENDER; j++) {
+            udpm_reassembly_t* slot = &sender->slots[j];
+            if (!slot->active) continue;
+            uint64_t idle = now - slot->last_ns;
+            if (udpm->nack) {
+                if (idle < UDPM_NACK_DELAY_NS) continue;
+                if (slot->nacks_sent < UDPM_MAX_NACKS) {
+                    send_nack(udpm, sender, slot);
+                    slot->nacks_sent++;
+                    slot->last_ns = now;
+                } else {
+                    slot_clear(slot);
+                }
+            } else if (idle > UDPM_REASSEMBLY_TIMEOUT_NS) {
+                slot_clear(slot);
+            }
+        }
+    }
+}
+
+static void receive_from(zetabus_udpm_t* udpm, int fd, uint64_t now) {
+    for (;;) {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(fd, udpm->recv_buf, UDPM_MAX_MTU, MSG_DONTWAIT, (struct sockaddr*)&from, &from_len);
+        if (n < 0) return;
+
+        udpm_header_t h;
+        if (decode_header(udpm->recv_buf, (size_t)n, &h) != 0) continue;
+        const uint8_t* body = udpm->recv_buf + UDPM_HEADER_SIZE;
+        size_t body_len = (size_t)n - UDPM_HEADER_SIZE;
+        if (h.type == UDPM_TYPE_DATA) {
+            handle_data(udpm, &h, body, body_len, &from, now);
+        } else if (h.type == UDPM_TYPE_NACK) {
+            handle_nack(udpm, &h, body, body_len, &from);
+        }
+    }
+}
+
+static void* udpm_thread(void* arg) {
+    zetabus_udpm_t* udpm = (zetabus_udpm_t*)arg;
+    while (atomic_load(&udpm->running)) {
+        struct pollfd fds[2] = {
+            { .fd = udpm->send_fd, .events = POLLIN },
+            { .fd = atomic_load(&udpm->joined) ? udpm->recv_fd : -1, .events = POLLIN }
+        };
+        int ready = poll(fds, 2, UDPM_POLL_MS);
+        uint64_t now = zeta_clock_monotonic_ns();
+        if (ready > 0) {
+            if (fds[0].revents & POLLIN) receive_from(udpm, udpm->send_fd, now);
+            if (fds[1].revents & POLLIN) receive_from(udpm, udpm->recv_fd, now);
+        }
+        check_timers(udpm, now);
+    }
+    return NULL;
+}
+
+// Lifecycle
+
+static uint32_t random_sender_id(void) {
+    uint32_t id = 0;
+    FILE* f = fopen("/dev/urandom", "rb");
+    if (f) {
+        if (fread(&id, sizeof(id), 1, f) != 1) id = 0;
+        fclose(f);
+    }
+    if (id == 0) id = (uint32_t)zeta_clock_monotonic_ns() ^ ((uint32_t)getpid() << 16);
+    return id;
+}
+
+zetabus_udpm_t* zetabus_udpm_create(zetabus_t* bus, const char* url) {
+    zetabus_udpm_t* udpm = (zetabus_udpm_t*)calloc(1, sizeof(zetabus_udpm_t));
+    if (!udpm) return NULL;
+    udpm->bus = bus;
+    udpm->send_fd = -1;
+    udpm->recv_fd = -1;
+
+    int ttl = parse_url(udpm, url);
+    udpm->recv_buf = (uint8_t*)malloc(UDPM_MAX_MTU);
+    if (ttl < 0 || !udpm->recv_buf) goto fail;
+
+    udpm->send_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    udpm->recv_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (udpm->send_fd < 0 || udpm->recv_fd < 0) goto fail;
+
+    // Loopback lets subscribers on this host (including this bus) see our messages
+    unsigned char mttl = (unsigned char)ttl;
+    unsigned char loop = 1;
+    if (setsockopt(udpm->send_fd, IPPROTO_IP, IP_MULTICAST_TTL, &mttl, sizeof(mttl)) != 0 ||
+        setsockopt(udpm->send_fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) != 0) {
+        goto fail;
+    }
+    if (udpm->iface.s_addr != htonl(INADDR_ANY) &&
+        setsockopt(udpm->send_fd, IPPROTO_IP, IP_MULTICAST_IF, &udpm->iface, sizeof(udpm->iface)) != 0) {
+        goto fail;
+    }
+
+    // Several buses on one host share the group port
+    int on = 1;
+    setsockopt(udpm->recv_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+#ifdef SO_REUSEPORT
+    setsockopt(udpm->recv_fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+#endif
+#ifdef IP_MULTICAST_ALL
+    // Only receive groups this socket joined, not every group joined on the host
+    int off = 0;
+    setsockopt(udpm->recv_fd, IPPROTO_IP, IP_MULTICAST_ALL, &off, sizeof(off));
+#endif
+    int rcvbuf = 4 * 1024 * 1024;
+    setsockopt(udpm->recv_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct sockaddr_in bind_addr = udpm->group;
+    bind_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(udpm->recv_fd, (struct sockaddr*)&bind_addr, sizeof(bind_addr)) != 0) goto fail;
+
+    udpm->sender_id = random_sender_id();
+    pthread_mutex_init(&udpm->send_lock, NULL);
+    atomic_init(&udpm->joined, false);
+#ifdef ZETABUS_TEST_HOOKS
+    atomic_init(&udpm->test_drop_every, 0);
+#endif
+    atomic_init(&udpm->running, true);
+    if (pthread_create(&udpm->thread, NULL, udpm_thread, udpm) != 0) {
+        pthread_mutex_destroy(&udpm->send_lock);
+        goto fail;
+    }
+    return udpm;
+
+fail:
+    if (udpm->send_fd >= 0) close(udpm->send_fd);
+    if (udpm->recv_fd >= 0) close(udpm->recv_fd);
+    free(udpm->recv_buf);
+    free(udpm);
+    return NULL;
+}
+
+int zetabus_udpm_join(zetabus_udpm_t* udpm) {
+    if (atomic_load(&udpm->joined)) return 0;
+
+    struct ip_mreq mreq = {
+        .imr_multiaddr = udpm->group.sin_addr,
+        .imr_interface = udpm->iface
+    };
+    if (setsockopt(udpm->recv_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) != 0) {
+        return -1;
+    }
+    atomic_store(&udpm->joined, true);
+    return 0;
+}
+
+#ifdef ZETABUS_TEST_HOOKS
+void zetabus_udpm_set_test_drop(zetabus_udpm_t* udpm, uint32_t drop_every) {
+    atomic_store(&udpm->test_drop_every, drop_every);
+}
+#endif
+
+void zetabus_udpm_destroy(zetabus_udpm_t* udpm) {
+    if (!udpm) return;
+
+    atomic_store(&udpm->running, false);
+    pthread_join(udpm->thread, NULL);
+    close(udpm->send_fd);
+    close(udpm->recv_fd);
+
+    for (size_t i = 0; i < UDPM_MAX_SENDERS; i++) {
+        for (size_t j = 0; j < UDPM_SLOTS_PER_SENDER; j++) {
+            slot_clear(&udpm->senders[i].slots[j]);
+        }
+    }
+    for (size_t i = 0; i < UDPM_REPAIR_DEPTH; i++) {
+        free(udpm->repair[i].data);
+    }
+    pthread_mutex_destroy(&udpm->send_lock);
+    free(udpm->recv_buf);
+    free(udpm);
+}
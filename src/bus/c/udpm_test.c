@@ -0,0 +1,261 @@
+#include "bus.h"
+#include "bus_internal.h"
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Multicast on loopback: every bus in this process joins the same group
+static char g_url[128];
+static char g_nack_url[128];
+
+#define LARGE_SIZE (200 * 1024) // Spans ~150 fragments at the default MTU
+
+typedef struct {
+    atomic_int count;
+    atomic_int bytes;
+    atomic_int corrupt;
+} counter_t;
+
+static counter_t g_imu_a;
+static counter_t g_imu_b;
+static counter_t g_all_b;
+static counter_t g_large;
+
+static void count_into(counter_t* c, const void* data, size_t size) {
+    atomic_fetch_add(&c->count, 1);
+    atomic_fetch_add(&c->bytes, (int)size);
+}
+
+static void on_imu_a(const char* topic, const void* data, size_t size) { count_into(&g_imu_a, data, size); }
+static void on_imu_b(const char* topic, const void* data, size_t size) { count_into(&g_imu_b, data, size); }
+static void on_all_b(const char* topic, const void* data, size_t size) { count_into(&g_all_b, data, size); }
+
+static void on_large(const char* topic, const void* data, size_t size) {
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++) {
+        if (p[i] != (uint8_t)(i * 31 + 7)) {
+            atomic_fetch_add(&g_large.corrupt, 1);
+            break;
+        }
+    }
+    count_into(&g_large, data, size);
+}
+
+// Hands over to a new subscriber from inside its own callback
+static zetabus_t* g_handover_bus;
+static _Atomic(zetabus_subscriber_t*) g_handover_sub; // Set by the callback on the receive thread
+static counter_t g_handover_first;
+static counter_t g_handover_next;
+
+static void on_handover_next(const char* topic, const void* data, size_t size) {
+    count_into(&g_handover_next, data, size);
+}
+
+static void on_handover_first(const char* topic, const void* data, size_t size) {
+    count_into(&g_handover_first, data, size);
+    zetabus_subscriber_destroy(atomic_load(&g_handover_sub));
+    zetabus_subscriber_t* next = zetabus_subscriber_create(g_handover_bus, "robot.handover", on_handover_next);
+    assert(next != NULL);
+    atomic_store(&g_handover_sub, next);
+}
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+// Wait up to a second for a counter to reach target
+static int wait_for(counter_t* c, int target) {
+    for (int i = 0; i < 200 && atomic_load(&c->count) < target; i++) {
+        sleep_ms(5);
+    }
+    return atomic_load(&c->count);
+}
+
+static uint8_t* make_large(void) {
+    uint8_t* data = (uint8_t*)malloc(LARGE_SIZE);
+    assert(data != NULL);
+    for (size_t i = 0; i < LARGE_SIZE; i++) {
+        data[i] = (uint8_t)(i * 31 + 7);
+    }
+    return data;
+}
+
+// Test fan-out to several subscribers with local topic filtering
+void test_fanout(void) {
+    printf("Running test_fanout...\n");
+
+    zetabus_t* pub_bus = zetabus_create(g_url);
+    zetabus_t* sub_a = zetabus_create(g_url);
+    zetabus_t* sub_b = zetabus_create(g_url);
+    assert(pub_bus && sub_a && sub_b);
+
+    zetabus_subscriber_t* s1 = zetabus_subscriber_create(sub_a, "robot.imu", on_imu_a);
+    zetabus_subscriber_t* s2 = zetabus_subscriber_create(sub_b, "robot.imu", on_imu_b);
+    zetabus_subscriber_t* s3 = zetabus_subscriber_create(sub_b, "robot.>", on_all_b);
+    assert(s1 && s2 && s3);
+
+    zetabus_publisher_t* imu = zetabus_publisher_create(pub_bus, "robot.imu");
+    zetabus_publisher_t* odom = zetabus_publisher_create(pub_bus, "robot.odom");
+    zetabus_publisher_t* other = zetabus_publisher_create(pub_bus, "other.imu");
+    assert(imu && odom && other);
+
+    // Spooling needs a broker
+    assert(zetabus_publisher_enable_spool(imu, "/tmp/udpm_test.spool", 0) != 0);
+
+    for (int i = 0; i < 10; i++) {
+        assert(zetabus_publish(imu, "imu", 3) == 0);
+        assert(zetabus_publish(odom, "odom!", 5) == 0);
+        assert(zetabus_publish(other, "x", 1) == 0);
+        sleep_ms(1);
+    }
+
+    assert(wait_for(&g_imu_a, 10) == 10);
+    assert(wait_for(&g_imu_b, 10) == 10);
+    assert(wait_for(&g_all_b, 20) == 20);
+    sleep_ms(20);
+    assert(atomic_load(&g_imu_a.count) == 10); // No duplicates, nothing from other.*
+    assert(atomic_load(&g_imu_a.bytes) == 30);
+    assert(atomic_load(&g_all_b.bytes) == 80);
+
+    zetabus_publisher_destroy(imu);
+    zetabus_publisher_destroy(odom);
+    zetabus_publisher_destroy(other);
+    zetabus_subscriber_destroy(s1);
+    zetabus_subscriber_destroy(s2);
+    zetabus_subscriber_destroy(s3);
+    zetabus_destroy(pub_bus);
+    zetabus_destroy(sub_a);
+    zetabus_destroy(sub_b);
+
+    printf("test_fanout PASSED\n");
+}
+
+// Test that a callback can destroy its own subscriber and create another
+void test_callback_resubscribe(void) {
+    printf("Running test_callback_resubscribe...\n");
+
+    zetabus_t* pub_bus = zetabus_create(g_url);
+    g_handover_bus = zetabus_create(g_url);
+    assert(pub_bus && g_handover_bus);
+    atomic_store(&g_handover_sub, zetabus_subscriber_create(g_handover_bus, "robot.handover", on_handover_first));
+    zetabus_publisher_t* publisher = zetabus_publisher_create(pub_bus, "robot.handover");
+    assert(atomic_load(&g_handover_sub) && publisher);
+
+    assert(zetabus_publish(publisher, "a", 1) == 0);
+    assert(wait_for(&g_handover_first, 1) == 1);
+    for (int i = 0; i < 3; i++) {
+        assert(zetabus_publish(publisher, "b", 1) == 0);
+        sleep_ms(1);
+    }
+    assert(wait_for(&g_handover_next, 3) == 3);
+    assert(atomic_load(&g_handover_first.count) == 1);
+
+    zetabus_publisher_destroy(publisher);
+    zetabus_subscriber_destroy(atomic_load(&g_handover_sub));
+    zetabus_destroy(pub_bus);
+    zetabus_destroy(g_handover_bus);
+
+    printf("test_callback_resubscribe PASSED\n");
+}
+
+// Test that messages larger than a datagram are fragmented and reassembled
+void test_fragmentation(void) {
+    printf("Running test_fragmentation...\n");
+
+    atomic_store(&g_large.count, 0);
+    zetabus_t* pub_bus = zetabus_create(g_url);
+    zetabus_t* sub_bus = zetabus_create(g_url);
+    assert(pub_bus && sub_bus);
+
+    zetabus_subscriber_t* sub = zetabus_subscriber_create(sub_bus, "lidar.scan", on_large);
+    zetabus_publisher_t* pub = zetabus_publisher_create(pub_bus, "lidar.scan");
+    assert(sub && pub);
+
+    uint8_t* data = make_large();
+    for (int i = 0; i < 5; i++) {
+        assert(zetabus_publish(pub, data, LARGE_SIZE) == 0);
+        sleep_ms(5);
+    }
+
+    assert(wait_for(&g_large, 5) == 5);
+    assert(atomic_load(&g_large.corrupt) == 0);
+    assert(atomic_load(&g_large.bytes) == 5 * LARGE_SIZE);
+
+    free(data);
+    zetabus_publisher_destroy(pub);
+    zetabus_subscriber_destroy(sub);
+    zetabus_destroy(pub_bus);
+    zetabus_destroy(sub_bus);
+
+    printf("test_fragmentation PASSED\n");
+}
+
+// Test that lost fragments are repaired when NACKs are enabled
+void test_nack_repair(void) {
+    printf("Running test_nack_repair...\n");
+
+    atomic_store(&g_large.count, 0);
+    atomic_store(&g_large.bytes, 0);
+    zetabus_t* pub_bus = zetabus_create(g_nack_url);
+    zetabus_t* sub_bus = zetabus_create(g_nack_url);
+    assert(pub_bus && sub_bus);
+
+    zetabus_subscriber_t* sub = zetabus_subscriber_create(sub_bus, "lidar.scan", on_large);
+    zetabus_publisher_t* pub = zetabus_publisher_create(pub_bus, "lidar.scan");
+    assert(sub && pub);
+
+    // Lose every 7th fragment on first transmission
+    zetabus_udpm_set_test_drop(pub_bus->udpm, 7);
+
+    uint8_t* data = make_large();
+    for (int i = 0; i < 5; i++) {
+        assert(zetabus_publish(pub, data, LARGE_SIZE) == 0);
+        sleep_ms(5);
+    }
+
+    assert(wait_for(&g_large, 5) == 5);
+    assert(atomic_load(&g_large.corrupt) == 0);
+    assert(atomic_load(&g_large.bytes) == 5 * LARGE_SIZE);
+
+    free(data);
+    zetabus_publisher_destroy(pub);
+    zetabus_subscriber_destroy(sub);
+    zetabus_destroy(pub_bus);
+    zetabus_destroy(sub_bus);
+
+    printf("test_nack_repair PASSED\n");
+}
+
+// Test URL validation
+void test_bad_urls(void) {
+    printf("Running test_bad_urls...\n");
+
+    assert(zetabus_create("udpm://10.0.0.1:7667") == NULL);            // Not a multicast group
+    assert(zetabus_create("udpm://239.255.76.67") == NULL);            // No port
+    assert(zetabus_create("udpm://239.255.76.67:7667?bogus=1") == NULL);
+    assert(zetabus_create("udpm://239.255.76.67:7667?mtu=10") == NULL);
+
+    printf("test_bad_urls PASSED\n");
+}
+
+int main(void) {
+    printf("Running udpm transport tests...\n\n");
+
+    int port = 20000 + (int)(getpid() % 20000);
+    snprintf(g_url, sizeof(g_url), "udpm://239.255.76.67:%d?ttl=0&iface=127.0.0.1", port);
+    snprintf(g_nack_url, sizeof(g_nack_url), "udpm://239.255.76.68:%d?ttl=0&iface=127.0.0.1&nack=1", port + 1);
+
+    test_fanout();
+    test_callback_resubscribe();
+    test_fragmentation();
+    test_nack_repair();
+    test_bad_urls();
+
+    printf("\nAll tests PASSED!\n");
+    return 0;
+}
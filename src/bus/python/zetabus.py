@@ -5,12 +5,44 @@ A Python wrapper for NATS messaging with an API consistent with the C bus librar
 """
 
 from typing import Callable, Optional
+import struct
 import nats
 from nats.aio.client import Client as NATSClient
 from nats.aio.msg import Msg
 import asyncio
 
 
+# Batch envelopes sent by C publishers with batching enabled (see bus.h).
+# Only messages carrying the reserved reply subject are envelopes.
+_ENVELOPE_REPLY = "_ZETA.envelope"
+_ENVELOPE_MAGIC = 0x564e455a  # "ZENV"
+_ENVELOPE_VERSION = 1
+_ENVELOPE_HEADER = struct.Struct('<IB3xI')
+_ENTRY_HEADER = struct.Struct('<QI')
+
+
+def _unpack_envelope(data: bytes) -> Optional[list]:
+    """Split a batch envelope into (sent_ns, payload) pairs, or None if data is not one."""
+    if len(data) < _ENVELOPE_HEADER.size:
+        return None
+    magic, version, count = _ENVELOPE_HEADER.unpack_from(data)
+    if magic != _ENVELOPE_MAGIC or version != _ENVELOPE_VERSION:
+        return None
+    
+    entries = []
+    offset = _ENVELOPE_HEADER.size
+    for _ in range(count):
+        if len(data) - offset < _ENTRY_HEADER.size:
+            return None
+        sent_ns, size = _ENTRY_HEADER.unpack_from(data, offset)
+        offset += _ENTRY_HEADER.size
+        if len(data) - offset < size:
+            return None
+        entries.append((sent_ns, data[offset:offset + size]))
+        offset += size
+    return entries if offset == len(data) else None
+
+
 class ZetabusPublisher:
     """Publisher for a specific topic."""
     
@@ -45,7 +77,12 @@ class ZetabusSubscriber:
     async def _start(self) -> None:
         """Start the subscription (internal)."""
         async def _msg_handler(msg: Msg):
-            self._callback(msg.subject, msg.data)
+            entries = _unpack_envelope(msg.data) if msg.reply == _ENVELOPE_REPLY else None
+            if entries is None:
+                self._callback(msg.subject, msg.data)
+                return
+            for _, payload in entries:
+                self._callback(msg.subject, payload)
         
         self._subscription = await self._bus._nc.subscribe(self._topic, cb=_msg_handler)
     
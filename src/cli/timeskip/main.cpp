@@ -8,6 +8,9 @@
 #include "CLI11.hpp"
 #include <time.h>
 #include <chrono>
+#include <algorithm>
+#include <map>
+#include <vector>
 
 extern "C" {
 #include "recorder.h"
@@ -172,17 +175,104 @@ int main(int argc, char** argv) {
     record->add_option("-o,--output", output_file, "Specify the output file");
     record->add_option("-s,--server", nats_url, "NATS server URL (default: env NATS_URL or nats://localhost:4222)");
 
+    const std::map<std::string, uint32_t> compressions = {
+        {"none", ZET_COMPRESSION_NONE},
+        {"lz4", ZET_COMPRESSION_LZ4},
+        {"zstd", ZET_COMPRESSION_ZSTD},
+    };
+    uint32_t compression = ZET_COMPRESSION_LZ4;
+    int compression_level = 0;
+    record->add_option("-c,--compression", compression, "Chunk compression: lz4 (fast), zstd (smaller, for archival) or none")
+        ->transform(CLI::CheckedTransformer(compressions, CLI::ignore_case))
+        ->option_text("lz4|zstd|none [lz4]");
+    record->add_option("--compression-level", compression_level, "zstd compression level (default: 3)");
+
+    const std::map<std::string, uint32_t> io_backends = {
+        {"posix", ZET_IO_POSIX},
+        {"uring", ZET_IO_URING},
+    };
+    const std::map<std::string, uint32_t> sync_modes = {
+        {"none", ZET_SYNC_NONE},
+        {"periodic", ZET_SYNC_PERIODIC},
+        {"chunk", ZET_SYNC_CHUNK},
+    };
+    uint32_t io = ZET_IO_URING;
+    bool direct = false;
+    uint64_t preallocate_mb = 0;
+    uint32_t sync = ZET_SYNC_NONE;
+    record->add_option("--io", io, "Write with io_uring (falls back to posix where unavailable) or posix")
+        ->transform(CLI::CheckedTransformer(io_backends, CLI::ignore_case))
+        ->option_text("uring|posix [uring]");
+    record->add_flag("--direct", direct, "Bypass the page cache with O_DIRECT");
+    record->add_option("--preallocate", preallocate_mb, "Reserve disk space this many MB ahead of the recording");
+    record->add_option("--sync", sync, "fdatasync() never, once a second, or after every chunk")
+        ->transform(CLI::CheckedTransformer(sync_modes, CLI::ignore_case))
+        ->option_text("none|periodic|chunk [none]");
+    uint64_t segment_mb = 0;
+    double segment_seconds = 0;
+    record->add_option("--segment-size", segment_mb, "Rotate to a new segment file every this many MB");
+    record->add_option("--segment-duration", segment_seconds, "Rotate to a new segment file every this many seconds");
+    bool dedup = false;
+    record->add_flag("--dedup", dedup, "Store repeated large payloads (latched maps, calibrations) once");
+
     CLI::App* play = app.add_subcommand("play", "Play back a recorded Zetabus file");
-    std::string playback_file;
+    std::vector<std::string> playback_files;
     std::string play_nats_url;
     double speed = 1.0;
     bool interactive = true;
     
-    play->add_option("file", playback_file, "The recorded file to play back")->required();
+    play->add_option("files", playback_files, "The recorded file(s) to play back, merged by received time")->required();
     play->add_option("-s,--server", play_nats_url, "NATS server URL (default: env NATS_URL or nats://localhost:4222)");
     play->add_option("--speed", speed, "Playback speed multiplier (1.0=real-time, 2.0=2x, 0=max)")->default_val(1.0);
     play->add_flag("--no-interactive,!--interactive", interactive, "Disable interactive controls")->default_val(true);
 
+    CLI::App* recover = app.add_subcommand("recover", "Repair a recording cut short by a crash or power loss");
+    std::string recover_file;
+    recover->add_option("file", recover_file, "The recording to repair in place")->required();
+
+    CLI::App* info = app.add_subcommand("info", "Describe a recording: duration, topics and message sizes");
+    std::string info_file;
+    info->add_option("file", info_file, "The recording to describe")->required();
+
+    CLI::App* merge = app.add_subcommand("merge", "Merge recordings into one file, in received time order");
+    std::vector<std::string> merge_files;
+    std::string merge_output;
+    uint32_t merge_compression = ZET_COMPRESSION_LZ4;
+    int merge_compression_level = 0;
+    merge->add_option("files", merge_files, "The recordings to merge")->required();
+    merge->add_option("-o,--output", merge_output, "The merged file to write")->required();
+    merge->add_option("-c,--compression", merge_compression, "Chunk compression: lz4 (fast), zstd (smaller, for archival) or none")
+        ->transform(CLI::CheckedTransformer(compressions, CLI::ignore_case))
+        ->option_text("lz4|zstd|none [lz4]");
+    merge->add_option("--compression-level", merge_compression_level, "zstd compression level (default: 3)");
+
+    CLI::App* filter = app.add_subcommand("filter", "Extract topics or a time window of a recording into a new file");
+    std::string filter_file;
+    std::string filter_output;
+    std::vector<std::string> filter_topics;
+    double filter_start = 0.0;
+    double filter_end = 0.0;
+    uint32_t filter_compression = ZET_COMPRESSION_LZ4;
+    filter->add_option("file", filter_file, "The recording to extract from")->required();
+    filter->add_option("-o,--output", filter_output, "The file to write")->required();
+    filter->add_option("-t,--topics", filter_topics, "Topics to keep (default: all)");
+    filter->add_option("--start", filter_start, "Keep messages from this many seconds into the recording")
+        ->check(CLI::NonNegativeNumber);
+    filter->add_option("--end", filter_end, "Keep messages up to this many seconds into the recording (default: the end)")
+        ->check(CLI::NonNegativeNumber);
+    filter->add_option("-c,--compression", filter_compression, "Compression of the chunks re-encoded at the edges: lz4, zstd or none")
+        ->transform(CLI::CheckedTransformer(compressions, CLI::ignore_case))
+        ->option_text("lz4|zstd|none [lz4]");
+
+    CLI::App* tail = app.add_subcommand("tail", "Print the messages of a recording as they are written");
+    std::string tail_file;
+    std::vector<std::string> tail_topics;
+    double tail_timeout = 0.0;
+    tail->add_option("file", tail_file, "The recording to follow (it may still be recording)")->required();
+    tail->add_option("-t,--topics", tail_topics, "Topics to print (default: all)");
+    tail->add_option("--timeout", tail_timeout, "Stop after this many seconds without a new message (default: when the recording is closed)")
+        ->check(CLI::NonNegativeNumber);
+
     CLI11_PARSE(app, argc, argv);
 
     if (record->parsed()) {
@@ -199,16 +289,33 @@ int main(int argc, char** argv) {
             }
         }
         
+        // A rotated recording is named by its manifest
+        bool rotating = segment_mb > 0 || segment_seconds > 0;
+        if (rotating && record->count("--output") == 0) output_file += "m";
+        
         std::cout << "🔴 Recording Zetabus subject: " << subject << "\n";
-        std::cout << "📁 Output file: " << output_file << "\n";
+        std::cout << "📁 Output file: " << output_file << (rotating ? " (manifest of segments)" : "") << "\n";
         std::cout << "🌐 NATS server: " << server_url << "\n";
+        for (const auto& entry : compressions) {
+            if (entry.second == compression) std::cout << "🗜️  Compression: " << entry.first << "\n";
+        }
         std::cout << "\n🎮 Controls:\n";
         std::cout << "  p      : Pause/Resume recording\n";
         std::cout << "  Ctrl+C : Stop and save\n\n";
         
         // Create recorder
-        g_recorder = timeskip_recorder_create(server_url.c_str(), subject.c_str(), 
-                                              output_file.c_str(), 0);
+        zet_writer_options_t writer_options = {};
+        writer_options.compression = compression;
+        writer_options.compression_level = compression_level;
+        writer_options.io = io;
+        writer_options.direct = direct;
+        writer_options.preallocate_size = preallocate_mb << 20;
+        writer_options.sync = sync;
+        writer_options.segment_size = segment_mb << 20;
+        writer_options.segment_duration_ns = (uint64_t)(segment_seconds * 1e9);
+        writer_options.dedup_min_size = dedup ? ZET_DEDUP_MIN_SIZE : 0;
+        g_recorder = timeskip_recorder_create_ex(server_url.c_str(), subject.c_str(),
+                                                 output_file.c_str(), 0, &writer_options);
         if (!g_recorder) {
             std::cerr << "❌ Failed to create recorder\n";
             return 1;
@@ -270,7 +377,9 @@ int main(int argc, char** argv) {
         }
         
         std::cout << "▶️  Playing back recorded Zetabus file\n";
-        std::cout << "📁 Input file: " << playback_file << "\n";
+        for (const std::string& file : playback_files) {
+            std::cout << "📁 Input file: " << file << "\n";
+        }
         std::cout << "🌐 NATS server: " << server_url << "\n";
         std::cout << "⚡ Speed: " << (speed == 0 ? "MAX" : std::to_string(speed)) << "x\n";
         if (interactive) {
@@ -279,9 +388,10 @@ int main(int argc, char** argv) {
         std::cout << "\n";
         
         // Create player
-        timeskip_player_t* player = timeskip_player_create(server_url.c_str(), 
-                                                           playback_file.c_str(), 
-                                                           speed);
+        std::vector<const char*> files;
+        for (const std::string& file : playback_files) files.push_back(file.c_str());
+        timeskip_player_t* player = timeskip_player_create_multi(server_url.c_str(), files.data(), files.size(),
+                                                                 speed);
         if (!player) {
             std::cerr << "❌ Failed to create player (file not found or invalid format)\n";
             return 1;
@@ -310,6 +420,270 @@ int main(int argc, char** argv) {
         std::cout << "  Duration: " << (stats.duration_ns / 1e9) << "s\n";
         
         timeskip_player_destroy(player);
+    } else if (recover->parsed()) {
+        // A manifest stands for its segments, each repaired on its own
+        std::vector<std::string> files;
+        char** segments;
+        size_t segment_count;
+        if (zet_manifest_read(recover_file.c_str(), &segments, &segment_count) == 0) {
+            files.assign(segments, segments + segment_count);
+            zet_manifest_free(segments, segment_count);
+        } else {
+            files.push_back(recover_file);
+        }
+        
+        for (const std::string& file : files) {
+            std::cout << "🩹 Recovering " << file << "\n";
+            
+            auto start = std::chrono::steady_clock::now();
+            zet_recover_result_t result;
+            if (zet_recover(file.c_str(), &result) != 0) {
+                std::cerr << "❌ Failed to recover " << file << " (not a .zet file, or not writable)\n";
+                return 1;
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            
+            if (result.intact) {
+                std::cout << "✅ Intact, nothing to do: " << result.message_count << " messages\n";
+            } else {
+                std::cout << "✅ Recovered " << result.message_count << " messages";
+                if (result.chunk_count > 0) std::cout << " in " << result.chunk_count << " chunks";
+                std::cout << "\n";
+                std::cout << "  Dropped: " << result.dropped_bytes << " bytes of torn or damaged data\n";
+                if (result.damaged_count > 0) {
+                    std::cout << "  Damaged regions skipped: " << result.damaged_count << "\n";
+                }
+                std::cout << "  Size: " << result.file_size << " -> " << result.recovered_size << " bytes\n";
+            }
+            std::cout << "  Scanned " << (result.file_size / 1e6) << " MB in " << seconds << "s\n";
+        }
+    } else if (info->parsed()) {
+        // A manifest: one line per segment, from each segment's summary
+        char** segments;
+        size_t segment_count;
+        if (zet_manifest_read(info_file.c_str(), &segments, &segment_count) == 0) {
+            std::cout << "📁 " << info_file << " (" << segment_count << " segments)\n";
+            uint64_t total = 0;
+            for (size_t i = 0; i < segment_count; i++) {
+                zet_reader_t* reader = zet_reader_create_mmap(segments[i]);
+                zet_summary_t summary;
+                if (reader && zet_reader_get_summary(reader, &summary) == 0) {
+                    std::cout << "  " << segments[i] << ": " << summary.message_count << " msgs, "
+                              << ((summary.end_ns - summary.start_ns) / 1e9) << "s, "
+                              << format_bytes(summary.payload_bytes) << " of payload\n";
+                    total += summary.message_count;
+                } else {
+                    std::cout << "  " << segments[i] << ": " << (reader ? "no summary (still open, or never closed)"
+                                                                          : "unreadable") << "\n";
+                }
+                zet_reader_destroy(reader);
+            }
+            std::cout << "  Messages: " << total << " in closed segments\n";
+            zet_manifest_free(segments, segment_count);
+            return 0;
+        }
+        
+        auto start = std::chrono::steady_clock::now();
+        zet_reader_t* reader = zet_reader_create_mmap(info_file.c_str());
+        if (!reader) {
+            std::cerr << "❌ Failed to open " << info_file << " (file not found or invalid format)\n";
+            return 1;
+        }
+        
+        // Closed files carry a summary; others are read through once
+        zet_summary_t summary;
+        std::vector<zet_topic_summary_t> scanned;
+        bool has_summary = zet_reader_get_summary(reader, &summary) == 0;
+        if (!has_summary) {
+            summary = zet_summary_t{};
+            std::map<const char*, size_t> topic_index; // Topics are interned by the reader
+            zet_message_view_t views[1024];
+            size_t count;
+            while ((count = zet_reader_read_views(reader, views, 1024)) > 0) {
+                for (size_t i = 0; i < count; i++) {
+                    const zet_message_view_t& view = views[i];
+                    auto it = topic_index.emplace(view.topic, scanned.size()).first;
+                    if (it->second == scanned.size()) {
+                        scanned.push_back(zet_topic_summary_t{view.topic, 0, 0, view.received_ns, view.received_ns,
+                                                              (uint32_t)view.size, (uint32_t)view.size, 0.0});
+                    }
+                    zet_topic_summary_t& topic = scanned[it->second];
+                    topic.message_count++;
+                    topic.payload_bytes += view.size;
+                    topic.first_ns = std::min(topic.first_ns, view.received_ns);
+                    topic.last_ns = std::max(topic.last_ns, view.received_ns);
+                    topic.min_size = std::min(topic.min_size, (uint32_t)view.size);
+                    topic.max_size = std::max(topic.max_size, (uint32_t)view.size);
+                    if (summary.message_count == 0) summary.start_ns = summary.end_ns = view.received_ns;
+                    summary.start_ns = std::min(summary.start_ns, view.received_ns);
+                    summary.end_ns = std::max(summary.end_ns, view.received_ns);
+                    summary.message_count++;
+                    summary.payload_bytes += view.size;
+                }
+            }
+            for (zet_topic_summary_t& topic : scanned) {
+                topic.mean_size = (double)topic.payload_bytes / topic.message_count;
+            }
+            summary.topic_count = scanned.size();
+            summary.topics = scanned.data();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        
+        std::cout << "📁 " << info_file << " (format version " << zet_reader_get_version(reader) << ")\n";
+        std::cout << "  Duration: " << ((summary.end_ns - summary.start_ns) / 1e9) << "s\n";
+        std::cout << "  Messages: " << summary.message_count << " on " << summary.topic_count << " topics, "
+                  << format_bytes(summary.payload_bytes) << " of payload\n";
+        if (summary.topic_count > 0) std::cout << "  Per topic: messages, payload, min/mean/max size (B), rate\n";
+        for (size_t i = 0; i < summary.topic_count; i++) {
+            const zet_topic_summary_t& topic = summary.topics[i];
+            double span = (topic.last_ns - topic.first_ns) / 1e9;
+            char line[256];
+            snprintf(line, sizeof(line), "    %10llu msgs  %10s  size %u/%.0f/%u  %8.1f Hz  ",
+                     (unsigned long long)topic.message_count, format_bytes(topic.payload_bytes).c_str(),
+                     topic.min_size, topic.mean_size, topic.max_size,
+                     span > 0 ? (topic.message_count - 1) / span : 0.0);
+            std::cout << line << topic.topic << "\n";
+        }
+        if (has_summary) {
+            std::cout << "  Read the summary in " << (seconds * 1e3) << " ms\n";
+        } else {
+            if (zet_reader_get_status(reader) != ZET_STATUS_OK) {
+                std::cout << "⚠️  The file is cut short or damaged; `timeskip recover` repairs it\n";
+            }
+            std::cout << "  No summary (version 1, or never closed): read every message in " << seconds << "s\n";
+        }
+        zet_reader_destroy(reader);
+    } else if (merge->parsed()) {
+        if (std::find(merge_files.begin(), merge_files.end(), merge_output) != merge_files.end()) {
+            std::cerr << "❌ The output must not be one of the files being merged\n";
+            return 1;
+        }
+        
+        auto start = std::chrono::steady_clock::now();
+        std::vector<const char*> files;
+        for (const std::string& file : merge_files) files.push_back(file.c_str());
+        zet_merge_reader_t* reader = zet_merge_reader_create(files.data(), files.size(), nullptr);
+        if (!reader) {
+            std::cerr << "❌ Failed to open the recordings (file not found or invalid format)\n";
+            return 1;
+        }
+        zet_writer_options_t writer_options = {};
+        writer_options.compression = merge_compression;
+        writer_options.compression_level = merge_compression_level;
+        writer_options.buffer_size = 4 << 20;
+        zet_writer_t* writer = zet_writer_create_ex(merge_output.c_str(), &writer_options);
+        if (!writer) {
+            std::cerr << "❌ Failed to create " << merge_output << "\n";
+            zet_merge_reader_destroy(reader);
+            return 1;
+        }
+        
+        // Each batch is written before the next read, while its views are valid
+        uint64_t count = 0;
+        zet_message_view_t views[1024];
+        size_t n;
+        while ((n = zet_merge_reader_read_views(reader, views, 1024)) > 0) {
+            if (zet_writer_write_batch(writer, views, n) != 0) {
+                std::cerr << "❌ Failed to write " << merge_output << "\n";
+                zet_writer_destroy(writer);
+                zet_merge_reader_destroy(reader);
+                return 1;
+            }
+            count += n;
+        }
+        zet_writer_destroy(writer);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        
+        for (size_t i = 0; i < zet_merge_reader_get_count(reader); i++) {
+            if (zet_merge_reader_get_status(reader, i) != ZET_STATUS_OK) {
+                std::cout << "⚠️  " << zet_merge_reader_get_path(reader, i)
+                          << " is cut short or damaged; `timeskip recover` repairs it\n";
+            }
+        }
+        zet_merge_reader_destroy(reader);
+        std::cout << "✅ Merged " << count << " messages from " << files.size() << " files into " << merge_output
+                  << " in " << seconds << "s\n";
+    } else if (filter->parsed()) {
+        if (filter->count("--end") > 0 && filter_end < filter_start) {
+            std::cerr << "❌ --end must not be before --start\n";
+            return 1;
+        }
+
+        // Times are relative to the first message: from the summary, or read
+        zet_reader_t* reader = zet_reader_create(filter_file.c_str());
+        if (!reader) {
+            std::cerr << "❌ Failed to open " << filter_file << " (file not found or invalid format)\n";
+            return 1;
+        }
+        uint64_t base_ns = 0;
+        zet_summary_t summary;
+        zet_message_view_t first;
+        if (zet_reader_get_summary(reader, &summary) == 0) {
+            base_ns = summary.start_ns;
+        } else if (zet_reader_read_view(reader, &first) == 0) {
+            base_ns = first.received_ns;
+        }
+        zet_reader_destroy(reader);
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<const char*> topics;
+        for (const std::string& topic : filter_topics) topics.push_back(topic.c_str());
+        zet_filter_options_t options = {};
+        options.topics = topics.empty() ? nullptr : topics.data();
+        options.topic_count = topics.size();
+        options.start_ns = base_ns + (uint64_t)(filter_start * 1e9);
+        if (filter->count("--end") > 0) options.end_ns = base_ns + (uint64_t)(filter_end * 1e9);
+        options.compression = filter_compression;
+
+        zet_filter_result_t result;
+        if (zet_filter(filter_file.c_str(), filter_output.c_str(), &options, &result) != 0) {
+            std::cerr << "❌ Failed to filter " << filter_file << " into " << filter_output
+                      << " (the output must be another file; a damaged input needs `timeskip recover` first)\n";
+            return 1;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "✅ Kept " << result.message_count << " messages in " << filter_output << " in " << seconds << "s\n";
+        std::cout << "  Chunks copied:     " << result.chunks_copied << " (" << result.bytes_copied << " bytes)\n";
+        std::cout << "  Chunks re-encoded: " << result.chunks_rewritten << "\n";
+        std::cout << "  Chunks skipped:    " << result.chunks_skipped << "\n";
+    } else if (tail->parsed()) {
+        zet_reader_options_t options = {};
+        options.follow = 1;
+        options.follow_timeout_ns = (uint64_t)(tail_timeout * 1e9);
+        zet_reader_t* reader = zet_reader_create_ex(tail_file.c_str(), &options);
+        if (!reader) {
+            std::cerr << "❌ Failed to open " << tail_file << " (file not found or invalid format)\n";
+            return 1;
+        }
+        std::vector<const char*> topics;
+        for (const std::string& topic : tail_topics) topics.push_back(topic.c_str());
+        if (!topics.empty() && zet_reader_set_topics(reader, topics.data(), topics.size()) != 0) {
+            std::cerr << "❌ Failed to select topics in " << tail_file << "\n";
+            zet_reader_destroy(reader);
+            return 1;
+        }
+
+        // One line per message: seconds into the recording, payload size, topic
+        uint64_t start_ns = zet_reader_get_start_time(reader);
+        uint64_t count = 0;
+        zet_message_view_t view;
+        while (zet_reader_read_view(reader, &view) == 0) {
+            char line[64];
+            double at = view.received_ns > start_ns ? (view.received_ns - start_ns) / 1e9 : 0.0;
+            snprintf(line, sizeof(line), "%12.3fs  %10s  ", at, format_bytes(view.size).c_str());
+            std::cout << line << view.topic << std::endl;
+            count++;
+        }
+        int status = zet_reader_get_status(reader);
+        zet_reader_destroy(reader);
+        if (status == ZET_STATUS_PENDING) {
+            std::cout << "⏱️  No new messages for " << tail_timeout << "s: stopped after " << count << " messages\n";
+        } else if (status != ZET_STATUS_OK) {
+            std::cerr << "⚠️  Stopped at damaged data after " << count << " messages; `timeskip recover` repairs it\n";
+            return 1;
+        } else {
+            std::cout << "✅ Recording closed: " << count << " messages\n";
+        }
     }
 
     return 0;
@@ -1,6 +1,7 @@
 #include "player.h"
-#include "zet_format.h"
+#include "../../formats/zet/c/zet_format.h"
 #include "../../bus/c/bus.h"
+#include "../../clock/c/clock.h"
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -12,19 +13,17 @@
 #include <stdatomic.h>
 #include <sys/ioctl.h>
 
-// Get monotonic time in nanoseconds
-static uint64_t get_monotonic_ns(void) {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
-}
+// Messages are read in batches, and their payloads copied into large blocks
+// rather than allocated one by one
+#define READ_BATCH 256
+#define PAYLOAD_BLOCK_SIZE (16 * 1024 * 1024)
 
 // Message buffer for playback
 typedef struct {
     uint64_t sent_ns;
     uint64_t received_ns;
-    char* topic;
-    void* data;
+    const char* topic;       // Interned by the reader
+    void* data;              // In one of the payload blocks
     size_t size;
 } playback_message_t;
 
@@ -32,12 +31,16 @@ typedef struct {
 struct timeskip_player_s {
     zetabus_t* bus;
     zetabus_publisher_t** publishers; // One publisher per topic
-    char** topics;
+    const char** topics;              // Interned, so compared by address
     size_t topic_count;
     
     playback_message_t* messages;
     size_t message_count;
     size_t current_index;
+    uint8_t** payload_blocks;
+    size_t payload_block_count;
+    uint8_t* payload_next;   // Free space left in the last block
+    size_t payload_free;
     
     uint64_t start_time_ns;
     uint64_t duration_ns;
@@ -45,7 +48,9 @@ struct timeskip_player_s {
     
     atomic_uint_fast64_t messages_published;
     
-    char* input_file;
+    char** input_files;
+    size_t input_count;
+    zet_merge_reader_t* reader; // Kept open: it owns the message topics
 };
 
 // Get terminal width
@@ -181,7 +186,7 @@ static int read_key(void) {
 static zetabus_publisher_t* get_publisher_for_topic(timeskip_player_t* player, const char* topic) {
     // Check if we already have a publisher for this topic
     for (size_t i = 0; i < player->topic_count; i++) {
-        if (strcmp(player->topics[i], topic) == 0) {
+        if (player->topics[i] == topic) {
             return player->publishers[i];
         }
     }
@@ -192,79 +197,155 @@ static zetabus_publisher_t* get_publisher_for_topic(timeskip_player_t* player, c
     
     // Resize arrays
     player->topic_count++;
-    player->topics = realloc(player->topics, player->topic_count * sizeof(char*));
+    player->topics = realloc(player->topics, player->topic_count * sizeof(const char*));
     player->publishers = realloc(player->publishers, player->topic_count * sizeof(zetabus_publisher_t*));
     
-    player->topics[player->topic_count - 1] = strdup(topic);
+    player->topics[player->topic_count - 1] = topic;
     player->publishers[player->topic_count - 1] = pub;
     
     return pub;
 }
 
-// Load all messages from file
-static int load_messages(timeskip_player_t* player) {
-    zet_reader_t* reader = zet_reader_create(player->input_file);
-    if (!reader) return -1;
-    
-    player->start_time_ns = zet_reader_get_start_time(reader);
-    
-    // Count messages first
-    size_t count = 0;
-    zet_message_t msg;
-    while (zet_reader_read_message(reader, &msg) == 0) {
-        count++;
-        zet_message_free(&msg);
+// Copy a payload into the last block, starting a new one if it does not fit
+static void* store_payload(timeskip_player_t* player, const void* data, size_t size) {
+    if (size > player->payload_free || player->payload_block_count == 0) {
+        size_t block_size = size > PAYLOAD_BLOCK_SIZE ? size : PAYLOAD_BLOCK_SIZE;
+        uint8_t** blocks = realloc(player->payload_blocks, (player->payload_block_count + 1) * sizeof(uint8_t*));
+        if (!blocks) return NULL;
+        player->payload_blocks = blocks;
+        uint8_t* block = malloc(block_size);
+        if (!block) return NULL;
+        blocks[player->payload_block_count++] = block;
+        player->payload_next = block;
+        player->payload_free = block_size;
     }
     
-    // Allocate message buffer
-    player->messages = calloc(count, sizeof(playback_message_t));
-    if (!player->messages) {
-        zet_reader_destroy(reader);
-        return -1;
+    void* dst = player->payload_next;
+    memcpy(dst, data, size);
+    player->payload_next += size;
+    player->payload_free -= size;
+    return dst;
+}
+
+static void free_messages(timeskip_player_t* player) {
+    for (size_t i = 0; i < player->payload_block_count; i++) {
+        free(player->payload_blocks[i]);
     }
+    free(player->payload_blocks);
+    player->payload_blocks = NULL;
+    player->payload_block_count = 0;
+    free(player->messages);
+    player->messages = NULL;
+}
+
+// Load all messages from the files, merged into one timeline
+static int load_messages(timeskip_player_t* player) {
+    // Decompress chunks on the other cores while this thread copies payloads out.
+    // The merge reader has one file of each input open at a time (a manifest's
+    // segments are opened in turn), so the threads are shared among the inputs.
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t spare = cpus > 1 ? (uint32_t)(cpus > 8 ? 8 : cpus) - 1 : 0;
+    zet_reader_options_t options = { .threads = spare / (uint32_t)player->input_count };
+    zet_merge_reader_t* reader = zet_merge_reader_create((const char* const*)player->input_files,
+                                                         player->input_count, &options);
+    if (!reader) return -1;
+    player->reader = reader;
     
-    // Reload messages
-    zet_reader_destroy(reader);
-    reader = zet_reader_create(player->input_file);
-    if (!reader) {
-        free(player->messages);
-        return -1;
-    }
+    player->start_time_ns = zet_merge_reader_get_start_time(reader);
     
+    // Single pass, growing the message array as needed
+    size_t capacity = 0;
     size_t idx = 0;
     uint64_t first_timestamp = 0;
     uint64_t last_timestamp = 0;
-    
-    while (zet_reader_read_message(reader, &msg) == 0 && idx < count) {
-        player->messages[idx].sent_ns = msg.sent_ns;
-        player->messages[idx].received_ns = msg.received_ns;
-        player->messages[idx].topic = msg.topic;  // Transfer ownership
-        player->messages[idx].data = msg.data;    // Transfer ownership
-        player->messages[idx].size = msg.size;
-        
-        if (idx == 0) first_timestamp = msg.received_ns;
-        last_timestamp = msg.received_ns;
+    zet_message_view_t views[READ_BATCH];
+    size_t count;
+    
+    while ((count = zet_merge_reader_read_views(reader, views, READ_BATCH)) > 0) {
+        if (idx + count > capacity) {
+            size_t new_capacity = capacity ? capacity * 2 : 1024;
+            playback_message_t* messages = realloc(player->messages, new_capacity * sizeof(playback_message_t));
+            if (!messages) goto fail;
+            player->messages = messages;
+            capacity = new_capacity;
+        }
         
-        idx++;
+        for (size_t i = 0; i < count; i++) {
+            void* data = store_payload(player, views[i].data, views[i].size);
+            if (!data) goto fail;
+            
+            player->messages[idx].sent_ns = views[i].sent_ns;
+            player->messages[idx].received_ns = views[i].received_ns;
+            player->messages[idx].topic = views[i].topic;
+            player->messages[idx].data = data;
+            player->messages[idx].size = views[i].size;
+            
+            if (idx == 0) first_timestamp = views[i].received_ns;
+            last_timestamp = views[i].received_ns;
+            
+            idx++;
+        }
+    }
+    
+    // Play what could be read, but say why the rest could not
+    for (size_t i = 0; i < zet_merge_reader_get_count(reader); i++) {
+        int status = zet_merge_reader_get_status(reader, i);
+        if (status == ZET_STATUS_TRUNCATED || status == ZET_STATUS_CORRUPT) {
+            fprintf(stderr, "⚠️  %s is %s; `timeskip recover` repairs it\n", zet_merge_reader_get_path(reader, i),
+                    status == ZET_STATUS_TRUNCATED ? "cut short" : "damaged");
+        } else if (status != ZET_STATUS_OK) {
+            goto fail;
+        }
     }
     
     player->message_count = idx;
     player->duration_ns = last_timestamp - first_timestamp;
-    
-    zet_reader_destroy(reader);
     return 0;
+    
+fail:
+    free_messages(player);
+    zet_merge_reader_destroy(reader);
+    player->reader = NULL;
+    return -1;
+}
+
+static void free_input_files(timeskip_player_t* player) {
+    for (size_t i = 0; i < player->input_count; i++) {
+        free(player->input_files[i]);
+    }
+    free(player->input_files);
 }
 
 // Public API implementation
 timeskip_player_t* timeskip_player_create(const char* nats_url,
                                           const char* input_file,
                                           double speed) {
-    if (!nats_url || !input_file) return NULL;
+    return timeskip_player_create_multi(nats_url, &input_file, 1, speed);
+}
+
+timeskip_player_t* timeskip_player_create_multi(const char* nats_url,
+                                                const char* const* input_files,
+                                                size_t input_count,
+                                                double speed) {
+    if (!nats_url || !input_files || input_count == 0) return NULL;
     
     timeskip_player_t* player = calloc(1, sizeof(timeskip_player_t));
     if (!player) return NULL;
     
-    player->input_file = strdup(input_file);
+    player->input_files = calloc(input_count, sizeof(char*));
+    if (!player->input_files) {
+        free(player);
+        return NULL;
+    }
+    for (; player->input_count < input_count; player->input_count++) {
+        char* copy = strdup(input_files[player->input_count]);
+        if (!copy) {
+            free_input_files(player);
+            free(player);
+            return NULL;
+        }
+        player->input_files[player->input_count] = copy;
+    }
     player->speed = speed > 0 ? speed : 0; // 0 = max speed
     player->current_index = 0;
     atomic_init(&player->messages_published, 0);
@@ -272,7 +353,7 @@ timeskip_player_t* timeskip_player_create(const char* nats_url,
     // Connect to NATS
     player->bus = zetabus_create(nats_url);
     if (!player->bus) {
-        free(player->input_file);
+        free_input_files(player);
         free(player);
         return NULL;
     }
@@ -280,7 +361,7 @@ timeskip_player_t* timeskip_player_create(const char* nats_url,
     // Load messages from file
     if (load_messages(player) != 0) {
         zetabus_destroy(player->bus);
-        free(player->input_file);
+        free_input_files(player);
         free(player);
         return NULL;
     }
@@ -291,7 +372,7 @@ timeskip_player_t* timeskip_player_create(const char* nats_url,
 int timeskip_player_start(timeskip_player_t* player) {
     if (!player || player->message_count == 0) return -1;
     
-    uint64_t playback_start = get_monotonic_ns();
+    uint64_t playback_start = zeta_clock_now_ns();
     uint64_t recording_start = player->messages[0].received_ns;
     
     for (size_t i = 0; i < player->message_count; i++) {
@@ -304,7 +385,7 @@ int timeskip_player_start(timeskip_player_t* player) {
             uint64_t target_time = playback_start + (uint64_t)(msg_offset / player->speed);
             
             // Wait until target time
-            uint64_t now = get_monotonic_ns();
+            uint64_t now = zeta_clock_now_ns();
             if (now < target_time) {
                 uint64_t wait_ns = target_time - now;
                 struct timespec ts;
@@ -339,7 +420,7 @@ int timeskip_player_start_interactive(timeskip_player_t* player) {
     printf("  p   : Pause/Resume\n");
     printf("  q   : Quit\n\n");
     
-    uint64_t playback_start = get_monotonic_ns();
+    uint64_t playback_start = zeta_clock_now_ns();
     uint64_t recording_start = player->messages[0].received_ns;
     uint64_t pause_time = 0;
     bool paused = false;
@@ -356,14 +437,14 @@ int timeskip_player_start_interactive(timeskip_player_t* player) {
         
         if (player->speed > 0 && !skip_wait) {
             uint64_t target_time = playback_start + (uint64_t)(msg_offset / player->speed);
-            uint64_t now = get_monotonic_ns();
+            uint64_t now = zeta_clock_now_ns();
             
             if (now < target_time) {
                 // Wait until target time, checking for keyboard input
                 uint64_t wait_time = target_time - now;
                 uint64_t end_time = now + wait_time;
                 
-                while (get_monotonic_ns() < end_time && !skip_wait) {
+                while (zeta_clock_now_ns() < end_time && !skip_wait) {
                     // Handle keyboard input during wait
                     if (kbhit()) {
                         int key = read_key();
@@ -380,10 +461,10 @@ int timeskip_player_start_interactive(timeskip_player_t* player) {
                             case ' ':
                                 paused = !paused;
                                 if (paused) {
-                                    pause_time = get_monotonic_ns();
+                                    pause_time = zeta_clock_now_ns();
                                     printf("\r⏸️  Paused  ");
                                 } else {
-                                    uint64_t pause_duration = get_monotonic_ns() - pause_time;
+                                    uint64_t pause_duration = zeta_clock_now_ns() - pause_time;
                                     playback_start += pause_duration;
                                     end_time += pause_duration;
                                     printf("\r▶️  Playing ");
@@ -394,7 +475,7 @@ int timeskip_player_start_interactive(timeskip_player_t* player) {
                             case 'L': // Left arrow
                                 if (player->current_index >= 10) {
                                     player->current_index -= 10;
-                                    playback_start = get_monotonic_ns() - 
+                                    playback_start = zeta_clock_now_ns() - 
                                         (uint64_t)((player->messages[player->current_index].received_ns - recording_start) / player->speed);
                                     skip_wait = true;
                                 }
@@ -403,7 +484,7 @@ int timeskip_player_start_interactive(timeskip_player_t* player) {
                             case 'R': // Right arrow
                                 if (player->current_index + 10 < player->message_count) {
                                     player->current_index += 10;
-                                    playback_start = get_monotonic_ns() - 
+                                    playback_start = zeta_clock_now_ns() - 
                                         (uint64_t)((player->messages[player->current_index].received_ns - recording_start) / player->speed);
                                     skip_wait = true;
                                 }
@@ -415,7 +496,7 @@ int timeskip_player_start_interactive(timeskip_player_t* player) {
                                 } else if (player->speed < 10.0) {
                                     player->speed += 0.5;
                                 }
-                                playback_start = get_monotonic_ns() - 
+                                playback_start = zeta_clock_now_ns() - 
                                     (uint64_t)((player->messages[player->current_index].received_ns - recording_start) / player->speed);
                                 skip_wait = true;
                                 break;
@@ -426,7 +507,7 @@ int timeskip_player_start_interactive(timeskip_player_t* player) {
                                 } else if (player->speed > 0) {
                                     player->speed = 0; // Max speed
                                 }
-                                playback_start = get_monotonic_ns() - 
+                                playback_start = zeta_clock_now_ns() - 
                                     (uint64_t)((player->messages[player->current_index].received_ns - recording_start) / player->speed);
                                 skip_wait = true;
                                 break;
@@ -475,7 +556,7 @@ int timeskip_player_start_interactive(timeskip_player_t* player) {
                     case 'P':
                     case ' ': {
                         paused = false;
-                        uint64_t pause_duration = get_monotonic_ns() - pause_time;
+                        uint64_t pause_duration = zeta_clock_now_ns() - pause_time;
                         playback_start += pause_duration;
                         break;
                     }
@@ -486,7 +567,7 @@ int timeskip_player_start_interactive(timeskip_player_t* player) {
                         } else {
                             player->current_index = 0;
                         }
-                        playback_start = get_monotonic_ns() - 
+                        playback_start = zeta_clock_now_ns() - 
                             (uint64_t)((player->messages[player->current_index].received_ns - recording_start) / player->speed);
                         skip_wait = true;
                         break;
@@ -497,7 +578,7 @@ int timeskip_player_start_interactive(timeskip_player_t* player) {
                         } else if (player->current_index < player->message_count - 1) {
                             player->current_index = player->message_count - 1;
                         }
-                        playback_start = get_monotonic_ns() - 
+                        playback_start = zeta_clock_now_ns() - 
                             (uint64_t)((player->messages[player->current_index].received_ns - recording_start) / player->speed);
                         skip_wait = true;
                         break;
@@ -508,7 +589,7 @@ int timeskip_player_start_interactive(timeskip_player_t* player) {
                         } else if (player->speed < 10.0) {
                             player->speed += 0.5;
                         }
-                        playback_start = get_monotonic_ns() - 
+                        playback_start = zeta_clock_now_ns() - 
                             (uint64_t)((player->messages[player->current_index].received_ns - recording_start) / player->speed);
                         skip_wait = true;
                         break;
@@ -519,7 +600,7 @@ int timeskip_player_start_interactive(timeskip_player_t* player) {
                         } else if (player->speed > 0) {
                             player->speed = 0; // Max speed
                         }
-                        playback_start = get_monotonic_ns() - 
+                        playback_start = zeta_clock_now_ns() - 
                             (uint64_t)((player->messages[player->current_index].received_ns - recording_start) / player->speed);
                         skip_wait = true;
                         break;
@@ -529,7 +610,7 @@ int timeskip_player_start_interactive(timeskip_player_t* player) {
                         // Skip to next message immediately
                         skip_wait = true;
                         paused = false;
-                        uint64_t pause_dur = get_monotonic_ns() - pause_time;
+                        uint64_t pause_dur = zeta_clock_now_ns() - pause_time;
                         playback_start += pause_dur;
                         break;
                     }
@@ -550,7 +631,7 @@ int timeskip_player_start_interactive(timeskip_player_t* player) {
         }
         
         // Display progress (throttle to avoid spam, update every 100ms or so)
-        uint64_t now = get_monotonic_ns();
+        uint64_t now = zeta_clock_now_ns();
         if (now - last_display_time > 100000000ULL || player->current_index == 0) { // 100ms
             last_display_time = now;
             display_progress_bar(player, recording_start, msg, paused);
@@ -570,24 +651,20 @@ void timeskip_player_destroy(timeskip_player_t* player) {
     // Destroy publishers
     for (size_t i = 0; i < player->topic_count; i++) {
         zetabus_publisher_destroy(player->publishers[i]);
-        free(player->topics[i]);
     }
     free(player->publishers);
     free(player->topics);
     
     // Free messages
-    for (size_t i = 0; i < player->message_count; i++) {
-        free(player->messages[i].topic);
-        free(player->messages[i].data);
-    }
-    free(player->messages);
+    free_messages(player);
+    zet_merge_reader_destroy(player->reader);
     
     // Destroy bus
     if (player->bus) {
         zetabus_destroy(player->bus);
     }
     
-    free(player->input_file);
+    free_input_files(player);
     free(player);
 }
 
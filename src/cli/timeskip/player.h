@@ -15,6 +15,13 @@ timeskip_player_t* timeskip_player_create(const char* nats_url,
                                           const char* input_file,
                                           double speed);
 
+// Create a player for several files (from several machines, or segments of
+// one recording), played as one timeline in received time order
+timeskip_player_t* timeskip_player_create_multi(const char* nats_url,
+                                                const char* const* input_files,
+                                                size_t input_count,
+                                                double speed);
+
 // Start playback in interactive mode (blocking, handles keyboard input)
 int timeskip_player_start_interactive(timeskip_player_t* player);
 
@@ -1,22 +1,17 @@
 #include "recorder.h"
-#include "zet_format.h"
+#include "../../formats/zet/c/zet_format.h"
 #include "../../bus/c/bus.h"
+#include "../../clock/c/clock.h"
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
 #include <stdatomic.h>
 #include <unistd.h>
-#include <time.h>
 
 #define DEFAULT_BUFFER_SIZE 100000
 #define BATCH_SIZE 1000
-
-// Get monotonic time in nanoseconds
-static uint64_t get_monotonic_ns(void) {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
-}
+#define FLUSH_INTERVAL_NS 1000000000ULL // Hand data to the OS at least this often
+#define WRITE_BUFFER_SIZE (4 * 1024 * 1024) // Writer buffer unless the options set one
 
 // Buffered message
 typedef struct {
@@ -149,13 +144,10 @@ static bool buffer_is_empty(circular_buffer_t* buf) {
     return atomic_load(&buf->read_idx) == atomic_load(&buf->write_idx);
 }
 
-// Global recorder for callback (temporary workaround until we update zetabus API)
-static timeskip_recorder_t* g_current_recorder = NULL;
-
-// Subscriber callback (runs in NATS thread)
-static void recording_callback(const char* topic, const void* data, size_t size) {
-    timeskip_recorder_t* recorder = g_current_recorder;
-    if (!recorder) return;
+// Subscriber callback (runs in NATS thread). Batched envelopes arrive here
+// already unpacked, one call per original message.
+static void recording_callback(const zetabus_message_t* message, void* closure) {
+    timeskip_recorder_t* recorder = (timeskip_recorder_t*)closure;
     
     // Always count received messages
     atomic_fetch_add(&recorder->messages_received, 1);
@@ -168,18 +160,18 @@ static void recording_callback(const char* topic, const void* data, size_t size)
     
     // Create buffered message
     buffered_message_t msg;
-    msg.sent_ns = 0; // Not implemented yet
-    msg.received_ns = get_monotonic_ns();
-    msg.topic = strdup(topic);
-    msg.data = malloc(size);
+    msg.sent_ns = message->sent_ns;
+    msg.received_ns = zeta_clock_now_ns();
+    msg.topic = strdup(message->topic);
+    msg.data = malloc(message->size ? message->size : 1);
     if (!msg.topic || !msg.data) {
         free(msg.topic);
         free(msg.data);
         atomic_fetch_add(&recorder->messages_dropped, 1);
         return;
     }
-    memcpy(msg.data, data, size);
-    msg.size = size;
+    memcpy(msg.data, message->data, message->size);
+    msg.size = message->size;
     
     // Push to buffer
     if (!buffer_push(recorder->buffer, &msg)) {
@@ -194,6 +186,8 @@ static void recording_callback(const char* topic, const void* data, size_t size)
 static void* writer_thread_func(void* arg) {
     timeskip_recorder_t* recorder = (timeskip_recorder_t*)arg;
     buffered_message_t batch[BATCH_SIZE];
+    zet_message_view_t views[BATCH_SIZE];
+    uint64_t last_flush_ns = zeta_clock_now_ns();
     
     atomic_store(&recorder->writer_running, true);
     
@@ -208,21 +202,17 @@ static void* writer_thread_func(void* arg) {
         if (count > 0) {
             // Write batch to file
             for (size_t i = 0; i < count; i++) {
-                zet_writer_write_message(recorder->writer,
-                                        batch[i].sent_ns,
-                                        batch[i].received_ns,
-                                        batch[i].topic,
-                                        batch[i].data,
-                                        batch[i].size);
-                
-                // Track bytes written (header + topic + payload)
-                size_t msg_size = sizeof(uint64_t) * 2 + // timestamps
-                                 sizeof(uint16_t) +      // topic_len
-                                 sizeof(uint32_t) +      // payload_size
-                                 strlen(batch[i].topic) + 1 + // topic with null
-                                 batch[i].size;          // payload
-                atomic_fetch_add(&recorder->bytes_written, msg_size);
-                
+                views[i] = (zet_message_view_t){
+                    .sent_ns = batch[i].sent_ns,
+                    .received_ns = batch[i].received_ns,
+                    .topic = batch[i].topic,
+                    .data = batch[i].data,
+                    .size = batch[i].size
+                };
+            }
+            zet_writer_write_batch(recorder->writer, views, count);
+            
+            for (size_t i = 0; i < count; i++) {
                 // Free message memory
                 free(batch[i].topic);
                 free(batch[i].data);
@@ -230,14 +220,23 @@ static void* writer_thread_func(void* arg) {
                 atomic_fetch_add(&recorder->messages_written, 1);
             }
             
-            // Flush to disk
-            zet_writer_flush(recorder->writer);
+            // Chunks close on their own size and duration limits; flushing
+            // every batch would cut them short, so only flush periodically
+            uint64_t now = zeta_clock_now_ns();
+            if (now - last_flush_ns >= FLUSH_INTERVAL_NS) {
+                zet_writer_flush(recorder->writer);
+                last_flush_ns = now;
+            }
+            atomic_store(&recorder->bytes_written, zet_writer_get_bytes_written(recorder->writer));
         } else {
             // Buffer empty, sleep briefly
             usleep(1000); // 1ms
         }
     }
     
+    // Close the last chunk so the final size counts it
+    zet_writer_flush(recorder->writer);
+    atomic_store(&recorder->bytes_written, zet_writer_get_bytes_written(recorder->writer));
     atomic_store(&recorder->writer_running, false);
     return NULL;
 }
@@ -247,6 +246,14 @@ timeskip_recorder_t* timeskip_recorder_create(const char* nats_url,
                                                 const char* topic,
                                                 const char* output_file,
                                                 size_t buffer_size) {
+    return timeskip_recorder_create_ex(nats_url, topic, output_file, buffer_size, NULL);
+}
+
+timeskip_recorder_t* timeskip_recorder_create_ex(const char* nats_url,
+                                                   const char* topic,
+                                                   const char* output_file,
+                                                   size_t buffer_size,
+                                                   const zet_writer_options_t* writer_options) {
     if (!nats_url || !topic || !output_file) return NULL;
     
     timeskip_recorder_t* recorder = (timeskip_recorder_t*)calloc(1, sizeof(timeskip_recorder_t));
@@ -275,8 +282,11 @@ timeskip_recorder_t* timeskip_recorder_create(const char* nats_url,
         return NULL;
     }
     
-    // Create writer
-    recorder->writer = zet_writer_create(output_file);
+    // Create writer, buffered by default
+    zet_writer_options_t options = {0};
+    if (writer_options) options = *writer_options;
+    if (options.buffer_size == 0) options.buffer_size = WRITE_BUFFER_SIZE;
+    recorder->writer = zet_writer_create_ex(output_file, &options);
     if (!recorder->writer) {
         buffer_destroy(recorder->buffer);
         free(recorder->topic);
@@ -302,11 +312,8 @@ timeskip_recorder_t* timeskip_recorder_create(const char* nats_url,
 int timeskip_recorder_start(timeskip_recorder_t* recorder) {
     if (!recorder) return -1;
     
-    // Set global recorder (workaround)
-    g_current_recorder = recorder;
-    
     // Create subscriber with callback
-    recorder->subscriber = zetabus_subscriber_create(recorder->bus, recorder->topic, recording_callback);
+    recorder->subscriber = zetabus_subscriber_create_ex(recorder->bus, recorder->topic, recording_callback, recorder);
     if (!recorder->subscriber) {
         return -1;
     }
@@ -327,24 +334,19 @@ int timeskip_recorder_start(timeskip_recorder_t* recorder) {
 void timeskip_recorder_stop(timeskip_recorder_t* recorder) {
     if (!recorder) return;
     
+    // Destroy subscriber first so no callback still holds the recorder
+    if (recorder->subscriber) {
+        zetabus_subscriber_destroy(recorder->subscriber);
+        recorder->subscriber = NULL;
+    }
+    
     // Stop recording
     atomic_store(&recorder->recording, false);
     
-    // Clear global recorder
-    if (g_current_recorder == recorder) {
-        g_current_recorder = NULL;
-    }
-    
     // Wait for writer thread to finish draining buffer
     if (atomic_load(&recorder->writer_running)) {
         pthread_join(recorder->writer_thread, NULL);
     }
-    
-    // Destroy subscriber
-    if (recorder->subscriber) {
-        zetabus_subscriber_destroy(recorder->subscriber);
-        recorder->subscriber = NULL;
-    }
 }
 
 void timeskip_recorder_pause(timeskip_recorder_t* recorder) {
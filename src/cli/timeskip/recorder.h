@@ -4,6 +4,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include "../../formats/zet/c/zet_format.h"
 
 typedef struct timeskip_recorder_s timeskip_recorder_t;
 
@@ -17,6 +18,15 @@ timeskip_recorder_t* timeskip_recorder_create(const char* nats_url,
                                                 const char* output_file,
                                                 size_t buffer_size);
 
+// Create recorder with explicit .zet writer options (chunking, compression,
+// rotation into segments: output_file then names the manifest);
+// NULL takes the writer defaults
+timeskip_recorder_t* timeskip_recorder_create_ex(const char* nats_url,
+                                                   const char* topic,
+                                                   const char* output_file,
+                                                   size_t buffer_size,
+                                                   const zet_writer_options_t* writer_options);
+
 // Start recording (spawns writer thread)
 int timeskip_recorder_start(timeskip_recorder_t* recorder);
 
@@ -40,7 +50,7 @@ typedef struct {
     uint64_t messages_received;
     uint64_t messages_written;
     uint64_t messages_dropped;
-    uint64_t bytes_written;
+    uint64_t bytes_written;     // As stored so far, see zet_writer_get_bytes_written()
     bool buffer_overflow;
 } timeskip_stats_t;
 
@@ -0,0 +1,223 @@
+#include "clock.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define ZETA_CLOCK_HAVE_TSC 1
+#else
+#define ZETA_CLOCK_HAVE_TSC 0
+#endif
+
+#define CALIBRATION_WINDOW_NS 2000000ULL // Initial calibration spin (2 ms)
+#define SCALE_SHIFT 32                   // mult is ns per tick in 32.32 fixed point
+#define STEP_THRESHOLD_NS 1000000LL      // Errors above this are stepped, not slewed
+
+static pthread_once_t g_init_once = PTHREAD_ONCE_INIT;
+static bool g_use_tsc = false;
+
+uint64_t zeta_clock_monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+#if ZETA_CLOCK_HAVE_TSC
+
+// Conversion parameters, published through a seqlock so the hot path never
+// takes a lock. Fields are atomics only to keep concurrent reads well defined.
+typedef struct {
+    atomic_uint seq;
+    atomic_uint_fast64_t base_tsc;
+    atomic_uint_fast64_t base_ns;
+    atomic_uint_fast64_t mult;
+    atomic_uint_fast64_t rate;   // Unslewed mult, for ticks past next_calibration_tsc
+    atomic_uint_fast64_t next_calibration_tsc;
+} clock_params_t;
+
+static clock_params_t g_params;
+static atomic_flag g_calibrating = ATOMIC_FLAG_INIT;
+
+// Long-baseline anchor used to estimate the true tick rate
+static uint64_t g_anchor_tsc;
+static uint64_t g_anchor_ns;
+
+static inline uint64_t read_tsc(void) {
+    return __rdtsc();
+}
+
+// Invariant TSC: CPUID.80000007H:EDX[8]
+static bool tsc_is_invariant(void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007) {
+        return false;
+    }
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    return (edx & (1u << 8)) != 0;
+}
+
+// Sample a (tsc, monotonic) pair, keeping the tightest of a few brackets so a
+// preemption between the two reads does not skew the calibration.
+static void sample_pair(uint64_t* tsc, uint64_t* ns) {
+    uint64_t best_width = UINT64_MAX;
+    *tsc = 0;
+    *ns = 0;
+    for (int i = 0; i < 5; i++) {
+        uint64_t t0 = read_tsc();
+        uint64_t mono = zeta_clock_monotonic_ns();
+        uint64_t t1 = read_tsc();
+        if (t1 - t0 < best_width) {
+            best_width = t1 - t0;
+            *tsc = t0 + (t1 - t0) / 2;
+            *ns = mono;
+        }
+    }
+}
+
+static inline uint64_t ticks_to_ns(uint64_t ticks, uint64_t mult) {
+    return (uint64_t)(((unsigned __int128)ticks * mult) >> SCALE_SHIFT);
+}
+
+static void publish_params(uint64_t base_tsc, uint64_t base_ns, uint64_t mult, uint64_t rate, uint64_t next_tsc) {
+    unsigned seq = atomic_load_explicit(&g_params.seq, memory_order_relaxed);
+    atomic_store_explicit(&g_params.seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&g_params.base_tsc, base_tsc, memory_order_relaxed);
+    atomic_store_explicit(&g_params.base_ns, base_ns, memory_order_relaxed);
+    atomic_store_explicit(&g_params.mult, mult, memory_order_relaxed);
+    atomic_store_explicit(&g_params.rate, rate, memory_order_relaxed);
+    atomic_store_explicit(&g_params.next_calibration_tsc, next_tsc, memory_order_relaxed);
+    atomic_store_explicit(&g_params.seq, seq + 2, memory_order_release);
+}
+
+static void load_params(uint64_t* base_tsc, uint64_t* base_ns, uint64_t* mult, uint64_t* rate, uint64_t* next_tsc) {
+    unsigned seq0, seq1;
+    do {
+        seq0 = atomic_load_explicit(&g_params.seq, memory_order_acquire);
+        *base_tsc = atomic_load_explicit(&g_params.base_tsc, memory_order_relaxed);
+        *base_ns = atomic_load_explicit(&g_params.base_ns, memory_order_relaxed);
+        *mult = atomic_load_explicit(&g_params.mult, memory_order_relaxed);
+        *rate = atomic_load_explicit(&g_params.rate, memory_order_relaxed);
+        *next_tsc = atomic_load_explicit(&g_params.next_calibration_tsc, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        seq1 = atomic_load_explicit(&g_params.seq, memory_order_relaxed);
+    } while ((seq0 & 1) || seq0 != seq1);
+}
+
+// The slew in mult is sized to cancel the error over one interval, so it
+// applies only up to next_tsc; ticks after that (when nothing read the clock
+// for a while) run at the plain rate instead of correcting on and on
+static uint64_t convert(uint64_t tsc, uint64_t base_tsc, uint64_t base_ns, uint64_t mult, uint64_t rate,
+                        uint64_t next_tsc) {
+    // A thread may have read the TSC just before another published a newer base
+    if (tsc <= base_tsc) return base_ns;
+    if (tsc <= next_tsc) return base_ns + ticks_to_ns(tsc - base_tsc, mult);
+    return base_ns + ticks_to_ns(next_tsc - base_tsc, mult) + ticks_to_ns(tsc - next_tsc, rate);
+}
+
+// Re-derive the tick rate over the whole anchor baseline and slew towards
+// CLOCK_MONOTONIC so the remaining error is gone by the next calibration.
+static void recalibrate(void) {
+    uint64_t tsc, mono;
+    sample_pair(&tsc, &mono);
+    if (tsc <= g_anchor_tsc || mono <= g_anchor_ns) return;
+
+    uint64_t base_tsc, base_ns, mult, old_rate, next_tsc;
+    load_params(&base_tsc, &base_ns, &mult, &old_rate, &next_tsc);
+    uint64_t predicted = convert(tsc, base_tsc, base_ns, mult, old_rate, next_tsc);
+
+    uint64_t rate = (uint64_t)(((unsigned __int128)(mono - g_anchor_ns) << SCALE_SHIFT) /
+                               (tsc - g_anchor_tsc));
+    if (rate == 0) return;
+    uint64_t interval_ticks = (uint64_t)(((unsigned __int128)ZETA_CLOCK_RECALIBRATE_NS << SCALE_SHIFT) / rate);
+
+    int64_t error = (int64_t)(mono - predicted);
+    uint64_t new_base_ns = predicted;
+    if (error > STEP_THRESHOLD_NS) {
+        // Far behind (e.g. after a long stall): stepping forward is safe
+        new_base_ns = mono;
+        error = 0;
+    } else if (error < -(int64_t)(ZETA_CLOCK_RECALIBRATE_NS / 2)) {
+        // Far ahead: never step back, run at half rate until caught up
+        error = -(int64_t)(ZETA_CLOCK_RECALIBRATE_NS / 2);
+    }
+
+    uint64_t new_mult = (uint64_t)(((unsigned __int128)rate * (uint64_t)((int64_t)ZETA_CLOCK_RECALIBRATE_NS + error)) /
+                                   ZETA_CLOCK_RECALIBRATE_NS);
+    publish_params(tsc, new_base_ns, new_mult, rate, tsc + interval_ticks);
+}
+
+static void clock_init(void) {
+    const char* mode = getenv("ZETA_CLOCK");
+    if (mode && strcmp(mode, "monotonic") == 0) return;
+    if (!tsc_is_invariant()) return;
+
+    uint64_t tsc0, ns0, tsc1, ns1;
+    sample_pair(&tsc0, &ns0);
+    do {
+        sample_pair(&tsc1, &ns1);
+    } while (ns1 - ns0 < CALIBRATION_WINDOW_NS);
+    if (tsc1 <= tsc0) return;
+
+    uint64_t mult = (uint64_t)(((unsigned __int128)(ns1 - ns0) << SCALE_SHIFT) / (tsc1 - tsc0));
+    if (mult == 0) return;
+    uint64_t interval_ticks = (uint64_t)(((unsigned __int128)ZETA_CLOCK_RECALIBRATE_NS << SCALE_SHIFT) / mult);
+
+    g_anchor_tsc = tsc0;
+    g_anchor_ns = ns0;
+    publish_params(tsc1, ns1, mult, mult, tsc1 + interval_ticks);
+    g_use_tsc = true;
+}
+
+uint64_t zeta_clock_now_ns(void) {
+    pthread_once(&g_init_once, clock_init);
+    if (!g_use_tsc) return zeta_clock_monotonic_ns();
+
+    uint64_t tsc = read_tsc();
+    uint64_t base_tsc, base_ns, mult, rate, next_tsc;
+    load_params(&base_tsc, &base_ns, &mult, &rate, &next_tsc);
+
+    if (tsc >= next_tsc && !atomic_flag_test_and_set(&g_calibrating)) {
+        recalibrate();
+        atomic_flag_clear(&g_calibrating);
+        load_params(&base_tsc, &base_ns, &mult, &rate, &next_tsc);
+    }
+
+    return convert(tsc, base_tsc, base_ns, mult, rate, next_tsc);
+}
+
+void zeta_clock_calibrate(void) {
+    pthread_once(&g_init_once, clock_init);
+    if (!g_use_tsc) return;
+    if (!atomic_flag_test_and_set(&g_calibrating)) {
+        recalibrate();
+        atomic_flag_clear(&g_calibrating);
+    }
+}
+
+#else // !ZETA_CLOCK_HAVE_TSC
+
+static void clock_init(void) {
+    g_use_tsc = false;
+}
+
+uint64_t zeta_clock_now_ns(void) {
+    return zeta_clock_monotonic_ns();
+}
+
+void zeta_clock_calibrate(void) {
+    pthread_once(&g_init_once, clock_init);
+}
+
+#endif // ZETA_CLOCK_HAVE_TSC
+
+bool zeta_clock_uses_tsc(void) {
+    pthread_once(&g_init_once, clock_init);
+    return g_use_tsc;
+}
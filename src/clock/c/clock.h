@@ -0,0 +1,33 @@
+#ifndef ZETA_CLOCK_H
+#define ZETA_CLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Shared monotonic clock for zeta hot paths.
+//
+// On x86-64 CPUs with an invariant TSC the clock reads the TSC directly and
+// converts ticks to nanoseconds using a scale calibrated against
+// CLOCK_MONOTONIC. The scale is refined periodically (see
+// ZETA_CLOCK_RECALIBRATE_NS) by the first caller that notices it is due, so
+// readings stay slewed onto CLOCK_MONOTONIC without ever going backwards.
+//
+// When the TSC is unsuitable (not invariant, not x86, or ZETA_CLOCK=monotonic
+// in the environment) every call falls back to clock_gettime(CLOCK_MONOTONIC).
+
+// Interval between recalibrations against CLOCK_MONOTONIC
+#define ZETA_CLOCK_RECALIBRATE_NS 1000000000ULL
+
+// Monotonic time in nanoseconds (same epoch as CLOCK_MONOTONIC)
+uint64_t zeta_clock_now_ns(void);
+
+// Monotonic time read straight from clock_gettime (reference / fallback path)
+uint64_t zeta_clock_monotonic_ns(void);
+
+// Force a recalibration now (normally done lazily by zeta_clock_now_ns)
+void zeta_clock_calibrate(void);
+
+// True when zeta_clock_now_ns is backed by the TSC
+bool zeta_clock_uses_tsc(void);
+
+#endif // ZETA_CLOCK_H
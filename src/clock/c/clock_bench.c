@@ -0,0 +1,47 @@
+#include "clock.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Benchmark for the zeta clock
+//
+// Usage: clock_bench [drift_seconds]
+//   Reports the cost per timestamp of zeta_clock_now_ns and clock_gettime,
+//   then samples the offset between the two once per second for
+//   drift_seconds (default 3600) and reports the worst drift seen.
+
+#define CALLS 20000000
+
+static double bench_ns_per_call(uint64_t (*fn)(void)) {
+    volatile uint64_t sink = 0;
+    uint64_t start = zeta_clock_monotonic_ns();
+    for (int i = 0; i < CALLS; i++) {
+        sink += fn();
+    }
+    uint64_t elapsed = zeta_clock_monotonic_ns() - start;
+    (void)sink;
+    return (double)elapsed / CALLS;
+}
+
+int main(int argc, char** argv) {
+    long drift_seconds = argc > 1 ? atol(argv[1]) : 3600;
+
+    printf("TSC backed: %s\n", zeta_clock_uses_tsc() ? "yes" : "no");
+    printf("zeta_clock_now_ns:       %.2f ns/call\n", bench_ns_per_call(zeta_clock_now_ns));
+    printf("clock_gettime(MONOTONIC): %.2f ns/call\n", bench_ns_per_call(zeta_clock_monotonic_ns));
+
+    printf("\nDrift against CLOCK_MONOTONIC over %lds:\n", drift_seconds);
+    int64_t worst = 0;
+    for (long s = 1; s <= drift_seconds; s++) {
+        sleep(1);
+        uint64_t reference = zeta_clock_monotonic_ns();
+        int64_t offset = (int64_t)(zeta_clock_now_ns() - reference);
+        if (llabs(offset) > llabs(worst)) worst = offset;
+        if (s % 60 == 0 || s == drift_seconds) {
+            printf("  t=%5lds offset=%+lld ns worst=%+lld ns\n", s, (long long)offset, (long long)worst);
+            fflush(stdout);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include "clock.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Readings never go backwards across many calls
+void test_monotonic(void) {
+    printf("Running test_monotonic...\n");
+
+    uint64_t prev = zeta_clock_now_ns();
+    for (int i = 0; i < 1000000; i++) {
+        uint64_t now = zeta_clock_now_ns();
+        assert(now >= prev);
+        prev = now;
+    }
+
+    printf("test_monotonic PASSED\n");
+}
+
+// Readings track CLOCK_MONOTONIC, including across recalibrations
+void test_tracks_monotonic(void) {
+    printf("Running test_tracks_monotonic...\n");
+
+    for (int i = 0; i < 30; i++) {
+        uint64_t before = zeta_clock_monotonic_ns();
+        uint64_t now = zeta_clock_now_ns();
+        uint64_t after = zeta_clock_monotonic_ns();
+
+        // Allow 1 ms of slew error around the reference bracket
+        assert(now + 1000000ULL >= before);
+        assert(now <= after + 1000000ULL);
+
+        usleep(100000); // 100ms, crosses several recalibration intervals overall
+    }
+
+    printf("test_tracks_monotonic PASSED (tsc=%s)\n", zeta_clock_uses_tsc() ? "yes" : "no");
+}
+
+// After the clock goes unread for several recalibration intervals, the
+// first reading is still on CLOCK_MONOTONIC: the slew stops at the interval
+void test_idle(void) {
+    printf("Running test_idle...\n");
+
+    zeta_clock_calibrate();
+    usleep(2500000); // 2.5 recalibration intervals
+    uint64_t before = zeta_clock_monotonic_ns();
+    uint64_t now = zeta_clock_now_ns();
+    uint64_t after = zeta_clock_monotonic_ns();
+    assert(now + 1000000ULL >= before);
+    assert(now <= after + 1000000ULL);
+
+    printf("test_idle PASSED\n");
+}
+
+// Forced recalibration keeps readings monotonic
+void test_calibrate(void) {
+    printf("Running test_calibrate...\n");
+
+    uint64_t prev = zeta_clock_now_ns();
+    for (int i = 0; i < 100; i++) {
+        zeta_clock_calibrate();
+        uint64_t now = zeta_clock_now_ns();
+        assert(now >= prev);
+        prev = now;
+    }
+
+    printf("test_calibrate PASSED\n");
+}
+
+int main(void) {
+    printf("Starting zeta clock tests...\n\n");
+
+    test_monotonic();
+    test_tracks_monotonic();
+    test_idle();
+    test_calibrate();
+
+    printf("\nAll tests PASSED!\n");
+    return 0;
+}
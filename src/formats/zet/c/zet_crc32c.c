@@ -0,0 +1,142 @@
+#include "zet_crc32c.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+
+#define POLY 0x82f63b78U // Reflected Castagnoli polynomial
+
+// The CRC instruction has a latency of about three cycles but can start one
+// per cycle, so long inputs are run as three interleaved streams of STRIPE
+// bytes whose CRCs are then combined
+#define STRIPE 4096
+
+// Slice-by-8 tables for CPUs without CRC instructions
+static uint32_t table[8][256];
+static bool hardware;
+static uint32_t stripe_shift; // x^(8 * STRIPE) mod POLY
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+// a * b mod POLY, bit-reflected (x^0 is the top bit)
+static uint32_t multmodp(uint32_t a, uint32_t b) {
+    uint32_t product = 0;
+    for (uint32_t m = 1U << 31; m; m >>= 1) {
+        if (a & m) product ^= b;
+        b = b & 1 ? (b >> 1) ^ POLY : b >> 1;
+    }
+    return product;
+}
+
+static void init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int k = 0; k < 8; k++) crc = crc & 1 ? (crc >> 1) ^ POLY : crc >> 1;
+        table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int t = 1; t < 8; t++) table[t][i] = (table[t - 1][i] >> 8) ^ table[0][table[t - 1][i] & 0xff];
+    }
+    uint32_t x8 = 1U << 23; // x^8
+    stripe_shift = 1U << 31;
+    for (int i = 0; i < STRIPE; i++) stripe_shift = multmodp(stripe_shift, x8);
+#if defined(__x86_64__) || defined(__i386__)
+    hardware = __builtin_cpu_supports("sse4.2");
+#elif defined(__aarch64__)
+    hardware = (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#endif
+}
+
+static uint32_t crc_table(uint32_t crc, const uint8_t* p, size_t len) {
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        v ^= crc; // Little-endian, as are .zet files
+        crc = table[7][v & 0xff] ^ table[6][(v >> 8) & 0xff] ^ table[5][(v >> 16) & 0xff] ^
+              table[4][(v >> 24) & 0xff] ^ table[3][(v >> 32) & 0xff] ^ table[2][(v >> 40) & 0xff] ^
+              table[1][(v >> 48) & 0xff] ^ table[0][v >> 56];
+        p += 8;
+        len -= 8;
+    }
+    while (len--) crc = (crc >> 8) ^ table[0][(crc ^ *p++) & 0xff];
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2"))) static uint32_t crc_hardware(uint32_t crc, const uint8_t* p, size_t len) {
+    uint64_t c = crc;
+    for (; len >= 3 * STRIPE; p += 3 * STRIPE, len -= 3 * STRIPE) {
+        uint64_t c1 = 0, c2 = 0;
+        for (size_t i = 0; i < STRIPE; i += 8) {
+            uint64_t v0, v1, v2;
+            memcpy(&v0, p + i, 8);
+            memcpy(&v1, p + STRIPE + i, 8);
+            memcpy(&v2, p + 2 * STRIPE + i, 8);
+            c = _mm_crc32_u64(c, v0);
+            c1 = _mm_crc32_u64(c1, v1);
+            c2 = _mm_crc32_u64(c2, v2);
+        }
+        c = multmodp(multmodp((uint32_t)c, stripe_shift) ^ (uint32_t)c1, stripe_shift) ^ (uint32_t)c2;
+    }
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        c = _mm_crc32_u64(c, v);
+    }
+    crc = (uint32_t)c;
+    for (; len > 0; p++, len--) crc = _mm_crc32_u8(crc, *p);
+    return crc;
+}
+#elif defined(__i386__)
+__attribute__((target("sse4.2"))) static uint32_t crc_hardware(uint32_t crc, const uint8_t* p, size_t len) {
+    for (; len >= 4; p += 4, len -= 4) {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        crc = _mm_crc32_u32(crc, v);
+    }
+    for (; len > 0; p++, len--) crc = _mm_crc32_u8(crc, *p);
+    return crc;
+}
+#elif defined(__aarch64__)
+__attribute__((target("+crc"))) static uint32_t crc_hardware(uint32_t crc, const uint8_t* p, size_t len) {
+    for (; len >= 3 * STRIPE; p += 3 * STRIPE, len -= 3 * STRIPE) {
+        uint32_t c1 = 0, c2 = 0;
+        for (size_t i = 0; i < STRIPE; i += 8) {
+            uint64_t v0, v1, v2;
+            memcpy(&v0, p + i, 8);
+            memcpy(&v1, p + STRIPE + i, 8);
+            memcpy(&v2, p + 2 * STRIPE + i, 8);
+            crc = __crc32cd(crc, v0);
+            c1 = __crc32cd(c1, v1);
+            c2 = __crc32cd(c2, v2);
+        }
+        crc = multmodp(multmodp(crc, stripe_shift) ^ c1, stripe_shift) ^ c2;
+    }
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        crc = __crc32cd(crc, v);
+    }
+    for (; len > 0; p++, len--) crc = __crc32cb(crc, *p);
+    return crc;
+}
+#else
+static uint32_t crc_hardware(uint32_t crc, const uint8_t* p, size_t len) {
+    return crc_table(crc, p, len);
+}
+#endif
+
+uint32_t zet_crc32c(uint32_t crc, const void* data, size_t len) {
+    pthread_once(&once, init);
+    crc = ~crc;
+    crc = hardware ? crc_hardware(crc, (const uint8_t*)data, len) : crc_table(crc, (const uint8_t*)data, len);
+    return ~crc;
+}
@@ -0,0 +1,15 @@
+#ifndef ZET_CRC32C_H
+#define ZET_CRC32C_H
+
+// CRC32C (Castagnoli), the checksum of .zet chunks. Uses the SSE4.2 or ARMv8
+// CRC instructions when the CPU has them, a table otherwise. Internal to the
+// zet_format library.
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Extend crc (0 to start) over len bytes: zet_crc32c(zet_crc32c(0, a, n), b, m)
+// is the CRC of a followed by b
+uint32_t zet_crc32c(uint32_t crc, const void* data, size_t len);
+
+#endif // ZET_CRC32C_H
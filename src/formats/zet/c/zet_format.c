@@ -1,194 +1,4259 @@
 #include "zet_format.h"
+#include "zet_crc32c.h"
+#include "zet_io.h"
+#include "zet_xxh64.h"
+#include "../../../clock/c/clock.h"
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 #include <time.h>
+#include <unistd.h>
+#include <lz4.h>
+#include <zstd.h>
 
-// Get monotonic time in nanoseconds
-static uint64_t get_monotonic_ns(void) {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#define DEFAULT_CHUNK_SIZE (1024 * 1024)
+#define DEFAULT_CHUNK_DURATION_NS 1000000000ULL
+#define DEFAULT_ZSTD_LEVEL 3
+
+// Buffered output (buffer_size set): buffers are aligned and at least
+// OUTPUT_REF_MIN bytes, and pieces that large are written by reference
+#define OUTPUT_ALIGN 4096
+#define OUTPUT_REF_MIN (64 * 1024)
+#define OUTPUT_IOV_MAX 64
+#define DEFAULT_OUTPUT_BUFFER (1024 * 1024)   // When only io, direct or preallocation asks for one
+
+// Output pool (io_uring or O_DIRECT): buffers written whole while the next fills
+#define OUTPUT_POOL 4
+#define POOL_SYNC_ID UINT64_MAX              // io_uring user_data of an fdatasync()
+#define DEFAULT_SYNC_INTERVAL_NS 1000000000ULL
+
+// Record encoding of versions 1 to 3: sent_ns, received_ns, topic_len and
+// payload_size back to back (ZET_RECORD_HEADER_SIZE bytes), then topic and payload.
+// Version 1 writes records straight to the file, version 2 into chunk buffers.
+
+static void encode_record_header(uint8_t* p, uint64_t sent_ns, uint64_t received_ns,
+                                 uint16_t topic_len, uint32_t payload_size) {
+    memcpy(p, &sent_ns, sizeof(uint64_t));
+    memcpy(p + 8, &received_ns, sizeof(uint64_t));
+    memcpy(p + 16, &topic_len, sizeof(uint16_t));
+    memcpy(p + 18, &payload_size, sizeof(uint32_t));
+}
+
+static void decode_record_header(const uint8_t* p, zet_message_header_t* header) {
+    memcpy(&header->sent_ns, p, sizeof(uint64_t));
+    memcpy(&header->received_ns, p + 8, sizeof(uint64_t));
+    memcpy(&header->topic_len, p + 16, sizeof(uint16_t));
+    memcpy(&header->payload_size, p + 18, sizeof(uint32_t));
+}
+
+// Whether a chunked record holds a reference in place of its payload
+static bool record_is_ref(const zet_message_header_t* header, uint32_t flags) {
+    return (flags & ZET_FLAG_DEDUP) && (header->payload_size & ZET_PAYLOAD_REF);
+}
+
+// Bytes a chunked record stores after its topic, and the payload size it stands for
+static size_t record_stored_size(const zet_message_header_t* header, uint32_t flags) {
+    return record_is_ref(header, flags) ? sizeof(zet_payload_ref_t) : header->payload_size;
+}
+
+static uint32_t record_payload_size(const zet_message_header_t* header, uint32_t flags) {
+    return (flags & ZET_FLAG_DEDUP) ? header->payload_size & ~ZET_PAYLOAD_REF : header->payload_size;
+}
+
+// Version 4 record headers (see zet_format.h). Every field but the channel is
+// found from the control byte alone: it indexes tables of widths and masks,
+// and each field is one unaligned 64-bit load, masked, with no branch per
+// byte. Records near the end of a chunk are decoded from a padded copy so
+// those loads never run past it.
+#define COMPACT_HEADER_MAX 24    // Control byte, 8 + 8 + 4 bytes of fields, 3 of channel
+#define COMPACT_LOAD_PAD 8
+
+static const uint8_t compact_widths[8] = { 0, 1, 2, 3, 4, 5, 6, 8 };
+
+static const uint64_t compact_masks[8] = {
+    0, 0xffULL, 0xffffULL, 0xffffffULL, 0xffffffffULL, 0xffffffffffULL, 0xffffffffffffULL, UINT64_MAX
+};
+
+// The send delta has no 5-byte width, so that its last code can stand for a
+// record without a sent_ns
+#define COMPACT_NO_SEND 7
+
+static const uint8_t compact_send_widths[8] = { 0, 1, 2, 3, 4, 6, 8, 0 };
+
+static const uint64_t compact_send_masks[8] = {
+    0, 0xffULL, 0xffffULL, 0xffffffULL, 0xffffffffULL, 0xffffffffffffULL, UINT64_MAX, 0
+};
+
+// What a chunk's next version 4 record header is encoded against; zero at
+// the start of each chunk
+typedef struct {
+    uint64_t received_ns;    // Of the previous record
+    uint64_t send_offset;    // received_ns - sent_ns of the last record with a sent_ns
+} chunk_deltas_t;
+
+static uint64_t zigzag_encode(uint64_t delta) {
+    return (delta << 1) ^ (uint64_t)-(int64_t)(delta >> 63);
+}
+
+static uint64_t zigzag_decode(uint64_t value) {
+    return (value >> 1) ^ (uint64_t)-(int64_t)(value & 1);
+}
+
+// Width code of a field holding value
+static unsigned compact_code(uint64_t value) {
+    unsigned code = 0;
+    while (code < 7 && value > compact_masks[code]) code++;
+    return code;
+}
+
+static unsigned compact_send_code(uint64_t value) {
+    unsigned code = 0;
+    while (code < 6 && value > compact_send_masks[code]) code++;
+    return code;
+}
+
+static uint64_t load_u64(const uint8_t* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// Encode a chunked record's header at p, returning its size, and advance
+// *deltas past it
+static size_t encode_chunk_record(uint8_t* p, uint32_t version, chunk_deltas_t* deltas, uint64_t sent_ns,
+                                  uint64_t received_ns, uint16_t topic_len, uint32_t payload_size) {
+    if (version < ZET_FORMAT_VERSION_4) {
+        encode_record_header(p, sent_ns, received_ns, topic_len, payload_size);
+        return ZET_RECORD_HEADER_SIZE;
+    }
+    uint64_t delta = zigzag_encode(received_ns - deltas->received_ns);
+    unsigned delta_code = compact_code(delta);
+    uint64_t send = 0;
+    unsigned send_code = COMPACT_NO_SEND;
+    if (sent_ns != 0) {
+        send = zigzag_encode(received_ns - sent_ns - deltas->send_offset);
+        send_code = compact_send_code(send);
+        deltas->send_offset = received_ns - sent_ns;
+    }
+    unsigned size_width = payload_size > 0xffffff ? 4 : payload_size > 0xffff ? 3 : payload_size > 0xff ? 2 : 1;
+    size_t len = 1;
+    p[0] = (uint8_t)(delta_code | send_code << 3 | (size_width - 1) << 6);
+    memcpy(p + len, &delta, compact_widths[delta_code]);
+    len += compact_widths[delta_code];
+    memcpy(p + len, &send, compact_send_widths[send_code]);
+    len += compact_send_widths[send_code];
+    memcpy(p + len, &payload_size, size_width);
+    len += size_width;
+    uint32_t channel = topic_len;
+    while (channel >= 0x80) {
+        p[len++] = (uint8_t)(channel | 0x80);
+        channel >>= 7;
+    }
+    p[len++] = (uint8_t)channel;
+    deltas->received_ns = received_ns;
+    return len;
+}
+
+// Decode the header of the chunked record at p, with avail bytes left in the
+// chunk. Returns its size, or 0 if the chunk ends first or it is malformed.
+static size_t decode_chunk_record(const uint8_t* p, size_t avail, uint32_t version, chunk_deltas_t* deltas,
+                                  zet_message_header_t* header) {
+    if (version < ZET_FORMAT_VERSION_4) {
+        if (avail < ZET_RECORD_HEADER_SIZE) return 0;
+        decode_record_header(p, header);
+        return ZET_RECORD_HEADER_SIZE;
+    }
+    uint8_t padded[COMPACT_HEADER_MAX + COMPACT_LOAD_PAD];
+    if (avail < sizeof(padded)) {
+        if (avail == 0) return 0;
+        memset(padded, 0, sizeof(padded));
+        memcpy(padded, p, avail);
+        p = padded;
+    }
+    unsigned control = p[0];
+    unsigned send_code = (control >> 3) & 7;
+    unsigned delta_width = compact_widths[control & 7];
+    size_t size_at = 1 + delta_width + compact_send_widths[send_code];
+    uint64_t delta = zigzag_decode(load_u64(p + 1) & compact_masks[control & 7]);
+    uint64_t send = zigzag_decode(load_u64(p + 1 + delta_width) & compact_send_masks[send_code]);
+    header->payload_size = (uint32_t)(load_u64(p + size_at) & compact_masks[(control >> 6) + 1]);
+
+    // The channel: one byte unless there are more than 128
+    const uint8_t* c = p + size_at + (control >> 6) + 1;
+    uint32_t channel = c[0] & 0x7f;
+    size_t len = (size_t)(c - p) + 1;
+    if (c[0] & 0x80) {
+        channel |= (uint32_t)(c[1] & 0x7f) << 7;
+        len++;
+        if (c[1] & 0x80) {
+            channel |= (uint32_t)c[2] << 14;
+            len++;
+        }
+    }
+    if (len > avail || channel > UINT16_MAX) return 0;
+    header->received_ns = deltas->received_ns + delta;
+    header->sent_ns = 0;
+    if (send_code != COMPACT_NO_SEND) {
+        deltas->send_offset += send;
+        header->sent_ns = header->received_ns - deltas->send_offset;
+    }
+    header->topic_len = (uint16_t)channel;
+    deltas->received_ns = header->received_ns;
+    return len;
+}
+
+// Topic table: every distinct topic is stored once and keeps its address, so
+// readers hand out interned pointers and writers map topics to channel IDs.
+// Open addressing on an FNV-1a hash, plus a channel ID to topic array.
+typedef struct {
+    char* topic;
+    size_t len;              // Without the null terminator
+    uint32_t hash;
+    uint32_t id;
+} topic_slot_t;
+
+typedef struct {
+    topic_slot_t* slots;
+    size_t cap;              // Power of two
+    size_t count;
+    const char** channels;   // Indexed by channel ID
+    size_t channel_cap;
+} topic_table_t;
+
+static uint32_t topic_hash(const char* topic, size_t len) {
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)topic[i]) * 16777619U;
+    }
+    return hash;
+}
+
+static topic_slot_t* topic_find(topic_table_t* table, const char* topic, size_t len, uint32_t hash) {
+    if (table->cap == 0) return NULL;
+    for (size_t i = hash & (table->cap - 1);; i = (i + 1) & (table->cap - 1)) {
+        topic_slot_t* slot = &table->slots[i];
+        if (!slot->topic) return NULL;
+        if (slot->hash == hash && slot->len == len && memcmp(slot->topic, topic, len) == 0) return slot;
+    }
+}
+
+// Find or add a topic (len bytes, not necessarily null-terminated). New topics
+// get the next free ID. Returns NULL if out of memory.
+static topic_slot_t* topic_intern(topic_table_t* table, const char* topic, size_t len, bool* added) {
+    uint32_t hash = topic_hash(topic, len);
+    topic_slot_t* slot = topic_find(table, topic, len, hash);
+    if (added) *added = slot == NULL;
+    if (slot) return slot;
+
+    // Keep the load factor under one half
+    if ((table->count + 1) * 2 > table->cap) {
+        size_t cap = table->cap ? table->cap * 2 : 64;
+        topic_slot_t* slots = (topic_slot_t*)calloc(cap, sizeof(topic_slot_t));
+        if (!slots) return NULL;
+        for (size_t i = 0; i < table->cap; i++) {
+            topic_slot_t* old = &table->slots[i];
+            if (!old->topic) continue;
+            size_t j = old->hash & (cap - 1);
+            while (slots[j].topic) j = (j + 1) & (cap - 1);
+            slots[j] = *old;
+        }
+        free(table->slots);
+        table->slots = slots;
+        table->cap = cap;
+    }
+
+    char* copy = (char*)malloc(len + 1);
+    if (!copy) return NULL;
+    memcpy(copy, topic, len);
+    copy[len] = '\0';
+
+    size_t i = hash & (table->cap - 1);
+    while (table->slots[i].topic) i = (i + 1) & (table->cap - 1);
+    table->slots[i] = (topic_slot_t){ .topic = copy, .len = len, .hash = hash, .id = (uint32_t)table->count };
+    table->count++;
+    return &table->slots[i];
+}
+
+// Point a channel ID at an interned topic
+static int topic_set_channel(topic_table_t* table, uint32_t id, const char* topic) {
+    if (id >= table->channel_cap) {
+        size_t cap = table->channel_cap ? table->channel_cap : 64;
+        while (cap <= id) cap *= 2;
+        const char** channels = (const char**)realloc((void*)table->channels, cap * sizeof(const char*));
+        if (!channels) return -1;
+        memset((void*)(channels + table->channel_cap), 0, (cap - table->channel_cap) * sizeof(const char*));
+        table->channels = channels;
+        table->channel_cap = cap;
+    }
+    table->channels[id] = topic;
+    return 0;
+}
+
+static const char* topic_channel(const topic_table_t* table, uint32_t id) {
+    return id < table->channel_cap ? table->channels[id] : NULL;
+}
+
+static void topic_table_free(topic_table_t* table) {
+    for (size_t i = 0; i < table->cap; i++) {
+        free(table->slots[i].topic);
+    }
+    free(table->slots);
+    free((void*)table->channels);
+}
+
+// Topic filters (see zet_topic_filter_header_t): the three bits of a topic hash
+#define TOPIC_FILTER_PROBES 3
+#define TOPIC_FILTER_MAX_SIZE 65536 // Larger ones are taken for damage and ignored
+
+static void topic_filter_add(uint8_t* filter, size_t size, uint32_t hash) {
+    uint32_t step = (hash >> 17 | hash << 15) | 1;
+    for (uint32_t i = 0; i < TOPIC_FILTER_PROBES; i++) {
+        uint32_t bit = (hash + i * step) % (uint32_t)(size * 8);
+        filter[bit / 8] |= (uint8_t)(1U << (bit % 8));
+    }
+}
+
+static bool topic_filter_test(const uint8_t* filter, size_t size, uint32_t hash) {
+    uint32_t step = (hash >> 17 | hash << 15) | 1;
+    for (uint32_t i = 0; i < TOPIC_FILTER_PROBES; i++) {
+        uint32_t bit = (hash + i * step) % (uint32_t)(size * 8);
+        if (!(filter[bit / 8] & (1U << (bit % 8)))) return false;
+    }
+    return true;
+}
+
+// Append one channel definition to a channel block body
+static int append_channel(uint8_t** buf, size_t* len, size_t* cap, uint16_t id, const char* topic, size_t topic_len) {
+    size_t need = *len + 4 + topic_len + 1;
+    if (need > *cap) {
+        size_t grown = *cap ? *cap * 2 : 1024;
+        while (grown < need) grown *= 2;
+        uint8_t* p = (uint8_t*)realloc(*buf, grown);
+        if (!p) return -1;
+        *buf = p;
+        *cap = grown;
+    }
+    uint16_t stored_len = (uint16_t)(topic_len + 1);
+    memcpy(*buf + *len, &id, sizeof(id));
+    memcpy(*buf + *len + 2, &stored_len, sizeof(stored_len));
+    memcpy(*buf + *len + 4, topic, topic_len + 1);
+    *len = need;
+    return 0;
+}
+
+// Per-topic summary of a file, as writers and recovery build it: entries are
+// indexed by topic ID, and a topic table names the IDs
+typedef struct {
+    zet_summary_entry_t* entries;
+    size_t cap;
+    uint64_t message_count;
+    uint64_t start_ns;
+    uint64_t end_ns;
+} summary_builder_t;
+
+static int summary_add(summary_builder_t* summary, uint32_t id, uint64_t received_ns, size_t size) {
+    if (id >= summary->cap) {
+        size_t cap = summary->cap ? summary->cap : 64;
+        while (cap <= id) cap *= 2;
+        zet_summary_entry_t* entries = (zet_summary_entry_t*)realloc(summary->entries, cap * sizeof(zet_summary_entry_t));
+        if (!entries) return -1;
+        memset(entries + summary->cap, 0, (cap - summary->cap) * sizeof(zet_summary_entry_t));
+        summary->entries = entries;
+        summary->cap = cap;
+    }
+    zet_summary_entry_t* entry = &summary->entries[id];
+    if (entry->message_count == 0) {
+        entry->first_ns = entry->last_ns = received_ns;
+        entry->min_size = entry->max_size = (uint32_t)size;
+    }
+    if (received_ns < entry->first_ns) entry->first_ns = received_ns;
+    if (received_ns > entry->last_ns) entry->last_ns = received_ns;
+    if (size < entry->min_size) entry->min_size = (uint32_t)size;
+    if (size > entry->max_size) entry->max_size = (uint32_t)size;
+    entry->message_count++;
+    entry->payload_bytes += size;
+
+    if (summary->message_count == 0) summary->start_ns = summary->end_ns = received_ns;
+    if (received_ns < summary->start_ns) summary->start_ns = received_ns;
+    if (received_ns > summary->end_ns) summary->end_ns = received_ns;
+    summary->message_count++;
+    return 0;
+}
+
+// Encode the summary block, topics with messages in ID order. Returns NULL
+// if out of memory or too large for the footer to describe.
+static uint8_t* summary_encode(summary_builder_t* summary, const topic_table_t* topics, size_t* len) {
+    zet_summary_header_t header = {
+        .magic = ZET_SUMMARY_MAGIC,
+        .topic_count = 0,
+        .data_size = 0,
+        .start_ns = summary->start_ns,
+        .end_ns = summary->end_ns
+    };
+    for (size_t id = 0; id < summary->cap; id++) {
+        zet_summary_entry_t* entry = &summary->entries[id];
+        const char* topic = topic_channel(topics, (uint32_t)id);
+        if (entry->message_count == 0 || !topic) continue;
+        entry->topic_len = (uint16_t)(strlen(topic) + 1);
+        header.data_size += sizeof(zet_summary_entry_t) + entry->topic_len;
+        header.topic_count++;
+    }
+    *len = sizeof(header) + (size_t)header.data_size;
+    if (*len > UINT32_MAX) return NULL;
+    uint8_t* block = (uint8_t*)malloc(*len);
+    if (!block) return NULL;
+
+    uint8_t* p = block;
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    for (size_t id = 0; id < summary->cap; id++) {
+        const zet_summary_entry_t* entry = &summary->entries[id];
+        const char* topic = topic_channel(topics, (uint32_t)id);
+        if (entry->message_count == 0 || !topic) continue;
+        memcpy(p, entry, sizeof(*entry));
+        memcpy(p + sizeof(*entry), topic, entry->topic_len);
+        p += sizeof(*entry) + entry->topic_len;
+    }
+    return block;
 }
 
+// A buffer of the output pool, and the write of it in flight, if any
+typedef struct {
+    uint8_t* data;
+    size_t len;
+    struct iovec iov;
+    uint64_t offset;
+    bool busy;
+} pool_buffer_t;
+
+// A payload a dedup writer has written in full
+typedef struct {
+    uint64_t hash;
+    uint64_t received_ns;    // Of its record
+    uint32_t size;
+    bool used;
+} dedup_entry_t;
+
 // Writer implementation
+// Rotation (see below): the writer of the current segment, and the manifest
+typedef struct {
+    zet_writer_options_t options; // For each segment, without the rotation
+    uint64_t size;
+    uint64_t duration_ns;
+    char* base;                   // Segment paths up to their number
+    const char* name;             // ...and file names, as listed in the manifest
+    FILE* manifest;
+    zet_writer_t* segment;
+    uint32_t index;               // Number of the next segment
+    uint64_t start_ns;            // First received_ns in the current segment
+    uint64_t messages;            // In the current segment
+    atomic_uint_fast64_t bytes_done; // Written to the segments before it
+    zet_writer_t* done;           // The segment the closer is finishing
+    pthread_t closer;             // Finishing the previous segment
+    bool closing;
+} rotation_t;
+
+static zet_writer_t* rotation_create(const char* filename, const zet_writer_options_t* options);
+static int rotation_write(rotation_t* r, const zet_message_view_t* messages, size_t count);
+static void rotation_destroy(zet_writer_t* writer);
+
 struct zet_writer_s {
+    // Output: a stdio stream, or a file descriptor and the writer's own buffer
     FILE* file;
+    int fd;
+    uint8_t* buf;
+    size_t buf_len;
+    size_t buf_cap;
+    size_t buf_mark;         // Start of the buffered bytes not yet in iov
+    struct iovec iov[OUTPUT_IOV_MAX];
+    int iov_count;
+
+    // ...or, for io_uring and O_DIRECT, a pool of buffers that are copied
+    // into and written at explicit offsets
+    pool_buffer_t pool[OUTPUT_POOL];
+    int pool_count;
+    int pool_current;        // Being filled
+    size_t pool_cap;
+    uint64_t pool_offset;    // File offset of the current buffer
+    bool direct;
+    int plain_fd;            // Without O_DIRECT, for a partial last block
+    bool uring;
+    zet_uring_t ring;
+    int in_flight;
+    bool failed;             // An asynchronous write failed
+    uint64_t preallocate_size;
+    uint64_t allocated;      // File bytes reserved with fallocate()
+
+    // Durability
+    uint32_t sync;
+    uint64_t sync_interval_ns;
+    uint64_t last_sync_ns;
+
     uint64_t start_time_ns;
+    uint32_t version;
+    size_t chunk_size;
+    uint64_t chunk_duration_ns;
+
+    // Version 2: the chunk being filled
+    uint8_t* chunk;
+    size_t chunk_len;
+    size_t chunk_cap;
+    uint32_t chunk_messages;
+    uint64_t chunk_start_ns;
+    uint64_t chunk_end_ns;
+    chunk_deltas_t chunk_deltas; // Past its last record, for version 4 headers
+    uint8_t chunk_topics[ZET_TOPIC_FILTER_SIZE]; // Its topic filter
+    uint64_t offset; // File offset the next chunk (or version 1 record) is written at
+
+    // Version 2: compression of each chunk
+    uint32_t compression;
+    int compression_level;
+    uint8_t* packed;
+    size_t packed_cap;
+    ZSTD_CCtx* zstd;
+
+    // Version 3: channel IDs, and channels not yet written to the file
+    topic_table_t topics;
+    uint8_t* new_channels;
+    size_t new_channels_len;
+    size_t new_channels_cap;
+    uint32_t new_channel_count;
+
+    // Version 2: index of the chunks written so far, and their topic filters
+    zet_index_entry_t* index;
+    uint8_t* topic_filters;  // ZET_TOPIC_FILTER_SIZE bytes per entry
+    size_t index_count;
+    size_t index_cap;
+    uint64_t message_count;
+
+    // Version 2: summary of each topic, by its ID in topics
+    summary_builder_t summary;
+
+    // Version 2: payloads written in full, by hash, for dedup (ZET_DEDUP_PAYLOADS
+    // slots; a new payload takes over the slot its hash falls in)
+    uint32_t dedup_min_size;
+    dedup_entry_t* dedup;
+
+    // Rotation: messages go to the writer of the current segment, and this
+    // one only keeps the manifest
+    rotation_t* rotation;
 };
 
-zet_writer_t* zet_writer_create(const char* filename) {
-    zet_writer_t* writer = (zet_writer_t*)malloc(sizeof(zet_writer_t));
-    if (!writer) return NULL;
+// Output. Through stdio, every piece is an fwrite(). Otherwise pieces are
+// copied into the writer's buffer, or queued by reference when large, and
+// go out in one writev() when the buffer fills or output_flush() is called.
+// Pieces queued by reference must stay valid until then: every writer entry
+// point calls output_release() before returning.
+//
+// With io_uring or O_DIRECT, pieces are always copied, into a pool of
+// buffers: a full buffer is submitted whole and the next one fills while it
+// is written. O_DIRECT only writes whole aligned blocks, so a partial last
+// block stays behind to start the next buffer; a flush also writes it through
+// the page cache so readers see it.
 
-    writer->file = fopen(filename, "wb");
-    if (!writer->file) {
-        free(writer);
-        return NULL;
+static int write_full(int fd, struct iovec* iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t n = writev(fd, iov, iovcnt);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
     }
+    return 0;
+}
 
-    writer->start_time_ns = get_monotonic_ns();
+static int write_full_at(int fd, const uint8_t* data, size_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, data, len, (off_t)offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return 0;
+}
 
-    // Write header
-    zet_header_t header = {
-        .magic = {'Z', 'E', 'T', '\0'},
-        .version = 1,
-        .start_time_ns = writer->start_time_ns,
-        .reserved = {0}
-    };
+// Take one io_uring completion
+static int pool_reap(zet_writer_t* writer, bool wait) {
+    uint64_t id;
+    int32_t res;
+    if (zet_uring_complete(&writer->ring, wait, &id, &res) != 0) return -1;
+    writer->in_flight--;
+    if (id == POOL_SYNC_ID) {
+        if (res < 0) writer->failed = true;
+        return 0;
+    }
 
-    if (fwrite(&header, sizeof(zet_header_t), 1, writer->file) != 1) {
-        fclose(writer->file);
-        free(writer);
-        return NULL;
+    pool_buffer_t* buffer = &writer->pool[id];
+    buffer->busy = false;
+    if (res < 0) {
+        writer->failed = true;
+    } else if ((size_t)res < buffer->iov.iov_len) {
+        // Short write: finish it here, through the page cache if the rest is unaligned
+        int fd = writer->plain_fd >= 0 ? writer->plain_fd : writer->fd;
+        if (write_full_at(fd, buffer->data + res, buffer->iov.iov_len - (size_t)res,
+                          buffer->offset + (uint64_t)res) != 0) {
+            writer->failed = true;
+        }
+    }
+    return 0;
+}
+
+static int pool_wait_all(zet_writer_t* writer) {
+    while (writer->in_flight > 0) {
+        if (pool_reap(writer, true) != 0) return -1;
     }
+    return writer->failed ? -1 : 0;
+}
 
-    return writer;
+// Keep what is in flight within what the completion queue holds
+static int pool_make_room(zet_writer_t* writer) {
+    while (writer->in_flight >= (int)writer->ring.entries) {
+        if (pool_reap(writer, true) != 0) return -1;
+    }
+    return 0;
 }
 
-void zet_writer_destroy(zet_writer_t* writer) {
-    if (writer) {
-        if (writer->file) {
-            fflush(writer->file);
-            fclose(writer->file);
+// Write len bytes of a buffer at offset: submitted, or done here without io_uring
+static int pool_issue(zet_writer_t* writer, int index, size_t len, uint64_t offset) {
+    pool_buffer_t* buffer = &writer->pool[index];
+    if (writer->preallocate_size > 0 && offset + len > writer->allocated) {
+        // Best effort: without room reserved the writes still go through
+        uint64_t end = offset + len + writer->preallocate_size;
+        zet_io_preallocate(writer->fd, writer->allocated, end - writer->allocated);
+        writer->allocated = end;
+    }
+
+    buffer->iov = (struct iovec){ .iov_base = buffer->data, .iov_len = len };
+    buffer->offset = offset;
+    if (!writer->uring) return write_full_at(writer->fd, buffer->data, len, offset);
+    if (pool_make_room(writer) != 0) return -1;
+    if (zet_uring_writev(&writer->ring, writer->fd, &buffer->iov, offset, (uint64_t)index) != 0) return -1;
+    buffer->busy = true;
+    writer->in_flight++;
+    return 0;
+}
+
+// A buffer other than the current one with no write in flight
+static int pool_next(zet_writer_t* writer) {
+    for (;;) {
+        while (writer->uring && pool_reap(writer, false) == 0) {
+        }
+        for (int i = 1; i < writer->pool_count; i++) {
+            int index = (writer->pool_current + i) % writer->pool_count;
+            if (!writer->pool[index].busy) return index;
         }
-        free(writer);
+        if (!writer->uring || pool_reap(writer, true) != 0) return -1;
     }
 }
 
-int zet_writer_write_message(zet_writer_t* writer,
-                              uint64_t sent_ns,
-                              uint64_t received_ns,
-                              const char* topic,
-                              const void* data,
-                              size_t size) {
-    if (!writer || !writer->file || !topic || !data) return -1;
+// Write out the current buffer (only its whole blocks with O_DIRECT) and
+// move on to the next. With flush set, a partial block is written too.
+static int pool_submit(zet_writer_t* writer, bool flush) {
+    pool_buffer_t* buffer = &writer->pool[writer->pool_current];
+    size_t whole = writer->direct ? buffer->len & ~(size_t)(OUTPUT_ALIGN - 1) : buffer->len;
+    size_t tail = buffer->len - whole;
+    if (flush && tail > 0 &&
+        write_full_at(writer->plain_fd, buffer->data + whole, tail, writer->pool_offset + whole) != 0) {
+        return -1;
+    }
+    if (whole == 0) return 0;
+
+    if (pool_issue(writer, writer->pool_current, whole, writer->pool_offset) != 0) return -1;
+    int next = pool_next(writer);
+    if (next < 0) return -1;
+    memcpy(writer->pool[next].data, buffer->data + whole, tail);
+    writer->pool[next].len = tail;
+    writer->pool_offset += whole;
+    writer->pool_current = next;
+    return 0;
+}
 
-    uint16_t topic_len = (uint16_t)(strlen(topic) + 1); // Include null terminator
-    uint32_t payload_size = (uint32_t)size;
+static int pool_write(zet_writer_t* writer, const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    while (len > 0) {
+        pool_buffer_t* buffer = &writer->pool[writer->pool_current];
+        size_t n = writer->pool_cap - buffer->len < len ? writer->pool_cap - buffer->len : len;
+        memcpy(buffer->data + buffer->len, p, n);
+        buffer->len += n;
+        p += n;
+        len -= n;
+        if (buffer->len == writer->pool_cap && pool_submit(writer, false) != 0) return -1;
+    }
+    return 0;
+}
 
-    // Write message header
-    if (fwrite(&sent_ns, sizeof(uint64_t), 1, writer->file) != 1) return -1;
-    if (fwrite(&received_ns, sizeof(uint64_t), 1, writer->file) != 1) return -1;
-    if (fwrite(&topic_len, sizeof(uint16_t), 1, writer->file) != 1) return -1;
-    if (fwrite(&payload_size, sizeof(uint32_t), 1, writer->file) != 1) return -1;
+// Close the buffered bytes since the last queued piece into an iovec
+static void output_mark(zet_writer_t* writer) {
+    if (writer->buf_len > writer->buf_mark) {
+        writer->iov[writer->iov_count++] = (struct iovec){
+            .iov_base = writer->buf + writer->buf_mark,
+            .iov_len = writer->buf_len - writer->buf_mark
+        };
+        writer->buf_mark = writer->buf_len;
+    }
+}
 
-    // Write topic
-    if (fwrite(topic, 1, topic_len, writer->file) != topic_len) return -1;
+// Hand everything written so far to the OS
+static int output_flush(zet_writer_t* writer) {
+    if (writer->file) return fflush(writer->file) == 0 ? 0 : -1;
+    if (writer->pool_count > 0) {
+        if (pool_submit(writer, true) != 0) return -1;
+        return pool_wait_all(writer);
+    }
+    output_mark(writer);
+    int ret = write_full(writer->fd, writer->iov, writer->iov_count);
+    writer->buf_len = 0;
+    writer->buf_mark = 0;
+    writer->iov_count = 0;
+    return ret;
+}
 
-    // Write payload
-    if (fwrite(data, 1, size, writer->file) != size) return -1;
+static int output_write(zet_writer_t* writer, const void* data, size_t len) {
+    if (writer->file) return fwrite(data, 1, len, writer->file) == len ? 0 : -1;
+    if (writer->pool_count > 0) return writer->failed ? -1 : pool_write(writer, data, len);
 
+    if (len >= OUTPUT_REF_MIN) {
+        // Room for the buffered bytes before it, this piece and the bytes after
+        if (writer->iov_count + 3 > OUTPUT_IOV_MAX && output_flush(writer) != 0) return -1;
+        output_mark(writer);
+        writer->iov[writer->iov_count++] = (struct iovec){ .iov_base = (void*)data, .iov_len = len };
+        return 0;
+    }
+    if (writer->buf_len + len > writer->buf_cap && output_flush(writer) != 0) return -1;
+    memcpy(writer->buf + writer->buf_len, data, len);
+    writer->buf_len += len;
     return 0;
 }
 
-void zet_writer_flush(zet_writer_t* writer) {
-    if (writer && writer->file) {
-        fflush(writer->file);
+// Write out anything queued by reference
+static int output_release(zet_writer_t* writer) {
+    return writer->iov_count > 0 ? output_flush(writer) : 0;
+}
+
+// Make everything written so far durable. With io_uring the fdatasync() is
+// queued behind the writes in flight rather than waited for.
+static int output_sync(zet_writer_t* writer) {
+    writer->last_sync_ns = zeta_clock_monotonic_ns();
+    if (writer->file) {
+        if (fflush(writer->file) != 0) return -1;
+        return fdatasync(fileno(writer->file));
     }
+    if (writer->uring) {
+        if (pool_submit(writer, true) != 0 || pool_make_room(writer) != 0) return -1;
+        if (zet_uring_datasync(&writer->ring, writer->fd, POOL_SYNC_ID) != 0) return -1;
+        writer->in_flight++;
+        return 0;
+    }
+    if (output_flush(writer) != 0) return -1;
+    return fdatasync(writer->fd);
 }
 
-// Reader implementation
-struct zet_reader_s {
-    FILE* file;
-    zet_header_t header;
-};
+static int output_sync_if_due(zet_writer_t* writer) {
+    if (writer->sync != ZET_SYNC_PERIODIC) return 0;
+    if (zeta_clock_monotonic_ns() - writer->last_sync_ns < writer->sync_interval_ns) return 0;
+    return output_sync(writer);
+}
 
-zet_reader_t* zet_reader_create(const char* filename) {
-    zet_reader_t* reader = (zet_reader_t*)malloc(sizeof(zet_reader_t));
-    if (!reader) return NULL;
+// Open the file for buffered output, with the pool for io_uring or O_DIRECT
+static int output_open(zet_writer_t* writer, const char* filename, const zet_writer_options_t* options) {
+    size_t cap = options->buffer_size ? options->buffer_size : DEFAULT_OUTPUT_BUFFER;
+    if (cap < OUTPUT_REF_MIN) cap = OUTPUT_REF_MIN;
+    cap = (cap + OUTPUT_ALIGN - 1) & ~(size_t)(OUTPUT_ALIGN - 1);
 
-    reader->file = fopen(filename, "rb");
-    if (!reader->file) {
-        free(reader);
-        return NULL;
+    writer->direct = options->direct != 0;
+    writer->fd = zet_io_open(filename, &writer->direct);
+    if (writer->fd < 0) return -1;
+    if (writer->direct) {
+        writer->plain_fd = open(filename, O_WRONLY);
+        if (writer->plain_fd < 0) return -1;
     }
+    writer->uring = options->io == ZET_IO_URING && zet_uring_init(&writer->ring, 2 * OUTPUT_POOL) == 0;
 
-    // Read and validate header
-    if (fread(&reader->header, sizeof(zet_header_t), 1, reader->file) != 1) {
-        fclose(reader->file);
-        free(reader);
+    // Without either, plain writev() with large pieces passed by reference
+    int count = writer->uring ? OUTPUT_POOL : writer->direct ? 2 : 0;
+    if (count == 0) {
+        void* buf = NULL;
+        if (posix_memalign(&buf, OUTPUT_ALIGN, cap) != 0) return -1;
+        writer->buf = (uint8_t*)buf;
+        writer->buf_cap = cap;
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        void* buf = NULL;
+        if (posix_memalign(&buf, OUTPUT_ALIGN, cap) != 0) return -1;
+        writer->pool[i].data = (uint8_t*)buf;
+        writer->pool_count++;
+    }
+    writer->pool_cap = cap;
+    return 0;
+}
+
+// Flush, make durable if asked to, and release reserved space past the end
+static int output_close(zet_writer_t* writer) {
+    int ret = output_flush(writer);
+    if (ret == 0 && writer->sync != ZET_SYNC_NONE) {
+        ret = output_sync(writer);
+        if (ret == 0 && writer->uring) ret = pool_wait_all(writer);
+    }
+    if (writer->preallocate_size > 0) {
+        // Truncating to the same size frees the blocks reserved past it
+        struct stat st;
+        if (fstat(writer->fd, &st) != 0 || ftruncate(writer->fd, st.st_size) != 0) ret = -1;
+    }
+    return ret;
+}
+
+static int write_channel_block(zet_writer_t* writer, const uint8_t* data, size_t len, uint32_t count) {
+    zet_channel_header_t header = {
+        .magic = ZET_CHANNEL_MAGIC,
+        .channel_count = count,
+        .data_size = len
+    };
+    if (output_write(writer, &header, sizeof(header)) != 0) return -1;
+    if (len > 0 && output_write(writer, data, len) != 0) return -1;
+    return 0;
+}
+
+static void writer_free(zet_writer_t* writer) {
+    if (writer->uring) {
+        pool_wait_all(writer);
+        zet_uring_free(&writer->ring);
+    }
+    if (writer->file) fclose(writer->file);
+    if (writer->fd >= 0) close(writer->fd);
+    if (writer->plain_fd >= 0) close(writer->plain_fd);
+    for (int i = 0; i < writer->pool_count; i++) {
+        free(writer->pool[i].data);
+    }
+    ZSTD_freeCCtx(writer->zstd);
+    free(writer->buf);
+    free(writer->chunk);
+    free(writer->packed);
+    free(writer->index);
+    free(writer->topic_filters);
+    free(writer->summary.entries);
+    free(writer->new_channels);
+    free(writer->dedup);
+    topic_table_free(&writer->topics);
+    free(writer);
+}
+
+zet_writer_t* zet_writer_create(const char* filename) {
+    return zet_writer_create_ex(filename, NULL);
+}
+
+zet_writer_t* zet_writer_create_ex(const char* filename, const zet_writer_options_t* options) {
+    zet_writer_options_t defaults = {0};
+    if (!options) options = &defaults;
+    if (options->segment_size > 0 || options->segment_duration_ns > 0) return rotation_create(filename, options);
+
+    uint32_t version = options->version ? options->version : ZET_FORMAT_VERSION;
+    if (version < ZET_FORMAT_VERSION_1 || version > ZET_FORMAT_VERSION_4) return NULL;
+    if (options->compression > ZET_COMPRESSION_ZSTD) return NULL;
+    if (options->compression != ZET_COMPRESSION_NONE && version == ZET_FORMAT_VERSION_1) return NULL;
+    if (options->dedup_min_size > 0 && version == ZET_FORMAT_VERSION_1) return NULL;
+
+    if (options->io > ZET_IO_URING || options->sync > ZET_SYNC_CHUNK) return NULL;
+
+    zet_writer_t* writer = (zet_writer_t*)calloc(1, sizeof(zet_writer_t));
+    if (!writer) return NULL;
+    writer->fd = -1;
+    writer->plain_fd = -1;
+    writer->ring.fd = -1;
+
+    writer->version = version;
+    writer->chunk_size = options->chunk_size ? options->chunk_size : DEFAULT_CHUNK_SIZE;
+    writer->chunk_duration_ns = options->chunk_duration_ns ? options->chunk_duration_ns : DEFAULT_CHUNK_DURATION_NS;
+    writer->compression = options->compression;
+    writer->compression_level = options->compression_level ? options->compression_level : DEFAULT_ZSTD_LEVEL;
+    writer->preallocate_size = options->preallocate_size;
+    writer->sync = options->sync;
+    writer->sync_interval_ns = options->sync_interval_ns ? options->sync_interval_ns : DEFAULT_SYNC_INTERVAL_NS;
+    writer->last_sync_ns = zeta_clock_monotonic_ns();
+
+    if (writer->compression == ZET_COMPRESSION_ZSTD) {
+        writer->zstd = ZSTD_createCCtx();
+        if (!writer->zstd) {
+            writer_free(writer);
+            return NULL;
+        }
+    }
+    writer->dedup_min_size = options->dedup_min_size;
+    if (writer->dedup_min_size > 0 &&
+        !(writer->dedup = (dedup_entry_t*)calloc(ZET_DEDUP_PAYLOADS, sizeof(dedup_entry_t)))) {
+        writer_free(writer);
         return NULL;
     }
 
-    // Validate magic
-    if (memcmp(reader->header.magic, "ZET", 3) != 0) {
-        fclose(reader->file);
-        free(reader);
+    bool buffered = options->buffer_size > 0 || options->io != ZET_IO_POSIX || options->direct ||
+                    options->preallocate_size > 0;
+    if (buffered ? output_open(writer, filename, options) != 0 : !(writer->file = fopen(filename, "wb"))) {
+        writer_free(writer);
         return NULL;
     }
 
-    // Check version
-    if (reader->header.version != 1) {
-        fclose(reader->file);
-        free(reader);
+    writer->start_time_ns = zeta_clock_now_ns();
+
+    // Write header
+    zet_header_t header = {
+        .magic = {'Z', 'E', 'T', '\0'},
+        .version = version,
+        .start_time_ns = writer->start_time_ns,
+        .flags = (version >= ZET_FORMAT_VERSION_2 ? ZET_FLAG_CHECKSUMS : 0) | (writer->dedup ? ZET_FLAG_DEDUP : 0),
+        .reserved = {0}
+    };
+
+    if (output_write(writer, &header, sizeof(zet_header_t)) != 0) {
+        writer_free(writer);
         return NULL;
     }
+    writer->offset = sizeof(zet_header_t);
 
-    return reader;
+    return writer;
 }
 
-void zet_reader_destroy(zet_reader_t* reader) {
-    if (reader) {
-        if (reader->file) {
-            fclose(reader->file);
-        }
-        free(reader);
+// Compress the chunk being filled into writer->packed. Returns the compressed
+// size, or 0 to store the chunk as is (compression off, failed or no smaller).
+static size_t compress_chunk(zet_writer_t* writer) {
+    size_t bound;
+    if (writer->compression == ZET_COMPRESSION_LZ4) {
+        if (writer->chunk_len > LZ4_MAX_INPUT_SIZE) return 0;
+        bound = (size_t)LZ4_compressBound((int)writer->chunk_len);
+    } else if (writer->compression == ZET_COMPRESSION_ZSTD) {
+        bound = ZSTD_compressBound(writer->chunk_len);
+    } else {
+        return 0;
     }
-}
 
-int zet_reader_read_message(zet_reader_t* reader, zet_message_t* msg) {
-    if (!reader || !reader->file || !msg) return -1;
+    if (bound > writer->packed_cap) {
+        uint8_t* packed = (uint8_t*)realloc(writer->packed, bound);
+        if (!packed) return 0;
+        writer->packed = packed;
+        writer->packed_cap = bound;
+    }
 
-    uint64_t sent_ns, received_ns;
-    uint16_t topic_len;
-    uint32_t payload_size;
+    size_t packed_len;
+    if (writer->compression == ZET_COMPRESSION_LZ4) {
+        int ret = LZ4_compress_default((const char*)writer->chunk, (char*)writer->packed,
+                                       (int)writer->chunk_len, (int)bound);
+        packed_len = ret > 0 ? (size_t)ret : 0;
+    } else {
+        packed_len = ZSTD_compressCCtx(writer->zstd, writer->packed, bound, writer->chunk, writer->chunk_len,
+                                       writer->compression_level);
+        if (ZSTD_isError(packed_len)) packed_len = 0;
+    }
+    return packed_len < writer->chunk_len ? packed_len : 0;
+}
 
-    // Read message header
-    if (fread(&sent_ns, sizeof(uint64_t), 1, reader->file) != 1) return -1;
-    if (fread(&received_ns, sizeof(uint64_t), 1, reader->file) != 1) return -1;
-    if (fread(&topic_len, sizeof(uint16_t), 1, reader->file) != 1) return -1;
-    if (fread(&payload_size, sizeof(uint32_t), 1, reader->file) != 1) return -1;
+// CRC32C of a chunk header, taken with crc 0, and of its data
+static uint32_t chunk_crc(const zet_chunk_header_t* header, const void* data) {
+    zet_chunk_header_t copy = *header;
+    copy.crc = 0;
+    return zet_crc32c(zet_crc32c(0, &copy, sizeof(copy)), data, (size_t)header->data_size);
+}
 
-    // Allocate and read topic
-    char* topic = (char*)malloc(topic_len);
-    if (!topic) return -1;
-    if (fread(topic, 1, topic_len, reader->file) != topic_len) {
-        free(topic);
-        return -1;
+// Room for one more index entry
+static int index_reserve(zet_writer_t* writer) {
+    if (writer->index_count == writer->index_cap) {
+        size_t cap = writer->index_cap ? writer->index_cap * 2 : 256;
+        zet_index_entry_t* index = (zet_index_entry_t*)realloc(writer->index, cap * sizeof(zet_index_entry_t));
+        if (index) writer->index = index;
+        uint8_t* filters = (uint8_t*)realloc(writer->topic_filters, cap * ZET_TOPIC_FILTER_SIZE);
+        if (filters) writer->topic_filters = filters;
+        if (!index || !filters) return -1;
+        writer->index_cap = cap;
     }
+    return 0;
+}
 
-    // Allocate and read payload
-    void* data = malloc(payload_size);
-    if (!data) {
-        free(topic);
-        return -1;
-    }
-    if (fread(data, 1, payload_size, reader->file) != payload_size) {
-        free(topic);
-        free(data);
+// Define the channels first seen since the last chunk, just before the next
+static int write_new_channels(zet_writer_t* writer) {
+    if (writer->new_channel_count == 0) return 0;
+    if (write_channel_block(writer, writer->new_channels, writer->new_channels_len,
+                            writer->new_channel_count) != 0) {
         return -1;
     }
+    writer->offset += sizeof(zet_channel_header_t) + writer->new_channels_len;
+    writer->new_channels_len = 0;
+    writer->new_channel_count = 0;
+    return 0;
+}
 
-    // Fill message structure
-    msg->sent_ns = sent_ns;
-    msg->received_ns = received_ns;
-    msg->topic = topic;
-    msg->data = data;
-    msg->size = payload_size;
+// Write out the chunk being filled, if any, and add it to the index
+static int write_chunk(zet_writer_t* writer) {
+    if (writer->chunk_messages == 0) return 0;
+    if (index_reserve(writer) != 0 || write_new_channels(writer) != 0) return -1;
 
-    return 0;
+    size_t packed_len = compress_chunk(writer);
+    const uint8_t* data = packed_len ? writer->packed : writer->chunk;
+    size_t data_size = packed_len ? packed_len : writer->chunk_len;
+
+    zet_chunk_header_t header = {
+        .magic = ZET_CHUNK_MAGIC,
+        .message_count = writer->chunk_messages,
+        .start_ns = writer->chunk_start_ns,
+        .end_ns = writer->chunk_end_ns,
+        .data_size = data_size,
+        .compression = packed_len ? writer->compression : ZET_COMPRESSION_NONE,
+        .crc = 0,
+        .raw_size = writer->chunk_len
+    };
+    header.crc = chunk_crc(&header, data);
+    if (output_write(writer, &header, sizeof(header)) != 0) return -1;
+    if (output_write(writer, data, data_size) != 0 || output_release(writer) != 0) return -1;
+
+    memcpy(writer->topic_filters + writer->index_count * ZET_TOPIC_FILTER_SIZE, writer->chunk_topics,
+           ZET_TOPIC_FILTER_SIZE);
+    memset(writer->chunk_topics, 0, ZET_TOPIC_FILTER_SIZE);
+    writer->index[writer->index_count++] = (zet_index_entry_t){
+        .offset = writer->offset,
+        .start_ns = writer->chunk_start_ns,
+        .end_ns = writer->chunk_end_ns,
+        .message_count = writer->chunk_messages,
+        .reserved = 0
+    };
+    writer->offset += sizeof(header) + data_size;
+    writer->message_count += writer->chunk_messages;
+    writer->chunk_len = 0;
+    writer->chunk_deltas = (chunk_deltas_t){ 0 };
+    writer->chunk_messages = 0;
+    return writer->sync == ZET_SYNC_CHUNK ? output_sync(writer) : 0;
 }
 
-void zet_message_free(zet_message_t* msg) {
-    if (msg) {
-        free(msg->topic);
-        free(msg->data);
-        msg->topic = NULL;
-        msg->data = NULL;
-        msg->size = 0;
+// Append a chunk of another file as it is: its header and data, len bytes
+// at in_offset of in_fd, copied inside the kernel, or written from data
+// (the same bytes in memory) where that cannot be done. The chunk being
+// filled goes out first. The caller adds the chunk's records to the summary
+// and gives its topic filter.
+static int write_chunk_copy(zet_writer_t* writer, const zet_chunk_header_t* header, const uint8_t* topics,
+                            int in_fd, uint64_t in_offset, const uint8_t* data) {
+    if (write_chunk(writer) != 0 || index_reserve(writer) != 0 || write_new_channels(writer) != 0) return -1;
+
+    // Only plain buffered output has a file position the kernel can append at
+    uint64_t len = sizeof(*header) + header->data_size;
+    bool plain = !writer->file && writer->pool_count == 0;
+    if (plain && output_flush(writer) != 0) return -1;
+    int64_t copied = plain ? zet_io_copy(writer->fd, in_fd, in_offset, len) : -1;
+    if (copied >= 0 && (uint64_t)copied != len) return -1;
+    if (copied < 0 && (output_write(writer, data, (size_t)len) != 0 || output_release(writer) != 0)) return -1;
+
+    memcpy(writer->topic_filters + writer->index_count * ZET_TOPIC_FILTER_SIZE, topics, ZET_TOPIC_FILTER_SIZE);
+    writer->index[writer->index_count++] = (zet_index_entry_t){
+        .offset = writer->offset,
+        .start_ns = header->start_ns,
+        .end_ns = header->end_ns,
+        .message_count = header->message_count,
+        .reserved = 0
+    };
+    writer->offset += len;
+    writer->message_count += header->message_count;
+    return writer->sync == ZET_SYNC_CHUNK ? output_sync(writer) : 0;
+}
+
+// Write every channel in ID order (version 3), so a reader that seeks past
+// the channel blocks still knows them all. IDs can have gaps when they were
+// taken from another file.
+static int write_all_channels(zet_writer_t* writer) {
+    const topic_table_t* topics = &writer->topics;
+    uint8_t* buf = NULL;
+    size_t len = 0;
+    size_t cap = 0;
+    uint32_t count = 0;
+    int ret = 0;
+    for (size_t id = 0; id < topics->channel_cap && ret == 0; id++) {
+        const char* topic = topic_channel(topics, (uint32_t)id);
+        if (!topic) continue;
+        ret = append_channel(&buf, &len, &cap, (uint16_t)id, topic, strlen(topic));
+        count++;
     }
+    if (ret == 0) ret = write_channel_block(writer, buf, len, count);
+    if (ret == 0) ret = output_release(writer);
+    if (ret == 0) writer->offset += sizeof(zet_channel_header_t) + len;
+    free(buf);
+    return ret;
 }
 
-uint64_t zet_reader_get_start_time(zet_reader_t* reader) {
-    return reader ? reader->header.start_time_ns : 0;
+// Write the chunk index, topic filters, summary and footer that make a
+// chunked file seekable, leaving the offset at the end of the file
+static int write_index(zet_writer_t* writer) {
+    zet_index_header_t header = {
+        .magic = ZET_INDEX_MAGIC,
+        .chunk_count = (uint32_t)writer->index_count
+    };
+    zet_topic_filter_header_t filters = {
+        .magic = ZET_TOPIC_FILTER_MAGIC,
+        .filter_size = ZET_TOPIC_FILTER_SIZE,
+        .data_size = (uint64_t)writer->index_count * ZET_TOPIC_FILTER_SIZE
+    };
+    zet_footer_t footer = {
+        .magic = ZET_FOOTER_MAGIC,
+        .summary_size = 0,
+        .index_offset = writer->offset,
+        .message_count = writer->message_count,
+        .channel_offset = 0
+    };
+    if (output_write(writer, &header, sizeof(header)) != 0) return -1;
+    if (output_write(writer, writer->index, writer->index_count * sizeof(zet_index_entry_t)) != 0) return -1;
+    if (output_write(writer, &filters, sizeof(filters)) != 0) return -1;
+    if (output_write(writer, writer->topic_filters, (size_t)filters.data_size) != 0) return -1;
+    writer->offset += sizeof(header) + writer->index_count * sizeof(zet_index_entry_t) + sizeof(filters) +
+                      filters.data_size;
+    if (writer->version >= ZET_FORMAT_VERSION_3) {
+        footer.channel_offset = writer->offset;
+        if (write_all_channels(writer) != 0) return -1;
+    }
+
+    size_t summary_len;
+    uint8_t* summary = summary_encode(&writer->summary, &writer->topics, &summary_len);
+    if (!summary) return -1;
+    footer.summary_size = (uint32_t)summary_len;
+    int ret = output_write(writer, summary, summary_len) == 0 && output_write(writer, &footer, sizeof(footer)) == 0
+                  ? output_release(writer) : -1;
+    if (ret == 0) writer->offset += summary_len + sizeof(footer);
+    free(summary);
+    return ret;
+}
+
+// Write out the last chunk and the index, and close the file
+static void writer_close(zet_writer_t* writer) {
+    if (writer->version != ZET_FORMAT_VERSION_1 && write_chunk(writer) == 0) {
+        write_index(writer);
+    }
+    output_close(writer);
+}
+
+void zet_writer_destroy(zet_writer_t* writer) {
+    if (writer && writer->rotation) {
+        rotation_destroy(writer);
+    } else if (writer) {
+        writer_close(writer);
+        writer_free(writer);
+    }
+}
+
+static int write_message_v1(zet_writer_t* writer, uint64_t sent_ns, uint64_t received_ns,
+                            const char* topic, uint16_t topic_len, const void* data, size_t size) {
+    uint8_t header[ZET_RECORD_HEADER_SIZE];
+    encode_record_header(header, sent_ns, received_ns, topic_len, (uint32_t)size);
+
+    if (output_write(writer, header, sizeof(header)) != 0) return -1;
+    if (output_write(writer, topic, topic_len) != 0) return -1;
+    if (output_write(writer, data, size) != 0) return -1;
+    writer->offset += sizeof(header) + topic_len + size;
+    return 0;
+}
+
+// Channel ID of a topic, defining a new channel the first time it is seen,
+// and the topic's hash
+static int channel_for_topic(zet_writer_t* writer, const char* topic, uint16_t topic_len, uint16_t* id,
+                             uint32_t* hash) {
+    topic_table_t* topics = &writer->topics;
+    size_t len = (size_t)topic_len - 1;
+    topic_slot_t* slot = topic_find(topics, topic, len, topic_hash(topic, len));
+    if (!slot) {
+        if (topics->count >= ZET_MAX_CHANNELS) return -1;
+        if (!(slot = topic_intern(topics, topic, len, NULL))) return -1;
+        if (topic_set_channel(topics, slot->id, slot->topic) != 0 ||
+            append_channel(&writer->new_channels, &writer->new_channels_len, &writer->new_channels_cap,
+                           (uint16_t)slot->id, topic, len) != 0) {
+            return -1;
+        }
+        writer->new_channel_count++;
+    }
+    *id = (uint16_t)slot->id;
+    *hash = slot->hash;
+    return 0;
+}
+
+// ID of a topic in writer->topics (version 2), added the first time it is
+// seen, and the topic's hash
+static int id_for_topic(zet_writer_t* writer, const char* topic, uint16_t topic_len, uint32_t* id, uint32_t* hash) {
+    bool added;
+    topic_slot_t* slot = topic_intern(&writer->topics, topic, (size_t)topic_len - 1, &added);
+    if (!slot || (added && topic_set_channel(&writer->topics, slot->id, slot->topic) != 0)) return -1;
+    *id = slot->id;
+    *hash = slot->hash;
+    return 0;
+}
+
+static int write_message_v2(zet_writer_t* writer, uint64_t sent_ns, uint64_t received_ns,
+                            const char* topic, uint16_t topic_len, const void* data, size_t size) {
+    // Version 3 records carry a channel ID in place of the topic
+    uint16_t channel = 0;
+    uint32_t id;
+    uint32_t hash;
+    bool channels = writer->version >= ZET_FORMAT_VERSION_3;
+    if (channels) {
+        if (channel_for_topic(writer, topic, topic_len, &channel, &hash) != 0) return -1;
+        id = channel;
+    } else if (id_for_topic(writer, topic, topic_len, &id, &hash) != 0) {
+        return -1;
+    }
+    size_t topic_size = channels ? 0 : topic_len;
+
+    // A payload written before is stored as a reference to the first copy
+    zet_payload_ref_t ref;
+    dedup_entry_t* first = NULL;
+    bool repeat = false;
+    if (writer->dedup) {
+        if (size >= ZET_PAYLOAD_REF) return -1;
+        if (size >= writer->dedup_min_size) {
+            ref.received_ns = received_ns;
+            ref.hash = zet_xxh64(data, size, 0);
+            first = &writer->dedup[ref.hash & (ZET_DEDUP_PAYLOADS - 1)];
+            repeat = first->used && first->hash == ref.hash && first->size == size;
+            if (repeat) ref.received_ns = first->received_ns;
+        }
+    }
+    const void* payload = repeat ? (const void*)&ref : data;
+    size_t stored = repeat ? sizeof(ref) : size;
+    uint8_t head[COMPACT_HEADER_MAX];
+    chunk_deltas_t deltas = writer->chunk_deltas;
+    uint16_t field = channels ? channel : topic_len;
+    uint32_t payload_size = (uint32_t)size | (repeat ? ZET_PAYLOAD_REF : 0);
+    size_t head_len = encode_chunk_record(head, writer->version, &deltas, sent_ns, received_ns, field, payload_size);
+    size_t record_size = head_len + topic_size + stored;
+
+    // A message that does not fit the current chunk starts the next one,
+    // with its time delta from 0
+    if (writer->chunk_messages > 0 && writer->chunk_len + record_size > writer->chunk_size) {
+        if (write_chunk(writer) != 0) return -1;
+        deltas = (chunk_deltas_t){ 0 };
+        head_len = encode_chunk_record(head, writer->version, &deltas, sent_ns, received_ns, field, payload_size);
+        record_size = head_len + topic_size + stored;
+    }
+
+    if (writer->chunk_len + record_size > writer->chunk_cap) {
+        size_t cap = writer->chunk_cap ? writer->chunk_cap : writer->chunk_size;
+        while (cap < writer->chunk_len + record_size) cap *= 2;
+        uint8_t* chunk = (uint8_t*)realloc(writer->chunk, cap);
+        if (!chunk) return -1;
+        writer->chunk = chunk;
+        writer->chunk_cap = cap;
+    }
+    if (summary_add(&writer->summary, id, received_ns, size) != 0) return -1;
+    topic_filter_add(writer->chunk_topics, ZET_TOPIC_FILTER_SIZE, hash);
+
+    uint8_t* p = writer->chunk + writer->chunk_len;
+    memcpy(p, head, head_len);
+    memcpy(p + head_len, topic, topic_size);
+    if (stored > 0) memcpy(p + head_len + topic_size, payload, stored);
+    writer->chunk_len += record_size;
+    writer->chunk_deltas = deltas;
+    if (first && !repeat) {
+        *first = (dedup_entry_t){ .hash = ref.hash, .received_ns = received_ns, .size = (uint32_t)size, .used = true };
+    }
+
+    if (writer->chunk_messages == 0) {
+        writer->chunk_start_ns = received_ns;
+        writer->chunk_end_ns = received_ns;
+    }
+    if (received_ns < writer->chunk_start_ns) writer->chunk_start_ns = received_ns;
+    if (received_ns > writer->chunk_end_ns) writer->chunk_end_ns = received_ns;
+    writer->chunk_messages++;
+
+    if (writer->chunk_len >= writer->chunk_size ||
+        writer->chunk_end_ns - writer->chunk_start_ns >= writer->chunk_duration_ns) {
+        return write_chunk(writer);
+    }
+    return 0;
+}
+
+// Write one message, leaving large payloads queued by reference
+static int write_message(zet_writer_t* writer, uint64_t sent_ns, uint64_t received_ns,
+                         const char* topic, const void* data, size_t size) {
+    if (!topic || !data) return -1;
+
+    size_t topic_len = strlen(topic) + 1; // Include null terminator
+    if (topic_len > UINT16_MAX || size > UINT32_MAX) return -1;
+
+    if (writer->version == ZET_FORMAT_VERSION_1) {
+        return write_message_v1(writer, sent_ns, received_ns, topic, (uint16_t)topic_len, data, size);
+    }
+    return write_message_v2(writer, sent_ns, received_ns, topic, (uint16_t)topic_len, data, size);
+}
+
+int zet_writer_write_message(zet_writer_t* writer,
+                              uint64_t sent_ns,
+                              uint64_t received_ns,
+                              const char* topic,
+                              const void* data,
+                              size_t size) {
+    if (!writer) return -1;
+    if (writer->rotation) {
+        zet_message_view_t msg = { sent_ns, received_ns, topic, data, size };
+        return rotation_write(writer->rotation, &msg, 1);
+    }
+
+    int ret = write_message(writer, sent_ns, received_ns, topic, data, size);
+    if (output_release(writer) != 0 || output_sync_if_due(writer) != 0) return -1;
+    return ret;
+}
+
+int zet_writer_write_batch(zet_writer_t* writer, const zet_message_view_t* messages, size_t count) {
+    if (!writer || (!messages && count > 0)) return -1;
+    if (writer->rotation) return rotation_write(writer->rotation, messages, count);
+
+    int ret = 0;
+    for (size_t i = 0; i < count && ret == 0; i++) {
+        const zet_message_view_t* msg = &messages[i];
+        ret = write_message(writer, msg->sent_ns, msg->received_ns, msg->topic, msg->data, msg->size);
+    }
+    if (output_release(writer) != 0 || output_sync_if_due(writer) != 0) return -1;
+    return ret;
+}
+
+void zet_writer_flush(zet_writer_t* writer) {
+    if (writer && writer->rotation) {
+        zet_writer_flush(writer->rotation->segment);
+    } else if (writer) {
+        if (writer->version != ZET_FORMAT_VERSION_1) {
+            write_chunk(writer);
+        } else if (writer->sync == ZET_SYNC_CHUNK) {
+            output_sync(writer);
+        }
+        output_flush(writer);
+        output_sync_if_due(writer);
+    }
+}
+
+uint64_t zet_writer_get_bytes_written(zet_writer_t* writer) {
+    if (writer && writer->rotation) {
+        return atomic_load(&writer->rotation->bytes_done) + zet_writer_get_bytes_written(writer->rotation->segment);
+    }
+    return writer ? writer->offset : 0;
+}
+
+uint32_t zet_writer_get_io(zet_writer_t* writer) {
+    if (writer && writer->rotation) return zet_writer_get_io(writer->rotation->segment);
+    return writer && writer->uring ? ZET_IO_URING : ZET_IO_POSIX;
+}
+
+// Rotation. Each segment is written by a writer of its own. The next segment
+// starts before the message that would take the current one past
+// segment_size or segment_duration_ns; messages are never split or repeated.
+// Finishing a segment (its last chunk, index and summary, and a sync if asked
+// for) is left to a thread, joined before the next one starts, so the writing
+// thread does not wait for it.
+static void* close_segment(void* arg) {
+    rotation_t* r = (rotation_t*)arg;
+    zet_writer_t* done = r->done;
+    uint64_t counted = done->offset;
+    writer_close(done);
+    atomic_fetch_add(&r->bytes_done, done->offset - counted);
+    writer_free(done);
+    return NULL;
+}
+
+// Open and list the next segment, and hand the current one to the closer
+static int rotation_next(rotation_t* r) {
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%04u.zet", r->index);
+    size_t len = strlen(r->base);
+    char* path = (char*)malloc(len + strlen(suffix) + 1);
+    if (!path) return -1;
+    memcpy(path, r->base, len);
+    strcpy(path + len, suffix);
+    zet_writer_t* next = zet_writer_create_ex(path, &r->options);
+    free(path);
+    if (!next) return -1;
+    if (fprintf(r->manifest, "%s%s\n", r->name, suffix) < 0 || fflush(r->manifest) != 0 ||
+        (r->options.sync != ZET_SYNC_NONE && fdatasync(fileno(r->manifest)) != 0)) {
+        zet_writer_destroy(next);
+        return -1;
+    }
+
+    zet_writer_t* done = r->segment;
+    if (done) {
+        // Pieces queued by reference point into the caller's messages
+        output_release(done);
+        if (r->closing) pthread_join(r->closer, NULL);
+        // What it has written so far counts now, the rest once it is closed
+        atomic_fetch_add(&r->bytes_done, done->offset);
+        r->done = done;
+        r->closing = pthread_create(&r->closer, NULL, close_segment, r) == 0;
+        if (!r->closing) close_segment(r);
+    }
+    r->segment = next;
+    r->index++;
+    r->messages = 0;
+    return 0;
+}
+
+static bool rotation_due(const rotation_t* r, uint64_t received_ns) {
+    if (r->messages == 0) return false;
+    const zet_writer_t* segment = r->segment;
+    if (r->size > 0 && segment->offset + segment->chunk_len >= r->size) return true;
+    return r->duration_ns > 0 && received_ns > r->start_ns && received_ns - r->start_ns >= r->duration_ns;
+}
+
+static int rotation_write(rotation_t* r, const zet_message_view_t* messages, size_t count) {
+    int ret = 0;
+    for (size_t i = 0; i < count && ret == 0; i++) {
+        const zet_message_view_t* msg = &messages[i];
+        if (rotation_due(r, msg->received_ns) && rotation_next(r) != 0) {
+            ret = -1;
+            break;
+        }
+        ret = write_message(r->segment, msg->sent_ns, msg->received_ns, msg->topic, msg->data, msg->size);
+        if (ret == 0 && r->messages++ == 0) r->start_ns = msg->received_ns;
+    }
+    if (output_release(r->segment) != 0 || output_sync_if_due(r->segment) != 0) return -1;
+    return ret;
+}
+
+static void rotation_destroy(zet_writer_t* writer) {
+    rotation_t* r = writer->rotation;
+    zet_writer_destroy(r->segment);
+    if (r->closing) pthread_join(r->closer, NULL);
+    if (r->manifest) fclose(r->manifest);
+    free(r->base);
+    free(r);
+    writer->rotation = NULL;
+    writer_free(writer);
+}
+
+static zet_writer_t* rotation_create(const char* filename, const zet_writer_options_t* options) {
+    zet_writer_t* writer = (zet_writer_t*)calloc(1, sizeof(zet_writer_t));
+    if (!writer) return NULL;
+    writer->fd = -1;
+    writer->plain_fd = -1;
+    writer->ring.fd = -1;
+    rotation_t* r = (rotation_t*)calloc(1, sizeof(rotation_t));
+    if (!r) {
+        writer_free(writer);
+        return NULL;
+    }
+    writer->rotation = r;
+    atomic_init(&r->bytes_done, 0);
+    r->options = *options;
+    r->options.segment_size = 0;
+    r->options.segment_duration_ns = 0;
+    r->size = options->segment_size;
+    r->duration_ns = options->segment_duration_ns;
+
+    // Segments are named after the manifest, without its extension
+    const char* slash = strrchr(filename, '/');
+    const char* dot = strrchr(filename, '.');
+    size_t len = dot && (!slash || dot > slash) ? (size_t)(dot - filename) : strlen(filename);
+    r->base = strndup(filename, len);
+    if (r->base) r->name = slash ? r->base + (slash - filename) + 1 : r->base;
+    r->manifest = fopen(filename, "w");
+    if (!r->base || !r->manifest || fputs(ZET_MANIFEST_MAGIC "\n", r->manifest) == EOF || rotation_next(r) != 0) {
+        rotation_destroy(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+int zet_manifest_read(const char* filename, char*** segments, size_t* count) {
+    if (!filename || !segments || !count) return -1;
+    FILE* f = fopen(filename, "r");
+    if (!f) return -1;
+    char magic[sizeof(ZET_MANIFEST_MAGIC)];
+    if (fread(magic, 1, sizeof(magic), f) != sizeof(magic) ||
+        memcmp(magic, ZET_MANIFEST_MAGIC "\n", sizeof(magic)) != 0) {
+        fclose(f);
+        return -1;
+    }
+
+    // Names are relative to the manifest's directory
+    const char* slash = strrchr(filename, '/');
+    size_t dir_len = slash ? (size_t)(slash - filename) + 1 : 0;
+    char** list = NULL;
+    size_t n = 0;
+    size_t cap = 0;
+    char* line = NULL;
+    size_t line_cap = 0;
+    ssize_t len;
+    int ret = 0;
+    while ((len = getline(&line, &line_cap, f)) > 0) {
+        // A line cut short by a crash names a segment not yet created
+        if (line[len - 1] != '\n') break;
+        line[--len] = '\0';
+        if (len == 0) continue;
+        size_t prefix = line[0] == '/' ? 0 : dir_len;
+        char* path = (char*)malloc(prefix + (size_t)len + 1);
+        if (!path) {
+            ret = -1;
+            break;
+        }
+        memcpy(path, filename, prefix);
+        memcpy(path + prefix, line, (size_t)len + 1);
+        if (access(path, F_OK) != 0) {
+            free(path);
+            continue;
+        }
+        if (n == cap) {
+            size_t grown = cap ? cap * 2 : 16;
+            char** more = (char**)realloc(list, grown * sizeof(char*));
+            if (!more) {
+                free(path);
+                ret = -1;
+                break;
+            }
+            list = more;
+            cap = grown;
+        }
+        list[n++] = path;
+    }
+    free(line);
+    fclose(f);
+    if (ret != 0) {
+        zet_manifest_free(list, n);
+        return -1;
+    }
+    *segments = list;
+    *count = n;
+    return 0;
+}
+
+void zet_manifest_free(char** segments, size_t count) {
+    if (!segments) return;
+    for (size_t i = 0; i < count; i++) {
+        free(segments[i]);
+    }
+    free(segments);
+}
+
+// Reader implementation
+typedef struct read_pipeline_s read_pipeline_t;
+
+// A payload a reference has resolved to, by its hash and size
+typedef struct {
+    uint64_t hash;
+    size_t size;
+    const uint8_t* data;     // In the mapping, or owned
+    uint8_t* owned;
+    bool used;
+} ref_slot_t;
+
+struct zet_reader_s {
+    // Source: a stdio stream, or a read-only mapping of the whole file
+    FILE* file;
+    const uint8_t* map;
+    size_t map_size;
+    size_t map_pos;
+
+    zet_header_t header;
+
+    // Topics handed out in messages, and version 3 channel IDs
+    topic_table_t topics;
+    uint8_t* scratch;        // Version 1 topics and channel blocks as read
+    size_t scratch_cap;
+    uint8_t* record;         // Version 1 payload, or a batch of records, as read
+    size_t record_cap;
+
+    // Version 2+: the chunk being read
+    const uint8_t* chunk_data; // Its records: in chunk, or in the mapping
+    size_t chunk_len;
+    size_t chunk_pos;
+    chunk_deltas_t chunk_deltas; // Past the record before chunk_pos (version 4)
+    uint16_t view_channel;   // Channel ID of the record just read (version 3 and later)
+    uint8_t* chunk;
+    size_t chunk_cap;
+    uint8_t* packed;         // Compressed chunk as read from the file
+    size_t packed_cap;
+    ZSTD_DCtx* zstd;
+
+    // Version 2+: chunk index, from the footer or by walking chunk headers
+    zet_index_entry_t* index;
+    uint64_t* index_max_end; // Running maximum of end_ns, sorted even if received_ns is not
+    size_t index_count;
+    bool index_loaded;
+    uint8_t* topic_filters;  // topic_filter_size bytes per entry, if the file has them
+    uint32_t topic_filter_size;
+
+    uint64_t data_end;       // Offset of the index, or the end of the last whole chunk
+
+    // Version 2+: the summary block, once asked for
+    zet_summary_t summary;
+    zet_topic_summary_t* summary_topics;
+    bool summary_loaded;
+
+    // Set by a seek: skip messages received before this time
+    bool skipping;
+    uint64_t skip_before_ns;
+
+    // Topics asked for with zet_reader_set_topics(), interned and sorted by
+    // address, and per index entry whether the chunk holds none of them
+    const char** wanted;
+    size_t wanted_count;
+    bool* chunk_skip;
+
+    // Why the last read stopped (ZET_STATUS_*), and for a short read how many
+    // bytes there were
+    int status;
+    size_t short_read;
+
+    // Version 2+ with threads: chunks read and decoded ahead
+    uint32_t threads;
+    uint32_t read_ahead;
+    read_pipeline_t* pipeline;
+    uint64_t pipeline_end;   // Where the last pipeline stopped, so it is not restarted there
+    bool pipeline_stale;     // The topics changed since it started: restart it at the next chunk
+
+    // Following: an inotify watch on the file (-1 without), and how long to
+    // wait for the writer
+    bool follow;
+    int watch;
+    uint64_t follow_timeout_ns;
+
+    // Dedup: the reference in the record just read, until it is resolved, and
+    // the payloads references have resolved to, in ZET_DEDUP_PAYLOADS slots
+    // kept as the writer keeps its own (see resolve_view()). Copies pushed
+    // out of a slot are retired until the next read, as views may hold them.
+    const uint8_t* view_ref;
+    ref_slot_t* refs;
+    uint8_t** ref_retired;
+    size_t ref_retired_count;
+    size_t ref_retired_cap;
+    uint8_t* ref_records;    // Another chunk's records, read to find a payload
+    size_t ref_records_cap;
+    uint8_t* ref_packed;
+    size_t ref_packed_cap;
+};
+
+// How far ahead a mapped reader asks the kernel to read after a seek
+#define MMAP_READAHEAD (8 * 1024 * 1024)
+
+// Bytes of version 1 records read at once by zet_reader_read_views()
+#define BATCH_READ_SIZE (256 * 1024)
+
+// Grow a buffer to at least size bytes
+static int reserve(uint8_t** buf, size_t* cap, uint64_t size) {
+    if (size <= *cap) return 0;
+    if (size > SIZE_MAX) return -1;
+    uint8_t* grown = (uint8_t*)realloc(*buf, (size_t)size);
+    if (!grown) return -1;
+    *buf = grown;
+    *cap = (size_t)size;
+    return 0;
+}
+
+// Source access. Headers are copied out with source_read(); records and
+// chunks come from source_view(), which points into the mapping when there is
+// one and reads into the given buffer otherwise. A read that fails leaves the
+// position where it was.
+
+// Record why reading stopped
+static int reader_stop(zet_reader_t* reader, int status) {
+    reader->status = status;
+    return -1;
+}
+
+static bool source_has(const zet_reader_t* reader, uint64_t size) {
+    return reader->map_pos <= reader->map_size && size <= reader->map_size - reader->map_pos;
+}
+
+static int64_t source_remaining(zet_reader_t* reader) {
+    if (reader->map) return reader->map_pos < reader->map_size ? (int64_t)(reader->map_size - reader->map_pos) : 0;
+    struct stat st;
+    off_t pos = ftello(reader->file);
+    return pos >= 0 && fstat(fileno(reader->file), &st) == 0 && st.st_size >= pos ? (int64_t)(st.st_size - pos) : -1;
+}
+
+// A read that came up short: torn, or an I/O error
+static int source_short(zet_reader_t* reader, size_t got) {
+    reader->short_read = got;
+    if (reader->map) return reader_stop(reader, ZET_STATUS_TRUNCATED);
+    int status = ferror(reader->file) ? ZET_STATUS_ERROR : ZET_STATUS_TRUNCATED;
+    fseeko(reader->file, -(off_t)got, SEEK_CUR);
+    return reader_stop(reader, status);
+}
+
+// Go back over bytes already read
+static void source_back(zet_reader_t* reader, size_t size) {
+    if (reader->map) {
+        reader->map_pos -= size;
+    } else {
+        fseeko(reader->file, -(off_t)size, SEEK_CUR);
+    }
+}
+
+static int source_read(zet_reader_t* reader, void* dst, size_t size) {
+    if (reader->map) {
+        if (!source_has(reader, size)) return source_short(reader, (size_t)source_remaining(reader));
+        memcpy(dst, reader->map + reader->map_pos, size);
+        reader->map_pos += size;
+        return 0;
+    }
+    size_t got = fread(dst, 1, size, reader->file);
+    return got == size ? 0 : source_short(reader, got);
+}
+
+static const uint8_t* source_view(zet_reader_t* reader, uint64_t size, uint8_t** buf, size_t* cap) {
+    static const uint8_t empty[1];
+    if (reader->map) {
+        if (!source_has(reader, size)) {
+            source_short(reader, (size_t)source_remaining(reader));
+            return NULL;
+        }
+        const uint8_t* p = reader->map + reader->map_pos;
+        reader->map_pos += (size_t)size;
+        return p;
+    }
+    if (size > *cap) {
+        // Never allocate for a length running past the end of the file
+        int64_t left = source_remaining(reader);
+        if (left >= 0 && size > (uint64_t)left) {
+            reader->short_read = (size_t)left;
+            reader_stop(reader, ZET_STATUS_TRUNCATED);
+            return NULL;
+        }
+    }
+    if (reserve(buf, cap, size) != 0) {
+        reader_stop(reader, ZET_STATUS_ERROR);
+        return NULL;
+    }
+    size_t got = fread(*buf, 1, (size_t)size, reader->file);
+    if (got != size) {
+        source_short(reader, got);
+        return NULL;
+    }
+    return *buf ? *buf : empty;
+}
+
+static int source_seek(zet_reader_t* reader, uint64_t offset) {
+    if (reader->map) {
+        reader->map_pos = offset < reader->map_size ? (size_t)offset : reader->map_size;
+        return 0;
+    }
+    return fseeko(reader->file, (off_t)offset, SEEK_SET);
+}
+
+static int64_t source_tell(zet_reader_t* reader) {
+    return reader->map ? (int64_t)reader->map_pos : (int64_t)ftello(reader->file);
+}
+
+static int64_t source_size(zet_reader_t* reader) {
+    if (reader->map) return (int64_t)reader->map_size;
+    struct stat st;
+    return fstat(fileno(reader->file), &st) == 0 ? (int64_t)st.st_size : -1;
+}
+
+// Read and check the file header
+static int reader_open(zet_reader_t* reader) {
+    if (source_read(reader, &reader->header, sizeof(zet_header_t)) != 0) return -1;
+    if (memcmp(reader->header.magic, "ZET", 3) != 0) return -1;
+    if (reader->header.version < ZET_FORMAT_VERSION_1 || reader->header.version > ZET_FORMAT_VERSION_4) return -1;
+    return 0;
+}
+
+zet_reader_t* zet_reader_create(const char* filename) {
+    return zet_reader_create_ex(filename, NULL);
+}
+
+static zet_reader_t* reader_create_stdio(const char* filename) {
+    zet_reader_t* reader = (zet_reader_t*)calloc(1, sizeof(zet_reader_t));
+    if (!reader) return NULL;
+    reader->watch = -1;
+
+    reader->file = fopen(filename, "rb");
+    if (!reader->file || reader_open(reader) != 0) {
+        zet_reader_destroy(reader);
+        return NULL;
+    }
+    return reader;
+}
+
+zet_reader_t* zet_reader_create_mmap(const char* filename) {
+    zet_reader_options_t options = { .mmap = 1 };
+    return zet_reader_create_ex(filename, &options);
+}
+
+static zet_reader_t* reader_create_mmap(const char* filename) {
+    zet_reader_t* reader = (zet_reader_t*)calloc(1, sizeof(zet_reader_t));
+    if (!reader) return NULL;
+    reader->watch = -1;
+
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(zet_header_t)) {
+        if (fd >= 0) close(fd);
+        free(reader);
+        return NULL;
+    }
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the file open
+    if (map == MAP_FAILED) {
+        free(reader);
+        return NULL;
+    }
+    reader->map = (const uint8_t*)map;
+    reader->map_size = (size_t)st.st_size;
+    madvise(map, reader->map_size, MADV_SEQUENTIAL);
+
+    if (reader_open(reader) != 0) {
+        zet_reader_destroy(reader);
+        return NULL;
+    }
+    return reader;
+}
+
+zet_reader_t* zet_reader_create_ex(const char* filename, const zet_reader_options_t* options) {
+    zet_reader_options_t defaults = {0};
+    if (!options) options = &defaults;
+
+    // A following reader reads through stdio: a mapping would not grow with the file
+    bool mmap = options->mmap && !options->follow;
+    zet_reader_t* reader = mmap ? reader_create_mmap(filename) : reader_create_stdio(filename);
+    if (reader) {
+        reader->threads = options->threads;
+        reader->read_ahead = options->read_ahead;
+        reader->follow = options->follow != 0;
+        reader->watch = options->follow ? zet_io_watch(filename) : -1;
+        reader->follow_timeout_ns = options->follow_timeout_ns;
+    }
+    return reader;
+}
+
+static void reader_stop_pipeline(zet_reader_t* reader);
+
+void zet_reader_destroy(zet_reader_t* reader) {
+    if (reader) {
+        reader_stop_pipeline(reader);
+        if (reader->file) {
+            fclose(reader->file);
+        }
+        if (reader->map) {
+            munmap((void*)reader->map, reader->map_size);
+        }
+        if (reader->watch >= 0) {
+            close(reader->watch);
+        }
+        ZSTD_freeDCtx(reader->zstd);
+        free(reader->chunk);
+        free(reader->packed);
+        free(reader->index);
+        free(reader->index_max_end);
+        free(reader->topic_filters);
+        free((void*)reader->wanted);
+        free(reader->chunk_skip);
+        free(reader->summary_topics);
+        free(reader->scratch);
+        free(reader->record);
+        for (size_t i = 0; reader->refs && i < ZET_DEDUP_PAYLOADS; i++) {
+            free(reader->refs[i].owned);
+        }
+        free(reader->refs);
+        for (size_t i = 0; i < reader->ref_retired_count; i++) {
+            free(reader->ref_retired[i]);
+        }
+        free(reader->ref_retired);
+        free(reader->ref_records);
+        free(reader->ref_packed);
+        topic_table_free(&reader->topics);
+        free(reader);
+    }
+}
+
+// Intern a topic as stored in a record (topic_len bytes, null-terminated)
+static const char* intern_record_topic(zet_reader_t* reader, const uint8_t* topic, uint16_t topic_len) {
+    size_t len = topic_len ? (size_t)topic_len - 1 : 0;
+    topic_slot_t* slot = topic_intern(&reader->topics, (const char*)topic, len, NULL);
+    return slot ? slot->topic : NULL;
+}
+
+static void fill_view(zet_message_view_t* view, const zet_message_header_t* header,
+                      const char* topic, const void* payload) {
+    view->sent_ns = header->sent_ns;
+    view->received_ns = header->received_ns;
+    view->topic = topic;
+    view->data = payload;
+    view->size = header->payload_size;
+}
+
+static int read_view_v1(zet_reader_t* reader, zet_message_view_t* view) {
+    uint8_t raw[ZET_RECORD_HEADER_SIZE];
+    zet_message_header_t header;
+
+    // Read message header; nothing at all is the end of the file
+    if (source_read(reader, raw, sizeof(raw)) != 0) {
+        if (reader->status == ZET_STATUS_TRUNCATED && reader->short_read == 0) reader->status = ZET_STATUS_OK;
+        return -1;
+    }
+    decode_record_header(raw, &header);
+
+    // Read and intern topic. A record cut short is left to be read again.
+    const uint8_t* topic_raw = source_view(reader, header.topic_len, &reader->scratch, &reader->scratch_cap);
+    if (!topic_raw) {
+        source_back(reader, sizeof(raw));
+        return -1;
+    }
+    const char* topic = intern_record_topic(reader, topic_raw, header.topic_len);
+    if (!topic) return reader_stop(reader, ZET_STATUS_ERROR);
+
+    // Read payload
+    const uint8_t* payload = source_view(reader, header.payload_size, &reader->record, &reader->record_cap);
+    if (!payload) {
+        source_back(reader, sizeof(raw) + header.topic_len);
+        return -1;
+    }
+
+    fill_view(view, &header, topic, payload);
+    return 0;
+}
+
+// Whether a compressed chunk's raw_size can be right, checked before
+// allocating for it (LZ4 expands at most 255 times; zstd records the size)
+static bool raw_size_plausible(const zet_chunk_header_t* header, const uint8_t* packed) {
+    if (header->compression == ZET_COMPRESSION_LZ4) return header->raw_size / 255 <= header->data_size;
+    return ZSTD_getFrameContentSize(packed, (size_t)header->data_size) == header->raw_size;
+}
+
+// Decompress a chunk into raw (header->raw_size bytes), creating *zstd if needed
+static int decompress_chunk(ZSTD_DCtx** zstd, const zet_chunk_header_t* header, const uint8_t* packed, uint8_t* raw) {
+    size_t raw_size = (size_t)header->raw_size;
+    if (header->compression == ZET_COMPRESSION_LZ4) {
+        if (header->data_size > LZ4_MAX_INPUT_SIZE || raw_size > INT32_MAX) return -1;
+        int ret = LZ4_decompress_safe((const char*)packed, (char*)raw, (int)header->data_size, (int)raw_size);
+        return ret >= 0 && (size_t)ret == raw_size ? 0 : -1;
+    }
+    if (header->compression == ZET_COMPRESSION_ZSTD) {
+        if (!*zstd && !(*zstd = ZSTD_createDCtx())) return -1;
+        size_t ret = ZSTD_decompressDCtx(*zstd, raw, raw_size, packed, (size_t)header->data_size);
+        return !ZSTD_isError(ret) && ret == raw_size ? 0 : -1;
+    }
+    return -1;
+}
+
+// Register the channels of a channel block body
+static int define_channels(zet_reader_t* reader, const zet_channel_header_t* header, const uint8_t* p) {
+    size_t avail = (size_t)header->data_size;
+    for (uint32_t i = 0; i < header->channel_count; i++) {
+        uint16_t id;
+        uint16_t topic_len;
+        if (avail < 4) return reader_stop(reader, ZET_STATUS_CORRUPT);
+        memcpy(&id, p, sizeof(id));
+        memcpy(&topic_len, p + 2, sizeof(topic_len));
+        if (avail - 4 < topic_len) return reader_stop(reader, ZET_STATUS_CORRUPT);
+
+        const char* topic = intern_record_topic(reader, p + 4, topic_len);
+        if (!topic || topic_set_channel(&reader->topics, id, topic) != 0) return reader_stop(reader, ZET_STATUS_ERROR);
+        p += 4 + topic_len;
+        avail -= 4 + (size_t)topic_len;
+    }
+    return 0;
+}
+
+// Register the channels of a channel block whose header was just read
+static int load_channels(zet_reader_t* reader, const zet_channel_header_t* header) {
+    const uint8_t* p = source_view(reader, header->data_size, &reader->scratch, &reader->scratch_cap);
+    return p ? define_channels(reader, header, p) : -1;
+}
+
+// Read the rest of a block header whose magic was just read
+static int read_block_header(zet_reader_t* reader, void* header, size_t size) {
+    return source_read(reader, (uint8_t*)header + sizeof(uint32_t), size - sizeof(uint32_t));
+}
+
+// Whether a topic is one of those asked for, if any
+static bool topic_wanted(const zet_reader_t* reader, const char* topic) {
+    size_t lo = 0;
+    size_t hi = reader->wanted_count;
+    if (hi == 0) return true;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (reader->wanted[mid] == topic) return true;
+        if ((uintptr_t)reader->wanted[mid] < (uintptr_t)topic) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return false;
+}
+
+// Whether the chunk at offset is on the index and marked to be passed over
+static bool chunk_skipped(const zet_index_entry_t* index, size_t count, const bool* skip, uint64_t offset) {
+    size_t lo = 0;
+    size_t hi = skip ? count : 0;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (index[mid].offset == offset) return skip[mid];
+        if (index[mid].offset < offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return false;
+}
+
+// Load the chunk at the current file position, taking in any channel blocks
+// before it and passing over chunks without the topics asked for (-1 at the
+// index, a torn tail or damage, as the status tells)
+static int load_chunk_here(zet_reader_t* reader) {
+    zet_chunk_header_t header;
+    for (;;) {
+        int64_t offset = source_tell(reader);
+        if (source_read(reader, &header.magic, sizeof(header.magic)) != 0) return -1;
+        if (header.magic == ZET_CHANNEL_MAGIC) {
+            zet_channel_header_t channels = { .magic = header.magic };
+            if (read_block_header(reader, &channels, sizeof(channels)) != 0) return -1;
+            if (load_channels(reader, &channels) != 0) return -1;
+            continue;
+        }
+        if (header.magic == ZET_INDEX_MAGIC) return reader_stop(reader, ZET_STATUS_OK);
+        if (header.magic != ZET_CHUNK_MAGIC) return reader_stop(reader, ZET_STATUS_CORRUPT);
+        if (read_block_header(reader, &header, sizeof(header)) != 0) return -1;
+        if (!chunk_skipped(reader->index, reader->index_count, reader->chunk_skip, (uint64_t)offset)) break;
+        if (source_seek(reader, (uint64_t)offset + sizeof(header) + header.data_size) != 0) return -1;
+    }
+    if (header.compression > ZET_COMPRESSION_ZSTD) return reader_stop(reader, ZET_STATUS_CORRUPT);
+
+    bool packed = header.compression != ZET_COMPRESSION_NONE;
+    const uint8_t* data = packed ? source_view(reader, header.data_size, &reader->packed, &reader->packed_cap)
+                                 : source_view(reader, header.data_size, &reader->chunk, &reader->chunk_cap);
+    if (!data) return -1;
+    if ((reader->header.flags & ZET_FLAG_CHECKSUMS) && chunk_crc(&header, data) != header.crc) {
+        return reader_stop(reader, ZET_STATUS_CORRUPT);
+    }
+
+    if (!packed) {
+        reader->chunk_data = data;
+        reader->chunk_len = header.data_size;
+    } else {
+        if (!raw_size_plausible(&header, data)) return reader_stop(reader, ZET_STATUS_CORRUPT);
+        if (reserve(&reader->chunk, &reader->chunk_cap, header.raw_size) != 0) {
+            return reader_stop(reader, ZET_STATUS_ERROR);
+        }
+        if (decompress_chunk(&reader->zstd, &header, data, reader->chunk) != 0) {
+            return reader_stop(reader, ZET_STATUS_CORRUPT);
+        }
+        reader->chunk_data = reader->chunk;
+        reader->chunk_len = header.raw_size;
+    }
+    reader->chunk_pos = 0;
+    reader->chunk_deltas = (chunk_deltas_t){ 0 };
+    return 0;
+}
+
+// Parallel reading. A read-ahead thread walks the blocks of the file with
+// large sequential reads (or through the mapping) and puts each chunk, with
+// any channel blocks just before it, into the next slot of a ring; worker
+// threads check and decompress slots in parallel, and the reader takes them
+// back in file order. Each slot has a state word stamped with the sequence
+// number of the chunk in it, so a slot is handed on with one atomic store and
+// the ring needs no lock; a thread with nothing to do sleeps on the word it
+// waits for (futex).
+//
+// Anything but a whole, intact chunk ends the pipeline, and the reader reads
+// on from that block by itself: how reading stops, and what reading again
+// does, is the same with threads as without.
+
+#define SLOT_FREE 0              // To be filled with the chunk of its sequence number
+#define SLOT_READ 1              // Filled, to be decoded
+#define SLOT_DONE 2              // Decoded, for the reader
+#define SLOT_STOP 3              // The pipeline is shutting down
+#define SLOT_STATE(seq, phase) ((uint32_t)((seq) << 2) | (phase))
+
+#define PIPELINE_PEEK 64                     // Read past each block, for the next block's header
+#define PIPELINE_ADVISE (16 * 1024 * 1024)   // How far ahead the kernel is asked to read
+
+typedef struct {
+    atomic_uint state;       // SLOT_STATE()
+    uint64_t offset;         // File offset of the first block in the slot
+    uint64_t next;           // ...and of the block after the chunk
+    bool end;                // No whole chunk: the reader takes over at offset
+    bool failed;             // Damaged, or out of memory: likewise
+    zet_chunk_header_t header;
+    uint8_t* channels;       // Channel blocks before the chunk, headers included
+    size_t channels_len;
+    size_t channels_cap;
+    const uint8_t* data;     // The chunk as stored: in buf, or in the mapping
+    uint8_t* buf;
+    size_t buf_cap;
+    const uint8_t* records;  // ...and its records: data, or unpacked
+    size_t records_len;
+    uint8_t* unpacked;
+    size_t unpacked_cap;
+} read_slot_t;
+
+struct read_pipeline_s {
+    int fd;                  // Read with pread(), which leaves the stream position alone
+    const uint8_t* map;
+    uint64_t size;           // File size, refreshed when a block seems to run past it
+    bool checksums;
+    uint64_t start;
+    const zet_index_entry_t* index; // Chunks to pass over, a copy of reader->chunk_skip
+    size_t index_count;
+    bool* skip;
+    read_slot_t* slots;
+    uint32_t depth;
+    pthread_t read_thread;
+    bool read_started;
+    pthread_t* workers;
+    uint32_t worker_count;
+    atomic_uint_fast64_t next_decode; // Sequence number the next idle worker takes
+    uint64_t next_take;      // ...and the reader (reader thread only)
+    bool holding;            // The reader is still using slot next_take - 1
+};
+
+// Hand a slot on, unless the pipeline is stopping
+static void slot_publish(read_slot_t* slot, uint32_t state) {
+    unsigned int now = atomic_load_explicit(&slot->state, memory_order_relaxed);
+    while ((now & 3) != SLOT_STOP &&
+           !atomic_compare_exchange_weak_explicit(&slot->state, &now, state, memory_order_release,
+                                                  memory_order_relaxed)) {
+    }
+    syscall(SYS_futex, &slot->state, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+// Wait for a slot to reach a state. False if the pipeline is stopping.
+static bool slot_wait(read_slot_t* slot, uint32_t state) {
+    for (;;) {
+        unsigned int now = atomic_load_explicit(&slot->state, memory_order_acquire);
+        if (now == state) return true;
+        if ((now & 3) == SLOT_STOP) return false;
+        syscall(SYS_futex, &slot->state, FUTEX_WAIT_PRIVATE, now, NULL, NULL, 0);
+    }
+}
+
+// The read-ahead thread's position in the file
+typedef struct {
+    uint64_t pos;
+    uint8_t peek[PIPELINE_PEEK]; // File bytes from pos on, already read
+    size_t peek_len;
+    uint64_t advised;        // Read-ahead asked for up to here
+} ahead_t;
+
+// Whether len bytes at the position can be in the file
+static bool ahead_fits(read_pipeline_t* p, const ahead_t* a, uint64_t len) {
+    if (a->pos <= p->size && len <= p->size - a->pos) return true;
+    struct stat st;
+    if (p->map || fstat(p->fd, &st) != 0) return false;
+    p->size = (uint64_t)st.st_size;
+    return a->pos <= p->size && len <= p->size - a->pos;
+}
+
+// Keep the kernel reading PIPELINE_ADVISE bytes ahead of the position, unless
+// chunks are being passed over, which that would fetch
+static void ahead_advise(read_pipeline_t* p, ahead_t* a, uint64_t len) {
+    if (p->skip || a->pos + len + PIPELINE_ADVISE / 2 <= a->advised) return;
+    uint64_t from = a->advised > a->pos ? a->advised : a->pos;
+    uint64_t to = a->pos + len + PIPELINE_ADVISE;
+    if (p->map) {
+        uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+        from &= ~(page - 1);
+        if (from < p->size) madvise((void*)(p->map + from), (size_t)((to < p->size ? to : p->size) - from), MADV_WILLNEED);
+    } else {
+        posix_fadvise(p->fd, (off_t)from, (off_t)(to - from), POSIX_FADV_WILLNEED);
+    }
+    a->advised = to;
+}
+
+// Read len bytes at the position. Through a file, the same read fetches the
+// next block's header into peek.
+static int ahead_read(read_pipeline_t* p, ahead_t* a, uint8_t* dst, size_t len) {
+    if (!ahead_fits(p, a, len)) return -1;
+    ahead_advise(p, a, len);
+    if (p->map) {
+        memcpy(dst, p->map + a->pos, len);
+        a->pos += len;
+        return 0;
+    }
+
+    size_t have = a->peek_len < len ? a->peek_len : len;
+    memcpy(dst, a->peek, have);
+    memmove(a->peek, a->peek + have, a->peek_len - have);
+    a->peek_len -= have;
+    while (have < len) {
+        struct iovec iov[2] = { { dst + have, len - have }, { a->peek, PIPELINE_PEEK } };
+        ssize_t got = preadv(p->fd, iov, 2, (off_t)(a->pos + have));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return -1;
+        if ((size_t)got > len - have) {
+            a->peek_len = (size_t)got - (len - have);
+            have = len;
+        } else {
+            have += (size_t)got;
+        }
+    }
+    a->pos += len;
+    return 0;
+}
+
+// Move the position past len bytes without reading them
+static void ahead_skip(ahead_t* a, uint64_t len) {
+    if (len < a->peek_len) {
+        memmove(a->peek, a->peek + len, a->peek_len - (size_t)len);
+        a->peek_len -= (size_t)len;
+    } else {
+        a->peek_len = 0;
+    }
+    a->pos += len;
+}
+
+// len bytes at the position: in the mapping, or read into *buf
+static const uint8_t* ahead_view(read_pipeline_t* p, ahead_t* a, uint64_t len, uint8_t** buf, size_t* cap) {
+    if (p->map) {
+        if (!ahead_fits(p, a, len)) return NULL;
+        ahead_advise(p, a, len);
+        const uint8_t* data = p->map + a->pos;
+        a->pos += len;
+        return data;
+    }
+    if (!ahead_fits(p, a, len) || reserve(buf, cap, len ? len : 1) != 0) return NULL;
+    return ahead_read(p, a, *buf, (size_t)len) == 0 ? *buf : NULL;
+}
+
+// Read the next chunk not passed over, and the channel blocks before it, into
+// a slot. False at anything else: the index, the end of the file, a read
+// error or damage.
+static bool fill_slot(read_pipeline_t* p, ahead_t* a, read_slot_t* slot) {
+    slot->offset = a->pos;
+    slot->channels_len = 0;
+    zet_chunk_header_t header;
+    for (;;) {
+        uint64_t offset = a->pos;
+        if (ahead_read(p, a, (uint8_t*)&header.magic, sizeof(header.magic)) != 0) return false;
+        if (header.magic == ZET_CHUNK_MAGIC) {
+            if (ahead_read(p, a, (uint8_t*)&header + sizeof(header.magic), sizeof(header) - sizeof(header.magic)) != 0) {
+                return false;
+            }
+            if (!chunk_skipped(p->index, p->index_count, p->skip, offset)) break;
+            ahead_skip(a, header.data_size);
+            continue;
+        }
+        if (header.magic != ZET_CHANNEL_MAGIC) return false;
+        zet_channel_header_t channels = { .magic = header.magic };
+        if (ahead_read(p, a, (uint8_t*)&channels + sizeof(channels.magic), sizeof(channels) - sizeof(channels.magic)) != 0 ||
+            !ahead_fits(p, a, channels.data_size)) {
+            return false;
+        }
+        size_t len = slot->channels_len + sizeof(channels) + (size_t)channels.data_size;
+        if (reserve(&slot->channels, &slot->channels_cap, len) != 0) return false;
+        memcpy(slot->channels + slot->channels_len, &channels, sizeof(channels));
+        if (ahead_read(p, a, slot->channels + slot->channels_len + sizeof(channels), (size_t)channels.data_size) != 0) {
+            return false;
+        }
+        slot->channels_len = len;
+    }
+    slot->header = header;
+    slot->data = ahead_view(p, a, header.data_size, &slot->buf, &slot->buf_cap);
+    slot->next = a->pos;
+    return slot->data != NULL;
+}
+
+static void* pipeline_read_ahead(void* arg) {
+    read_pipeline_t* p = (read_pipeline_t*)arg;
+    ahead_t a = { .pos = p->start, .advised = p->start };
+    if (!p->map) posix_fadvise(p->fd, (off_t)p->start, 0, POSIX_FADV_SEQUENTIAL);
+    for (uint64_t seq = 0;; seq++) {
+        read_slot_t* slot = &p->slots[seq % p->depth];
+        if (!slot_wait(slot, SLOT_STATE(seq, SLOT_FREE))) break;
+        slot->end = !fill_slot(p, &a, slot);
+        slot_publish(slot, SLOT_STATE(seq, SLOT_READ));
+        if (slot->end) break;
+    }
+    return NULL;
+}
+
+// Check and decompress a slot's chunk, as load_chunk_here() does
+static void decode_slot(read_pipeline_t* p, read_slot_t* slot, ZSTD_DCtx** zstd) {
+    const zet_chunk_header_t* header = &slot->header;
+    slot->failed = true;
+    if (header->compression > ZET_COMPRESSION_ZSTD) return;
+    if (p->checksums && chunk_crc(header, slot->data) != header->crc) return;
+    if (header->compression == ZET_COMPRESSION_NONE) {
+        slot->records = slot->data;
+        slot->records_len = (size_t)header->data_size;
+    } else {
+        if (!raw_size_plausible(header, slot->data) ||
+            reserve(&slot->unpacked, &slot->unpacked_cap, header->raw_size) != 0 ||
+            decompress_chunk(zstd, header, slot->data, slot->unpacked) != 0) {
+            return;
+        }
+        slot->records = slot->unpacked;
+        slot->records_len = (size_t)header->raw_size;
+    }
+    slot->failed = false;
+}
+
+static void* pipeline_decode(void* arg) {
+    read_pipeline_t* p = (read_pipeline_t*)arg;
+    ZSTD_DCtx* zstd = NULL;
+    for (;;) {
+        uint64_t seq = atomic_fetch_add(&p->next_decode, 1);
+        read_slot_t* slot = &p->slots[seq % p->depth];
+        if (!slot_wait(slot, SLOT_STATE(seq, SLOT_READ))) break;
+        if (!slot->end) decode_slot(p, slot, &zstd);
+        slot_publish(slot, SLOT_STATE(seq, SLOT_DONE));
+    }
+    ZSTD_freeDCtx(zstd);
+    return NULL;
+}
+
+static void pipeline_stop(read_pipeline_t* p) {
+    for (uint32_t i = 0; i < p->depth; i++) {
+        atomic_store(&p->slots[i].state, SLOT_STOP);
+        syscall(SYS_futex, &p->slots[i].state, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+    }
+    if (p->read_started) pthread_join(p->read_thread, NULL);
+    for (uint32_t i = 0; i < p->worker_count; i++) {
+        pthread_join(p->workers[i], NULL);
+    }
+    for (uint32_t i = 0; i < p->depth; i++) {
+        free(p->slots[i].channels);
+        free(p->slots[i].buf);
+        free(p->slots[i].unpacked);
+    }
+    free(p->slots);
+    free(p->workers);
+    free(p->skip);
+    free(p);
+}
+
+// Start reading ahead from offset. NULL if threads cannot be had.
+static read_pipeline_t* pipeline_start(zet_reader_t* reader, uint64_t offset) {
+    read_pipeline_t* p = (read_pipeline_t*)calloc(1, sizeof(read_pipeline_t));
+    if (!p) return NULL;
+    p->fd = reader->map ? -1 : fileno(reader->file);
+    p->map = reader->map;
+    p->size = reader->map ? reader->map_size : 0;
+    p->checksums = (reader->header.flags & ZET_FLAG_CHECKSUMS) != 0;
+    p->start = offset;
+    p->depth = reader->read_ahead ? reader->read_ahead : reader->threads * 2 + 2;
+    if (p->depth < 2) p->depth = 2;
+    atomic_init(&p->next_decode, 0);
+    if (reader->chunk_skip && (p->skip = (bool*)malloc(reader->index_count * sizeof(bool)))) {
+        memcpy(p->skip, reader->chunk_skip, reader->index_count * sizeof(bool));
+        p->index = reader->index;
+        p->index_count = reader->index_count;
+    }
+
+    p->slots = (read_slot_t*)calloc(p->depth, sizeof(read_slot_t));
+    p->workers = (pthread_t*)calloc(reader->threads, sizeof(pthread_t));
+    if (!p->slots || !p->workers || (reader->chunk_skip && !p->skip)) {
+        free(p->slots);
+        free(p->workers);
+        free(p->skip);
+        free(p);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < p->depth; i++) {
+        atomic_init(&p->slots[i].state, SLOT_STATE(i, SLOT_FREE));
+    }
+    for (; p->worker_count < reader->threads; p->worker_count++) {
+        if (pthread_create(&p->workers[p->worker_count], NULL, pipeline_decode, p) != 0) break;
+    }
+    p->read_started = p->worker_count > 0 && pthread_create(&p->read_thread, NULL, pipeline_read_ahead, p) == 0;
+    if (!p->read_started) {
+        pipeline_stop(p);
+        return NULL;
+    }
+    return p;
+}
+
+// Take the next chunk from the pipeline. -1 where the pipeline stopped: the
+// reader is then positioned at that block.
+static int pipeline_take(zet_reader_t* reader) {
+    read_pipeline_t* p = reader->pipeline;
+    if (p->holding) {
+        uint64_t seq = p->next_take - 1;
+        slot_publish(&p->slots[seq % p->depth], SLOT_STATE(seq + p->depth, SLOT_FREE));
+        p->holding = false;
+    }
+    read_slot_t* slot = &p->slots[p->next_take % p->depth];
+    slot_wait(slot, SLOT_STATE(p->next_take, SLOT_DONE));
+    if (slot->end || slot->failed) return -1;
+
+    for (size_t pos = 0; pos < slot->channels_len;) {
+        zet_channel_header_t channels;
+        memcpy(&channels, slot->channels + pos, sizeof(channels));
+        if (define_channels(reader, &channels, slot->channels + pos + sizeof(channels)) != 0) return -1;
+        pos += sizeof(channels) + (size_t)channels.data_size;
+    }
+    p->next_take++;
+    p->holding = true;
+    reader->chunk_data = slot->records;
+    reader->chunk_len = slot->records_len;
+    reader->chunk_pos = 0;
+    reader->chunk_deltas = (chunk_deltas_t){ 0 };
+    return source_seek(reader, slot->next);
+}
+
+static void reader_stop_pipeline(zet_reader_t* reader) {
+    if (!reader->pipeline) return;
+    pipeline_stop(reader->pipeline);
+    reader->pipeline = NULL;
+    reader->pipeline_stale = false;
+    reader->chunk_data = NULL;
+    reader->chunk_len = 0;
+    reader->chunk_pos = 0;
+    reader->chunk_deltas = (chunk_deltas_t){ 0 };
+}
+
+static int load_chunk(zet_reader_t* reader) {
+    if (reader->pipeline_stale) reader_stop_pipeline(reader);
+    int64_t start = source_tell(reader);
+    if (reader->threads > 0 && start >= 0 && (uint64_t)start != reader->pipeline_end) {
+        if (!reader->pipeline) reader->pipeline = pipeline_start(reader, (uint64_t)start);
+        if (reader->pipeline) {
+            if (pipeline_take(reader) == 0) return 0;
+            // The end, damage, or a chunk still being written: read it as without threads
+            reader_stop_pipeline(reader);
+            reader->pipeline_end = (uint64_t)start;
+        }
+    }
+    if (load_chunk_here(reader) == 0) return 0;
+    // Stay where reading stopped, so reading again stops the same way
+    if (start >= 0) source_seek(reader, (uint64_t)start);
+    return -1;
+}
+
+// Next record of a chunked (version 2 and later) file
+static int read_view_chunked(zet_reader_t* reader, zet_message_view_t* view) {
+    while (reader->chunk_pos == reader->chunk_len) {
+        if (load_chunk(reader) != 0) return -1;
+    }
+
+    const uint8_t* p = reader->chunk_data + reader->chunk_pos;
+    size_t avail = reader->chunk_len - reader->chunk_pos;
+    zet_message_header_t header;
+    size_t head_len = decode_chunk_record(p, avail, reader->header.version, &reader->chunk_deltas, &header);
+    if (head_len == 0) return reader_stop(reader, ZET_STATUS_CORRUPT);
+
+    // Version 3 records hold a channel ID in place of the topic
+    bool channels = reader->header.version >= ZET_FORMAT_VERSION_3;
+    size_t topic_size = channels ? 0 : header.topic_len;
+    size_t stored = record_stored_size(&header, reader->header.flags);
+    if (avail - head_len < topic_size + stored) {
+        return reader_stop(reader, ZET_STATUS_CORRUPT);
+    }
+
+    const char* topic = channels ? topic_channel(&reader->topics, header.topic_len)
+                                 : intern_record_topic(reader, p + head_len, header.topic_len);
+    if (!topic) return reader_stop(reader, channels ? ZET_STATUS_CORRUPT : ZET_STATUS_ERROR);
+    reader->chunk_pos += head_len + topic_size + stored;
+    reader->view_channel = header.topic_len;
+
+    // A reference is resolved only once the message is known to be wanted
+    const uint8_t* payload = p + head_len + topic_size;
+    reader->view_ref = record_is_ref(&header, reader->header.flags) ? payload : NULL;
+    header.payload_size = record_payload_size(&header, reader->header.flags);
+    fill_view(view, &header, topic, payload);
+    return 0;
+}
+
+// Whether a message is still before the time of the last seek
+static bool skip_message(zet_reader_t* reader, uint64_t received_ns) {
+    if (!reader->skipping) return false;
+    if (received_ns < reader->skip_before_ns) return true;
+    reader->skipping = false;
+    return false;
+}
+
+// Following: after reading stopped at the end of what has been written so
+// far, wait for the writer to add more. Reads that stop there leave the file
+// position at the start of the record or chunk cut off, so reading again
+// takes it whole. *deadline starts at 0 and is set by the first wait of a
+// read. Returns 0 to read again, -1 to stop: not following, at the real end
+// or damage, or with ZET_STATUS_PENDING after a timeout or a signal.
+static int follow_wait(zet_reader_t* reader, uint64_t* deadline) {
+    if (!reader->follow) return -1;
+    // A version 1 file ends cleanly after any record, so that is no end either
+    bool v1 = reader->header.version == ZET_FORMAT_VERSION_1;
+    if (reader->status != ZET_STATUS_TRUNCATED && !(v1 && reader->status == ZET_STATUS_OK)) return -1;
+
+    uint64_t timeout = 0;
+    if (reader->follow_timeout_ns) {
+        uint64_t now = zeta_clock_monotonic_ns();
+        if (*deadline == 0) *deadline = now + reader->follow_timeout_ns;
+        if (now >= *deadline) return reader_stop(reader, ZET_STATUS_PENDING);
+        timeout = *deadline - now;
+    }
+    if (zet_io_watch_wait(reader->watch, timeout) != 0) return reader_stop(reader, ZET_STATUS_PENDING);
+    reader->status = ZET_STATUS_OK;
+    reader->short_read = 0;
+    return 0;
+}
+
+static int resolve_view(zet_reader_t* reader, zet_message_view_t* view);
+static void release_refs(zet_reader_t* reader);
+
+// Next message after the seek time on a topic asked for. With in_chunk set,
+// 1 at the end of the current chunk rather than load the next one.
+static int next_view(zet_reader_t* reader, zet_message_view_t* view, bool in_chunk) {
+    uint64_t deadline = 0;
+    for (;;) {
+        if (in_chunk && reader->chunk_pos == reader->chunk_len) return 1;
+        int ret = reader->header.version == ZET_FORMAT_VERSION_1 ? read_view_v1(reader, view)
+                                                                 : read_view_chunked(reader, view);
+        if (ret < 0 && follow_wait(reader, &deadline) == 0) continue;
+        if (ret != 0) return ret;
+        if (!skip_message(reader, view->received_ns) && topic_wanted(reader, view->topic)) {
+            return reader->view_ref ? resolve_view(reader, view) : 0;
+        }
+    }
+}
+
+int zet_reader_read_view(zet_reader_t* reader, zet_message_view_t* view) {
+    if (!reader || !view) return -1;
+    release_refs(reader);
+    return next_view(reader, view, false);
+}
+
+// Version 1 batch through stdio: one large read, cut into whole records. The
+// reader is put back after the last record taken, so a record cut off at the
+// end of the block starts the next batch.
+static size_t read_views_v1(zet_reader_t* reader, zet_message_view_t* views, size_t max) {
+    size_t n = 0;
+    while (n == 0) {
+        int64_t offset = source_tell(reader);
+        if (offset < 0 || reserve(&reader->record, &reader->record_cap, BATCH_READ_SIZE) != 0) return 0;
+        size_t len = fread(reader->record, 1, BATCH_READ_SIZE, reader->file);
+        size_t pos = 0;
+
+        while (n < max && len - pos >= ZET_RECORD_HEADER_SIZE) {
+            zet_message_header_t header;
+            decode_record_header(reader->record + pos, &header);
+            size_t size = ZET_RECORD_HEADER_SIZE + header.topic_len + (size_t)header.payload_size;
+            if (len - pos < size) {
+                if (pos > 0) break;
+                // A record larger than a whole block: read the rest of it,
+                // unless it runs past the end of the file
+                int64_t left = source_remaining(reader);
+                if (left < 0 || size - len > (uint64_t)left) {
+                    reader_stop(reader, ZET_STATUS_TRUNCATED);
+                    break;
+                }
+                if (reserve(&reader->record, &reader->record_cap, size) != 0) {
+                    reader_stop(reader, ZET_STATUS_ERROR);
+                    return 0;
+                }
+                len += fread(reader->record + len, 1, size - len, reader->file);
+                if (len < size) {
+                    source_short(reader, len);
+                    break;
+                }
+            }
+
+            const uint8_t* p = reader->record + pos;
+            if (!skip_message(reader, header.received_ns)) {
+                const char* topic = intern_record_topic(reader, p + ZET_RECORD_HEADER_SIZE, header.topic_len);
+                if (!topic) {
+                    reader_stop(reader, ZET_STATUS_ERROR);
+                    break;
+                }
+                if (topic_wanted(reader, topic)) {
+                    fill_view(&views[n++], &header, topic, p + ZET_RECORD_HEADER_SIZE + header.topic_len);
+                }
+            }
+            pos += size;
+        }
+
+        if (source_seek(reader, (uint64_t)offset + pos) != 0) return n;
+        if (pos == 0) {
+            // End of file, a torn tail or an error
+            if (len == 0) {
+                reader_stop(reader, ferror(reader->file) ? ZET_STATUS_ERROR : ZET_STATUS_OK);
+            } else if (len < ZET_RECORD_HEADER_SIZE) {
+                reader_stop(reader, ZET_STATUS_TRUNCATED);
+            }
+            break;
+        }
+    }
+    return n;
+}
+
+// Whether the current chunk's records are in the mapping, rather than in a
+// buffer the next chunk may reuse
+static bool chunk_mapped(const zet_reader_t* reader) {
+    return reader->map && reader->chunk_data >= reader->map && reader->chunk_data < reader->map + reader->map_size;
+}
+
+size_t zet_reader_read_views(zet_reader_t* reader, zet_message_view_t* views, size_t max) {
+    if (!reader || !views) return 0;
+    release_refs(reader);
+    if (reader->header.version == ZET_FORMAT_VERSION_1 && !reader->map) {
+        uint64_t deadline = 0;
+        size_t n;
+        while ((n = read_views_v1(reader, views, max)) == 0 && follow_wait(reader, &deadline) == 0) {
+        }
+        return n;
+    }
+
+    // Mapped version 1 records stay put; chunked records can be taken until
+    // the next chunk would replace the buffer holding them
+    size_t n = 0;
+    while (n < max) {
+        bool in_chunk = n > 0 && reader->header.version != ZET_FORMAT_VERSION_1 && !chunk_mapped(reader);
+        if (next_view(reader, &views[n], in_chunk) != 0) break;
+        n++;
+    }
+    return n;
+}
+
+// Copy a view into msg->data, which holds *capacity bytes, reallocating it if
+// the payload does not fit
+static int copy_view(const zet_message_view_t* view, zet_message_t* msg, size_t* capacity) {
+    if (!msg->data || view->size > *capacity) {
+        size_t grown = view->size > *capacity * 2 ? view->size : *capacity * 2;
+        void* data = realloc(msg->data, grown ? grown : 1);
+        if (!data) return -1;
+        msg->data = data;
+        *capacity = grown;
+    }
+    memcpy(msg->data, view->data, view->size);
+
+    msg->sent_ns = view->sent_ns;
+    msg->received_ns = view->received_ns;
+    msg->topic = view->topic;
+    msg->size = view->size;
+    return 0;
+}
+
+int zet_reader_read_message(zet_reader_t* reader, zet_message_t* msg) {
+    if (!msg) return -1;
+
+    zet_message_view_t view;
+    if (zet_reader_read_view(reader, &view) != 0) return -1;
+
+    size_t capacity = 0;
+    msg->data = NULL;
+    return copy_view(&view, msg, &capacity);
+}
+
+int zet_reader_read_message_into(zet_reader_t* reader, zet_message_t* msg, size_t* capacity) {
+    if (!msg || !capacity) return -1;
+
+    zet_message_view_t view;
+    if (zet_reader_read_view(reader, &view) != 0) return -1;
+    return copy_view(&view, msg, capacity);
+}
+
+void zet_message_free(zet_message_t* msg) {
+    if (msg) {
+        free(msg->data); // The topic belongs to the reader
+        msg->topic = NULL;
+        msg->data = NULL;
+        msg->size = 0;
+    }
+}
+
+uint64_t zet_reader_get_start_time(zet_reader_t* reader) {
+    return reader ? reader->header.start_time_ns : 0;
+}
+
+uint32_t zet_reader_get_version(zet_reader_t* reader) {
+    return reader ? reader->header.version : 0;
+}
+
+int zet_reader_get_status(zet_reader_t* reader) {
+    return reader ? reader->status : ZET_STATUS_ERROR;
+}
+
+// Read the summary block named by the footer
+static int load_summary(zet_reader_t* reader) {
+    zet_footer_t footer;
+    zet_summary_header_t header;
+    int64_t size = source_size(reader);
+    if (size < (int64_t)(sizeof(zet_header_t) + sizeof(footer))) return -1;
+    uint64_t footer_offset = (uint64_t)size - sizeof(footer);
+    if (source_seek(reader, footer_offset) != 0) return -1;
+    if (source_read(reader, &footer, sizeof(footer)) != 0 || footer.magic != ZET_FOOTER_MAGIC) return -1;
+    if (footer.summary_size < sizeof(header) || footer.summary_size > footer_offset - sizeof(zet_header_t)) return -1;
+    if (source_seek(reader, footer_offset - footer.summary_size) != 0) return -1;
+    if (source_read(reader, &header, sizeof(header)) != 0 || header.magic != ZET_SUMMARY_MAGIC ||
+        header.data_size != footer.summary_size - sizeof(header)) {
+        return -1;
+    }
+    const uint8_t* p = source_view(reader, header.data_size, &reader->scratch, &reader->scratch_cap);
+    if (!p) return -1;
+
+    size_t avail = (size_t)header.data_size;
+    if (header.topic_count > avail / sizeof(zet_summary_entry_t)) return -1;
+    zet_topic_summary_t* topics = (zet_topic_summary_t*)calloc(header.topic_count ? header.topic_count : 1,
+                                                               sizeof(zet_topic_summary_t));
+    if (!topics) return -1;
+    zet_summary_t summary = { .start_ns = header.start_ns, .end_ns = header.end_ns, .topics = topics };
+    for (uint32_t i = 0; i < header.topic_count; i++) {
+        zet_summary_entry_t entry;
+        if (avail < sizeof(entry)) goto fail;
+        memcpy(&entry, p, sizeof(entry));
+        if (entry.topic_len == 0 || avail - sizeof(entry) < entry.topic_len ||
+            p[sizeof(entry) + entry.topic_len - 1] != '\0') {
+            goto fail;
+        }
+        const char* topic = intern_record_topic(reader, p + sizeof(entry), entry.topic_len);
+        if (!topic) goto fail;
+        topics[i] = (zet_topic_summary_t){
+            .topic = topic,
+            .message_count = entry.message_count,
+            .payload_bytes = entry.payload_bytes,
+            .first_ns = entry.first_ns,
+            .last_ns = entry.last_ns,
+            .min_size = entry.min_size,
+            .max_size = entry.max_size,
+            .mean_size = entry.message_count ? (double)entry.payload_bytes / (double)entry.message_count : 0.0
+        };
+        summary.message_count += entry.message_count;
+        summary.payload_bytes += entry.payload_bytes;
+        p += sizeof(entry) + entry.topic_len;
+        avail -= sizeof(entry) + entry.topic_len;
+    }
+    summary.topic_count = header.topic_count;
+    reader->summary = summary;
+    reader->summary_topics = topics;
+    return 0;
+
+fail:
+    free(topics);
+    return -1;
+}
+
+int zet_reader_get_summary(zet_reader_t* reader, zet_summary_t* summary) {
+    if (!reader || !summary || reader->header.version < ZET_FORMAT_VERSION_2) return -1;
+    if (!reader->summary_loaded) {
+        // Put the reader back where it was, stopped or not
+        int64_t pos = source_tell(reader);
+        int status = reader->status;
+        size_t short_read = reader->short_read;
+        int ret = pos >= 0 ? load_summary(reader) : -1;
+        if (pos < 0 || source_seek(reader, (uint64_t)pos) != 0) return -1;
+        reader->status = status;
+        reader->short_read = short_read;
+        if (ret != 0) return -1;
+        reader->summary_loaded = true;
+    }
+    *summary = reader->summary;
+    return 0;
+}
+
+// Seeking
+
+// Read the index the writer left at the end of the file
+static int load_index_from_footer(zet_reader_t* reader) {
+    zet_footer_t footer;
+    zet_index_header_t header;
+    int64_t size = source_size(reader);
+    if (size < (int64_t)(sizeof(zet_header_t) + sizeof(footer))) return -1;
+    if (source_seek(reader, (uint64_t)size - sizeof(footer)) != 0) return -1;
+    if (source_read(reader, &footer, sizeof(footer)) != 0 || footer.magic != ZET_FOOTER_MAGIC) return -1;
+    if (source_seek(reader, footer.index_offset) != 0) return -1;
+    if (source_read(reader, &header, sizeof(header)) != 0 || header.magic != ZET_INDEX_MAGIC) return -1;
+
+    zet_index_entry_t* index = (zet_index_entry_t*)malloc((header.chunk_count ? header.chunk_count : 1) *
+                                                          sizeof(zet_index_entry_t));
+    if (!index) return -1;
+    if (source_read(reader, index, header.chunk_count * sizeof(zet_index_entry_t)) != 0) {
+        free(index);
+        return -1;
+    }
+    reader->index = index;
+    reader->index_count = header.chunk_count;
+    reader->data_end = footer.index_offset;
+
+    // Topic filters, from writers that leave them (the footer follows in any case)
+    zet_topic_filter_header_t filters;
+    if (source_read(reader, &filters, sizeof(filters)) == 0 && filters.magic == ZET_TOPIC_FILTER_MAGIC &&
+        filters.filter_size > 0 && filters.filter_size <= TOPIC_FILTER_MAX_SIZE && filters.data_size == (uint64_t)header.chunk_count * filters.filter_size &&
+        source_remaining(reader) >= (int64_t)filters.data_size) {
+        reader->topic_filters = (uint8_t*)malloc(filters.data_size ? (size_t)filters.data_size : 1);
+        if (!reader->topic_filters || source_read(reader, reader->topic_filters, (size_t)filters.data_size) != 0) {
+            return -1;
+        }
+        reader->topic_filter_size = filters.filter_size;
+    }
+
+    // Every channel, for chunks reached without passing their channel blocks
+    if (reader->header.version >= ZET_FORMAT_VERSION_3) {
+        zet_channel_header_t channels;
+        if (source_seek(reader, footer.channel_offset) != 0) return -1;
+        if (source_read(reader, &channels, sizeof(channels)) != 0 || channels.magic != ZET_CHANNEL_MAGIC) return -1;
+        if (load_channels(reader, &channels) != 0) return -1;
+    }
+    return 0;
+}
+
+// Rebuild the index of a file without a footer by hopping from chunk header to
+// chunk header. A torn last chunk is left out.
+static int load_index_by_walking(zet_reader_t* reader) {
+    uint64_t offset = sizeof(zet_header_t);
+    int64_t size = source_size(reader);
+    if (size < 0) return -1;
+    uint64_t end = (uint64_t)size;
+
+    size_t cap = 0;
+    for (;;) {
+        zet_chunk_header_t header;
+        if (source_seek(reader, offset) != 0) break;
+        if (source_read(reader, &header.magic, sizeof(header.magic)) != 0) break;
+
+        // Channel blocks are read on the way
+        if (header.magic == ZET_CHANNEL_MAGIC) {
+            zet_channel_header_t channels = { .magic = header.magic };
+            if (read_block_header(reader, &channels, sizeof(channels)) != 0) break;
+            uint64_t next = offset + sizeof(channels) + channels.data_size;
+            if (next > end || next < offset || load_channels(reader, &channels) != 0) break;
+            offset = next;
+            continue;
+        }
+
+        if (header.magic != ZET_CHUNK_MAGIC || read_block_header(reader, &header, sizeof(header)) != 0) break;
+        uint64_t next = offset + sizeof(header) + header.data_size;
+        if (next > end || next < offset) break;
+
+        if (reader->index_count == cap) {
+            cap = cap ? cap * 2 : 256;
+            zet_index_entry_t* index = (zet_index_entry_t*)realloc(reader->index, cap * sizeof(zet_index_entry_t));
+            if (!index) return -1;
+            reader->index = index;
+        }
+        reader->index[reader->index_count++] = (zet_index_entry_t){
+            .offset = offset,
+            .start_ns = header.start_ns,
+            .end_ns = header.end_ns,
+            .message_count = header.message_count,
+            .reserved = 0
+        };
+        offset = next;
+    }
+    reader->data_end = offset;
+    return 0;
+}
+
+static int load_index(zet_reader_t* reader) {
+    if (reader->index_loaded) return 0;
+    if (load_index_from_footer(reader) != 0) {
+        free(reader->index);
+        free(reader->topic_filters);
+        reader->index = NULL;
+        reader->topic_filters = NULL;
+        reader->index_count = 0;
+        if (load_index_by_walking(reader) != 0) return -1;
+    }
+
+    reader->index_max_end = (uint64_t*)malloc((reader->index_count ? reader->index_count : 1) * sizeof(uint64_t));
+    if (!reader->index_max_end) return -1;
+    for (size_t i = 0; i < reader->index_count; i++) {
+        uint64_t end = reader->index[i].end_ns;
+        uint64_t prev = i > 0 ? reader->index_max_end[i - 1] : 0;
+        reader->index_max_end[i] = prev > end ? prev : end;
+    }
+    reader->index_loaded = true;
+    return 0;
+}
+
+// Load the index without disturbing reading: loading moves the read position
+// and may note a short read, so both are put back
+static int load_index_in_place(zet_reader_t* reader) {
+    int64_t pos = source_tell(reader);
+    int status = reader->status;
+    size_t short_read = reader->short_read;
+    int ret = load_index(reader);
+    reader->status = status;
+    reader->short_read = short_read;
+    if (pos < 0 || source_seek(reader, (uint64_t)pos) != 0) ret = -1;
+    return ret;
+}
+
+static int compare_address(const void* a, const void* b) {
+    uintptr_t x = (uintptr_t)*(const char* const*)a;
+    uintptr_t y = (uintptr_t)*(const char* const*)b;
+    return x < y ? -1 : x > y;
+}
+
+int zet_reader_set_topics(zet_reader_t* reader, const char* const* topics, size_t count) {
+    if (!reader || (count > 0 && !topics)) return -1;
+    free((void*)reader->wanted);
+    free(reader->chunk_skip);
+    reader->wanted = NULL;
+    reader->wanted_count = 0;
+    reader->chunk_skip = NULL;
+    reader->pipeline_stale = reader->pipeline != NULL;
+    if (count == 0) return 0;
+
+    // The reader's own copies, which its messages point to
+    const char** wanted = (const char**)malloc(count * sizeof(const char*));
+    uint32_t* hashes = (uint32_t*)malloc(count * sizeof(uint32_t));
+    if (!wanted || !hashes) {
+        free((void*)wanted);
+        free(hashes);
+        return -1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        topic_slot_t* slot = topics[i] ? topic_intern(&reader->topics, topics[i], strlen(topics[i]), NULL) : NULL;
+        if (!slot) {
+            free((void*)wanted);
+            free(hashes);
+            return -1;
+        }
+        wanted[i] = slot->topic;
+        hashes[i] = slot->hash;
+    }
+    qsort((void*)wanted, count, sizeof(const char*), compare_address);
+    reader->wanted = wanted;
+    reader->wanted_count = count;
+
+    // Chunks to pass over, from the topic filters
+    if (reader->header.version != ZET_FORMAT_VERSION_1) {
+        int ret = load_index_in_place(reader);
+        if (ret == 0 && reader->topic_filters &&
+            (reader->chunk_skip = (bool*)malloc((reader->index_count ? reader->index_count : 1) * sizeof(bool)))) {
+            for (size_t i = 0; i < reader->index_count; i++) {
+                const uint8_t* filter = reader->topic_filters + i * reader->topic_filter_size;
+                bool skip = true;
+                for (size_t j = 0; j < count && skip; j++) {
+                    skip = !topic_filter_test(filter, reader->topic_filter_size, hashes[j]);
+                }
+                reader->chunk_skip[i] = skip;
+            }
+        }
+    }
+    free(hashes);
+    return 0;
+}
+
+// Dedup. A reference names its payload by the received time of the record
+// holding it, its size and its hash. The record is looked for in the chunk
+// being read, then in the chunks whose time range holds that time, read to
+// the side without moving the read position. The payload found is kept: in
+// the mapping where the chunk is stored uncompressed, copied otherwise.
+
+// The slot a payload's hash falls in, as in the writer's table: a payload
+// the writer can still refer to is the last one it wrote there, so reading in
+// order finds it in the slot. After a seek the slot may hold another payload,
+// which the caller replaces.
+static ref_slot_t* ref_slot(zet_reader_t* reader, uint64_t hash) {
+    if (!reader->refs && !(reader->refs = (ref_slot_t*)calloc(ZET_DEDUP_PAYLOADS, sizeof(ref_slot_t)))) {
+        return NULL;
+    }
+    return &reader->refs[hash & (ZET_DEDUP_PAYLOADS - 1)];
+}
+
+// Free the copies retired since the last read, once no view can point at them
+static void release_refs(zet_reader_t* reader) {
+    for (size_t i = 0; i < reader->ref_retired_count; i++) {
+        free(reader->ref_retired[i]);
+    }
+    reader->ref_retired_count = 0;
+}
+
+// Among a chunk's records, the payload a reference stands for, or NULL
+static const uint8_t* find_payload(const zet_reader_t* reader, const uint8_t* records, size_t len,
+                                   const zet_payload_ref_t* ref, size_t size) {
+    bool channels = reader->header.version >= ZET_FORMAT_VERSION_3;
+    size_t pos = 0;
+    chunk_deltas_t deltas = { 0 };
+    while (pos < len) {
+        zet_message_header_t header;
+        size_t head_len = decode_chunk_record(records + pos, len - pos, reader->header.version, &deltas, &header);
+        if (head_len == 0) return NULL;
+        size_t topic_size = channels ? 0 : header.topic_len;
+        size_t stored = record_stored_size(&header, reader->header.flags);
+        if (len - pos - head_len < topic_size + stored) return NULL;
+        const uint8_t* payload = records + pos + head_len + topic_size;
+        if (header.received_ns == ref->received_ns && !record_is_ref(&header, reader->header.flags) &&
+            header.payload_size == size && zet_xxh64(payload, size, 0) == ref->hash) {
+            return payload;
+        }
+        pos += head_len + topic_size + stored;
+    }
+    return NULL;
+}
+
+// Read len bytes at offset without moving the read position
+static int source_pread(zet_reader_t* reader, uint64_t offset, void* dst, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = pread(fileno(reader->file), (uint8_t*)dst + done, len - done, (off_t)(offset + done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        done += (size_t)n;
+    }
+    return 0;
+}
+
+// The records of the chunk at offset, read to the side: in the mapping (and
+// *mapped set), or in reader->ref_records. NULL if the chunk cannot be read
+// or does not check out.
+static const uint8_t* chunk_records_at(zet_reader_t* reader, uint64_t offset, size_t* len, bool* mapped) {
+    zet_chunk_header_t header;
+    int64_t size = source_size(reader);
+    if (size < 0 || offset > (uint64_t)size || (uint64_t)size - offset < sizeof(header)) return NULL;
+    if (reader->map) {
+        memcpy(&header, reader->map + offset, sizeof(header));
+    } else if (source_pread(reader, offset, &header, sizeof(header)) != 0) {
+        return NULL;
+    }
+    if (header.magic != ZET_CHUNK_MAGIC || header.compression > ZET_COMPRESSION_ZSTD ||
+        header.data_size > (uint64_t)size - offset - sizeof(header)) {
+        return NULL;
+    }
+
+    bool packed = header.compression != ZET_COMPRESSION_NONE;
+    const uint8_t* data;
+    if (reader->map) {
+        data = reader->map + offset + sizeof(header);
+    } else {
+        uint8_t** buf = packed ? &reader->ref_packed : &reader->ref_records;
+        size_t* cap = packed ? &reader->ref_packed_cap : &reader->ref_records_cap;
+        if (reserve(buf, cap, header.data_size ? header.data_size : 1) != 0 ||
+            source_pread(reader, offset + sizeof(header), *buf, (size_t)header.data_size) != 0) {
+            return NULL;
+        }
+        data = *buf;
+    }
+    if ((reader->header.flags & ZET_FLAG_CHECKSUMS) && chunk_crc(&header, data) != header.crc) return NULL;
+
+    *mapped = reader->map && !packed;
+    if (!packed) {
+        *len = (size_t)header.data_size;
+        return data;
+    }
+    if (!raw_size_plausible(&header, data) ||
+        reserve(&reader->ref_records, &reader->ref_records_cap, header.raw_size ? header.raw_size : 1) != 0 ||
+        decompress_chunk(&reader->zstd, &header, data, reader->ref_records) != 0) {
+        return NULL;
+    }
+    *len = (size_t)header.raw_size;
+    return reader->ref_records;
+}
+
+// Find the payload a reference stands for: in the current chunk, or in the
+// chunks on the index around its time
+static const uint8_t* find_ref(zet_reader_t* reader, const zet_payload_ref_t* ref, size_t size, bool* mapped) {
+    const uint8_t* payload = find_payload(reader, reader->chunk_data, reader->chunk_len, ref, size);
+    if (payload) {
+        *mapped = chunk_mapped(reader);
+        return payload;
+    }
+    if (load_index_in_place(reader) != 0) return NULL;
+
+    // The first chunk that can reach the time, then every one whose range holds it
+    size_t lo = 0;
+    size_t hi = reader->index_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (reader->index_max_end[mid] < ref->received_ns) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    for (size_t i = lo; i < reader->index_count; i++) {
+        const zet_index_entry_t* entry = &reader->index[i];
+        if (entry->start_ns > ref->received_ns || entry->end_ns < ref->received_ns) continue;
+        size_t len;
+        const uint8_t* records = chunk_records_at(reader, entry->offset, &len, mapped);
+        if (records && (payload = find_payload(reader, records, len, ref, size))) return payload;
+    }
+    return NULL;
+}
+
+// Point a view read from a reference at the payload it repeats
+static int resolve_view(zet_reader_t* reader, zet_message_view_t* view) {
+    zet_payload_ref_t ref;
+    memcpy(&ref, reader->view_ref, sizeof(ref));
+    reader->view_ref = NULL;
+
+    ref_slot_t* slot = ref_slot(reader, ref.hash);
+    if (!slot) return reader_stop(reader, ZET_STATUS_ERROR);
+    if (!slot->used || slot->hash != ref.hash || slot->size != view->size) {
+        // An earlier view may still point at the copy being replaced
+        if (slot->owned) {
+            if (reader->ref_retired_count == reader->ref_retired_cap) {
+                size_t cap = reader->ref_retired_cap ? reader->ref_retired_cap * 2 : 16;
+                uint8_t** retired = (uint8_t**)realloc(reader->ref_retired, cap * sizeof(uint8_t*));
+                if (!retired) return reader_stop(reader, ZET_STATUS_ERROR);
+                reader->ref_retired = retired;
+                reader->ref_retired_cap = cap;
+            }
+            reader->ref_retired[reader->ref_retired_count++] = slot->owned;
+        }
+        *slot = (ref_slot_t){ 0 };
+
+        bool mapped = false;
+        const uint8_t* payload = find_ref(reader, &ref, view->size, &mapped);
+        // A walked index stops at the chunks there were: a file being
+        // followed may have written the one wanted since
+        if (!payload && reader->follow && !reader->topic_filters) {
+            free(reader->index);
+            free(reader->index_max_end);
+            reader->index = NULL;
+            reader->index_max_end = NULL;
+            reader->index_count = 0;
+            reader->index_loaded = false;
+            payload = find_ref(reader, &ref, view->size, &mapped);
+        }
+        if (!payload) return reader_stop(reader, ZET_STATUS_CORRUPT);
+        if (!mapped) {
+            if (!(slot->owned = (uint8_t*)malloc(view->size ? view->size : 1))) {
+                return reader_stop(reader, ZET_STATUS_ERROR);
+            }
+            memcpy(slot->owned, payload, view->size);
+            payload = slot->owned;
+        }
+        *slot = (ref_slot_t){ .hash = ref.hash, .size = view->size, .data = payload, .owned = slot->owned,
+                              .used = true };
+    }
+    view->data = slot->data;
+    return 0;
+}
+
+// Park the reader at the end of the file, or of the chunks
+static int seek_end(zet_reader_t* reader) {
+    if (reader->index_loaded) return source_seek(reader, reader->data_end);
+    int64_t size = source_size(reader);
+    return size < 0 ? -1 : source_seek(reader, (uint64_t)size);
+}
+
+static int seek_time_v1(zet_reader_t* reader, uint64_t time_ns) {
+    if (source_seek(reader, sizeof(zet_header_t)) != 0) return -1;
+
+    // No index: scan record headers, skipping payloads
+    for (;;) {
+        int64_t offset = source_tell(reader);
+        uint8_t raw[ZET_RECORD_HEADER_SIZE];
+        zet_message_header_t header;
+        if (offset < 0 || source_read(reader, raw, sizeof(raw)) != 0) break;
+        decode_record_header(raw, &header);
+        if (header.received_ns >= time_ns) {
+            return source_seek(reader, (uint64_t)offset);
+        }
+        uint64_t next = (uint64_t)offset + sizeof(raw) + header.topic_len + header.payload_size;
+        if (source_seek(reader, next) != 0) break;
+    }
+    return seek_end(reader);
+}
+
+static int seek_time_v2(zet_reader_t* reader, uint64_t time_ns) {
+    if (load_index(reader) != 0) return -1;
+
+    // First chunk that holds anything received at or after time_ns; every
+    // chunk before it is entirely earlier
+    size_t lo = 0;
+    size_t hi = reader->index_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (reader->index_max_end[mid] < time_ns) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    reader->chunk_len = 0;
+    reader->chunk_pos = 0;
+    reader->chunk_deltas = (chunk_deltas_t){ 0 };
+    if (lo == reader->index_count) {
+        // Nothing at or after time_ns: park on something that is not a chunk
+        return seek_end(reader);
+    }
+    reader->skipping = true;
+    reader->skip_before_ns = time_ns;
+
+    uint64_t offset = reader->index[lo].offset;
+    if (reader->map && offset < reader->map_size) {
+        // Start reading ahead from the new position right away
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t start = (size_t)offset & ~(page - 1);
+        size_t length = reader->map_size - start < MMAP_READAHEAD ? reader->map_size - start : MMAP_READAHEAD;
+        madvise((void*)(reader->map + start), length, MADV_WILLNEED);
+    }
+    return source_seek(reader, offset);
+}
+
+int zet_reader_seek_time(zet_reader_t* reader, uint64_t time_ns) {
+    if (!reader) return -1;
+
+    reader_stop_pipeline(reader);
+    reader->pipeline_end = 0;
+    reader->skipping = false;
+    reader->status = ZET_STATUS_OK;
+    if (reader->header.version == ZET_FORMAT_VERSION_1) {
+        return seek_time_v1(reader, time_ns);
+    }
+    return seek_time_v2(reader, time_ns);
+}
+
+// Merging. Each file is read a batch of views at a time (one chunk, or one
+// large read), and a binary heap of the files with views left, keyed on
+// received_ns and then file order, picks the next message. A file whose batch
+// runs out ends the caller's batch: refilling it would invalidate views
+// already handed out, and its next message may come before anything else.
+// A manifest's segments follow one another in time, so they are one source
+// to the heap: a segment is opened only once the one before it ends, and a
+// long rotated recording holds one file open rather than all of them.
+#define MERGE_BATCH 256
+#define MERGE_TOPIC_CACHE 64     // Per file: recently seen topic addresses
+
+typedef struct {
+    const char* from;            // Interned by the file's reader...
+    const char* to;              // ...and by the merge reader
+} merge_topic_t;
+
+typedef struct {
+    zet_reader_t* reader;        // Of the file being read, if it could be opened
+    size_t file;                 // Its index in the merge reader's paths
+    size_t first;                // The source's files: one, or a manifest's segments
+    size_t end;
+    uint64_t start_ns;           // Of its first file
+    bool seeking;                // Each file opened is sought to seek_ns, until
+    uint64_t seek_ns;            // one has messages from there
+    zet_message_view_t views[MERGE_BATCH];
+    size_t count;
+    size_t pos;
+    merge_topic_t topics[MERGE_TOPIC_CACHE];
+} merge_source_t;
+
+struct zet_merge_reader_s {
+    merge_source_t* sources;     // One per file or manifest given
+    size_t source_count;
+    char** paths;                // Of the files, each manifest's segments in turn
+    size_t path_count;
+    int* statuses;               // Of the files, as their readers ended when closed
+    zet_reader_options_t options;
+    size_t* heap;                // Indices of sources with views left
+    size_t heap_len;
+    size_t* drained;             // Sources whose batch ran out, refilled on the next read
+    size_t drained_len;
+    topic_table_t topics;        // One address per topic across all of the files
+};
+
+static bool merge_before(const zet_merge_reader_t* merge, size_t a, size_t b) {
+    uint64_t ta = merge->sources[a].views[merge->sources[a].pos].received_ns;
+    uint64_t tb = merge->sources[b].views[merge->sources[b].pos].received_ns;
+    return ta < tb || (ta == tb && a < b);
+}
+
+static void merge_sift_down(zet_merge_reader_t* merge, size_t i) {
+    size_t* heap = merge->heap;
+    for (;;) {
+        size_t least = i;
+        size_t left = 2 * i + 1;
+        if (left < merge->heap_len && merge_before(merge, heap[left], heap[least])) least = left;
+        if (left + 1 < merge->heap_len && merge_before(merge, heap[left + 1], heap[least])) least = left + 1;
+        if (least == i) return;
+        size_t tmp = heap[i];
+        heap[i] = heap[least];
+        heap[least] = tmp;
+        i = least;
+    }
+}
+
+static void merge_push(zet_merge_reader_t* merge, size_t source) {
+    size_t i = merge->heap_len++;
+    merge->heap[i] = source;
+    while (i > 0 && merge_before(merge, merge->heap[i], merge->heap[(i - 1) / 2])) {
+        size_t parent = (i - 1) / 2;
+        merge->heap[i] = merge->heap[parent];
+        merge->heap[parent] = source;
+        i = parent;
+    }
+}
+
+// Close the source's file, noting how it ended, and open another of its
+// files (sought, if the source is seeking). Returns -1 if it cannot be opened
+// or sought.
+static int merge_open(zet_merge_reader_t* merge, merge_source_t* s, size_t file) {
+    if (s->reader) {
+        merge->statuses[s->file] = zet_reader_get_status(s->reader);
+        zet_reader_destroy(s->reader);
+        // The next reader may intern other topics at the same addresses
+        memset(s->topics, 0, sizeof(s->topics));
+    }
+    s->file = file;
+    s->reader = zet_reader_create_ex(merge->paths[file], &merge->options);
+    if (!s->reader) {
+        merge->statuses[file] = ZET_STATUS_ERROR;
+        return -1;
+    }
+    return s->seeking ? zet_reader_seek_time(s->reader, s->seek_ns) : 0;
+}
+
+// Read the source's next batch, moving on to its next file as each one ends,
+// and put it back in the heap, unless it has ended
+static void merge_refill(zet_merge_reader_t* merge, size_t source) {
+    merge_source_t* s = &merge->sources[source];
+    s->count = s->reader ? zet_reader_read_views(s->reader, s->views, MERGE_BATCH) : 0;
+    while (s->count == 0 && s->file + 1 < s->end) {
+        merge_open(merge, s, s->file + 1);
+        if (s->reader) s->count = zet_reader_read_views(s->reader, s->views, MERGE_BATCH);
+    }
+    s->seeking = false;
+    s->pos = 0;
+    if (s->count > 0) merge_push(merge, source);
+}
+
+// The merge reader's address for a topic interned by one of the files
+static const char* merge_topic(zet_merge_reader_t* merge, merge_source_t* s, const char* topic) {
+    merge_topic_t* cached = &s->topics[((uintptr_t)topic >> 4) % MERGE_TOPIC_CACHE];
+    if (cached->from == topic) return cached->to;
+    topic_slot_t* slot = topic_intern(&merge->topics, topic, strlen(topic), NULL);
+    if (!slot) return NULL;
+    *cached = (merge_topic_t){ .from = topic, .to = slot->topic };
+    return slot->topic;
+}
+
+static void merge_restart(zet_merge_reader_t* merge) {
+    merge->heap_len = 0;
+    merge->drained_len = 0;
+    for (size_t i = 0; i < merge->source_count; i++) {
+        merge_refill(merge, i);
+    }
+}
+
+// Add a file to merge, or a manifest's segments
+static int merge_add(zet_merge_reader_t* merge, const char* filename, size_t* cap) {
+    char** segments = NULL;
+    size_t segment_count = 0;
+    bool manifest = zet_manifest_read(filename, &segments, &segment_count) == 0;
+    size_t add = manifest ? segment_count : 1;
+    if (merge->path_count + add > *cap) {
+        size_t grown = *cap ? *cap * 2 : 16;
+        while (grown < merge->path_count + add) grown *= 2;
+        char** more = (char**)realloc(merge->paths, grown * sizeof(char*));
+        if (!more) {
+            zet_manifest_free(segments, segment_count);
+            return -1;
+        }
+        merge->paths = more;
+        *cap = grown;
+    }
+    if (manifest) {
+        if (add > 0) memcpy(merge->paths + merge->path_count, segments, add * sizeof(char*));
+        free(segments);
+    } else if (!(merge->paths[merge->path_count] = strdup(filename))) {
+        return -1;
+    }
+    merge->path_count += add;
+    return 0;
+}
+
+zet_merge_reader_t* zet_merge_reader_create(const char* const* filenames, size_t count,
+                                            const zet_reader_options_t* options) {
+    if (!filenames || count == 0) return NULL;
+    zet_merge_reader_t* merge = (zet_merge_reader_t*)calloc(1, sizeof(zet_merge_reader_t));
+    if (!merge) return NULL;
+    if (options) merge->options = *options;
+    merge->sources = (merge_source_t*)calloc(count, sizeof(merge_source_t));
+    merge->heap = (size_t*)calloc(count, sizeof(size_t));
+    merge->drained = (size_t*)calloc(count, sizeof(size_t));
+    if (!merge->sources || !merge->heap || !merge->drained) goto fail;
+
+    size_t cap = 0;
+    for (size_t i = 0; i < count; i++) {
+        merge_source_t* s = &merge->sources[i];
+        s->first = merge->path_count;
+        if (merge_add(merge, filenames[i], &cap) != 0) goto fail;
+        s->end = merge->path_count;
+        s->file = s->first;
+    }
+    merge->source_count = count;
+    merge->statuses = (int*)calloc(merge->path_count ? merge->path_count : 1, sizeof(int));
+    if (merge->path_count == 0 || !merge->statuses) goto fail;
+
+    // The first file of each, so a missing or invalid one fails here
+    for (size_t i = 0; i < count; i++) {
+        merge_source_t* s = &merge->sources[i];
+        if (s->first == s->end) continue;
+        if (merge_open(merge, s, s->first) != 0) goto fail;
+        s->start_ns = zet_reader_get_start_time(s->reader);
+    }
+    merge_restart(merge);
+    return merge;
+
+fail:
+    zet_merge_reader_destroy(merge);
+    return NULL;
+}
+
+void zet_merge_reader_destroy(zet_merge_reader_t* merge) {
+    if (!merge) return;
+    for (size_t i = 0; i < merge->source_count; i++) {
+        zet_reader_destroy(merge->sources[i].reader);
+    }
+    zet_manifest_free(merge->paths, merge->path_count);
+    free(merge->statuses);
+    free(merge->sources);
+    free(merge->heap);
+    free(merge->drained);
+    topic_table_free(&merge->topics);
+    free(merge);
+}
+
+size_t zet_merge_reader_read_views(zet_merge_reader_t* merge, zet_message_view_t* views, size_t max) {
+    if (!merge || !views) return 0;
+    for (size_t i = 0; i < merge->drained_len; i++) {
+        merge_refill(merge, merge->drained[i]);
+    }
+    merge->drained_len = 0;
+
+    size_t n = 0;
+    while (n < max && merge->heap_len > 0) {
+        size_t source = merge->heap[0];
+        merge_source_t* s = &merge->sources[source];
+        zet_message_view_t* view = &s->views[s->pos];
+        const char* topic = merge_topic(merge, s, view->topic);
+        if (!topic) break;
+        views[n] = *view;
+        views[n].topic = topic;
+        n++;
+
+        if (++s->pos < s->count) {
+            merge_sift_down(merge, 0);
+            continue;
+        }
+        merge->heap[0] = merge->heap[--merge->heap_len];
+        merge_sift_down(merge, 0);
+        merge->drained[merge->drained_len++] = source;
+        break;
+    }
+    return n;
+}
+
+int zet_merge_reader_read_view(zet_merge_reader_t* merge, zet_message_view_t* view) {
+    return zet_merge_reader_read_views(merge, view, 1) == 1 ? 0 : -1;
+}
+
+uint64_t zet_merge_reader_get_start_time(zet_merge_reader_t* merge) {
+    if (!merge) return 0;
+    uint64_t start = UINT64_MAX;
+    for (size_t i = 0; i < merge->source_count; i++) {
+        const merge_source_t* s = &merge->sources[i];
+        if (s->first < s->end && s->start_ns < start) start = s->start_ns;
+    }
+    return start;
+}
+
+size_t zet_merge_reader_get_count(zet_merge_reader_t* merge) {
+    return merge ? merge->path_count : 0;
+}
+
+// The source reading a file, if the file is open
+static merge_source_t* merge_source_of(zet_merge_reader_t* merge, size_t index) {
+    for (size_t i = 0; i < merge->source_count; i++) {
+        merge_source_t* s = &merge->sources[i];
+        if (index >= s->first && index < s->end) return s->file == index && s->reader ? s : NULL;
+    }
+    return NULL;
+}
+
+zet_reader_t* zet_merge_reader_get_reader(zet_merge_reader_t* merge, size_t index) {
+    merge_source_t* s = merge && index < merge->path_count ? merge_source_of(merge, index) : NULL;
+    return s ? s->reader : NULL;
+}
+
+const char* zet_merge_reader_get_path(zet_merge_reader_t* merge, size_t index) {
+    return merge && index < merge->path_count ? merge->paths[index] : NULL;
+}
+
+int zet_merge_reader_get_status(zet_merge_reader_t* merge, size_t index) {
+    if (!merge || index >= merge->path_count) return ZET_STATUS_ERROR;
+    zet_reader_t* reader = zet_merge_reader_get_reader(merge, index);
+    return reader ? zet_reader_get_status(reader) : merge->statuses[index];
+}
+
+// Each source starts again from its first file, passing over the files that
+// end before time_ns
+int zet_merge_reader_seek_time(zet_merge_reader_t* merge, uint64_t time_ns) {
+    if (!merge) return -1;
+    int result = 0;
+    for (size_t i = 0; i < merge->source_count; i++) {
+        merge_source_t* s = &merge->sources[i];
+        if (s->first == s->end) continue;
+        s->seeking = true;
+        s->seek_ns = time_ns;
+        if (s->file == s->first && s->reader) {
+            if (zet_reader_seek_time(s->reader, time_ns) != 0) result = -1;
+        } else if (merge_open(merge, s, s->first) != 0) {
+            result = -1;
+        }
+    }
+    merge_restart(merge);
+    return result;
+}
+
+// Recovery. The file is mapped and walked block by block: channel blocks and
+// chunks that check out are kept, anything else is damage. With checksums the
+// walk resynchronizes on the next intact chunk; without, it stops there. Kept
+// blocks are then moved down over any gaps, the file is cut after the last
+// one, and a new index (and version 3 channel table), summary and footer are
+// written.
+
+typedef struct {
+    uint64_t offset;
+    uint64_t size;
+    bool chunk;
+    zet_chunk_header_t header; // For chunks
+} kept_block_t;
+
+typedef struct {
+    const uint8_t* map;
+    uint64_t size;
+    uint32_t version;
+    bool checksums;
+    uint32_t flags;            // Of the file header
+    kept_block_t* blocks;
+    size_t block_count;
+    size_t block_cap;
+    const uint8_t** channels;  // Version 3: each defined ID's channel entry in the mapping
+    uint8_t* unpacked;         // A compressed chunk's records, when they are checked
+    size_t unpacked_cap;
+    ZSTD_DCtx* zstd;
+    summary_builder_t* summary; // When set, checked records are counted in it...
+    topic_table_t* names;       // ...by channel ID, or by topic ID in here (version 2)...
+    uint8_t* topic_filter;      // ...and their topics added to the chunk's filter
+} recover_scan_t;
+
+static int keep_block(recover_scan_t* scan, uint64_t offset, uint64_t size, const zet_chunk_header_t* header) {
+    if (scan->block_count == scan->block_cap) {
+        size_t cap = scan->block_cap ? scan->block_cap * 2 : 256;
+        kept_block_t* blocks = (kept_block_t*)realloc(scan->blocks, cap * sizeof(kept_block_t));
+        if (!blocks) return -1;
+        scan->blocks = blocks;
+        scan->block_cap = cap;
+    }
+    kept_block_t* block = &scan->blocks[scan->block_count++];
+    *block = (kept_block_t){ .offset = offset, .size = size, .chunk = header != NULL };
+    if (header) block->header = *header;
+    return 0;
+}
+
+// Size of the well-formed channel block at offset, or 0. With define set,
+// its channels are taken in.
+static uint64_t scan_channel_block(recover_scan_t* scan, uint64_t offset, bool define) {
+    zet_channel_header_t header;
+    if (scan->size - offset < sizeof(header)) return 0;
+    memcpy(&header, scan->map + offset, sizeof(header));
+    if (header.magic != ZET_CHANNEL_MAGIC || header.data_size > scan->size - offset - sizeof(header)) return 0;
+
+    const uint8_t* p = scan->map + offset + sizeof(header);
+    size_t avail = (size_t)header.data_size;
+    for (uint32_t i = 0; i < header.channel_count; i++) {
+        uint16_t topic_len;
+        if (avail < 4) return 0;
+        memcpy(&topic_len, p + 2, sizeof(topic_len));
+        if (topic_len == 0 || avail - 4 < topic_len || p[4 + topic_len - 1] != '\0') return 0;
+        p += 4 + topic_len;
+        avail -= 4 + (size_t)topic_len;
+    }
+    if (avail != 0) return 0;
+
+    if (define) {
+        p = scan->map + offset + sizeof(header);
+        for (uint32_t i = 0; i < header.channel_count; i++) {
+            uint16_t id;
+            uint16_t topic_len;
+            memcpy(&id, p, sizeof(id));
+            memcpy(&topic_len, p + 2, sizeof(topic_len));
+            scan->channels[id] = p;
+            p += 4 + topic_len;
+        }
+    }
+    return sizeof(header) + header.data_size;
+}
+
+// Whether a chunk's records fill it exactly, agree with its header and, in
+// version 3, use only channels defined so far
+static bool scan_records(recover_scan_t* scan, const zet_chunk_header_t* header, const uint8_t* data) {
+    const uint8_t* p = data;
+    size_t avail = (size_t)header->raw_size;
+    if (header->compression != ZET_COMPRESSION_NONE) {
+        if (!raw_size_plausible(header, data) || reserve(&scan->unpacked, &scan->unpacked_cap, header->raw_size) != 0) {
+            return false;
+        }
+        if (decompress_chunk(&scan->zstd, header, data, scan->unpacked) != 0) return false;
+        p = scan->unpacked;
+    }
+
+    bool channels = scan->version >= ZET_FORMAT_VERSION_3;
+    uint32_t count = 0;
+    chunk_deltas_t deltas = { 0 };
+    while (avail > 0) {
+        zet_message_header_t record;
+        size_t head_len = decode_chunk_record(p, avail, scan->version, &deltas, &record);
+        if (head_len == 0) return false;
+        size_t topic_size = channels ? 0 : record.topic_len;
+        size_t stored = record_stored_size(&record, scan->flags);
+        if (avail - head_len < topic_size + stored) return false;
+        if (record.received_ns < header->start_ns || record.received_ns > header->end_ns) return false;
+        if (channels ? !scan->channels[record.topic_len]
+                     : topic_size == 0 || p[head_len + topic_size - 1] != '\0') {
+            return false;
+        }
+        if (scan->summary) {
+            uint32_t id = record.topic_len;
+            uint32_t hash;
+            if (!channels) {
+                bool added;
+                topic_slot_t* slot = topic_intern(scan->names, (const char*)p + head_len,
+                                                  topic_size - 1, &added);
+                if (!slot || (added && topic_set_channel(scan->names, slot->id, slot->topic) != 0)) return false;
+                id = slot->id;
+                hash = slot->hash;
+            } else {
+                const uint8_t* entry = scan->channels[id];
+                uint16_t topic_len;
+                memcpy(&topic_len, entry + 2, sizeof(topic_len));
+                hash = topic_hash((const char*)entry + 4, (size_t)topic_len - 1);
+            }
+            uint32_t payload_size = record_payload_size(&record, scan->flags);
+            if (summary_add(scan->summary, id, record.received_ns, payload_size) != 0) return false;
+            topic_filter_add(scan->topic_filter, ZET_TOPIC_FILTER_SIZE, hash);
+        }
+        size_t size = head_len + topic_size + stored;
+        p += size;
+        avail -= size;
+        count++;
+    }
+    return count == header->message_count;
+}
+
+// Size of the intact chunk at offset, or 0. Its records are checked too when
+// there is no checksum, or when asked to.
+static uint64_t scan_chunk(recover_scan_t* scan, uint64_t offset, bool check_records, zet_chunk_header_t* header) {
+    if (scan->size - offset < sizeof(*header)) return 0;
+    memcpy(header, scan->map + offset, sizeof(*header));
+    if (header->magic != ZET_CHUNK_MAGIC || header->compression > ZET_COMPRESSION_ZSTD) return 0;
+    if (header->message_count == 0 || header->start_ns > header->end_ns) return 0;
+    if (header->data_size > scan->size - offset - sizeof(*header)) return 0;
+    if (header->compression == ZET_COMPRESSION_NONE && header->raw_size != header->data_size) return 0;
+
+    const uint8_t* data = scan->map + offset + sizeof(*header);
+    if (scan->checksums && chunk_crc(header, data) != header->crc) return 0;
+    if ((!scan->checksums || check_records) && !scan_records(scan, header, data)) return 0;
+    return sizeof(*header) + header->data_size;
+}
+
+// Offset of the next block that checks out after damage at offset, or the
+// end of the file. A chunk magic is only taken with a matching checksum.
+static uint64_t scan_resync(recover_scan_t* scan, uint64_t offset, bool check_records) {
+    for (uint64_t pos = offset + 1; pos + sizeof(uint32_t) <= scan->size; pos++) {
+        const uint8_t* z = (const uint8_t*)memchr(scan->map + pos, 'Z', (size_t)(scan->size - pos));
+        if (!z) break;
+        pos = (uint64_t)(z - scan->map);
+        if (scan->size - pos < sizeof(uint32_t)) break;
+
+        uint32_t magic;
+        memcpy(&magic, z, sizeof(magic));
+        zet_chunk_header_t header;
+        if (magic == ZET_CHUNK_MAGIC && scan_chunk(scan, pos, check_records, &header) > 0) return pos;
+        if (magic == ZET_CHANNEL_MAGIC && scan->version >= ZET_FORMAT_VERSION_3 &&
+            scan_channel_block(scan, pos, false) > 0) {
+            return pos;
+        }
+    }
+    return scan->size;
+}
+
+// Whether the summary_size bytes at offset are a well-formed summary block
+// counting message_count messages
+static bool scan_summary_block(recover_scan_t* scan, uint64_t offset, uint64_t summary_size, uint64_t message_count) {
+    zet_summary_header_t header;
+    if (summary_size < sizeof(header) || scan->size - offset < summary_size) return false;
+    memcpy(&header, scan->map + offset, sizeof(header));
+    if (header.magic != ZET_SUMMARY_MAGIC || header.data_size != summary_size - sizeof(header)) return false;
+
+    const uint8_t* p = scan->map + offset + sizeof(header);
+    size_t avail = (size_t)header.data_size;
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < header.topic_count; i++) {
+        zet_summary_entry_t entry;
+        if (avail < sizeof(entry)) return false;
+        memcpy(&entry, p, sizeof(entry));
+        if (entry.topic_len == 0 || avail - sizeof(entry) < entry.topic_len ||
+            p[sizeof(entry) + entry.topic_len - 1] != '\0') {
+            return false;
+        }
+        count += entry.message_count;
+        p += sizeof(entry) + entry.topic_len;
+        avail -= sizeof(entry) + entry.topic_len;
+    }
+    return avail == 0 && count == message_count;
+}
+
+// Whether the index at offset, and what follows it, is exactly what the
+// writer leaves after the chunks that were kept
+static bool scan_trailer(recover_scan_t* scan, uint64_t offset, uint64_t message_count) {
+    zet_index_header_t header;
+    if (scan->size - offset < sizeof(header)) return false;
+    memcpy(&header, scan->map + offset, sizeof(header));
+
+    size_t chunk_count = 0;
+    for (size_t i = 0; i < scan->block_count; i++) chunk_count += scan->blocks[i].chunk;
+    if (header.magic != ZET_INDEX_MAGIC || header.chunk_count != chunk_count) return false;
+    uint64_t pos = offset + sizeof(header);
+    if ((scan->size - pos) / sizeof(zet_index_entry_t) < chunk_count) return false;
+    for (size_t i = 0; i < scan->block_count; i++) {
+        if (!scan->blocks[i].chunk) continue;
+        zet_index_entry_t entry;
+        memcpy(&entry, scan->map + pos, sizeof(entry));
+        if (entry.offset != scan->blocks[i].offset) return false;
+        pos += sizeof(entry);
+    }
+
+    // Topic filters, from writers that leave them
+    zet_topic_filter_header_t filters;
+    if (scan->size - pos >= sizeof(filters)) {
+        memcpy(&filters, scan->map + pos, sizeof(filters));
+        if (filters.magic == ZET_TOPIC_FILTER_MAGIC) {
+            if (filters.data_size != (uint64_t)chunk_count * filters.filter_size ||
+                scan->size - pos - sizeof(filters) < filters.data_size) {
+                return false;
+            }
+            pos += sizeof(filters) + filters.data_size;
+        }
+    }
+
+    uint64_t channel_offset = 0;
+    if (scan->version >= ZET_FORMAT_VERSION_3) {
+        uint64_t size = scan_channel_block(scan, pos, false);
+        if (size == 0) return false;
+        channel_offset = pos;
+        pos += size;
+    }
+
+    // Then the summary, if the writer had summaries, and the footer
+    zet_footer_t footer;
+    if (scan->size - pos < sizeof(footer)) return false;
+    memcpy(&footer, scan->map + scan->size - sizeof(footer), sizeof(footer));
+    if (scan->size - pos != sizeof(footer) + footer.summary_size) return false;
+    if (footer.summary_size > 0 && !scan_summary_block(scan, pos, footer.summary_size, message_count)) return false;
+    return footer.magic == ZET_FOOTER_MAGIC && footer.index_offset == offset &&
+           footer.message_count == message_count && footer.channel_offset == channel_offset;
+}
+
+// Summary of the records in the kept chunks, read before they move, and
+// the chunks' topic filters. Returns NULL if a chunk's records do not check
+// out or out of memory.
+static uint8_t* summarize_blocks(recover_scan_t* scan, size_t* len, uint8_t** filters) {
+    summary_builder_t summary = {0};
+    topic_table_t names = {0};
+    uint8_t* block = NULL;
+    size_t chunk_count = 0;
+    for (size_t i = 0; i < scan->block_count; i++) chunk_count += scan->blocks[i].chunk;
+    if (!(*filters = (uint8_t*)calloc(chunk_count ? chunk_count : 1, ZET_TOPIC_FILTER_SIZE))) return NULL;
+
+    scan->summary = &summary;
+    scan->names = &names;
+    scan->topic_filter = *filters;
+    for (size_t i = 0; i < scan->block_count; i++) {
+        const kept_block_t* kept = &scan->blocks[i];
+        if (!kept->chunk) continue;
+        if (!scan_records(scan, &kept->header, scan->map + kept->offset + sizeof(kept->header))) goto done;
+        scan->topic_filter += ZET_TOPIC_FILTER_SIZE;
+    }
+    if (scan->version >= ZET_FORMAT_VERSION_3) {
+        for (uint32_t id = 0; id < ZET_MAX_CHANNELS; id++) {
+            const uint8_t* entry = scan->channels[id];
+            if (!entry) continue;
+            uint16_t topic_len;
+            memcpy(&topic_len, entry + 2, sizeof(topic_len));
+            topic_slot_t* slot = topic_intern(&names, (const char*)entry + 4, (size_t)topic_len - 1, NULL);
+            if (!slot || topic_set_channel(&names, id, slot->topic) != 0) goto done;
+        }
+    }
+    block = summary_encode(&summary, &names, len);
+
+done:
+    scan->summary = NULL;
+    scan->names = NULL;
+    scan->topic_filter = NULL;
+    free(summary.entries);
+    topic_table_free(&names);
+    if (!block) {
+        free(*filters);
+        *filters = NULL;
+    }
+    return block;
+}
+
+// The index, topic filters (if any), channel table (version 3), summary and
+// footer for the kept blocks, once they sit at their new offsets
+static uint8_t* build_trailer(recover_scan_t* scan, const uint64_t* offsets, uint64_t index_offset,
+                              uint64_t message_count, const uint8_t* summary, size_t summary_len,
+                              const uint8_t* filters, size_t* len) {
+    size_t chunk_count = 0;
+    for (size_t i = 0; i < scan->block_count; i++) chunk_count += scan->blocks[i].chunk;
+
+    uint8_t* channels = NULL;
+    size_t channels_len = 0;
+    size_t channels_cap = 0;
+    uint32_t channel_count = 0;
+    if (scan->version >= ZET_FORMAT_VERSION_3) {
+        for (uint32_t id = 0; id < ZET_MAX_CHANNELS; id++) {
+            const uint8_t* entry = scan->channels[id];
+            if (!entry) continue;
+            uint16_t topic_len;
+            memcpy(&topic_len, entry + 2, sizeof(topic_len));
+            if (append_channel(&channels, &channels_len, &channels_cap, (uint16_t)id, (const char*)entry + 4,
+                               (size_t)topic_len - 1) != 0) {
+                free(channels);
+                return NULL;
+            }
+            channel_count++;
+        }
+    }
+
+    size_t filters_len = filters ? chunk_count * ZET_TOPIC_FILTER_SIZE : 0;
+    size_t index_len = sizeof(zet_index_header_t) + chunk_count * sizeof(zet_index_entry_t) +
+                       (filters ? sizeof(zet_topic_filter_header_t) + filters_len : 0);
+    size_t channel_block_len = scan->version >= ZET_FORMAT_VERSION_3 ? sizeof(zet_channel_header_t) + channels_len : 0;
+    *len = index_len + channel_block_len + summary_len + sizeof(zet_footer_t);
+    uint8_t* trailer = (uint8_t*)malloc(*len);
+    if (!trailer) {
+        free(channels);
+        return NULL;
+    }
+
+    uint8_t* p = trailer;
+    zet_index_header_t header = { .magic = ZET_INDEX_MAGIC, .chunk_count = (uint32_t)chunk_count };
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    for (size_t i = 0; i < scan->block_count; i++) {
+        const kept_block_t* block = &scan->blocks[i];
+        if (!block->chunk) continue;
+        zet_index_entry_t entry = {
+            .offset = offsets[i],
+            .start_ns = block->header.start_ns,
+            .end_ns = block->header.end_ns,
+            .message_count = block->header.message_count,
+            .reserved = 0
+        };
+        memcpy(p, &entry, sizeof(entry));
+        p += sizeof(entry);
+    }
+    if (filters) {
+        zet_topic_filter_header_t block = { .magic = ZET_TOPIC_FILTER_MAGIC, .filter_size = ZET_TOPIC_FILTER_SIZE,
+                                            .data_size = filters_len };
+        memcpy(p, &block, sizeof(block));
+        memcpy(p + sizeof(block), filters, filters_len);
+        p += sizeof(block) + filters_len;
+    }
+    zet_footer_t footer = {
+        .magic = ZET_FOOTER_MAGIC,
+        .summary_size = (uint32_t)summary_len,
+        .index_offset = index_offset,
+        .message_count = message_count,
+        .channel_offset = 0
+    };
+    if (channel_block_len > 0) {
+        zet_channel_header_t block = { .magic = ZET_CHANNEL_MAGIC, .channel_count = channel_count,
+                                       .data_size = channels_len };
+        memcpy(p, &block, sizeof(block));
+        if (channels_len > 0) memcpy(p + sizeof(block), channels, channels_len);
+        footer.channel_offset = index_offset + index_len;
+        p += channel_block_len;
+    }
+    if (summary_len > 0) memcpy(p, summary, summary_len);
+    memcpy(p + summary_len, &footer, sizeof(footer));
+    free(channels);
+    return trailer;
+}
+
+// Version 1: keep every whole record
+static uint64_t scan_records_v1(const uint8_t* map, uint64_t size, uint64_t* message_count) {
+    uint64_t pos = sizeof(zet_header_t);
+    while (size - pos >= ZET_RECORD_HEADER_SIZE) {
+        zet_message_header_t record;
+        decode_record_header(map + pos, &record);
+        uint64_t record_size = ZET_RECORD_HEADER_SIZE + (uint64_t)record.topic_len + record.payload_size;
+        if (record_size > size - pos || record.topic_len == 0 ||
+            map[pos + ZET_RECORD_HEADER_SIZE + record.topic_len - 1] != '\0') {
+            break;
+        }
+        pos += record_size;
+        (*message_count)++;
+    }
+    return pos;
+}
+
+// Move the kept blocks down over the gaps between them, front to back so
+// nothing is overwritten before it is copied. Returns the end of the last.
+static int compact_blocks(int fd, recover_scan_t* scan, uint64_t* offsets, uint64_t* end) {
+    uint64_t out = sizeof(zet_header_t);
+    uint8_t* bounce = NULL;
+    for (size_t i = 0; i < scan->block_count; i++) {
+        const kept_block_t* block = &scan->blocks[i];
+        offsets[i] = out;
+        if (block->offset != out) {
+            if (!bounce && !(bounce = (uint8_t*)malloc(DEFAULT_OUTPUT_BUFFER))) return -1;
+            for (uint64_t done = 0; done < block->size;) {
+                size_t piece = block->size - done < DEFAULT_OUTPUT_BUFFER ? (size_t)(block->size - done)
+                                                                          : DEFAULT_OUTPUT_BUFFER;
+                memcpy(bounce, scan->map + block->offset + done, piece);
+                if (write_full_at(fd, bounce, piece, out + done) != 0) {
+                    free(bounce);
+                    return -1;
+                }
+                done += piece;
+            }
+        }
+        out += block->size;
+    }
+    free(bounce);
+    *end = out;
+    return 0;
+}
+
+int zet_recover(const char* filename, zet_recover_result_t* result) {
+    zet_recover_result_t unused;
+    if (!result) result = &unused;
+    memset(result, 0, sizeof(*result));
+
+    int fd = open(filename, O_RDWR);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(zet_header_t)) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    recover_scan_t scan = { .map = (const uint8_t*)map, .size = (uint64_t)st.st_size };
+    zet_header_t header;
+    memcpy(&header, map, sizeof(header));
+    scan.version = header.version;
+    scan.checksums = (header.flags & ZET_FLAG_CHECKSUMS) != 0;
+    scan.flags = header.flags;
+    result->file_size = scan.size;
+
+    int ret = -1;
+    uint64_t* offsets = NULL;
+    uint8_t* summary = NULL;
+    uint8_t* filters = NULL;
+    uint8_t* trailer = NULL;
+    if (memcmp(header.magic, "ZET", 3) != 0 || header.version < ZET_FORMAT_VERSION_1 ||
+        header.version > ZET_FORMAT_VERSION_4) {
+        goto done;
+    }
+
+    if (header.version == ZET_FORMAT_VERSION_1) {
+        uint64_t end = scan_records_v1(scan.map, scan.size, &result->message_count);
+        result->recovered_size = end;
+        result->dropped_bytes = scan.size - end;
+        result->intact = end == scan.size;
+        munmap(map, (size_t)scan.size);
+        map = NULL;
+        ret = result->intact || (ftruncate(fd, (off_t)end) == 0 && fdatasync(fd) == 0) ? 0 : -1;
+        goto done;
+    }
+
+    if (header.version >= ZET_FORMAT_VERSION_3 &&
+        !(scan.channels = (const uint8_t**)calloc(ZET_MAX_CHANNELS, sizeof(const uint8_t*)))) {
+        goto done;
+    }
+
+    // Once part of a version 3 file is lost, so may be channel definitions:
+    // chunks after it are kept only if every record's channel is known
+    bool after_gap = false;
+    bool trailer_intact = false;
+    uint64_t pos = sizeof(zet_header_t);
+    while (pos < scan.size) {
+        uint32_t magic = 0;
+        if (scan.size - pos >= sizeof(magic)) memcpy(&magic, scan.map + pos, sizeof(magic));
+
+        uint64_t size;
+        zet_chunk_header_t chunk;
+        bool check_records = after_gap && scan.version >= ZET_FORMAT_VERSION_3;
+        if (magic == ZET_CHANNEL_MAGIC && (size = scan_channel_block(&scan, pos, true)) > 0) {
+            if (keep_block(&scan, pos, size, NULL) != 0) goto done;
+            pos += size;
+            continue;
+        }
+        if (magic == ZET_CHUNK_MAGIC && (size = scan_chunk(&scan, pos, check_records, &chunk)) > 0) {
+            if (keep_block(&scan, pos, size, &chunk) != 0) goto done;
+            result->message_count += chunk.message_count;
+            result->chunk_count++;
+            pos += size;
+            continue;
+        }
+        if (magic == ZET_INDEX_MAGIC) {
+            // The index follows the last chunk; a partly written one is rebuilt
+            trailer_intact = !after_gap && scan_trailer(&scan, pos, result->message_count);
+            break;
+        }
+
+        // Damage, or the torn tail when nothing intact follows
+        uint64_t next = scan.checksums ? scan_resync(&scan, pos, check_records) : scan.size;
+        result->dropped_bytes += next - pos;
+        if (next < scan.size) {
+            result->damaged_count++;
+            after_gap = true;
+        }
+        pos = next;
+    }
+
+    if (trailer_intact) {
+        result->intact = 1;
+        result->recovered_size = scan.size;
+        ret = 0;
+        goto done;
+    }
+
+    // Without a summary the file is still whole, only slower to describe
+    size_t summary_len = 0;
+    summary = summarize_blocks(&scan, &summary_len, &filters);
+    if (!summary) summary_len = 0;
+
+    offsets = (uint64_t*)malloc((scan.block_count ? scan.block_count : 1) * sizeof(uint64_t));
+    uint64_t end;
+    if (!offsets || compact_blocks(fd, &scan, offsets, &end) != 0) goto done;
+    size_t trailer_len;
+    trailer = build_trailer(&scan, offsets, end, result->message_count, summary, summary_len, filters, &trailer_len);
+    if (!trailer) goto done;
+
+    // The mapping must go before the file shrinks under it
+    munmap(map, (size_t)scan.size);
+    map = NULL;
+    if (ftruncate(fd, (off_t)end) != 0 || write_full_at(fd, trailer, trailer_len, end) != 0 || fdatasync(fd) != 0) {
+        goto done;
+    }
+    result->recovered_size = end + trailer_len;
+    ret = 0;
+
+done:
+    if (map) munmap(map, (size_t)scan.size);
+    close(fd);
+    free(trailer);
+    free(summary);
+    free(filters);
+    free(offsets);
+    free(scan.blocks);
+    free((void*)scan.channels);
+    free(scan.unpacked);
+    ZSTD_freeDCtx(scan.zstd);
+    return ret;
+}
+
+// Filtering. Chunks outside the time range, or whose topic filters rule out
+// the topics, are passed over by their index entries. Every other chunk is
+// decompressed to check its records against the topics (the reader's, from
+// zet_reader_set_topics()), and to add them to the output's summary; a chunk
+// whose records all pass is then copied into the output as it is, and one
+// that passes in part has those records written like any others. With dedup,
+// so is a chunk with references to payloads in other chunks, which may not
+// make it into the output; references within a chunk go with it.
+typedef struct {
+    zet_reader_t* reader;
+    zet_writer_t* writer;
+    uint64_t start_ns;
+    uint64_t end_ns;
+
+    // Records of the chunk being checked, and their channel IDs (version 3)
+    zet_message_view_t* views;
+    uint16_t* channels;
+    size_t view_cap;
+} filter_t;
+
+static bool filter_keeps(filter_t* f, const zet_message_view_t* view) {
+    return view->received_ns >= f->start_ns && view->received_ns <= f->end_ns && topic_wanted(f->reader, view->topic);
+}
+
+// Define a channel in the output with the ID it has in the input, so copied
+// chunks still name the right topics
+static int filter_channel(zet_writer_t* writer, uint16_t id, const char* topic) {
+    topic_table_t* topics = &writer->topics;
+    size_t len = strlen(topic);
+    topic_slot_t* slot = topic_find(topics, topic, len, topic_hash(topic, len));
+    if (slot) return slot->id == id ? 0 : -1;
+    if (!(slot = topic_intern(topics, topic, len, NULL))) return -1;
+    slot->id = id;
+    if (topic_set_channel(topics, id, slot->topic) != 0 ||
+        append_channel(&writer->new_channels, &writer->new_channels_len, &writer->new_channels_cap,
+                       id, topic, len) != 0) {
+        return -1;
+    }
+    writer->new_channel_count++;
+    return 0;
+}
+
+// Read every record of the chunk just loaded into f->views, resolving
+// references. *whole is cleared if any is to a payload in another chunk.
+static int filter_load_records(filter_t* f, size_t* count, bool* whole) {
+    zet_reader_t* reader = f->reader;
+    release_refs(reader);
+    size_t n = 0;
+    while (reader->chunk_pos < reader->chunk_len) {
+        if (n == f->view_cap) {
+            size_t cap = f->view_cap ? f->view_cap * 2 : 1024;
+            zet_message_view_t* views = (zet_message_view_t*)realloc(f->views, cap * sizeof(zet_message_view_t));
+            if (views) f->views = views;
+            uint16_t* ids = (uint16_t*)realloc(f->channels, cap * sizeof(uint16_t));
+            if (ids) f->channels = ids;
+            if (!views || !ids) return -1;
+            f->view_cap = cap;
+        }
+        if (read_view_chunked(reader, &f->views[n]) != 0) return -1;
+        if (reader->view_ref) {
+            zet_payload_ref_t ref;
+            memcpy(&ref, reader->view_ref, sizeof(ref));
+            if (!find_payload(reader, reader->chunk_data, reader->chunk_len, &ref, f->views[n].size)) *whole = false;
+            if (resolve_view(reader, &f->views[n]) != 0) return -1;
+        }
+        f->channels[n++] = reader->view_channel;
+    }
+    *count = n;
+    return 0;
+}
+
+static int filter_chunks(filter_t* f, int in_fd, zet_filter_result_t* result) {
+    zet_reader_t* reader = f->reader;
+    zet_writer_t* writer = f->writer;
+    bool channels = reader->header.version >= ZET_FORMAT_VERSION_3;
+    if (load_index(reader) != 0) return -1;
+
+    for (size_t i = 0; i < reader->index_count; i++) {
+        const zet_index_entry_t* entry = &reader->index[i];
+        size_t count;
+        if (entry->end_ns < f->start_ns || entry->start_ns > f->end_ns || (reader->chunk_skip && reader->chunk_skip[i])) {
+            result->chunks_skipped++;
+            continue;
+        }
+        bool whole = true;
+        if (source_seek(reader, entry->offset) != 0 || load_chunk_here(reader) != 0) return -1;
+        if (filter_load_records(f, &count, &whole) != 0) return -1;
+
+        size_t kept = 0;
+        for (size_t j = 0; j < count; j++) {
+            if (!filter_keeps(f, &f->views[j])) continue;
+            if (channels && filter_channel(writer, f->channels[j], f->views[j].topic) != 0) return -1;
+            kept++;
+        }
+        if (kept == 0) {
+            result->chunks_skipped++;
+            continue;
+        }
+        result->message_count += kept;
+
+        if (kept < count || !whole) {
+            for (size_t j = 0; j < count; j++) {
+                const zet_message_view_t* view = &f->views[j];
+                if (!filter_keeps(f, view)) continue;
+                if (write_message(writer, view->sent_ns, view->received_ns, view->topic, view->data, view->size) != 0) {
+                    return -1;
+                }
+            }
+            if (output_release(writer) != 0) return -1;
+            result->chunks_rewritten++;
+            continue;
+        }
+
+        // Summary and topic filter, looking each topic up once per run of it
+        uint8_t topics[ZET_TOPIC_FILTER_SIZE] = {0};
+        const char* last = NULL;
+        uint32_t id = 0;
+        for (size_t j = 0; j < count; j++) {
+            const zet_message_view_t* view = &f->views[j];
+            if (view->topic != last) {
+                uint32_t hash;
+                uint16_t topic_len = (uint16_t)(strlen(view->topic) + 1);
+                if (channels) {
+                    uint16_t channel;
+                    if (channel_for_topic(writer, view->topic, topic_len, &channel, &hash) != 0) return -1;
+                    id = channel;
+                } else if (id_for_topic(writer, view->topic, topic_len, &id, &hash) != 0) {
+                    return -1;
+                }
+                topic_filter_add(topics, ZET_TOPIC_FILTER_SIZE, hash);
+                last = view->topic;
+            }
+            if (summary_add(&writer->summary, id, view->received_ns, view->size) != 0) return -1;
+        }
+        zet_chunk_header_t header;
+        memcpy(&header, reader->map + entry->offset, sizeof(header));
+        if (write_chunk_copy(writer, &header, topics, in_fd, entry->offset, reader->map + entry->offset) != 0) {
+            return -1;
+        }
+        result->chunks_copied++;
+        result->bytes_copied += sizeof(header) + header.data_size;
+    }
+    return 0;
+}
+
+// Version 1: every record is read and written again
+static int filter_records(filter_t* f, zet_filter_result_t* result) {
+    zet_message_view_t views[256];
+    size_t count;
+    while ((count = zet_reader_read_views(f->reader, views, 256)) > 0) {
+        size_t kept = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (filter_keeps(f, &views[i])) views[kept++] = views[i];
+        }
+        if (zet_writer_write_batch(f->writer, views, kept) != 0) return -1;
+        result->message_count += kept;
+    }
+    return zet_reader_get_status(f->reader) == ZET_STATUS_OK ? 0 : -1;
+}
+
+int zet_filter(const char* input, const char* output, const zet_filter_options_t* options,
+               zet_filter_result_t* result) {
+    zet_filter_result_t unused;
+    zet_filter_options_t defaults = {0};
+    if (!result) result = &unused;
+    if (!options) options = &defaults;
+    memset(result, 0, sizeof(*result));
+    if (!input || !output || options->compression > ZET_COMPRESSION_ZSTD) return -1;
+    if (options->topic_count > 0 && !options->topics) return -1;
+
+    // Writing the output over the input would truncate it while it is read
+    struct stat in_st, out_st;
+    if (stat(input, &in_st) != 0) return -1;
+    if (stat(output, &out_st) == 0 && in_st.st_dev == out_st.st_dev && in_st.st_ino == out_st.st_ino) return -1;
+
+    filter_t f = {
+        .start_ns = options->start_ns,
+        .end_ns = options->end_ns ? options->end_ns : UINT64_MAX
+    };
+    int ret = -1;
+    int in_fd = open(input, O_RDONLY);
+    if (in_fd < 0 || !(f.reader = zet_reader_create_mmap(input))) goto done;
+    if (zet_reader_set_topics(f.reader, options->topics, options->topic_count) != 0) goto done;
+
+    uint32_t version = f.reader->header.version;
+    zet_writer_options_t writer_options = {
+        .version = version,
+        .compression = version == ZET_FORMAT_VERSION_1 ? ZET_COMPRESSION_NONE : options->compression,
+        .buffer_size = DEFAULT_OUTPUT_BUFFER,
+        .dedup_min_size = (f.reader->header.flags & ZET_FLAG_DEDUP) ? ZET_DEDUP_MIN_SIZE : 0
+    };
+    if (!(f.writer = zet_writer_create_ex(output, &writer_options))) goto done;
+
+    ret = version == ZET_FORMAT_VERSION_1 ? filter_records(&f, result) : filter_chunks(&f, in_fd, result);
+    if (ret == 0 && version != ZET_FORMAT_VERSION_1 && (write_chunk(f.writer) != 0 || write_index(f.writer) != 0)) {
+        ret = -1;
+    }
+    if (output_close(f.writer) != 0) ret = -1;
+    writer_free(f.writer);
+
+done:
+    if (in_fd >= 0) close(in_fd);
+    zet_reader_destroy(f.reader);
+    free(f.views);
+    free(f.channels);
+    return ret;
 }
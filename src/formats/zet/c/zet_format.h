@@ -5,37 +5,296 @@
 #include <stddef.h>
 #include <stdio.h>
 
+// Format versions. Version 1 is a flat stream of records after the header.
+// Version 2 groups the same records into chunks and ends with a chunk index,
+// so readers can seek by time without scanning the file:
+//
+//   zet_header_t
+//   { zet_chunk_header_t, records... }   one per chunk
+//   zet_index_header_t, zet_index_entry_t[chunk_count]
+//   zet_footer_t                         last bytes of the file
+//
+// A file whose writer never closed has no index or footer; readers then walk
+// the chunk headers instead, which is still one small read per chunk.
+//
+// Version 3 replaces the topic string in each record with a channel ID. A
+// channel block defining new IDs comes before the first chunk that uses them,
+// and a block with every channel follows the index:
+//
+//   zet_header_t
+//   { [zet_channel_header_t, channels...], zet_chunk_header_t, records... }
+//   zet_index_header_t, zet_index_entry_t[chunk_count]
+//   zet_channel_header_t, channels...
+//   zet_footer_t
+//
+// Version 4 lays the file out as version 3, but packs each record header in
+// a chunk into as few bytes as it needs. A control byte gives the width of
+// each field after it, so a reader knows where every field and the payload
+// start without looking at them byte by byte:
+//
+//   control     bits 0-2: width of the time delta (0, 1, 2, 3, 4, 5, 6 or 8
+//               bytes); bits 3-5: width of the send delta (0, 1, 2, 3, 4, 6
+//               or 8 bytes, or 7 for none: sent_ns is 0); bits 6-7: width
+//               of the payload size less one
+//   time delta  received_ns less that of the chunk's previous record (or
+//               0 for its first), zigzag-encoded, little-endian
+//   send delta  the send offset, received_ns - sent_ns, less that of the
+//               chunk's previous record with a sent_ns (or 0 for its
+//               first), zigzag-encoded, little-endian
+//   size        payload_size, little-endian
+//   channel     the channel ID as a LEB128 varint (1 to 3 bytes)
+//
+// A sent_ns that is unknown, equal to received_ns, or on a clock a fixed
+// distance from the receiver's costs nothing past the control byte, so a
+// small message received a millisecond after the last has a 6-byte header
+// instead of 22. Each chunk still decodes on its own.
+//
+// A closed chunked file also has a summary block just before the footer, with
+// per-topic counts and sizes, so tools can describe a recording without
+// reading its messages (see zet_reader_get_summary()).
+//
+// The index entries may be followed by a topic filter block: a small Bloom
+// filter of each chunk's topics, so readers after a few topics can pass over
+// chunks without reading them (see zet_reader_set_topics()). Readers that
+// predate it find the blocks after it through the footer, as before.
+//
+// Chunked files written with ZET_FLAG_DEDUP store a payload repeated from an
+// earlier record once: the repeats hold a zet_payload_ref_t naming the first
+// copy by its received time and hash, which holds up when recovery or
+// filtering moves chunks around.
+//
+// Chunked files written with ZET_FLAG_CHECKSUMS carry a CRC32C in each chunk
+// header. The chunk magic followed by a header whose checksum matches is also
+// a sync marker: after damage, zet_recover() finds the next intact chunk by
+// scanning for it.
+#define ZET_FORMAT_VERSION_1 1
+#define ZET_FORMAT_VERSION_2 2
+#define ZET_FORMAT_VERSION_3 3
+#define ZET_FORMAT_VERSION_4 4
+#define ZET_FORMAT_VERSION ZET_FORMAT_VERSION_4 // Written by default
+
+// Chunk compression (version 2 and later). LZ4 is cheap enough to run while recording;
+// zstd packs tighter at several times the CPU cost, for archival.
+#define ZET_COMPRESSION_NONE 0
+#define ZET_COMPRESSION_LZ4 1
+#define ZET_COMPRESSION_ZSTD 2
+
+// Writer output (see zet_writer_options_t). Both write from the writer's own
+// buffer; io_uring keeps several buffers in flight so the caller rarely waits
+// on the disk, and falls back to ZET_IO_POSIX where the kernel lacks it.
+#define ZET_IO_POSIX 0
+#define ZET_IO_URING 1
+
+// Writer durability
+#define ZET_SYNC_NONE 0      // Leave write-back to the OS
+#define ZET_SYNC_PERIODIC 1  // fdatasync() every sync_interval_ns
+#define ZET_SYNC_CHUNK 2     // fdatasync() after every chunk (every flush in version 1)
+
+// zet_header_t flags
+#define ZET_FLAG_CHECKSUMS 0x1U // Chunk headers hold a CRC32C (version 2 and later)
+#define ZET_FLAG_DEDUP 0x2U     // Records may repeat an earlier payload by reference (version 2 and later)
+
+#define ZET_CHUNK_MAGIC 0x4b48435aU  // "ZCHK"
+#define ZET_INDEX_MAGIC 0x5844495aU  // "ZIDX"
+#define ZET_FOOTER_MAGIC 0x444e455aU // "ZEND"
+#define ZET_CHANNEL_MAGIC 0x4e48435aU // "ZCHN"
+#define ZET_SUMMARY_MAGIC 0x4d55535aU // "ZSUM"
+#define ZET_TOPIC_FILTER_MAGIC 0x504f545aU // "ZTOP"
+
 // .zet file format header
 typedef struct {
     char magic[4];           // "ZET\0"
-    uint32_t version;        // File format version (1)
+    uint32_t version;        // File format version (1 to 4)
     uint64_t start_time_ns;  // Recording start time
-    uint8_t reserved[16];    // Future use
+    uint32_t flags;          // ZET_FLAG_*
+    uint8_t reserved[12];    // Future use
 } zet_header_t;
 
 // Message record in .zet file
 typedef struct {
     uint64_t sent_ns;        // When publisher sent (0 if unknown)
     uint64_t received_ns;    // When timeskip received
-    uint16_t topic_len;      // Length of topic string (including null terminator)
+    uint16_t topic_len;      // Length of topic string (including null terminator);
+                             // the channel ID in version 3 and later
     uint32_t payload_size;   // Size of payload in bytes
     // Followed by:
-    // - topic (topic_len bytes, null-terminated)
+    // - topic (topic_len bytes, null-terminated; none in version 3 and later)
     // - payload (payload_size bytes)
 } zet_message_header_t;
 
+// Size of a record header on disk (the fields above, unpadded) before version 4
+#define ZET_RECORD_HEADER_SIZE 22
+
+// With ZET_FLAG_DEDUP, a record whose payload_size has ZET_PAYLOAD_REF set
+// holds a zet_payload_ref_t in place of its payload, and payload_size without
+// the bit is the size of the payload it repeats: that of an earlier record
+// received at received_ns, of that size and with that XXH64 hash (seed 0),
+// which is not itself a reference. Payloads in such files stay under 2 GiB.
+#define ZET_PAYLOAD_REF 0x80000000U
+
+typedef struct {
+    uint64_t received_ns;    // The record holding the payload
+    uint64_t hash;           // XXH64 of the payload
+} zet_payload_ref_t;
+
+// Version 2+ chunk, followed by data_size bytes of records, compressed as a
+// whole unless compression is ZET_COMPRESSION_NONE
+typedef struct {
+    uint32_t magic;          // ZET_CHUNK_MAGIC
+    uint32_t message_count;
+    uint64_t start_ns;       // Earliest received_ns in the chunk
+    uint64_t end_ns;         // Latest received_ns in the chunk
+    uint64_t data_size;      // Bytes stored in the file after this header
+    uint32_t compression;    // ZET_COMPRESSION_*
+    uint32_t crc;            // With ZET_FLAG_CHECKSUMS: CRC32C of this header (crc 0) and the data
+    uint64_t raw_size;       // Bytes of records once decompressed
+} zet_chunk_header_t;
+
+// Version 2+ chunk index, written when the writer is destroyed
+typedef struct {
+    uint32_t magic;          // ZET_INDEX_MAGIC
+    uint32_t chunk_count;
+} zet_index_header_t;
+
+typedef struct {
+    uint64_t offset;         // File offset of the chunk header
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint32_t message_count;
+    uint32_t reserved;
+} zet_index_entry_t;
+
+// Version 2+ topic filters, optional, just after the index entries: one
+// filter_size byte Bloom filter per chunk, in index order. A topic with
+// FNV-1a hash h sets bits (h + i * ((h >> 17 | h << 15) | 1)) % (8 * filter_size)
+// for i = 0, 1, 2, bit b being (filter[b / 8] >> (b % 8)) & 1.
+typedef struct {
+    uint32_t magic;          // ZET_TOPIC_FILTER_MAGIC
+    uint32_t filter_size;    // Bytes per chunk
+    uint64_t data_size;      // chunk_count * filter_size
+} zet_topic_filter_header_t;
+
+#define ZET_TOPIC_FILTER_SIZE 32 // What writers use: under 1% false positives up to 20 topics a chunk
+
+typedef struct {
+    uint32_t magic;          // ZET_FOOTER_MAGIC
+    uint32_t summary_size;   // Bytes of the summary block just before the footer (0 if none)
+    uint64_t index_offset;   // File offset of the zet_index_header_t
+    uint64_t message_count;  // Messages in the whole file
+    uint64_t channel_offset; // File offset of the full channel block (version 3 and later)
+} zet_footer_t;
+
+// Version 3 channel block, followed by data_size bytes of channels, each a
+// uint16_t ID, a uint16_t topic length (including null terminator) and the topic
+typedef struct {
+    uint32_t magic;          // ZET_CHANNEL_MAGIC
+    uint32_t channel_count;
+    uint64_t data_size;
+} zet_channel_header_t;
+
+#define ZET_MAX_CHANNELS 65536
+
+// Version 2+ summary block, followed by topic_count entries, each a
+// zet_summary_entry_t and the topic
+typedef struct {
+    uint32_t magic;          // ZET_SUMMARY_MAGIC
+    uint32_t topic_count;
+    uint64_t data_size;
+    uint64_t start_ns;       // Earliest received_ns in the file
+    uint64_t end_ns;         // Latest received_ns in the file
+} zet_summary_header_t;
+
+typedef struct {
+    uint64_t message_count;
+    uint64_t payload_bytes;
+    uint64_t first_ns;       // Earliest received_ns on the topic
+    uint64_t last_ns;        // Latest received_ns on the topic
+    uint32_t min_size;       // Smallest payload
+    uint32_t max_size;       // Largest payload
+    uint16_t topic_len;      // Including null terminator
+    uint16_t reserved[3];
+} zet_summary_entry_t;
+
+// A message that refers to data it does not own: what
+// zet_writer_write_batch() takes, and what zet_reader_read_view() returns.
+// Views from a reader have an interned topic, as in zet_message_t, and data
+// pointing into the reader's buffers, valid until the next read or seek.
+typedef struct {
+    uint64_t sent_ns;
+    uint64_t received_ns;
+    const char* topic;
+    const void* data;
+    size_t size;
+} zet_message_view_t;
+
 // Writer API
 typedef struct zet_writer_s zet_writer_t;
 
+// Zero-initialized fields take the defaults
+typedef struct {
+    uint32_t version;            // ZET_FORMAT_VERSION_1 to _4 (default ZET_FORMAT_VERSION)
+    size_t chunk_size;           // Close a chunk at this many bytes of records (default 1 MiB)
+    uint64_t chunk_duration_ns;  // ...or once it spans this much received time (default 1 s)
+    uint32_t compression;        // ZET_COMPRESSION_* for each chunk (version 2 and later)
+    int compression_level;       // zstd level (default 3); ignored by LZ4
+    size_t buffer_size;          // Write through a buffer of this many bytes (at least 64 KiB) with
+                                 // one writev() each time it fills, instead of stdio (default stdio,
+                                 // or 1 MiB if any of the options below need a buffer)
+    uint32_t io;                 // ZET_IO_* (default ZET_IO_POSIX)
+    uint32_t direct;             // Nonzero: O_DIRECT where the file system supports it
+    uint64_t preallocate_size;   // Reserve disk space this far ahead of the data (default none)
+    uint32_t sync;               // ZET_SYNC_* (default ZET_SYNC_NONE)
+    uint64_t sync_interval_ns;   // For ZET_SYNC_PERIODIC (default 1 s)
+    uint64_t segment_size;       // Rotate: start a new segment file once about this many bytes are written
+    uint64_t segment_duration_ns;// ...or before a message this much later than the segment's first
+                                 // (default: one file). See "Rotation" below.
+    uint32_t dedup_min_size;     // Version 2 and later: store a payload of at least this many bytes
+                                 // once, and its repeats as references (default 0: off). The
+                                 // writer remembers up to ZET_DEDUP_PAYLOADS distinct payloads,
+                                 // and a reader keeps as many resolved.
+} zet_writer_options_t;
+
+#define ZET_DEDUP_PAYLOADS 4096
+#define ZET_DEDUP_MIN_SIZE 1024   // A sensible dedup_min_size, used by zet_filter and timeskip
+
 zet_writer_t* zet_writer_create(const char* filename);
+zet_writer_t* zet_writer_create_ex(const char* filename, const zet_writer_options_t* options);
 void zet_writer_destroy(zet_writer_t* writer);
-int zet_writer_write_message(zet_writer_t* writer, 
+int zet_writer_write_message(zet_writer_t* writer,
                               uint64_t sent_ns,
                               uint64_t received_ns,
                               const char* topic,
                               const void* data,
                               size_t size);
+// Write count messages in order, stopping at the first that fails. With
+// buffer_size set, a batch that fits the buffer costs at most one writev().
+int zet_writer_write_batch(zet_writer_t* writer, const zet_message_view_t* messages, size_t count);
+// Closes the current chunk (version 2 and later) and hands everything written to the OS
 void zet_writer_flush(zet_writer_t* writer);
+// Bytes the file takes so far (across the segments, with rotation): the
+// header and every chunk or record written out, as stored, so compressed
+// when compression is on. The chunk still being filled counts once it is
+// closed (zet_writer_flush()), the index and footer once the writer is
+// destroyed.
+uint64_t zet_writer_get_bytes_written(zet_writer_t* writer);
+// The ZET_IO_* actually in use: ZET_IO_POSIX if io_uring was asked for but unavailable
+uint32_t zet_writer_get_io(zet_writer_t* writer);
+
+// Rotation: with segment_size or segment_duration_ns set, filename names a
+// manifest, a text file holding ZET_MANIFEST_MAGIC and then one segment file
+// name per line. Segments sit next to it, named after it without its
+// extension, e.g. mission.zetm lists mission.0000.zet, mission.0001.zet...
+// Each message lands in exactly one segment, and each segment is a complete
+// recording of its own. A segment is listed before anything is written to
+// it, and the previous one is closed on a thread of its own, so rotating
+// costs the writing thread no more than opening a file.
+#define ZET_MANIFEST_MAGIC "zet-manifest 1"
+
+// The segments a manifest lists, in order, as paths usable from the current
+// directory. Segments since deleted are left out. Returns -1 if filename is
+// not a manifest. Release with zet_manifest_free().
+int zet_manifest_read(const char* filename, char*** segments, size_t* count);
+void zet_manifest_free(char** segments, size_t count);
 
 // Reader API (for future playback)
 typedef struct zet_reader_s zet_reader_t;
@@ -43,15 +302,188 @@ typedef struct zet_reader_s zet_reader_t;
 typedef struct {
     uint64_t sent_ns;
     uint64_t received_ns;
-    char* topic;
-    void* data;
+    const char* topic;       // Interned by the reader, valid until zet_reader_destroy()
+    void* data;              // Owned by the message, released by zet_message_free()
     size_t size;
 } zet_message_t;
 
 zet_reader_t* zet_reader_create(const char* filename);
+// Map the whole file instead of reading it through stdio. Views of
+// uncompressed records then point straight into the mapping and stay valid
+// until zet_reader_destroy(). The file must not shrink while mapped.
+zet_reader_t* zet_reader_create_mmap(const char* filename);
+
+// Zero-initialized fields take the defaults
+typedef struct {
+    uint32_t mmap;           // Nonzero: map the file, as zet_reader_create_mmap()
+    uint32_t threads;        // Chunked files: verify and decompress chunks on this many worker threads,
+                             // fed by a thread reading ahead; messages still come in file order
+                             // (default 0: everything on the calling thread)
+    uint32_t read_ahead;     // With threads: chunks in flight (default 2 per thread, plus 2)
+    uint32_t follow;         // Nonzero: read a recording still being written. See "Following" below.
+    uint64_t follow_timeout_ns; // With follow: stop after waiting this long for new records
+                                // (default 0: wait until the writer closes the file)
+} zet_reader_options_t;
+
+// Following: at the end of what has been written so far, a following reader
+// waits for the file to grow instead of stopping, woken by inotify as the
+// writer's data reaches the OS (whether the writer is in this process or
+// another), or looking again every 10 ms where inotify is unavailable. Only
+// whole records are returned: a record or chunk cut off at the end is left
+// to be read once the rest of it arrives. Records reach the file as chunks
+// close and when the writer flushes, so chunk_duration_ns bounds how far
+// a follower lags behind. Reading ends, with ZET_STATUS_OK, at the index a
+// chunked file is closed with; a version 1 file has no such end, so it is
+// followed until follow_timeout_ns passes without a new record. A timeout, or
+// a signal during a wait, stops with ZET_STATUS_PENDING, and reading again
+// carries on. Seeks and topic sets see the chunks written when first used.
+// Following reads through stdio: mmap is ignored.
+
+zet_reader_t* zet_reader_create_ex(const char* filename, const zet_reader_options_t* options);
 void zet_reader_destroy(zet_reader_t* reader);
 int zet_reader_read_message(zet_reader_t* reader, zet_message_t* msg);
+int zet_reader_read_view(zet_reader_t* reader, zet_message_view_t* view);
+// Read into a buffer the caller keeps across calls: msg->data holds *capacity
+// bytes and is reallocated, updating *capacity, only when a payload does not
+// fit. Start with msg->data NULL and *capacity 0; release with zet_message_free().
+int zet_reader_read_message_into(zet_reader_t* reader, zet_message_t* msg, size_t* capacity);
+// Read up to max messages at once, from one large read or chunk. All of the
+// views stay valid until the next read or seek. Returns how many were read,
+// 0 at end of file.
+size_t zet_reader_read_views(zet_reader_t* reader, zet_message_view_t* views, size_t max);
 void zet_message_free(zet_message_t* msg);
 uint64_t zet_reader_get_start_time(zet_reader_t* reader);
+uint32_t zet_reader_get_version(zet_reader_t* reader);
+
+// Why the last read returned no message
+#define ZET_STATUS_OK 0         // Clean end of file (or not stopped)
+#define ZET_STATUS_TRUNCATED 1  // The file ends part way through a record or chunk, or
+                                // (version 2 and later) without its index: see zet_recover()
+#define ZET_STATUS_CORRUPT 2    // A checksum, length or block does not match
+#define ZET_STATUS_ERROR 3      // Out of memory or a read error
+#define ZET_STATUS_PENDING 4    // Following: nothing new within follow_timeout_ns, or a signal
+int zet_reader_get_status(zet_reader_t* reader);
+
+typedef struct {
+    const char* topic;       // Interned, as in zet_message_t
+    uint64_t message_count;
+    uint64_t payload_bytes;
+    uint64_t first_ns;       // Earliest and latest received_ns
+    uint64_t last_ns;
+    uint32_t min_size;       // Payload sizes
+    uint32_t max_size;
+    double mean_size;
+} zet_topic_summary_t;
+
+typedef struct {
+    uint64_t message_count;
+    uint64_t payload_bytes;
+    uint64_t start_ns;       // Earliest and latest received_ns: end_ns - start_ns is the duration
+    uint64_t end_ns;
+    size_t topic_count;
+    const zet_topic_summary_t* topics; // In order of first appearance, valid until zet_reader_destroy()
+} zet_summary_t;
+
+// What the writer noted about the file as it closed it, read from the end of
+// the file without touching the messages or the read position. Returns -1 if
+// there is none: version 1 files, and files never closed (until zet_recover()).
+int zet_reader_get_summary(zet_reader_t* reader, zet_summary_t* summary);
+
+// Return only messages on these topics from now on (count 0: every topic
+// again). Chunks whose topic filter rules all of them out are passed over
+// without being read or decompressed; files without topic filters are still
+// read whole. Best called before reading, or just before a seek.
+int zet_reader_set_topics(zet_reader_t* reader, const char* const* topics, size_t count);
+
+// Position the reader so the next read returns the first message, in file
+// order, with received_ns >= time_ns (or end of file if there is none).
+// Chunked files binary-search the chunk index; version 1 files are scanned.
+int zet_reader_seek_time(zet_reader_t* reader, uint64_t time_ns);
+
+// Merged reading: several recordings (from several machines, or segments of
+// one) read as one timeline, in received_ns order across the files (ties in
+// the order the files were given). Each file keeps one chunk or batch in
+// memory at a time. A manifest's segments are read one after another, each
+// opened as the one before it ends, so a manifest holds one file (and one
+// set of reader threads) open however many segments it has. Topics are
+// interned across all of the files, so the same topic has the same address
+// whichever file it came from.
+typedef struct zet_merge_reader_s zet_merge_reader_t;
+
+// options (may be NULL) apply to each file. A manifest among filenames
+// stands for its segments, so a rotated recording reads as one. Fails if a
+// file, or the first segment of a manifest, cannot be opened; a later segment
+// that cannot be opened is passed over, with ZET_STATUS_ERROR.
+zet_merge_reader_t* zet_merge_reader_create(const char* const* filenames, size_t count,
+                                            const zet_reader_options_t* options);
+void zet_merge_reader_destroy(zet_merge_reader_t* merge);
+int zet_merge_reader_read_view(zet_merge_reader_t* merge, zet_message_view_t* view);
+// As zet_reader_read_views(): the views stay valid until the next read or
+// seek. Returns 0 once every file has ended; a file that stops early (see
+// zet_reader_get_status() on zet_merge_reader_get_reader()) just ends sooner.
+size_t zet_merge_reader_read_views(zet_merge_reader_t* merge, zet_message_view_t* views, size_t max);
+// The earliest start time of the files
+uint64_t zet_merge_reader_get_start_time(zet_merge_reader_t* merge);
+// How many files, counting each segment of a manifest. The files are numbered
+// from 0 in the order given, a manifest's segments in its order.
+size_t zet_merge_reader_get_count(zet_merge_reader_t* merge);
+// The reader of one file, for its version or summary, or NULL unless the file
+// is open (segments are opened in turn). Reading or seeking it directly leaves
+// the merge in an undefined state.
+zet_reader_t* zet_merge_reader_get_reader(zet_merge_reader_t* merge, size_t index);
+// The path of one file (a segment's, for a manifest), valid until
+// zet_merge_reader_destroy()
+const char* zet_merge_reader_get_path(zet_merge_reader_t* merge, size_t index);
+// Why one file stopped returning messages, as zet_reader_get_status():
+// ZET_STATUS_OK for a segment not reached yet
+int zet_merge_reader_get_status(zet_merge_reader_t* merge, size_t index);
+// Seek every file, as zet_reader_seek_time(), a manifest's segments from the
+// first that has messages from time_ns on
+int zet_merge_reader_seek_time(zet_merge_reader_t* merge, uint64_t time_ns);
+
+// Recovery
+typedef struct {
+    uint64_t file_size;      // Before recovery
+    uint64_t recovered_size; // After
+    uint64_t message_count;  // Messages kept
+    uint64_t chunk_count;    // Chunks kept (version 2 and later)
+    uint64_t dropped_bytes;  // Torn tail and damaged regions cut out
+    uint32_t damaged_count;  // Damaged regions skipped before the end (needs ZET_FLAG_CHECKSUMS)
+    int intact;              // Nonzero: nothing needed doing and the file was left alone
+} zet_recover_result_t;
+
+// Repair a recording in place after a crash or power loss: drop a torn tail
+// (version 1: the partial last record), cut out damaged chunks between intact
+// ones, and write a fresh index and footer. One sequential pass over the
+// file; an intact file is not written to. Returns -1 if the file is not a
+// .zet file or cannot be written.
+int zet_recover(const char* filename, zet_recover_result_t* result);
+
+// Filtering. Zero-initialized fields keep everything.
+typedef struct {
+    const char* const* topics; // Keep only these topics (NULL: every topic)
+    size_t topic_count;
+    uint64_t start_ns;         // Keep messages received in [start_ns, end_ns]
+    uint64_t end_ns;           // 0: no end
+    uint32_t compression;      // ZET_COMPRESSION_* for chunks that are re-encoded
+} zet_filter_options_t;
+
+typedef struct {
+    uint64_t message_count;    // Messages kept
+    uint64_t chunks_copied;    // Kept whole, copied byte for byte
+    uint64_t chunks_rewritten; // Kept in part, re-encoded
+    uint64_t chunks_skipped;   // Nothing kept
+    uint64_t bytes_copied;
+} zet_filter_result_t;
+
+// Write the messages of input that pass the options to a new recording of
+// the same version. Chunks entirely kept are copied as they are (inside the
+// kernel where it can), so their data is never re-compressed; chunks outside
+// the time range are passed over by the index alone; only chunks kept in
+// part are re-encoded. Version 3 output keeps the input's channel IDs.
+// Version 1 files are read and rewritten message by message. Returns -1 if
+// either file cannot be used, or the input is damaged (see zet_recover()).
+int zet_filter(const char* input, const char* output, const zet_filter_options_t* options,
+               zet_filter_result_t* result);
 
 #endif // ZET_FORMAT_H
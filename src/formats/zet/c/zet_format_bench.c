@@ -0,0 +1,468 @@
+#include "zet_format.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Benchmarks for the .zet writer and reader
+//
+// Compression: writes a sensor-like recording with each chunk compression and
+// reports write and read throughput, file size, and the longest single
+// zet_writer_write_message() call. The recorder's writer thread must drain its
+// buffer (RECORDER_BUFFER messages) faster than RECORD_RATE fills it,
+// and a stall while a chunk is compressed must not overflow the buffer. Reads
+// are timed on the calling thread and with READ_THREADS threads decompressing
+// chunks ahead of it.
+//
+// Writing: sustained throughput of a version 1 and a chunked recording
+// written through stdio, and through the writer's own buffer one message or
+// one batch at a time, including closing the file; then batches through
+// io_uring, with O_DIRECT, and with O_DIRECT and a periodic fdatasync(). The
+// longest single call is where a recorder's writer thread would stall.
+//
+// Iteration: reads one recording with zet_reader_read_message(),
+// zet_reader_read_message_into(), zet_reader_read_view() and
+// zet_reader_read_views(), through stdio and through a mapping, as a version 1
+// and a chunked file, next to a memcpy of the same number of bytes as a
+// memory bandwidth reference.
+//
+// Record headers: bytes on disk per message as a version 3 and a chunked
+// file, with sent_ns equal to received_ns, unknown (0, as the recorder
+// writes for unbatched messages), and taken from CLOCK_REALTIME next to a
+// monotonic received_ns, as a batching publisher on another clock would.
+//
+// Seeking: writes the same recording as a version 1 and a chunked file,
+// then times random zet_reader_seek_time() calls (each followed by one read).
+//
+// Recovery: zet_recover() on the chunked file as left by a crash (cut part way
+// through a chunk, no index), with every chunk checksummed.
+//
+// Usage: zet_format_bench [message count] [payload size] [directory]
+
+#define CHUNKED_SEEKS 10000
+#define V1_SEEKS 20
+#define RECORD_RATE 200e6         // Bytes per second the recorder must sustain
+#define RECORDER_BUFFER 100000    // Messages buffered by the recorder by default
+#define WRITE_BUFFER (4 * 1024 * 1024) // The recorder's writer buffer
+#define WRITE_BATCH 1000          // Messages per batch, as the recorder drains them
+#define READ_THREADS 4U           // Decompression threads for the parallel read
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Fill a payload like an IMU or joint state sample: slowly drifting 16-bit
+// channels with a little noise
+static void fill_sample(uint8_t* payload, size_t size, size_t i, uint32_t* noise) {
+    for (size_t j = 0; j + 1 < size; j += 2) {
+        *noise = *noise * 1103515245U + 12345U;
+        int16_t value = (int16_t)(1000 * (int)(j % 7) + (int)(i / 16) + (int)((*noise >> 16) & 3));
+        memcpy(payload + j, &value, sizeof(value));
+    }
+}
+
+// Read a whole recording, on the calling thread or with threads decompressing
+// chunks ahead of it. Returns how many messages were read.
+static size_t read_all(const char* filename, uint32_t threads, uint64_t* elapsed) {
+    zet_reader_options_t options = { .threads = threads };
+    zet_reader_t* reader = zet_reader_create_ex(filename, &options);
+    if (!reader) return 0;
+    zet_message_view_t views[256];
+    size_t read = 0;
+    size_t n;
+    uint64_t start = now_ns();
+    while ((n = zet_reader_read_views(reader, views, 256)) > 0) read += n;
+    *elapsed = now_ns() - start;
+    zet_reader_destroy(reader);
+    return read;
+}
+
+static void bench_compression(const char* filename, uint32_t compression, const char* name,
+                              size_t count, size_t size) {
+    zet_writer_options_t options = { .compression = compression };
+    zet_writer_t* writer = zet_writer_create_ex(filename, &options);
+    if (!writer) {
+        fprintf(stderr, "Failed to create %s\n", filename);
+        return;
+    }
+
+    uint8_t* payload = (uint8_t*)calloc(1, size);
+    uint32_t noise = 1;
+    uint64_t worst = 0;
+    uint64_t busy = 0;
+    for (size_t i = 0; i < count; i++) {
+        fill_sample(payload, size, i, &noise);
+        uint64_t t = 1000000000ULL + (uint64_t)i * 1000000ULL;
+        uint64_t start = now_ns();
+        zet_writer_write_message(writer, t, t, "bench/imu", payload, size);
+        uint64_t elapsed = now_ns() - start;
+        busy += elapsed;
+        if (elapsed > worst) worst = elapsed;
+    }
+    uint64_t start = now_ns();
+    zet_writer_destroy(writer);
+    busy += now_ns() - start;
+
+    FILE* f = fopen(filename, "rb");
+    fseeko(f, 0, SEEK_END);
+    double file_size = (double)ftello(f);
+    fclose(f);
+
+    uint64_t read_ns;
+    uint64_t parallel_ns;
+    size_t read = read_all(filename, 0, &read_ns);
+    size_t parallel_read = read_all(filename, READ_THREADS, &parallel_ns);
+
+    double raw = (double)count * (double)size;
+    double write_rate = raw / (busy / 1e9);
+    // Messages arriving during the longest stall, at RECORD_RATE
+    double backlog = RECORD_RATE / (double)size * (worst / 1e9);
+    printf("%-5s write %7.0f MB/s (%4.1fx needed)  read %7.0f MB/s (%7.0f MB/s with %u threads)  ratio %5.2f  "
+           "max stall %6.2f ms (%3.0f%% of buffer)%s\n",
+           name, write_rate / 1e6, write_rate / RECORD_RATE, raw / (read_ns / 1e9) / 1e6,
+           raw / (parallel_ns / 1e9) / 1e6, READ_THREADS, raw / file_size, worst / 1e6,
+           100.0 * backlog / RECORDER_BUFFER,
+           read != count || parallel_read != count ? "  [wrong results]"
+           : write_rate < RECORD_RATE              ? "  [slower than recording]"
+                                                   : "");
+    free(payload);
+    unlink(filename);
+}
+
+#define BATCH 256 // Views per zet_reader_read_views() call
+
+typedef enum { READ_MESSAGE, READ_MESSAGE_INTO, READ_VIEW, READ_VIEWS } read_mode_t;
+
+static void bench_iterate(const char* filename, read_mode_t mode, bool use_mmap, const char* name) {
+    zet_reader_t* reader = use_mmap ? zet_reader_create_mmap(filename) : zet_reader_create(filename);
+    if (!reader) {
+        fprintf(stderr, "Failed to open %s\n", filename);
+        return;
+    }
+
+    // Touch every payload so nothing is skipped
+    size_t count = 0;
+    size_t bytes = 0;
+    uint64_t checksum = 0;
+    uint64_t start = now_ns();
+    if (mode == READ_MESSAGE) {
+        zet_message_t msg;
+        while (zet_reader_read_message(reader, &msg) == 0) {
+            for (size_t i = 0; i < msg.size; i += 64) checksum += ((const uint8_t*)msg.data)[i];
+            bytes += msg.size;
+            count++;
+            zet_message_free(&msg);
+        }
+    } else if (mode == READ_MESSAGE_INTO) {
+        zet_message_t msg = {0};
+        size_t capacity = 0;
+        while (zet_reader_read_message_into(reader, &msg, &capacity) == 0) {
+            for (size_t i = 0; i < msg.size; i += 64) checksum += ((const uint8_t*)msg.data)[i];
+            bytes += msg.size;
+            count++;
+        }
+        zet_message_free(&msg);
+    } else if (mode == READ_VIEW) {
+        zet_message_view_t view;
+        while (zet_reader_read_view(reader, &view) == 0) {
+            for (size_t i = 0; i < view.size; i += 64) checksum += ((const uint8_t*)view.data)[i];
+            bytes += view.size;
+            count++;
+        }
+    } else {
+        zet_message_view_t views[BATCH];
+        size_t n;
+        while ((n = zet_reader_read_views(reader, views, BATCH)) > 0) {
+            for (size_t j = 0; j < n; j++) {
+                for (size_t i = 0; i < views[j].size; i += 64) checksum += ((const uint8_t*)views[j].data)[i];
+                bytes += views[j].size;
+            }
+            count += n;
+        }
+    }
+    uint64_t elapsed = now_ns() - start;
+    uint32_t version = zet_reader_get_version(reader);
+    zet_reader_destroy(reader);
+
+    printf("v%u %-24s %9.2f M msg/s  %6.2f GB/s  (checksum %llu)\n", version, name, count / (elapsed / 1e9) / 1e6,
+           bytes / (elapsed / 1e9) / 1e9, (unsigned long long)checksum);
+}
+
+static void bench_memcpy(size_t bytes) {
+    uint8_t* src = (uint8_t*)malloc(bytes);
+    uint8_t* dst = (uint8_t*)malloc(bytes);
+    if (!src || !dst) {
+        free(src);
+        free(dst);
+        return;
+    }
+    memset(src, 1, bytes);
+    memset(dst, 0, bytes);
+    uint64_t elapsed = UINT64_MAX;
+    for (int i = 0; i < 3; i++) {
+        uint64_t start = now_ns();
+        memcpy(dst, src, bytes);
+        uint64_t t = now_ns() - start;
+        if (t < elapsed) elapsed = t;
+    }
+    printf("%-27s %9s           %6.2f GB/s  (check %d)\n", "memcpy reference", "", bytes / (elapsed / 1e9) / 1e9,
+           dst[bytes / 2]);
+    free(src);
+    free(dst);
+}
+
+typedef enum {
+    WRITE_STDIO,
+    WRITE_BUFFERED,
+    WRITE_BUFFERED_BATCH,
+    WRITE_URING_BATCH,
+    WRITE_DIRECT_BATCH,
+    WRITE_DIRECT_SYNC_BATCH
+} write_mode_t;
+
+static void bench_write(const char* filename, uint32_t version, write_mode_t mode, const char* name,
+                        size_t count, size_t size) {
+    zet_writer_options_t options = {
+        .version = version,
+        .buffer_size = mode == WRITE_STDIO ? 0 : WRITE_BUFFER,
+        .io = mode >= WRITE_URING_BATCH ? ZET_IO_URING : ZET_IO_POSIX,
+        .direct = mode >= WRITE_DIRECT_BATCH,
+        .sync = mode == WRITE_DIRECT_SYNC_BATCH ? ZET_SYNC_PERIODIC : ZET_SYNC_NONE
+    };
+    uint8_t* payload = (uint8_t*)calloc(1, size);
+    zet_message_view_t* batch = (zet_message_view_t*)calloc(WRITE_BATCH, sizeof(zet_message_view_t));
+    if (!payload || !batch) {
+        free(payload);
+        free(batch);
+        return;
+    }
+
+    uint64_t start = now_ns();
+    zet_writer_t* writer = zet_writer_create_ex(filename, &options);
+    if (!writer) {
+        fprintf(stderr, "Failed to create %s\n", filename);
+        free(payload);
+        free(batch);
+        return;
+    }
+    int failed = 0;
+    uint64_t worst = 0;
+    for (size_t i = 0; i < count;) {
+        size_t n = count - i < WRITE_BATCH ? count - i : WRITE_BATCH;
+        for (size_t j = 0; j < n; j++) {
+            uint64_t t = 1000000000ULL + (uint64_t)(i + j) * 1000000ULL;
+            batch[j] = (zet_message_view_t){ .sent_ns = t, .received_ns = t, .topic = "bench/data",
+                                             .data = payload, .size = size };
+        }
+        if (mode >= WRITE_BUFFERED_BATCH) {
+            uint64_t call = now_ns();
+            failed |= zet_writer_write_batch(writer, batch, n);
+            call = now_ns() - call;
+            if (call > worst) worst = call;
+        } else {
+            for (size_t j = 0; j < n; j++) {
+                uint64_t call = now_ns();
+                failed |= zet_writer_write_message(writer, batch[j].sent_ns, batch[j].received_ns, batch[j].topic,
+                                                   batch[j].data, batch[j].size);
+                call = now_ns() - call;
+                if (call > worst) worst = call;
+            }
+        }
+        i += n;
+    }
+    zet_writer_destroy(writer);
+    uint64_t elapsed = now_ns() - start;
+
+    printf("v%u %-30s %9.2f M msg/s  %6.2f GB/s  max call %7.2f ms%s\n", version, name,
+           count / (elapsed / 1e9) / 1e6, (double)count * (double)size / (elapsed / 1e9) / 1e9, worst / 1e6,
+           failed ? "  [failed]" : "");
+    free(payload);
+    free(batch);
+    unlink(filename);
+}
+
+typedef enum {
+    SENT_RECEIVED,
+    SENT_UNKNOWN,
+    SENT_REALTIME
+} sent_clock_t;
+
+static void bench_header_size(const char* filename, uint32_t version, sent_clock_t clock, const char* name,
+                              size_t count, size_t size) {
+    zet_writer_options_t options = { .version = version };
+    zet_writer_t* writer = zet_writer_create_ex(filename, &options);
+    uint8_t* payload = (uint8_t*)calloc(1, size ? size : 1);
+    if (!writer || !payload) {
+        if (writer) zet_writer_destroy(writer);
+        free(payload);
+        return;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t epoch = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    uint32_t jitter = 1;
+    for (size_t i = 0; i < count; i++) {
+        // 1 kHz of messages, sent 20-120 us before they are received
+        uint64_t t = 1000000000ULL + (uint64_t)i * 1000000ULL;
+        jitter = jitter * 1103515245U + 12345U;
+        uint64_t sent_ns = clock == SENT_RECEIVED ? t
+                         : clock == SENT_UNKNOWN  ? 0
+                                                  : epoch + t - 20000 - (jitter >> 16) % 100000;
+        zet_writer_write_message(writer, sent_ns, t, "bench/data", payload, size);
+    }
+    zet_writer_destroy(writer);
+
+    struct stat st;
+    long bytes = stat(filename, &st) == 0 ? (long)st.st_size : 0;
+    printf("v%u headers, sent %-10s %12ld B on disk, %5.2f B/message past the payload\n", version, name, bytes,
+           count ? ((double)bytes - (double)count * (double)size) / (double)count : 0.0);
+    free(payload);
+    unlink(filename);
+}
+
+static int write_file(const char* filename, uint32_t version, size_t count, size_t size) {
+    zet_writer_options_t options = { .version = version };
+    zet_writer_t* writer = zet_writer_create_ex(filename, &options);
+    if (!writer) return -1;
+
+    uint8_t* payload = (uint8_t*)calloc(1, size);
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < count; i++) {
+        // 1 kHz of messages
+        uint64_t t = 1000000000ULL + (uint64_t)i * 1000000ULL;
+        zet_writer_write_message(writer, t, t, "bench/data", payload, size);
+    }
+    zet_writer_destroy(writer);
+    uint64_t elapsed = now_ns() - start;
+
+    struct stat st;
+    double file_mb = stat(filename, &st) == 0 ? st.st_size / 1e6 : 0;
+    printf("v%u write  %zu messages of %zu B in %.2f s (%.1f MB/s), %.1f MB on disk\n", version, count, size,
+           elapsed / 1e9, (double)count * (double)size / (elapsed / 1e9) / 1e6, file_mb);
+    free(payload);
+    return 0;
+}
+
+static void bench_recover(const char* filename) {
+    FILE* f = fopen(filename, "rb");
+    if (!f) return;
+    fseeko(f, 0, SEEK_END);
+    off_t size = ftello(f);
+    fclose(f);
+    if (truncate(filename, size - size / 100) != 0) return;
+
+    zet_recover_result_t result;
+    uint64_t start = now_ns();
+    int ret = zet_recover(filename, &result);
+    uint64_t elapsed = now_ns() - start;
+    printf("recover  %.1f MB, %llu messages kept in %.3f s (%.0f MB/s)%s\n", result.file_size / 1e6,
+           (unsigned long long)result.message_count, elapsed / 1e9, result.file_size / (elapsed / 1e9) / 1e6,
+           ret != 0 || result.intact ? "  [failed]" : "");
+}
+
+static void bench_seek(const char* filename, size_t count, int seeks) {
+    zet_reader_t* reader = zet_reader_create(filename);
+    if (!reader) {
+        fprintf(stderr, "Failed to open %s\n", filename);
+        return;
+    }
+
+    srand(1);
+    uint64_t total = 0;
+    uint64_t worst = 0;
+    int misses = 0;
+    for (int i = 0; i < seeks; i++) {
+        size_t target = (size_t)rand() % count;
+        uint64_t time_ns = 1000000000ULL + (uint64_t)target * 1000000ULL;
+
+        uint64_t start = now_ns();
+        zet_message_t msg;
+        if (zet_reader_seek_time(reader, time_ns) != 0 || zet_reader_read_message(reader, &msg) != 0) {
+            misses++;
+            continue;
+        }
+        uint64_t elapsed = now_ns() - start;
+        if (msg.received_ns != time_ns) misses++;
+        zet_message_free(&msg);
+
+        total += elapsed;
+        if (elapsed > worst) worst = elapsed;
+    }
+
+    printf("v%u seek   %d seeks  mean %10.1f us  max %10.1f us%s\n", zet_reader_get_version(reader),
+           seeks, total / 1e3 / seeks, worst / 1e3, misses ? "  [wrong results]" : "");
+    zet_reader_destroy(reader);
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000000;
+    size_t size = argc > 2 ? strtoul(argv[2], NULL, 10) : 256;
+    const char* dir = argc > 3 ? argv[3] : "/tmp";
+    if (count == 0) return 1;
+
+    char file[512];
+    char v1_file[512];
+    char v3_file[512];
+    char chunked_file[512];
+    snprintf(file, sizeof(file), "%s/zet_bench_%d.zet", dir, getpid());
+    snprintf(v1_file, sizeof(v1_file), "%s/zet_bench_v1_%d.zet", dir, getpid());
+    snprintf(v3_file, sizeof(v3_file), "%s/zet_bench_v3_%d.zet", dir, getpid());
+    snprintf(chunked_file, sizeof(chunked_file), "%s/zet_bench_chunked_%d.zet", dir, getpid());
+
+    bench_compression(file, ZET_COMPRESSION_NONE, "none", count, size);
+    bench_compression(file, ZET_COMPRESSION_LZ4, "lz4", count, size);
+    bench_compression(file, ZET_COMPRESSION_ZSTD, "zstd", count, size);
+
+    const uint32_t versions[] = { ZET_FORMAT_VERSION_1, ZET_FORMAT_VERSION };
+    for (size_t v = 0; v < 2; v++) {
+        bench_write(file, versions[v], WRITE_STDIO, "write_message (stdio)", count, size);
+        bench_write(file, versions[v], WRITE_BUFFERED, "write_message (buffered)", count, size);
+        bench_write(file, versions[v], WRITE_BUFFERED_BATCH, "write_batch (buffered)", count, size);
+        bench_write(file, versions[v], WRITE_URING_BATCH, "write_batch (io_uring)", count, size);
+        bench_write(file, versions[v], WRITE_DIRECT_BATCH, "write_batch (io_uring, direct)", count, size);
+        bench_write(file, versions[v], WRITE_DIRECT_SYNC_BATCH, "write_batch (direct, periodic)", count, size);
+    }
+
+    const char* clocks[] = { "= received", "unknown", "realtime" };
+    for (size_t v = 0; v < 2; v++) {
+        uint32_t version = v == 0 ? ZET_FORMAT_VERSION_3 : ZET_FORMAT_VERSION;
+        for (int c = SENT_RECEIVED; c <= SENT_REALTIME; c++) {
+            bench_header_size(file, version, (sent_clock_t)c, clocks[c], count, size);
+        }
+    }
+
+    // Version 3 against the default, for the cost of fixed record headers
+    if (write_file(v1_file, ZET_FORMAT_VERSION_1, count, size) != 0 ||
+        write_file(v3_file, ZET_FORMAT_VERSION_3, count, size) != 0 ||
+        write_file(chunked_file, ZET_FORMAT_VERSION, count, size) != 0) {
+        fprintf(stderr, "Failed to write to %s\n", dir);
+        return 1;
+    }
+
+    const char* files[] = { v1_file, v3_file, chunked_file };
+    for (size_t f = 0; f < 3; f++) {
+        bench_iterate(files[f], READ_MESSAGE, false, "read_message");
+        bench_iterate(files[f], READ_MESSAGE_INTO, false, "read_message_into");
+        bench_iterate(files[f], READ_VIEW, false, "read_view");
+        bench_iterate(files[f], READ_VIEWS, false, "read_views");
+        bench_iterate(files[f], READ_VIEW, true, "read_view (mmap)");
+        bench_iterate(files[f], READ_VIEWS, true, "read_views (mmap)");
+    }
+    bench_memcpy(count * size);
+
+    bench_seek(v1_file, count, V1_SEEKS);
+    bench_seek(chunked_file, count, CHUNKED_SEEKS);
+    bench_recover(chunked_file);
+
+    unlink(v1_file);
+    unlink(v3_file);
+    unlink(chunked_file);
+    return 0;
+}
@@ -1,7 +1,10 @@
 #include "zet_format.h"
 #include <assert.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 // Test helper to create a temp file path
@@ -203,13 +206,20 @@ void test_flush(void) {
     assert(ret == 0);
     
     zet_writer_flush(writer);
+    uint64_t flushed = zet_writer_get_bytes_written(writer);
+    assert(flushed > strlen(data));
     
     // Write another message after flush
     ret = zet_writer_write_message(writer, 1000, 2000, topic, data, strlen(data));
     assert(ret == 0);
+    assert(zet_writer_get_bytes_written(writer) == flushed);
     
     zet_writer_destroy(writer);
     
+    // The index and footer come on top
+    struct stat st;
+    assert(stat(filename, &st) == 0 && (uint64_t)st.st_size > flushed);
+    
     // Verify both messages are readable
     zet_reader_t* reader = zet_reader_create(filename);
     assert(reader != NULL);
@@ -230,6 +240,1897 @@ void test_flush(void) {
     printf("test_flush PASSED\n");
 }
 
+// Write count messages one millisecond apart, starting at 1 s
+static void write_timeline(const char* filename, const zet_writer_options_t* options, int count) {
+    zet_writer_t* writer = zet_writer_create_ex(filename, options);
+    assert(writer != NULL);
+    for (int i = 0; i < count; i++) {
+        uint64_t t = 1000000000ULL + (uint64_t)i * 1000000ULL;
+        int ret = zet_writer_write_message(writer, t - 500, t, i % 2 ? "seek/odd" : "seek/even", &i, sizeof(i));
+        assert(ret == 0);
+    }
+    zet_writer_destroy(writer);
+}
+
+// Read the next message and return its index (or -1 at end of file)
+static int read_index(zet_reader_t* reader) {
+    zet_message_t msg;
+    if (zet_reader_read_message(reader, &msg) != 0) return -1;
+    int value;
+    assert(msg.size >= sizeof(value));
+    memcpy(&value, msg.data, sizeof(value));
+    zet_message_free(&msg);
+    return value;
+}
+
+// Test that version 1 files can still be written and read
+void test_version1_compat(void) {
+    printf("Running test_version1_compat...\n");
+    
+    const char* filename = get_test_filename();
+    unlink(filename);
+    
+    zet_writer_options_t options = { .version = ZET_FORMAT_VERSION_1 };
+    write_timeline(filename, &options, 100);
+    
+    zet_reader_t* reader = zet_reader_create(filename);
+    assert(reader != NULL);
+    assert(zet_reader_get_version(reader) == ZET_FORMAT_VERSION_1);
+    for (int i = 0; i < 100; i++) {
+        assert(read_index(reader) == i);
+    }
+    assert(read_index(reader) == -1);
+    
+    // Seeking works by scanning
+    assert(zet_reader_seek_time(reader, 1000000000ULL + 42500000ULL) == 0);
+    assert(read_index(reader) == 43);
+    assert(zet_reader_seek_time(reader, 0) == 0);
+    assert(read_index(reader) == 0);
+    
+    zet_reader_destroy(reader);
+    unlink(filename);
+    
+    printf("test_version1_compat PASSED\n");
+}
+
+// Test seeking through the chunk index of a version 2 file
+void test_seek_time(void) {
+    printf("Running test_seek_time...\n");
+    
+    const char* filename = get_test_filename();
+    unlink(filename);
+    
+    // Small chunks so the index has many entries
+    zet_writer_options_t options = { .chunk_size = 1024 };
+    write_timeline(filename, &options, 5000);
+    
+    zet_reader_t* reader = zet_reader_create(filename);
+    assert(reader != NULL);
+    assert(zet_reader_get_version(reader) == ZET_FORMAT_VERSION);
+    
+    // Exact hits, times between messages, and both ends
+    assert(zet_reader_seek_time(reader, 1000000000ULL + 2500ULL * 1000000ULL) == 0);
+    assert(read_index(reader) == 2500);
+    assert(read_index(reader) == 2501);
+    assert(zet_reader_seek_time(reader, 1000000000ULL + 1234567890ULL) == 0);
+    assert(read_index(reader) == 1235);
+    assert(zet_reader_seek_time(reader, 0) == 0);
+    assert(read_index(reader) == 0);
+    assert(zet_reader_seek_time(reader, 1000000000ULL + 4999ULL * 1000000ULL) == 0);
+    assert(read_index(reader) == 4999);
+    assert(read_index(reader) == -1);
+    assert(zet_reader_seek_time(reader, UINT64_MAX) == 0);
+    assert(read_index(reader) == -1);
+    
+    // Seeking backwards after reaching the end
+    assert(zet_reader_seek_time(reader, 1000000000ULL + 10ULL * 1000000ULL) == 0);
+    for (int i = 10; i < 5000; i++) {
+        assert(read_index(reader) == i);
+    }
+    assert(read_index(reader) == -1);
+    
+    zet_reader_destroy(reader);
+    unlink(filename);
+    
+    printf("test_seek_time PASSED\n");
+}
+
+// Test a version 2 file whose writer never closed: no index or footer, torn last chunk
+void test_seek_without_footer(void) {
+    printf("Running test_seek_without_footer...\n");
+    
+    const char* filename = get_test_filename();
+    unlink(filename);
+    
+    zet_writer_options_t options = { .chunk_size = 1024 };
+    write_timeline(filename, &options, 1000);
+    
+    // Cut the file in the middle of a chunk near the end
+    FILE* f = fopen(filename, "rb");
+    assert(f != NULL);
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    assert(truncate(filename, size - 2000) == 0);
+    
+    zet_reader_t* reader = zet_reader_create(filename);
+    assert(reader != NULL);
+    assert(zet_reader_seek_time(reader, 1000000000ULL + 500ULL * 1000000ULL) == 0);
+    int last = -1;
+    for (int value; (value = read_index(reader)) >= 0; last = value) {
+        assert(value == (last < 0 ? 500 : last + 1));
+    }
+    assert(last > 500 && last < 999); // The torn tail is not returned
+    
+    zet_reader_destroy(reader);
+    unlink(filename);
+    
+    printf("test_seek_without_footer PASSED\n");
+}
+
+// Test that flush closes a chunk and that messages larger than a chunk still fit
+void test_chunk_boundaries(void) {
+    printf("Running test_chunk_boundaries...\n");
+    
+    const char* filename = get_test_filename();
+    unlink(filename);
+    
+    zet_writer_options_t options = { .chunk_size = 256 };
+    zet_writer_t* writer = zet_writer_create_ex(filename, &options);
+    assert(writer != NULL);
+    
+    static uint8_t big[10000];
+    for (size_t i = 0; i < sizeof(big); i++) big[i] = (uint8_t)i;
+    assert(zet_writer_write_message(writer, 1, 10, "a", "x", 1) == 0);
+    zet_writer_flush(writer);
+    assert(zet_writer_write_message(writer, 2, 20, "big", big, sizeof(big)) == 0);
+    assert(zet_writer_write_message(writer, 3, 30, "a", "y", 1) == 0);
+    zet_writer_destroy(writer);
+    
+    zet_reader_t* reader = zet_reader_create(filename);
+    assert(reader != NULL);
+    zet_message_t msg;
+    assert(zet_reader_read_message(reader, &msg) == 0 && msg.received_ns == 10);
+    zet_message_free(&msg);
+    assert(zet_reader_read_message(reader, &msg) == 0 && msg.size == sizeof(big));
+    assert(memcmp(msg.data, big, sizeof(big)) == 0 && strcmp(msg.topic, "big") == 0);
+    zet_message_free(&msg);
+    assert(zet_reader_seek_time(reader, 25) == 0);
+    assert(zet_reader_read_message(reader, &msg) == 0 && msg.received_ns == 30);
+    zet_message_free(&msg);
+    assert(zet_reader_read_message(reader, &msg) != 0);
+    
+    zet_reader_destroy(reader);
+    unlink(filename);
+    
+    printf("test_chunk_boundaries PASSED\n");
+}
+
+// Test compressed chunks: round trip, seeking, and incompressible chunks stored as is
+void test_compression(void) {
+    printf("Running test_compression...\n");
+    
+    const char* filename = get_test_filename();
+    const uint32_t modes[] = { ZET_COMPRESSION_LZ4, ZET_COMPRESSION_ZSTD };
+    
+    for (size_t m = 0; m < 2; m++) {
+        unlink(filename);
+        zet_writer_options_t options = { .chunk_size = 8192, .compression = modes[m] };
+        zet_writer_t* writer = zet_writer_create_ex(filename, &options);
+        assert(writer != NULL);
+        
+        // Slowly changing samples compress well; random bytes do not
+        uint8_t sample[256];
+        uint32_t noise = 12345;
+        for (int i = 0; i < 3000; i++) {
+            if (i < 2000) {
+                for (size_t j = 0; j < sizeof(sample); j++) sample[j] = (uint8_t)((i + j) / 64);
+            } else {
+                for (size_t j = 0; j < sizeof(sample); j++) sample[j] = (uint8_t)((noise = noise * 1103515245 + 12345) >> 16);
+            }
+            memcpy(sample, &i, sizeof(i));
+            assert(zet_writer_write_message(writer, 0, 1000 + (uint64_t)i, "sensor/imu", sample, sizeof(sample)) == 0);
+        }
+        zet_writer_destroy(writer);
+        
+        FILE* f = fopen(filename, "rb");
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        fclose(f);
+        assert(size < 3000 * 256 * 2 / 3); // The first two thirds shrink
+        
+        zet_reader_t* reader = zet_reader_create(filename);
+        assert(reader != NULL);
+        zet_message_t msg;
+        int count = 0;
+        while (zet_reader_read_message(reader, &msg) == 0) {
+            int value;
+            memcpy(&value, msg.data, sizeof(value));
+            assert(value == count && msg.size == sizeof(sample));
+            if (value < 2000) assert(((uint8_t*)msg.data)[100] == (uint8_t)((value + 100) / 64));
+            zet_message_free(&msg);
+            count++;
+        }
+        assert(count == 3000);
+        
+        assert(zet_reader_seek_time(reader, 1000 + 1500) == 0);
+        assert(read_index(reader) == 1500);
+        assert(zet_reader_seek_time(reader, 1000 + 2500) == 0);
+        assert(read_index(reader) == 2500);
+        zet_reader_destroy(reader);
+    }
+    
+    // Compression needs chunks
+    zet_writer_options_t v1 = { .version = ZET_FORMAT_VERSION_1, .compression = ZET_COMPRESSION_LZ4 };
+    assert(zet_writer_create_ex(filename, &v1) == NULL);
+    zet_writer_options_t bad = { .compression = 99 };
+    assert(zet_writer_create_ex(filename, &bad) == NULL);
+    
+    unlink(filename);
+    printf("test_compression PASSED\n");
+}
+
+// Test topics across versions: channel IDs in version 3, interned topics on read
+void test_channels(void) {
+    printf("Running test_channels...\n");
+    
+    const char* filename = get_test_filename();
+    long sizes[5] = {0};
+    
+    for (uint32_t version = ZET_FORMAT_VERSION_1; version <= ZET_FORMAT_VERSION_4; version++) {
+        unlink(filename);
+        zet_writer_options_t options = { .version = version, .chunk_size = 4096 };
+        zet_writer_t* writer = zet_writer_create_ex(filename, &options);
+        assert(writer != NULL);
+        
+        // 300 topics, a new one every ten messages, then all of them again
+        char topic[64];
+        uint8_t payload[40] = {0};
+        for (int i = 0; i < 6000; i++) {
+            int t = i < 3000 ? i / 10 : i % 300;
+            snprintf(topic, sizeof(topic), "robot/arm_%d/joint_states", t);
+            memcpy(payload, &i, sizeof(i));
+            assert(zet_writer_write_message(writer, 0, 1000 + (uint64_t)i, topic, payload, sizeof(payload)) == 0);
+        }
+        zet_writer_destroy(writer);
+        
+        FILE* f = fopen(filename, "rb");
+        fseek(f, 0, SEEK_END);
+        sizes[version] = ftell(f);
+        fclose(f);
+        
+        zet_reader_t* reader = zet_reader_create(filename);
+        assert(reader != NULL);
+        const char* first[300] = {0};
+        zet_message_t msg;
+        for (int i = 0; i < 6000; i++) {
+            int t = i < 3000 ? i / 10 : i % 300;
+            snprintf(topic, sizeof(topic), "robot/arm_%d/joint_states", t);
+            assert(zet_reader_read_message(reader, &msg) == 0);
+            assert(strcmp(msg.topic, topic) == 0);
+            if (!first[t]) first[t] = msg.topic;
+            assert(msg.topic == first[t]); // Interned: the same pointer every time
+            zet_message_free(&msg);
+        }
+        assert(zet_reader_read_message(reader, &msg) != 0);
+        
+        // Seeking past the channel blocks still resolves every channel
+        assert(zet_reader_seek_time(reader, 1000 + 4567) == 0);
+        assert(zet_reader_read_message(reader, &msg) == 0);
+        assert(strcmp(msg.topic, "robot/arm_67/joint_states") == 0);
+        zet_message_free(&msg);
+        assert(msg.topic == NULL && msg.data == NULL);
+        zet_reader_destroy(reader);
+    }
+    
+    // Topics longer than the payload dominated versions 1 and 2, and record
+    // headers version 3
+    assert(sizes[3] < sizes[2] * 3 / 4);
+    assert(sizes[4] < sizes[3] * 4 / 5);
+    
+    unlink(filename);
+    printf("test_channels PASSED\n");
+}
+
+// Test that version 4 record headers hold any value, at every width
+void test_compact_records(void) {
+    printf("Running test_compact_records...\n");
+    
+    const char* filename = get_test_filename();
+    const uint64_t now = 1700000000000000000ULL;
+    // Times running backwards, equal, and far apart; sent times unknown,
+    // later than received, and at the ends of the range
+    const uint64_t received[] = { now, now, now + 1, now - 1000, now + 1000000, now + (1ULL << 40), 5, UINT64_MAX, 0, now };
+    const uint64_t sent[] = { now - 200, 0, now + 1, UINT64_MAX, now + 1000000, 1, 5, 0, UINT64_MAX, now - 1 };
+    const size_t sizes[] = { 0, 1, 255, 256, 65535, 65536, 70000, 17, 3, 100 };
+    const size_t count = sizeof(received) / sizeof(received[0]);
+    uint8_t* payload = (uint8_t*)malloc(70000);
+    assert(payload != NULL);
+    for (size_t i = 0; i < 70000; i++) payload[i] = (uint8_t)(i * 7);
+    
+    // Every record alone in a chunk and all in one, uncompressed and compressed
+    const zet_writer_options_t kinds[] = {
+        { .chunk_size = 1 },
+        { .chunk_size = 1 << 20, .chunk_duration_ns = UINT64_MAX },
+        { .chunk_size = 1 << 20, .chunk_duration_ns = UINT64_MAX, .compression = ZET_COMPRESSION_LZ4 },
+    };
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        zet_writer_t* writer = zet_writer_create_ex(filename, &kinds[k]);
+        assert(writer != NULL);
+        char topic[32];
+        for (size_t i = 0; i < count; i++) {
+            snprintf(topic, sizeof(topic), "compact/%zu", i);
+            assert(zet_writer_write_message(writer, sent[i], received[i], topic, payload, sizes[i]) == 0);
+        }
+        zet_writer_destroy(writer);
+        
+        zet_reader_t* reader = zet_reader_create(filename);
+        assert(reader != NULL && zet_reader_get_version(reader) == ZET_FORMAT_VERSION_4);
+        zet_message_view_t view;
+        for (size_t i = 0; i < count; i++) {
+            snprintf(topic, sizeof(topic), "compact/%zu", i);
+            assert(zet_reader_read_view(reader, &view) == 0);
+            assert(view.sent_ns == sent[i] && view.received_ns == received[i]);
+            assert(view.size == sizes[i] && memcmp(view.data, payload, sizes[i]) == 0);
+            assert(strcmp(view.topic, topic) == 0);
+        }
+        assert(zet_reader_read_view(reader, &view) != 0);
+        assert(zet_reader_get_status(reader) == ZET_STATUS_OK);
+        zet_reader_destroy(reader);
+    }
+    
+    // A send time equal to the receive time, unknown, or on another clock a
+    // fixed distance away costs no more than the jitter between the clocks
+    long sizes_by_clock[3];
+    for (int clock = 0; clock < 3; clock++) {
+        zet_writer_t* writer = zet_writer_create(filename);
+        assert(writer != NULL);
+        uint32_t jitter = 1;
+        for (int i = 0; i < 1000; i++) {
+            uint64_t t = now + (uint64_t)i * 1000000ULL;
+            jitter = jitter * 1103515245U + 12345U;
+            uint64_t sent_ns = clock == 0 ? t : clock == 1 ? 0 : t - 3600000000000ULL - (jitter >> 16) % 30000;
+            assert(zet_writer_write_message(writer, sent_ns, t, "compact/clock", payload, 32) == 0);
+        }
+        zet_writer_destroy(writer);
+        FILE* f = fopen(filename, "rb");
+        fseek(f, 0, SEEK_END);
+        sizes_by_clock[clock] = ftell(f);
+        fclose(f);
+
+        zet_reader_t* reader = zet_reader_create(filename);
+        assert(reader != NULL);
+        zet_message_view_t view;
+        jitter = 1;
+        for (int i = 0; i < 1000; i++) {
+            uint64_t t = now + (uint64_t)i * 1000000ULL;
+            jitter = jitter * 1103515245U + 12345U;
+            uint64_t sent_ns = clock == 0 ? t : clock == 1 ? 0 : t - 3600000000000ULL - (jitter >> 16) % 30000;
+            assert(zet_reader_read_view(reader, &view) == 0);
+            assert(view.sent_ns == sent_ns && view.received_ns == t);
+        }
+        zet_reader_destroy(reader);
+    }
+    assert(sizes_by_clock[1] == sizes_by_clock[0]);
+    assert(sizes_by_clock[2] <= sizes_by_clock[0] + 2 * 1000 + 8);
+    
+    // Channel IDs of one, two and three bytes
+    zet_writer_t* writer = zet_writer_create(filename);
+    assert(writer != NULL);
+    char topic[32];
+    for (int i = 0; i < 20000; i++) {
+        snprintf(topic, sizeof(topic), "compact/%d", i);
+        assert(zet_writer_write_message(writer, 0, now + (uint64_t)i, topic, &i, sizeof(i)) == 0);
+    }
+    zet_writer_destroy(writer);
+    zet_reader_t* reader = zet_reader_create(filename);
+    assert(reader != NULL);
+    zet_message_view_t view;
+    for (int i = 0; i < 20000; i++) {
+        snprintf(topic, sizeof(topic), "compact/%d", i);
+        assert(zet_reader_read_view(reader, &view) == 0);
+        assert(strcmp(view.topic, topic) == 0 && view.received_ns == now + (uint64_t)i);
+    }
+    assert(zet_reader_read_view(reader, &view) != 0 && zet_reader_get_status(reader) == ZET_STATUS_OK);
+    zet_reader_destroy(reader);
+    
+    free(payload);
+    unlink(filename);
+    printf("test_compact_records PASSED\n");
+}
+
+// Test the mapped reader against the stdio reader on every kind of file
+void test_mmap_reader(void) {
+    printf("Running test_mmap_reader...\n");
+    
+    const char* filename = get_test_filename();
+    const zet_writer_options_t kinds[] = {
+        { .version = ZET_FORMAT_VERSION_1 },
+        { .version = ZET_FORMAT_VERSION_2, .chunk_size = 2048 },
+        { .chunk_size = 2048 },
+        { .chunk_size = 2048, .compression = ZET_COMPRESSION_LZ4 },
+    };
+    
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        unlink(filename);
+        write_timeline(filename, &kinds[k], 2000);
+        
+        zet_reader_t* stream = zet_reader_create(filename);
+        zet_reader_t* mapped = zet_reader_create_mmap(filename);
+        assert(stream != NULL && mapped != NULL);
+        assert(zet_reader_get_version(mapped) == zet_reader_get_version(stream));
+        
+        zet_message_t msg;
+        zet_message_view_t view;
+        const void* views[2000];
+        for (int i = 0; i < 2000; i++) {
+            assert(zet_reader_read_message(stream, &msg) == 0);
+            assert(zet_reader_read_view(mapped, &view) == 0);
+            assert(view.received_ns == msg.received_ns && view.sent_ns == msg.sent_ns);
+            assert(strcmp(view.topic, msg.topic) == 0);
+            assert(view.size == msg.size && memcmp(view.data, msg.data, msg.size) == 0);
+            views[i] = view.data;
+            zet_message_free(&msg);
+        }
+        assert(zet_reader_read_view(mapped, &view) != 0);
+        
+        // Uncompressed views point into the mapping and outlive later reads
+        if (kinds[k].compression == ZET_COMPRESSION_NONE) {
+            for (int i = 0; i < 2000; i++) {
+                int value;
+                memcpy(&value, views[i], sizeof(value));
+                assert(value == i);
+            }
+        }
+        
+        assert(zet_reader_seek_time(mapped, 1000000000ULL + 1234ULL * 1000000ULL) == 0);
+        assert(read_index(mapped) == 1234);
+        assert(zet_reader_seek_time(mapped, UINT64_MAX) == 0);
+        assert(read_index(mapped) == -1);
+        
+        zet_reader_destroy(stream);
+        zet_reader_destroy(mapped);
+    }
+    
+    // A torn file reads up to the torn chunk, as with stdio
+    zet_writer_options_t options = { .chunk_size = 1024 };
+    write_timeline(filename, &options, 1000);
+    FILE* f = fopen(filename, "rb");
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    assert(truncate(filename, size - 2000) == 0);
+    zet_reader_t* mapped = zet_reader_create_mmap(filename);
+    assert(mapped != NULL);
+    assert(zet_reader_seek_time(mapped, 1000000000ULL + 100ULL * 1000000ULL) == 0);
+    int count = 0;
+    while (read_index(mapped) >= 0) count++;
+    assert(count > 500 && count < 899);
+    zet_reader_destroy(mapped);
+    
+    // Empty and missing files
+    assert(truncate(filename, 0) == 0);
+    assert(zet_reader_create_mmap(filename) == NULL);
+    unlink(filename);
+    assert(zet_reader_create_mmap(filename) == NULL);
+    
+    printf("test_mmap_reader PASSED\n");
+}
+
+// Payload size of message i in test_batch_reads: mostly small, one larger
+// than a whole version 1 batch read
+static size_t batch_payload_size(int i) {
+    return i == 1500 ? 300 * 1024 : sizeof(int) + (size_t)(i * 37 % 1000);
+}
+
+// Test batched views and reads into a reused buffer on every kind of file
+void test_batch_reads(void) {
+    printf("Running test_batch_reads...\n");
+    
+    const char* filename = get_test_filename();
+    const zet_writer_options_t kinds[] = {
+        { .version = ZET_FORMAT_VERSION_1 },
+        { .version = ZET_FORMAT_VERSION_2, .chunk_size = 8192 },
+        { .chunk_size = 8192 },
+        { .chunk_size = 8192, .compression = ZET_COMPRESSION_LZ4 },
+    };
+    uint8_t* payload = (uint8_t*)calloc(1, batch_payload_size(1500));
+    assert(payload != NULL);
+    
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        unlink(filename);
+        zet_writer_t* writer = zet_writer_create_ex(filename, &kinds[k]);
+        assert(writer != NULL);
+        for (int i = 0; i < 3000; i++) {
+            memcpy(payload, &i, sizeof(i));
+            uint64_t t = 1000 + (uint64_t)i;
+            assert(zet_writer_write_message(writer, t, t, i % 2 ? "batch/odd" : "batch/even",
+                                            payload, batch_payload_size(i)) == 0);
+        }
+        zet_writer_destroy(writer);
+        
+        for (int use_mmap = 0; use_mmap <= 1; use_mmap++) {
+            zet_reader_t* reader = use_mmap ? zet_reader_create_mmap(filename) : zet_reader_create(filename);
+            assert(reader != NULL);
+            
+            // Every view of a batch is intact until the next call
+            zet_message_view_t views[64];
+            int next = 0;
+            size_t n;
+            while ((n = zet_reader_read_views(reader, views, 64)) > 0) {
+                assert(n <= 64);
+                for (size_t j = 0; j < n; j++) {
+                    int value;
+                    memcpy(&value, views[j].data, sizeof(value));
+                    assert(value == next);
+                    assert(views[j].size == batch_payload_size(next));
+                    assert(views[j].received_ns == 1000 + (uint64_t)next);
+                    assert(strcmp(views[j].topic, next % 2 ? "batch/odd" : "batch/even") == 0);
+                    next++;
+                }
+            }
+            assert(next == 3000);
+            
+            // Batches pick up where a seek leaves off
+            assert(zet_reader_seek_time(reader, 1000 + 1499) == 0);
+            n = zet_reader_read_views(reader, views, 2);
+            assert(n >= 1 && views[0].received_ns == 1000 + 1499);
+            assert(n == 1 || views[1].size == batch_payload_size(1500));
+            assert(read_index(reader) == 1499 + (int)n);
+            zet_reader_destroy(reader);
+        }
+        
+        // One buffer for the whole file, grown only for larger payloads
+        zet_reader_t* reader = zet_reader_create(filename);
+        assert(reader != NULL);
+        zet_message_t msg = {0};
+        size_t capacity = 0;
+        int grows = 0;
+        for (int i = 0; i < 3000; i++) {
+            void* before = msg.data;
+            assert(zet_reader_read_message_into(reader, &msg, &capacity) == 0);
+            int value;
+            memcpy(&value, msg.data, sizeof(value));
+            assert(value == i && msg.size == batch_payload_size(i));
+            assert(capacity >= msg.size);
+            if (msg.data != before) grows++;
+        }
+        assert(grows <= 12);
+        assert(zet_reader_read_message_into(reader, &msg, &capacity) != 0);
+        zet_message_free(&msg);
+        zet_reader_destroy(reader);
+    }
+    
+    free(payload);
+    unlink(filename);
+    printf("test_batch_reads PASSED\n");
+}
+
+// Read a whole file into memory
+static uint8_t* read_file(const char* filename, long* size) {
+    FILE* f = fopen(filename, "rb");
+    assert(f != NULL);
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t* data = (uint8_t*)malloc((size_t)*size + 1);
+    assert(data != NULL);
+    assert(fread(data, 1, (size_t)*size, f) == (size_t)*size);
+    fclose(f);
+    return data;
+}
+
+// Test that the buffered writer and batches write the same bytes as stdio
+void test_buffered_writer(void) {
+    printf("Running test_buffered_writer...\n");
+    
+    const char* filename = get_test_filename();
+    char buffered_name[256];
+    snprintf(buffered_name, sizeof(buffered_name), "%s.buffered", filename);
+    const zet_writer_options_t kinds[] = {
+        { .version = ZET_FORMAT_VERSION_1 },
+        { .version = ZET_FORMAT_VERSION_2, .chunk_size = 8192 },
+        { .chunk_size = 8192 },
+        { .compression = ZET_COMPRESSION_LZ4 },
+    };
+    
+    // Mostly small payloads, with some at and past the size written by
+    // reference, and one larger than the whole buffer
+    uint8_t* payload = (uint8_t*)malloc(200 * 1024 + 64);
+    assert(payload != NULL);
+    for (size_t i = 0; i < 200 * 1024 + 64; i++) payload[i] = (uint8_t)(i * 7);
+    zet_message_view_t messages[2000];
+    for (int i = 0; i < 2000; i++) {
+        size_t size = i % 250 == 0 ? 64 * 1024 : i % 333 == 0 ? 70000 : (size_t)(i * 13 % 500);
+        if (i == 1000) size = 200 * 1024;
+        messages[i] = (zet_message_view_t){
+            .sent_ns = (uint64_t)i,
+            .received_ns = 1000 + (uint64_t)i,
+            .topic = i % 3 ? "buffered/a" : "buffered/b",
+            .data = payload + i % 64,
+            .size = size
+        };
+    }
+    
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        unlink(filename);
+        zet_writer_t* writer = zet_writer_create_ex(filename, &kinds[k]);
+        assert(writer != NULL);
+        for (int i = 0; i < 2000; i++) {
+            assert(zet_writer_write_message(writer, messages[i].sent_ns, messages[i].received_ns,
+                                            messages[i].topic, messages[i].data, messages[i].size) == 0);
+        }
+        zet_writer_destroy(writer);
+        
+        // Uneven batches through a buffer of the smallest size
+        zet_writer_options_t options = kinds[k];
+        options.buffer_size = 1;
+        writer = zet_writer_create_ex(buffered_name, &options);
+        assert(writer != NULL);
+        for (int i = 0; i < 2000;) {
+            size_t count = (size_t)(i % 7) * 40 + 1;
+            if (count > (size_t)(2000 - i)) count = (size_t)(2000 - i);
+            assert(zet_writer_write_batch(writer, &messages[i], count) == 0);
+            i += (int)count;
+            if (i == 1201) {
+                // Flushed batches are complete on disk
+                zet_writer_flush(writer);
+                zet_reader_t* reader = zet_reader_create(buffered_name);
+                assert(reader != NULL);
+                int n = 0;
+                zet_message_t msg;
+                while (zet_reader_read_message(reader, &msg) == 0) {
+                    n++;
+                    zet_message_free(&msg);
+                }
+                assert(n == 1201);
+                zet_reader_destroy(reader);
+            }
+        }
+        assert(zet_writer_write_batch(writer, NULL, 0) == 0);
+        zet_writer_destroy(writer);
+        
+        // Identical after the header, which holds the start time
+        long size;
+        long buffered_size;
+        uint8_t* expected = read_file(filename, &size);
+        uint8_t* actual = read_file(buffered_name, &buffered_size);
+        assert(size == buffered_size);
+        assert(memcmp(expected + sizeof(zet_header_t), actual + sizeof(zet_header_t),
+                      (size_t)size - sizeof(zet_header_t)) == 0);
+        free(expected);
+        free(actual);
+    }
+    
+    // A batch stops at the first bad message
+    zet_writer_options_t options = { .buffer_size = 1 << 20 };
+    zet_writer_t* writer = zet_writer_create_ex(buffered_name, &options);
+    assert(writer != NULL);
+    zet_message_view_t bad[3] = { messages[0], messages[1], messages[2] };
+    bad[1].topic = NULL;
+    assert(zet_writer_write_batch(writer, bad, 3) != 0);
+    zet_writer_destroy(writer);
+    zet_reader_t* reader = zet_reader_create(buffered_name);
+    assert(reader != NULL);
+    zet_message_t msg;
+    assert(zet_reader_read_message(reader, &msg) == 0);
+    assert(msg.received_ns == 1000 && msg.size == messages[0].size);
+    zet_message_free(&msg);
+    assert(zet_reader_read_message(reader, &msg) != 0);
+    zet_reader_destroy(reader);
+    
+    free(payload);
+    unlink(filename);
+    unlink(buffered_name);
+    printf("test_buffered_writer PASSED\n");
+}
+
+// Test that io_uring, O_DIRECT, preallocation and each sync mode write the
+// same bytes as stdio, including across flushes that leave partial blocks
+void test_io_backends(void) {
+    printf("Running test_io_backends...\n");
+    
+    const char* filename = get_test_filename();
+    char io_name[256];
+    snprintf(io_name, sizeof(io_name), "%s.io", filename);
+    const zet_writer_options_t kinds[] = {
+        { .io = ZET_IO_URING },
+        { .direct = 1 },
+        { .io = ZET_IO_URING, .direct = 1, .buffer_size = 1 },
+        { .io = ZET_IO_URING, .preallocate_size = 1 << 20, .sync = ZET_SYNC_CHUNK },
+        { .direct = 1, .preallocate_size = 1 << 16, .sync = ZET_SYNC_PERIODIC, .sync_interval_ns = 1 },
+        { .version = ZET_FORMAT_VERSION_1, .io = ZET_IO_URING, .direct = 1, .sync = ZET_SYNC_CHUNK },
+    };
+    
+    uint8_t payload[3000];
+    for (size_t i = 0; i < sizeof(payload); i++) payload[i] = (uint8_t)(i * 11);
+    zet_message_view_t messages[3000];
+    for (int i = 0; i < 3000; i++) {
+        messages[i] = (zet_message_view_t){
+            .sent_ns = (uint64_t)i,
+            .received_ns = 1 + (uint64_t)i,
+            .topic = "io/topic",
+            .data = payload + i % 100,
+            .size = (size_t)(i * 29 % 2900)
+        };
+    }
+    
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        zet_writer_options_t options = { .version = kinds[k].version, .chunk_size = 8192 };
+        unlink(filename);
+        zet_writer_t* writer = zet_writer_create_ex(filename, &options);
+        assert(writer != NULL);
+        assert(zet_writer_get_io(writer) == ZET_IO_POSIX);
+        for (int i = 0; i < 3000; i += 500) {
+            assert(zet_writer_write_batch(writer, &messages[i], 500) == 0);
+            zet_writer_flush(writer);
+        }
+        zet_writer_destroy(writer);
+        
+        options = kinds[k];
+        options.chunk_size = 8192;
+        writer = zet_writer_create_ex(io_name, &options);
+        assert(writer != NULL);
+        assert(zet_writer_get_io(writer) == ZET_IO_POSIX || options.io == ZET_IO_URING);
+        for (int i = 0; i < 3000; i += 500) {
+            assert(zet_writer_write_batch(writer, &messages[i], 500) == 0);
+            zet_writer_flush(writer);
+            
+            // Flushed messages are on disk even when the tail is not a whole block
+            zet_reader_t* reader = zet_reader_create(io_name);
+            assert(reader != NULL);
+            int n = 0;
+            zet_message_t msg;
+            while (zet_reader_read_message(reader, &msg) == 0) {
+                n++;
+                zet_message_free(&msg);
+            }
+            assert(n == i + 500);
+            zet_reader_destroy(reader);
+        }
+        zet_writer_destroy(writer);
+        
+        // Preallocated space past the data is released on close
+        long size;
+        long io_size;
+        uint8_t* expected = read_file(filename, &size);
+        uint8_t* actual = read_file(io_name, &io_size);
+        assert(size == io_size);
+        assert(memcmp(expected + sizeof(zet_header_t), actual + sizeof(zet_header_t),
+                      (size_t)size - sizeof(zet_header_t)) == 0);
+        free(expected);
+        free(actual);
+    }
+    
+    zet_writer_options_t options = { .io = 7 };
+    assert(zet_writer_create_ex(io_name, &options) == NULL);
+    options = (zet_writer_options_t){ .sync = 7 };
+    assert(zet_writer_create_ex(io_name, &options) == NULL);
+    
+    unlink(filename);
+    unlink(io_name);
+    printf("test_io_backends PASSED\n");
+}
+
+// Read a whole file through stdio and through a mapping, checking that
+// message indices increase and topics match them. Returns how many there
+// were; *status is why reading stopped, the same both ways.
+static int read_checked(const char* filename, int* status) {
+    const zet_reader_options_t ways[] = {
+        { 0 },
+        { .mmap = 1 },
+        { .threads = 2 },
+        { .mmap = 1, .threads = 3, .read_ahead = 2 },
+    };
+    const int way_count = (int)(sizeof(ways) / sizeof(ways[0]));
+    int counts[4];
+    int statuses[4];
+    for (int way = 0; way < way_count; way++) {
+        zet_reader_t* reader = zet_reader_create_ex(filename, &ways[way]);
+        assert(reader != NULL);
+        int count = 0;
+        int last = -1;
+        zet_message_t msg;
+        while (zet_reader_read_message(reader, &msg) == 0) {
+            int value;
+            assert(msg.size == sizeof(value));
+            memcpy(&value, msg.data, sizeof(value));
+            assert(value > last);
+            assert(strcmp(msg.topic, value % 2 ? "seek/odd" : "seek/even") == 0);
+            last = value;
+            count++;
+            zet_message_free(&msg);
+        }
+        // Reading on past the end stops the same way
+        statuses[way] = zet_reader_get_status(reader);
+        assert(zet_reader_read_message(reader, &msg) != 0);
+        assert(zet_reader_get_status(reader) == statuses[way]);
+        counts[way] = count;
+        zet_reader_destroy(reader);
+    }
+    for (int way = 1; way < way_count; way++) {
+        assert(counts[way] == counts[0] && statuses[way] == statuses[0]);
+    }
+    *status = statuses[0];
+    return counts[0];
+}
+
+static void write_bytes(const char* filename, const uint8_t* data, long size) {
+    FILE* f = fopen(filename, "wb");
+    assert(f != NULL);
+    assert(fwrite(data, 1, (size_t)size, f) == (size_t)size);
+    fclose(f);
+}
+
+// Test that torn and damaged files are told apart from clean ends, and that
+// recovery keeps every intact chunk and leaves a file with a working index
+void test_recovery(void) {
+    printf("Running test_recovery...\n");
+    
+    const char* filename = get_test_filename();
+    char damaged_name[256];
+    snprintf(damaged_name, sizeof(damaged_name), "%s.damaged", filename);
+    const zet_writer_options_t kinds[] = {
+        { .version = ZET_FORMAT_VERSION_2, .chunk_size = 1024 },
+        { .chunk_size = 1024, .compression = ZET_COMPRESSION_LZ4 },
+        { .chunk_size = 1024, .compression = ZET_COMPRESSION_ZSTD },
+    };
+    
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        unlink(filename);
+        write_timeline(filename, &kinds[k], 2000);
+        int status;
+        assert(read_checked(filename, &status) == 2000 && status == ZET_STATUS_OK);
+        
+        // A closed file is left alone
+        zet_recover_result_t result;
+        long size;
+        uint8_t* original = read_file(filename, &size);
+        assert(zet_recover(filename, &result) == 0);
+        assert(result.intact && result.message_count == 2000 && result.dropped_bytes == 0);
+        assert(result.recovered_size == (uint64_t)size);
+        
+        // Power lost at any point: the torn tail is reported, then cut
+        const long cuts[] = { size - 1, size - 200, size * 3 / 4, size / 2 + 7, (long)sizeof(zet_header_t) + 10 };
+        for (size_t c = 0; c < sizeof(cuts) / sizeof(cuts[0]); c++) {
+            write_bytes(damaged_name, original, cuts[c]);
+            int before = read_checked(damaged_name, &status);
+            assert(status == ZET_STATUS_TRUNCATED || (before == 2000 && status == ZET_STATUS_OK)); // Cut in the index
+            
+            assert(zet_recover(damaged_name, &result) == 0);
+            assert(!result.intact && result.damaged_count == 0);
+            assert(result.file_size == (uint64_t)cuts[c]);
+            assert(result.message_count == (uint64_t)before);
+            assert(read_checked(damaged_name, &status) == before && status == ZET_STATUS_OK);
+            
+            // Recovered files seek through their new index, and recover as intact
+            zet_reader_t* reader = zet_reader_create(damaged_name);
+            assert(reader != NULL);
+            if (before > 0) {
+                assert(zet_reader_seek_time(reader, 1000000000ULL + (uint64_t)(before - 1) * 1000000ULL) == 0);
+                assert(read_index(reader) == before - 1);
+            }
+            assert(read_index(reader) == -1);
+            assert(zet_reader_get_status(reader) == ZET_STATUS_OK);
+            zet_reader_destroy(reader);
+            assert(zet_recover(damaged_name, &result) == 0 && result.intact);
+        }
+        
+        // A flipped bit mid-file is caught by the checksum; recovery skips
+        // just the damaged chunk and keeps the ones after it
+        original[size / 3] ^= 0x10;
+        write_bytes(damaged_name, original, size);
+        int before = read_checked(damaged_name, &status);
+        assert(status == ZET_STATUS_CORRUPT && before < 2000);
+        assert(zet_recover(damaged_name, &result) == 0);
+        assert(result.damaged_count == 1 && result.dropped_bytes > 0);
+        assert(result.message_count > (uint64_t)before && result.message_count < 2000);
+        assert(read_checked(damaged_name, &status) == (int)result.message_count && status == ZET_STATUS_OK);
+        free(original);
+    }
+    
+    // A lost channel block takes the chunks that need it along: the odd
+    // topic is first used, and defined, half way through
+    zet_writer_options_t options = { .chunk_size = 1024 };
+    zet_writer_t* writer = zet_writer_create_ex(filename, &options);
+    assert(writer != NULL);
+    for (int i = 0; i < 2000; i++) {
+        if (i < 1000 && i % 2) continue;
+        uint64_t t = 1000000000ULL + (uint64_t)i * 1000000ULL;
+        assert(zet_writer_write_message(writer, t, t, i % 2 ? "seek/odd" : "seek/even", &i, sizeof(i)) == 0);
+    }
+    zet_writer_destroy(writer);
+    long size;
+    uint8_t* data = read_file(filename, &size);
+    const uint8_t channel_magic[4] = { 'Z', 'C', 'H', 'N' };
+    uint8_t* second = NULL;
+    for (long i = (long)sizeof(zet_header_t) + 4; i + 4 <= size && !second; i++) {
+        if (memcmp(data + i, channel_magic, 4) == 0) second = data + i;
+    }
+    assert(second != NULL);
+    second[0] = 'X';
+    write_bytes(damaged_name, data, size);
+    int status;
+    read_checked(damaged_name, &status);
+    assert(status == ZET_STATUS_CORRUPT);
+    zet_recover_result_t result;
+    assert(zet_recover(damaged_name, &result) == 0 && result.damaged_count >= 1);
+    assert(read_checked(damaged_name, &status) == (int)result.message_count && status == ZET_STATUS_OK);
+    free(data);
+    
+    // Version 1: the partial last record goes, and a length running past the
+    // end of the file is a torn tail, not an allocation
+    options = (zet_writer_options_t){ .version = ZET_FORMAT_VERSION_1 };
+    write_timeline(filename, &options, 100);
+    data = read_file(filename, &size);
+    write_bytes(damaged_name, data, size - 3);
+    assert(read_checked(damaged_name, &status) == 99 && status == ZET_STATUS_TRUNCATED);
+    uint32_t huge = 0xfffffff0U;
+    long last_record = size - (long)(ZET_RECORD_HEADER_SIZE + sizeof("seek/odd") + sizeof(int));
+    memcpy(data + last_record + 18, &huge, sizeof(huge));
+    write_bytes(damaged_name, data, size);
+    assert(read_checked(damaged_name, &status) == 99 && status == ZET_STATUS_TRUNCATED);
+    assert(zet_recover(damaged_name, &result) == 0);
+    assert(!result.intact && result.message_count == 99);
+    assert(read_checked(damaged_name, &status) == 99 && status == ZET_STATUS_OK);
+    free(data);
+    
+    assert(zet_recover("/tmp/nonexistent_file_12345.zet", &result) != 0);
+    unlink(filename);
+    unlink(damaged_name);
+    printf("test_recovery PASSED\n");
+}
+
+// Test the summary a writer leaves at close
+static void check_summary(zet_reader_t* reader) {
+    zet_summary_t summary;
+    assert(zet_reader_get_summary(reader, &summary) == 0);
+    assert(summary.message_count == 1000 && summary.topic_count == 2);
+    assert(summary.start_ns == 1000000000ULL && summary.end_ns == 1000000000ULL + 999 * 1000000ULL);
+    
+    // Every third message is on /imu; payloads run from 10 to 109 bytes
+    const zet_topic_summary_t* imu = &summary.topics[0];
+    const zet_topic_summary_t* camera = &summary.topics[1];
+    assert(strcmp(imu->topic, "/imu") == 0 && strcmp(camera->topic, "/camera") == 0);
+    assert(imu->message_count == 334 && camera->message_count == 666);
+    assert(imu->first_ns == 1000000000ULL && imu->last_ns == 1000000000ULL + 999 * 1000000ULL);
+    assert(camera->first_ns == 1000000000ULL + 1000000ULL);
+    assert(camera->last_ns == 1000000000ULL + 998 * 1000000ULL);
+    assert(imu->min_size == 10 && imu->max_size == 109);
+    assert(camera->min_size == 10 && camera->max_size == 109);
+    assert(summary.payload_bytes == camera->payload_bytes + imu->payload_bytes);
+    assert(imu->mean_size == (double)imu->payload_bytes / 334);
+}
+
+void test_summary(void) {
+    printf("Running test_summary...\n");
+    
+    const char* filename = get_test_filename();
+    char damaged_name[256];
+    snprintf(damaged_name, sizeof(damaged_name), "%s.damaged", filename);
+    const zet_writer_options_t kinds[] = {
+        { .version = ZET_FORMAT_VERSION_1 },
+        { .version = ZET_FORMAT_VERSION_2, .chunk_size = 4096 },
+        { .chunk_size = 4096, .compression = ZET_COMPRESSION_LZ4 },
+    };
+    uint8_t payload[128] = {0};
+    
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        unlink(filename);
+        zet_writer_t* writer = zet_writer_create_ex(filename, &kinds[k]);
+        assert(writer != NULL);
+        for (int i = 0; i < 1000; i++) {
+            uint64_t t = 1000000000ULL + (uint64_t)i * 1000000ULL;
+            int ret = zet_writer_write_message(writer, 0, t, i % 3 ? "/camera" : "/imu", payload, 10 + i % 100);
+            assert(ret == 0);
+        }
+        zet_writer_destroy(writer);
+        
+        zet_reader_t* reader = zet_reader_create(filename);
+        assert(reader != NULL);
+        zet_summary_t summary;
+        if (kinds[k].version == ZET_FORMAT_VERSION_1) {
+            // Version 1 files are a bare stream of records
+            assert(zet_reader_get_summary(reader, &summary) != 0);
+            zet_reader_destroy(reader);
+            continue;
+        }
+        
+        // Asking does not disturb reading
+        zet_message_t msg;
+        assert(zet_reader_read_message(reader, &msg) == 0);
+        zet_message_free(&msg);
+        check_summary(reader);
+        check_summary(reader);
+        int count = 1;
+        while (zet_reader_read_message(reader, &msg) == 0) {
+            zet_message_free(&msg);
+            count++;
+        }
+        assert(count == 1000 && zet_reader_get_status(reader) == ZET_STATUS_OK);
+        zet_reader_destroy(reader);
+        
+        reader = zet_reader_create_mmap(filename);
+        assert(reader != NULL);
+        check_summary(reader);
+        zet_reader_destroy(reader);
+        
+        // A file never closed has none, until recovered
+        long size;
+        uint8_t* data = read_file(filename, &size);
+        write_bytes(damaged_name, data, size - 1);
+        reader = zet_reader_create(damaged_name);
+        assert(reader != NULL);
+        assert(zet_reader_get_summary(reader, &summary) != 0);
+        zet_reader_destroy(reader);
+        zet_recover_result_t result;
+        assert(zet_recover(damaged_name, &result) == 0 && !result.intact && result.message_count == 1000);
+        reader = zet_reader_create(damaged_name);
+        assert(reader != NULL);
+        check_summary(reader);
+        zet_reader_destroy(reader);
+        assert(zet_recover(damaged_name, &result) == 0 && result.intact);
+        free(data);
+    }
+    
+    unlink(filename);
+    unlink(damaged_name);
+    printf("test_summary PASSED\n");
+}
+
+// Test that reading with threads gives the same messages as without
+void test_parallel_reader(void) {
+    printf("Running test_parallel_reader...\n");
+    
+    const char* filename = get_test_filename();
+    const zet_writer_options_t kinds[] = {
+        { .version = ZET_FORMAT_VERSION_1 },
+        { .version = ZET_FORMAT_VERSION_2, .chunk_size = 4096 },
+        { .chunk_size = 4096, .compression = ZET_COMPRESSION_LZ4 },
+        { .chunk_size = 16384, .compression = ZET_COMPRESSION_ZSTD },
+    };
+    uint8_t payload[600];
+    for (size_t i = 0; i < sizeof(payload); i++) payload[i] = (uint8_t)(i * 7);
+    
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        // Topics keep appearing, so channel blocks come all through the file
+        unlink(filename);
+        zet_writer_t* writer = zet_writer_create_ex(filename, &kinds[k]);
+        assert(writer != NULL);
+        for (int i = 0; i < 5000; i++) {
+            char topic[32];
+            snprintf(topic, sizeof(topic), "parallel/%d", i % (1 + i / 100));
+            memcpy(payload, &i, sizeof(i));
+            int ret = zet_writer_write_message(writer, (uint64_t)i, 1000000ULL * (uint64_t)(i + 1), topic, payload,
+                                               sizeof(i) + (size_t)(i * 13) % (sizeof(payload) - sizeof(i)));
+            assert(ret == 0);
+        }
+        zet_writer_destroy(writer);
+        
+        for (uint32_t threads = 1; threads <= 4; threads++) {
+            zet_reader_options_t options = { .mmap = threads % 2, .threads = threads, .read_ahead = threads == 3 ? 2 : 0 };
+            zet_reader_t* serial = zet_reader_create(filename);
+            zet_reader_t* parallel = zet_reader_create_ex(filename, &options);
+            assert(serial != NULL && parallel != NULL);
+            
+            // Batches of views, with a seek back part way through
+            zet_message_view_t expected[64];
+            zet_message_view_t got[64];
+            int total = 0;
+            int before_seek = 0;
+            for (int round = 0;; round++) {
+                if (round == 20) {
+                    before_seek = total;
+                    assert(zet_reader_seek_time(serial, 1000000ULL * 700) == 0);
+                    assert(zet_reader_seek_time(parallel, 1000000ULL * 700) == 0);
+                }
+                size_t n = zet_reader_read_views(serial, expected, 64);
+                size_t m = 0;
+                while (m < n) {
+                    size_t more = zet_reader_read_views(parallel, got + m, n - m);
+                    assert(more > 0);
+                    // Each batch stays valid until the next read from the same reader
+                    for (size_t i = m; i < m + more; i++) {
+                        assert(got[i].received_ns == expected[i].received_ns);
+                        assert(got[i].sent_ns == expected[i].sent_ns);
+                        assert(strcmp(got[i].topic, expected[i].topic) == 0);
+                        assert(got[i].size == expected[i].size);
+                        assert(memcmp(got[i].data, expected[i].data, got[i].size) == 0);
+                    }
+                    m += more;
+                }
+                if (n == 0) break;
+                total += (int)n;
+            }
+            assert(before_seek > 0 && total == before_seek + 5000 - 699);
+            zet_message_view_t view;
+            assert(zet_reader_read_view(parallel, &view) != 0);
+            assert(zet_reader_get_status(parallel) == ZET_STATUS_OK);
+            zet_reader_destroy(serial);
+            zet_reader_destroy(parallel);
+        }
+    }
+    
+    unlink(filename);
+    printf("test_parallel_reader PASSED\n");
+}
+
+// Test that a merge reader interleaves several files into one timeline
+void test_merge_reader(void) {
+    printf("Running test_merge_reader...\n");
+    
+    // Message i of file f is received at 3 * i + f ms, except that every
+    // tenth one lands on the same millisecond in all of the files
+    const char* names[] = { "/tmp/test_zet_merge_0.zet", "/tmp/test_zet_merge_1.zet", "/tmp/test_zet_merge_2.zet" };
+    const zet_writer_options_t kinds[] = {
+        { .version = ZET_FORMAT_VERSION_1 },
+        { .version = ZET_FORMAT_VERSION_2, .chunk_size = 2048, .compression = ZET_COMPRESSION_LZ4 },
+        { .chunk_size = 4096 },
+    };
+    const int counts[] = { 1500, 1000, 2000 };
+    for (int f = 0; f < 3; f++) {
+        zet_writer_t* writer = zet_writer_create_ex(names[f], &kinds[f]);
+        assert(writer != NULL);
+        for (int i = 0; i < counts[f]; i++) {
+            uint64_t t = 1000000ULL * (uint64_t)(i % 10 ? 3 * i + f : 3 * i);
+            int value = f * 100000 + i;
+            int ret = zet_writer_write_message(writer, 0, t, i % 2 ? "merge/shared" : names[f], &value, sizeof(value));
+            assert(ret == 0);
+        }
+        zet_writer_destroy(writer);
+    }
+    
+    for (int way = 0; way < 3; way++) {
+        zet_reader_options_t options = { .mmap = way == 1, .threads = way == 2 ? 2 : 0 };
+        zet_merge_reader_t* merge = zet_merge_reader_create(names, 3, way ? &options : NULL);
+        assert(merge != NULL && zet_merge_reader_get_count(merge) == 3);
+        assert(zet_merge_reader_get_start_time(merge) == zet_reader_get_start_time(zet_merge_reader_get_reader(merge, 0)));
+        
+        // Batches come back in order, each valid until the next read
+        zet_message_view_t views[64];
+        int next[3] = { 0, 0, 0 };
+        uint64_t last = 0;
+        int last_file = -1;
+        const char* shared = NULL;
+        size_t n;
+        while ((n = zet_merge_reader_read_views(merge, views, way == 1 ? 1 : 64)) > 0) {
+            for (size_t j = 0; j < n; j++) {
+                int value;
+                assert(views[j].size == sizeof(value));
+                memcpy(&value, views[j].data, sizeof(value));
+                int f = value / 100000;
+                assert(value % 100000 == next[f]);
+                next[f]++;
+                assert(views[j].received_ns > last || (views[j].received_ns == last && f > last_file));
+                last = views[j].received_ns;
+                last_file = f;
+                if (value % 2) {
+                    // One address for a topic, whichever file it came from
+                    if (!shared) shared = views[j].topic;
+                    assert(views[j].topic == shared);
+                } else {
+                    assert(strcmp(views[j].topic, names[f]) == 0);
+                }
+            }
+        }
+        assert(next[0] == counts[0] && next[1] == counts[1] && next[2] == counts[2]);
+        zet_message_view_t view;
+        assert(zet_merge_reader_read_view(merge, &view) != 0);
+        
+        // Seeking lands every file on the same time
+        assert(zet_merge_reader_seek_time(merge, 1000000ULL * 2500) == 0);
+        assert(zet_merge_reader_read_view(merge, &view) == 0);
+        int value;
+        memcpy(&value, view.data, sizeof(value));
+        assert(view.received_ns == 1000000ULL * 2500 && value == 100000 + 833);
+        int rest = 1;
+        while (zet_merge_reader_read_view(merge, &view) == 0) rest++;
+        assert(rest == (1500 - 834) + (1000 - 833) + (2000 - 833));
+        for (size_t f = 0; f < 3; f++) {
+            assert(zet_reader_get_status(zet_merge_reader_get_reader(merge, f)) == ZET_STATUS_OK);
+        }
+        zet_merge_reader_destroy(merge);
+    }
+    
+    // A file cut short ends early, without holding back the others
+    long size;
+    uint8_t* data = read_file(names[2], &size);
+    write_bytes(names[2], data, size / 2);
+    free(data);
+    zet_merge_reader_t* merge = zet_merge_reader_create(names, 3, NULL);
+    assert(merge != NULL);
+    zet_message_view_t view;
+    int total = 0;
+    while (zet_merge_reader_read_view(merge, &view) == 0) total++;
+    assert(total > counts[0] + counts[1] && total < counts[0] + counts[1] + counts[2]);
+    assert(zet_reader_get_status(zet_merge_reader_get_reader(merge, 2)) == ZET_STATUS_TRUNCATED);
+    zet_merge_reader_destroy(merge);
+    
+    // Every file must open
+    const char* missing[] = { names[0], "/tmp/nonexistent_file_12345.zet" };
+    assert(zet_merge_reader_create(missing, 2, NULL) == NULL);
+    assert(zet_merge_reader_create(names, 0, NULL) == NULL);
+    
+    for (int f = 0; f < 3; f++) unlink(names[f]);
+    printf("test_merge_reader PASSED\n");
+}
+
+// Test that a rotating writer splits a recording into segments that read
+// back as one
+void test_rotation(void) {
+    printf("Running test_rotation...\n");
+    
+    const char* manifest = "/tmp/test_zet_rotation.zetm";
+    const zet_writer_options_t kinds[] = {
+        // By size, with a batch crossing the cut; by time; by size, version 1
+        { .chunk_size = 4096, .compression = ZET_COMPRESSION_LZ4, .segment_size = 48 * 1024, .buffer_size = 65536 },
+        { .version = ZET_FORMAT_VERSION_2, .segment_duration_ns = 1000000000ULL, .sync = ZET_SYNC_CHUNK },
+        { .version = ZET_FORMAT_VERSION_1, .segment_size = 100000 },
+    };
+    uint8_t payload[100];
+    memset(payload, 0x5a, sizeof(payload));
+    
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        zet_writer_t* writer = zet_writer_create_ex(manifest, &kinds[k]);
+        assert(writer != NULL);
+        // Noise, so compressed segments come out much the same size
+        zet_message_view_t batch[100];
+        uint8_t payloads[100][sizeof(int) + 100];
+        uint32_t noise = 1;
+        for (size_t j = 0; j < sizeof(payloads); j++) {
+            noise = noise * 1103515245U + 12345U;
+            payloads[j / sizeof(payloads[0])][j % sizeof(payloads[0])] = (uint8_t)(noise >> 16);
+        }
+        for (int i = 0; i < 2500; i += 100) {
+            for (int j = 0; j < 100; j++) {
+                int value = i + j;
+                memcpy(payloads[j], &value, sizeof(value));
+                uint64_t t = 1000000000ULL + (uint64_t)value * 1000000ULL;
+                batch[j] = (zet_message_view_t){ t, t, value % 2 ? "rotate/a" : "rotate/b", payloads[j],
+                                                 sizeof(value) + (size_t)j };
+            }
+            assert(zet_writer_write_batch(writer, batch, 100) == 0);
+        }
+        assert(zet_writer_write_message(writer, 0, 99000000000ULL, "rotate/a", payload, sizeof(payload)) == 0);
+        zet_writer_flush(writer);
+        uint64_t written = zet_writer_get_bytes_written(writer);
+        zet_writer_destroy(writer);
+        
+        char** segments;
+        size_t count;
+        assert(zet_manifest_read(manifest, &segments, &count) == 0);
+        assert(strcmp(segments[0], "/tmp/test_zet_rotation.0000.zet") == 0);
+        if (kinds[k].segment_duration_ns) {
+            // One per second of messages, and one for the last
+            assert(count == 4);
+        } else {
+            assert(count > 2);
+        }
+        
+        // Each segment is complete, and every message is in exactly one
+        int next = 0;
+        for (size_t i = 0; i < count; i++) {
+            zet_reader_t* reader = zet_reader_create(segments[i]);
+            assert(reader != NULL);
+            zet_message_t msg;
+            int in_segment = 0;
+            while (zet_reader_read_message(reader, &msg) == 0) {
+                if (next < 2500) {
+                    int value;
+                    memcpy(&value, msg.data, sizeof(value));
+                    assert(value == next);
+                }
+                next++;
+                in_segment++;
+                zet_message_free(&msg);
+            }
+            assert(in_segment > 0 && zet_reader_get_status(reader) == ZET_STATUS_OK);
+            if (kinds[k].segment_duration_ns && i < 2) assert(in_segment == 1000);
+            zet_summary_t summary;
+            if (kinds[k].version != ZET_FORMAT_VERSION_1) assert(zet_reader_get_summary(reader, &summary) == 0);
+            zet_reader_destroy(reader);
+        }
+        assert(next == 2501);
+        
+        // Every segment counts towards the bytes written, those not yet closed
+        // (the last, and the one the closer may still be on) without their index
+        uint64_t on_disk = 0;
+        for (size_t i = 0; i < count; i++) {
+            struct stat st;
+            assert(stat(segments[i], &st) == 0);
+            on_disk += (uint64_t)st.st_size;
+        }
+        assert(written <= on_disk && written > on_disk / 2);
+        
+        // A merge reader takes the manifest for the segments
+        zet_merge_reader_t* merge = zet_merge_reader_create(&manifest, 1, NULL);
+        assert(merge != NULL && zet_merge_reader_get_count(merge) == count);
+        zet_message_view_t view;
+        int total = 0;
+        while (zet_merge_reader_read_view(merge, &view) == 0) total++;
+        assert(total == 2501);
+        for (size_t i = 0; i < count; i++) {
+            assert(strcmp(zet_merge_reader_get_path(merge, i), segments[i]) == 0);
+            assert(zet_merge_reader_get_status(merge, i) == ZET_STATUS_OK);
+        }
+        assert(zet_merge_reader_get_path(merge, count) == NULL);
+        
+        // One segment is open at a time, and a seek passes over those before the time
+        assert(zet_merge_reader_get_reader(merge, 0) == NULL && zet_merge_reader_get_reader(merge, count - 1) != NULL);
+        assert(zet_merge_reader_seek_time(merge, 1000000000ULL + 2000ULL * 1000000ULL) == 0);
+        assert(zet_merge_reader_read_view(merge, &view) == 0);
+        int first;
+        memcpy(&first, view.data, sizeof(first));
+        assert(first == 2000);
+        for (total = 1; zet_merge_reader_read_view(merge, &view) == 0; total++) {}
+        assert(total == 501);
+        zet_merge_reader_destroy(merge);
+        
+        // Segments deleted since are left out
+        unlink(segments[0]);
+        char** rest;
+        size_t rest_count;
+        assert(zet_manifest_read(manifest, &rest, &rest_count) == 0 && rest_count == count - 1);
+        assert(strcmp(rest[0], segments[1]) == 0);
+        zet_manifest_free(rest, rest_count);
+        for (size_t i = 0; i < count; i++) unlink(segments[i]);
+        zet_manifest_free(segments, count);
+    }
+    
+    // Recordings are not manifests
+    const char* filename = get_test_filename();
+    write_timeline(filename, NULL, 10);
+    char** segments;
+    size_t count;
+    assert(zet_manifest_read(filename, &segments, &count) != 0);
+    zet_writer_options_t invalid = { .version = 9, .segment_size = 4096 };
+    assert(zet_writer_create_ex(manifest, &invalid) == NULL);
+    
+    unlink(filename);
+    unlink(manifest);
+    printf("test_rotation PASSED\n");
+}
+
+// Read every message on the topic with a topic set, in batches, and check
+// nothing else comes back
+static int read_topic(const char* filename, const zet_reader_options_t* options, const char* topic, int* status) {
+    zet_reader_t* reader = zet_reader_create_ex(filename, options);
+    assert(reader != NULL);
+    assert(zet_reader_set_topics(reader, &topic, 1) == 0);
+    zet_message_view_t views[16];
+    size_t n;
+    int count = 0;
+    while ((n = zet_reader_read_views(reader, views, 16)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            int value;
+            assert(strcmp(views[i].topic, topic) == 0);
+            memcpy(&value, views[i].data, sizeof(value));
+            assert(value % 500 == 250);
+            count++;
+        }
+    }
+    *status = zet_reader_get_status(reader);
+    zet_reader_destroy(reader);
+    return count;
+}
+
+// Test that readers after one topic pass over chunks the topic filters rule out
+void test_topic_filters(void) {
+    printf("Running test_topic_filters...\n");
+    
+    const char* filename = get_test_filename();
+    uint8_t frame[2000];
+    memset(frame, 0x11, sizeof(frame));
+    for (uint32_t version = ZET_FORMAT_VERSION_2; version <= ZET_FORMAT_VERSION_4; version++) {
+        // Camera frames, with a GPS fix every 500 of them
+        zet_writer_options_t options = { .version = version, .chunk_size = 16384 };
+        zet_writer_t* writer = zet_writer_create_ex(filename, &options);
+        assert(writer != NULL);
+        for (int i = 0; i < 5000; i++) {
+            uint64_t t = 1000000000ULL + (uint64_t)i * 1000000ULL;
+            memcpy(frame, &i, sizeof(i));
+            int fix = i % 500 == 250;
+            assert(zet_writer_write_message(writer, t, t, fix ? "sensor/gps" : "camera/front", frame,
+                                            fix ? sizeof(i) : sizeof(frame)) == 0);
+        }
+        zet_writer_destroy(writer);
+        
+        // Damage a camera-only chunk half way through
+        long size;
+        uint8_t* data = read_file(filename, &size);
+        uint64_t pos = sizeof(zet_header_t);
+        int first = 0;
+        int damaged = 0;
+        while (!damaged) {
+            zet_chunk_header_t header;
+            memcpy(&header, data + pos, sizeof(header));
+            if (header.magic == ZET_CHANNEL_MAGIC) {
+                zet_channel_header_t channels;
+                memcpy(&channels, data + pos, sizeof(channels));
+                pos += sizeof(channels) + channels.data_size;
+                continue;
+            }
+            assert(header.magic == ZET_CHUNK_MAGIC);
+            int last = first + (int)header.message_count - 1;
+            if (first > 2500 && first % 500 > 250 && last % 500 < 499 && first / 500 == last / 500) {
+                data[pos + sizeof(header) + 100] ^= 0xff;
+                damaged = 1;
+            }
+            first = last + 1;
+            pos += sizeof(header) + header.data_size;
+        }
+        write_bytes(filename, data, size);
+        free(data);
+        
+        // Reading the GPS topic never touches the damage, with or without
+        // threads and through either source
+        const zet_reader_options_t sources[] = { { 0 }, { .mmap = 1 }, { .threads = 2 }, { .mmap = 1, .threads = 2 } };
+        for (size_t k = 0; k < 4; k++) {
+            int status;
+            assert(read_topic(filename, &sources[k], "sensor/gps", &status) == 10);
+            assert(status == ZET_STATUS_OK);
+        }
+        
+        // A topic not in the file reads nothing; clearing the set reads all
+        // again, up to the damage
+        int status;
+        assert(read_topic(filename, NULL, "sensor/none", &status) == 0);
+        zet_reader_t* reader = zet_reader_create(filename);
+        const char* gps = "sensor/gps";
+        assert(zet_reader_set_topics(reader, &gps, 1) == 0);
+        assert(zet_reader_set_topics(reader, NULL, 0) == 0);
+        assert(zet_reader_set_topics(reader, NULL, 1) != 0);
+        zet_message_view_t view;
+        int count = 0;
+        while (zet_reader_read_view(reader, &view) == 0) count++;
+        assert(count > 2500 && count < 5000 && zet_reader_get_status(reader) == ZET_STATUS_CORRUPT);
+        zet_reader_destroy(reader);
+        
+        // Recovery cuts out the damaged chunk and rebuilds the filters
+        zet_recover_result_t result;
+        assert(zet_recover(filename, &result) == 0 && result.damaged_count == 1);
+        assert(read_topic(filename, NULL, "sensor/gps", &status) == 10 && status == ZET_STATUS_OK);
+        assert(zet_recover(filename, &result) == 0 && result.intact);
+    }
+    
+    unlink(filename);
+    printf("test_topic_filters PASSED\n");
+}
+
+// Test that filtering keeps the right messages, copying whole chunks
+void test_filter(void) {
+    printf("Running test_filter...\n");
+    
+    const char* input = get_test_filename();
+    const char* output = "/tmp/test_zet_filter_out.zet";
+    const char* topics[] = { "filter/a", "filter/b", "filter/c" };
+    
+    for (uint32_t version = ZET_FORMAT_VERSION_1; version <= ZET_FORMAT_VERSION_4; version++) {
+        zet_writer_options_t options = {
+            .version = version,
+            .chunk_size = 4096,
+            .chunk_duration_ns = 100000000ULL,
+            .compression = version == ZET_FORMAT_VERSION_1 ? ZET_COMPRESSION_NONE : ZET_COMPRESSION_LZ4
+        };
+        // Runs of 500 messages per topic, one every millisecond, about 100 to
+        // a chunk whatever the size of the records
+        zet_writer_t* writer = zet_writer_create_ex(input, &options);
+        assert(writer != NULL);
+        for (int i = 0; i < 3000; i++) {
+            uint64_t t = 1000000000ULL + (uint64_t)i * 1000000ULL;
+            assert(zet_writer_write_message(writer, t, t, topics[(i / 500) % 3], &i, sizeof(i)) == 0);
+        }
+        zet_writer_destroy(writer);
+        
+        // One topic; a time range; everything
+        const char* only_b[] = { "filter/b", "filter/none" };
+        const zet_filter_options_t cases[] = {
+            { .topics = only_b, .topic_count = 2 },
+            { .start_ns = 1500000000ULL, .end_ns = 2000000000ULL, .compression = ZET_COMPRESSION_ZSTD },
+            { 0 },
+        };
+        const uint64_t expected[] = { 1000, 501, 3000 };
+        for (size_t c = 0; c < 3; c++) {
+            zet_filter_result_t result;
+            assert(zet_filter(input, output, &cases[c], &result) == 0);
+            assert(result.message_count == expected[c]);
+            if (version != ZET_FORMAT_VERSION_1) {
+                assert(result.chunks_copied > 0 && result.bytes_copied > 0);
+                // Only the chunks across a topic change or the range ends are re-encoded
+                assert(result.chunks_rewritten <= (c == 0 ? 4U : c == 1 ? 2U : 0U));
+                assert(c != 2 || result.chunks_skipped == 0);
+            }
+            
+            zet_reader_t* reader = zet_reader_create(output);
+            assert(reader != NULL);
+            zet_message_t msg;
+            uint64_t count = 0;
+            int last = -1;
+            while (zet_reader_read_message(reader, &msg) == 0) {
+                int value;
+                memcpy(&value, msg.data, sizeof(value));
+                assert(value > last);
+                assert(strcmp(msg.topic, topics[(value / 500) % 3]) == 0);
+                if (c == 0) assert(strcmp(msg.topic, "filter/b") == 0);
+                if (c == 1) assert(msg.received_ns >= 1500000000ULL && msg.received_ns <= 2000000000ULL);
+                last = value;
+                count++;
+                zet_message_free(&msg);
+            }
+            assert(zet_reader_get_status(reader) == ZET_STATUS_OK && count == expected[c]);
+            
+            // The summary counts copied chunks as well as re-encoded ones
+            zet_summary_t summary;
+            if (version != ZET_FORMAT_VERSION_1) {
+                assert(zet_reader_get_summary(reader, &summary) == 0);
+                assert(summary.message_count == expected[c]);
+                assert(summary.topic_count == (c == 0 ? 1U : c == 1 ? 2U : 3U));
+            }
+            zet_reader_destroy(reader);
+        }
+    }
+    
+    // The output cannot be the input
+    assert(zet_filter(input, input, NULL, NULL) != 0);
+    assert(zet_filter("/tmp/nonexistent_file_12345.zet", output, NULL, NULL) != 0);
+    
+    unlink(input);
+    unlink(output);
+    printf("test_filter PASSED\n");
+}
+
+// Write a message holding its number, at a time from it
+static void write_numbered(zet_writer_t* writer, int i) {
+    uint8_t payload[64];
+    memset(payload, 0x5a, sizeof(payload));
+    memcpy(payload, &i, sizeof(i));
+    uint64_t t = 1000000000ULL + (uint64_t)i * 1000000ULL;
+    assert(zet_writer_write_message(writer, t, t, i % 3 ? "follow/a" : "follow/b", payload, sizeof(payload)) == 0);
+}
+
+// Read messages, in batches, until the reader stops; check they carry the
+// numbers from *next on
+static void read_numbered(zet_reader_t* reader, int* next) {
+    zet_message_view_t views[16];
+    size_t n;
+    while ((n = zet_reader_read_views(reader, views, 16)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            int value;
+            assert(views[i].size == 64);
+            memcpy(&value, views[i].data, sizeof(value));
+            assert(value == *next);
+            (*next)++;
+        }
+    }
+}
+
+static void* write_live(void* arg) {
+    zet_writer_t* writer = (zet_writer_t*)arg;
+    for (int i = 0; i < 2000; i++) {
+        write_numbered(writer, i);
+        if (i % 50 == 49) {
+            zet_writer_flush(writer);
+            usleep(500);
+        }
+    }
+    zet_writer_destroy(writer);
+    return NULL;
+}
+
+// Test that a following reader takes records as they are written, never part
+// of one, and stops at the end of a closed file
+void test_follow(void) {
+    printf("Running test_follow...\n");
+    
+    const char* filename = get_test_filename();
+    zet_reader_options_t follow = { .follow = 1, .follow_timeout_ns = 20000000ULL };
+    for (uint32_t version = ZET_FORMAT_VERSION_1; version <= ZET_FORMAT_VERSION_4; version++) {
+        // Flushed writes show up at once; waiting for more times out
+        zet_writer_options_t options = { .version = version, .chunk_size = 4096 };
+        zet_writer_t* writer = zet_writer_create_ex(filename, &options);
+        assert(writer != NULL);
+        zet_writer_flush(writer);
+        zet_reader_t* reader = zet_reader_create_ex(filename, &follow);
+        assert(reader != NULL);
+        zet_message_view_t view;
+        assert(zet_reader_read_view(reader, &view) != 0);
+        assert(zet_reader_get_status(reader) == ZET_STATUS_PENDING);
+        int next = 0;
+        for (int round = 1; round <= 3; round++) {
+            for (int i = next; i < round * 100; i++) write_numbered(writer, i);
+            zet_writer_flush(writer);
+            read_numbered(reader, &next);
+            assert(next == round * 100);
+            assert(zet_reader_get_status(reader) == ZET_STATUS_PENDING);
+        }
+        
+        // A chunked file ends at its index; a version 1 file just stops growing
+        zet_writer_destroy(writer);
+        assert(zet_reader_read_view(reader, &view) != 0);
+        int end = version == ZET_FORMAT_VERSION_1 ? ZET_STATUS_PENDING : ZET_STATUS_OK;
+        assert(zet_reader_get_status(reader) == end);
+        zet_reader_destroy(reader);
+        
+        // Written in pieces cut anywhere, even part way through a record, a
+        // chunk or a header: only whole records come out, each once
+        long size;
+        uint8_t* data = read_file(filename, &size);
+        const long cuts[] = { sizeof(zet_header_t), sizeof(zet_header_t) + 5, size / 3, size / 2 + 7, size - 30, size };
+        write_bytes(filename, data, cuts[0]);
+        reader = zet_reader_create_ex(filename, &follow);
+        assert(reader != NULL);
+        next = 0;
+        for (size_t k = 1; k < sizeof(cuts) / sizeof(cuts[0]); k++) {
+            size_t len = (size_t)(cuts[k] - cuts[k - 1]);
+            FILE* f = fopen(filename, "ab");
+            assert(f != NULL);
+            assert(fwrite(data + cuts[k - 1], 1, len, f) == len);
+            fclose(f);
+            read_numbered(reader, &next);
+            assert(next <= 300);
+        }
+        assert(next == 300 && zet_reader_get_status(reader) == end);
+        zet_reader_destroy(reader);
+        free(data);
+    }
+    
+    // A writer on another thread, followed with threads decoding and no
+    // timeout: every message arrives, and reading ends when the writer closes
+    zet_writer_options_t options = { .version = ZET_FORMAT_VERSION_3, .chunk_size = 4096,
+                                     .compression = ZET_COMPRESSION_LZ4 };
+    zet_writer_t* writer = zet_writer_create_ex(filename, &options);
+    assert(writer != NULL);
+    zet_writer_flush(writer);
+    zet_reader_options_t live = { .follow = 1, .threads = 2 };
+    zet_reader_t* reader = zet_reader_create_ex(filename, &live);
+    assert(reader != NULL);
+    pthread_t thread;
+    assert(pthread_create(&thread, NULL, write_live, writer) == 0);
+    int next = 0;
+    read_numbered(reader, &next);
+    assert(pthread_join(thread, NULL) == 0);
+    assert(next == 2000 && zet_reader_get_status(reader) == ZET_STATUS_OK);
+    zet_reader_destroy(reader);
+    
+    unlink(filename);
+    printf("test_follow PASSED\n");
+}
+
+// The payload of message i: a number, or one of a few large latched payloads
+// (as a map or a calibration would be) that each repeat for a while
+static size_t dedup_payload(int i, uint8_t* payload) {
+    if (i % 4 == 3) {
+        memcpy(payload, &i, sizeof(i));
+        return sizeof(i);
+    }
+    uint32_t seed = (uint32_t)(i / 100 % 6) * 2654435761U + 1;
+    for (size_t k = 0; k < 3000; k++) {
+        seed = seed * 1103515245U + 12345U;
+        payload[k] = (uint8_t)(seed >> 16);
+    }
+    return 3000;
+}
+
+static void write_dedup(const char* filename, const zet_writer_options_t* options, int count) {
+    zet_writer_t* writer = zet_writer_create_ex(filename, options);
+    assert(writer != NULL);
+    uint8_t payload[3000];
+    for (int i = 0; i < count; i++) {
+        uint64_t t = 1000000000ULL + (uint64_t)i * 1000000ULL;
+        size_t size = dedup_payload(i, payload);
+        assert(zet_writer_write_message(writer, t, t, i % 2 ? "dedup/a" : "dedup/b", payload, size) == 0);
+    }
+    zet_writer_destroy(writer);
+}
+
+// Read to the end, checking every payload against its number from its time;
+// returns how many messages were read, from *first on
+static int read_dedup(zet_reader_t* reader, int* first) {
+    uint8_t expected[3000];
+    zet_message_view_t views[16];
+    size_t n;
+    int count = 0;
+    while ((n = zet_reader_read_views(reader, views, 16)) > 0) {
+        for (size_t k = 0; k < n; k++) {
+            int i = (int)((views[k].received_ns - 1000000000ULL) / 1000000ULL);
+            if (count == 0) *first = i;
+            assert(i == *first + count);
+            size_t size = dedup_payload(i, expected);
+            assert(views[k].size == size && memcmp(views[k].data, expected, size) == 0);
+            assert(strcmp(views[k].topic, i % 2 ? "dedup/a" : "dedup/b") == 0);
+            count++;
+        }
+    }
+    return count;
+}
+
+// Test that repeated payloads are stored once and read back whole, however
+// the file is read, filtered or recovered
+void test_dedup(void) {
+    printf("Running test_dedup...\n");
+    
+    const char* filename = get_test_filename();
+    const char* output = "/tmp/test_zet_dedup_out.zet";
+    const zet_writer_options_t kinds[] = {
+        { .version = ZET_FORMAT_VERSION_2, .chunk_size = 16384, .dedup_min_size = 1024 },
+        { .chunk_size = 16384, .dedup_min_size = 1024 },
+        { .chunk_size = 16384, .compression = ZET_COMPRESSION_LZ4, .dedup_min_size = 1024 },
+        { .chunk_size = 16384, .compression = ZET_COMPRESSION_ZSTD, .dedup_min_size = 1024 },
+    };
+    
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        // Six distinct large payloads in 1500 messages: the file is a fraction
+        // of the size it is without dedup
+        zet_writer_options_t plain = kinds[k];
+        plain.dedup_min_size = 0;
+        write_dedup(filename, &plain, 1500);
+        long plain_size;
+        free(read_file(filename, &plain_size));
+        write_dedup(filename, &kinds[k], 1500);
+        long size;
+        uint8_t* original = read_file(filename, &size);
+        assert(size * 10 < plain_size);
+        
+        // Every way of reading resolves references, in this chunk or earlier ones
+        const zet_reader_options_t readers[] = { { 0 }, { .mmap = 1 }, { .threads = 2 }, { .follow = 1, .follow_timeout_ns = 20000000ULL } };
+        for (size_t r = 0; r < sizeof(readers) / sizeof(readers[0]); r++) {
+            zet_reader_t* reader = zet_reader_create_ex(filename, &readers[r]);
+            assert(reader != NULL);
+            int first = -1;
+            assert(read_dedup(reader, &first) == 1500 && first == 0);
+            assert(zet_reader_get_status(reader) == ZET_STATUS_OK);
+            
+            // Seeking past the first copies, and to one topic
+            assert(zet_reader_seek_time(reader, 1000000000ULL + 1234 * 1000000ULL) == 0);
+            assert(read_dedup(reader, &first) == 266 && first == 1234);
+            zet_reader_destroy(reader);
+        }
+        
+        // The summary counts each payload at its full size
+        zet_reader_t* reader = zet_reader_create(filename);
+        assert(reader != NULL);
+        zet_summary_t summary;
+        assert(zet_reader_get_summary(reader, &summary) == 0);
+        assert(summary.message_count == 1500);
+        assert(summary.payload_bytes == 1125ULL * 3000 + 375 * sizeof(int));
+        const char* only_a[] = { "dedup/a" };
+        assert(zet_reader_set_topics(reader, only_a, 1) == 0);
+        zet_message_t msg;
+        int count = 0;
+        while (zet_reader_read_message(reader, &msg) == 0) {
+            assert(strcmp(msg.topic, "dedup/a") == 0);
+            count++;
+            zet_message_free(&msg);
+        }
+        assert(count == 750 && zet_reader_get_status(reader) == ZET_STATUS_OK);
+        zet_reader_destroy(reader);
+        
+        // A time range that starts after the first copies: the output keeps
+        // its own, and dedups again
+        zet_filter_options_t range = { .start_ns = 1000000000ULL + 700 * 1000000ULL };
+        zet_filter_result_t result;
+        assert(zet_filter(filename, output, &range, &result) == 0);
+        assert(result.message_count == 800 && result.chunks_rewritten > 0);
+        reader = zet_reader_create(output);
+        assert(reader != NULL);
+        int first = -1;
+        assert(read_dedup(reader, &first) == 800 && first == 700);
+        assert(zet_reader_get_status(reader) == ZET_STATUS_OK);
+        zet_reader_destroy(reader);
+        long output_size;
+        free(read_file(output, &output_size));
+        assert(output_size * 10 < plain_size);
+        
+        // Cut anywhere and recovered: the references that remain still resolve
+        char damaged_name[256];
+        snprintf(damaged_name, sizeof(damaged_name), "%s.damaged", filename);
+        write_bytes(damaged_name, original, size * 2 / 3);
+        zet_recover_result_t recovered;
+        assert(zet_recover(damaged_name, &recovered) == 0 && !recovered.intact);
+        assert(recovered.message_count > 0 && recovered.message_count < 1500);
+        reader = zet_reader_create_mmap(damaged_name);
+        assert(reader != NULL);
+        assert(read_dedup(reader, &first) == (int)recovered.message_count && first == 0);
+        assert(zet_reader_get_status(reader) == ZET_STATUS_OK);
+        zet_reader_destroy(reader);
+        unlink(damaged_name);
+        free(original);
+    }
+    
+    // Version 1 records have no room for references
+    zet_writer_options_t v1 = { .version = ZET_FORMAT_VERSION_1, .dedup_min_size = 1024 };
+    assert(zet_writer_create_ex(filename, &v1) == NULL);
+    
+    unlink(filename);
+    unlink(output);
+    printf("test_dedup PASSED\n");
+}
+
+// Payload j of many, each distinct
+static void distinct_payload(int j, uint8_t* payload, size_t size) {
+    uint32_t seed = (uint32_t)j * 2654435761U + 7;
+    for (size_t k = 0; k < size; k++) {
+        seed = seed * 1103515245U + 12345U;
+        payload[k] = (uint8_t)(seed >> 16);
+    }
+}
+
+// Test that the reader keeps no more resolved payloads than the writer can
+// refer to, and still resolves every reference after older ones are replaced
+void test_dedup_many_payloads(void) {
+    printf("Running test_dedup_many_payloads...\n");
+
+    const char* filename = get_test_filename();
+    enum { DISTINCT = 3 * ZET_DEDUP_PAYLOADS, SIZE = 1100 };
+    const zet_writer_options_t kinds[] = {
+        { .chunk_size = 65536, .dedup_min_size = 1024 },
+        { .chunk_size = 65536, .compression = ZET_COMPRESSION_LZ4, .dedup_min_size = 1024 },
+    };
+    uint8_t payload[SIZE];
+    uint8_t expected[SIZE];
+
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        // Each payload is written, then repeated twice: right away and after
+        // the next few dozen others, so references reach back across chunks
+        zet_writer_t* writer = zet_writer_create_ex(filename, &kinds[k]);
+        assert(writer != NULL);
+        uint64_t t = 1000000000ULL;
+        for (int j = 0; j < DISTINCT + 40; j++) {
+            int ids[3] = { j, j, j - 40 };
+            for (int n = 0; n < 3; n++) {
+                if (ids[n] < 0 || ids[n] >= DISTINCT) continue;
+                distinct_payload(ids[n], payload, SIZE);
+                memcpy(payload, &ids[n], sizeof(int));
+                assert(zet_writer_write_message(writer, t, t, "dedup/many", payload, SIZE) == 0);
+                t += 1000;
+            }
+        }
+        zet_writer_destroy(writer);
+
+        const zet_reader_options_t readers[] = { { 0 }, { .mmap = 1 } };
+        for (size_t r = 0; r < sizeof(readers) / sizeof(readers[0]); r++) {
+            zet_reader_t* reader = zet_reader_create_ex(filename, &readers[r]);
+            assert(reader != NULL);
+
+            // Whole batches at a time, so a payload replaced in its slot is
+            // still read through views taken before it was
+            zet_message_view_t views[256];
+            size_t n;
+            int count = 0;
+            while ((n = zet_reader_read_views(reader, views, 256)) > 0) {
+                for (size_t v = 0; v < n; v++) {
+                    int id;
+                    assert(views[v].size == SIZE);
+                    memcpy(&id, views[v].data, sizeof(id));
+                    assert(id >= 0 && id < DISTINCT);
+                    distinct_payload(id, expected, SIZE);
+                    memcpy(expected, &id, sizeof(id));
+                    assert(memcmp(views[v].data, expected, SIZE) == 0);
+                    count++;
+                }
+            }
+            assert(count == 3 * DISTINCT && zet_reader_get_status(reader) == ZET_STATUS_OK);
+
+            // Back to the start, where the slots hold later payloads
+            assert(zet_reader_seek_time(reader, 1000000000ULL + 3000) == 0);
+            zet_message_t msg;
+            for (int i = 0; i < 300; i++) {
+                assert(zet_reader_read_message(reader, &msg) == 0);
+                int id;
+                memcpy(&id, msg.data, sizeof(id));
+                distinct_payload(id, expected, SIZE);
+                memcpy(expected, &id, sizeof(id));
+                assert(msg.size == SIZE && memcmp(msg.data, expected, SIZE) == 0);
+                zet_message_free(&msg);
+            }
+            zet_reader_destroy(reader);
+        }
+    }
+
+    unlink(filename);
+    printf("test_dedup_many_payloads PASSED\n");
+}
+
 // Test invalid file operations
 void test_invalid_operations(void) {
     printf("Running test_invalid_operations...\n");
@@ -253,6 +2154,27 @@ int main(void) {
     test_binary_data();
     test_multiple_messages_same_topic();
     test_flush();
+    test_version1_compat();
+    test_seek_time();
+    test_seek_without_footer();
+    test_chunk_boundaries();
+    test_compression();
+    test_channels();
+    test_compact_records();
+    test_mmap_reader();
+    test_batch_reads();
+    test_buffered_writer();
+    test_io_backends();
+    test_recovery();
+    test_summary();
+    test_parallel_reader();
+    test_merge_reader();
+    test_rotation();
+    test_filter();
+    test_topic_filters();
+    test_follow();
+    test_dedup();
+    test_dedup_many_payloads();
     test_invalid_operations();
     
     printf("\nAll tests PASSED!\n");
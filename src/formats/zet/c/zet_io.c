@@ -0,0 +1,212 @@
+#define _GNU_SOURCE // O_DIRECT, fallocate(), copy_file_range()
+#include "zet_io.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+int zet_io_open(const char* filename, bool* direct) {
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    if (*direct) {
+        int fd = open(filename, flags | O_DIRECT, 0666);
+        if (fd >= 0) return fd;
+        *direct = false;
+    }
+    return open(filename, flags, 0666);
+}
+
+int zet_io_preallocate(int fd, uint64_t offset, uint64_t len) {
+    return fallocate(fd, FALLOC_FL_KEEP_SIZE, (off_t)offset, (off_t)len);
+}
+
+int64_t zet_io_copy(int out_fd, int in_fd, uint64_t in_offset, uint64_t len) {
+    uint64_t done = 0;
+    bool range = true;
+    while (done < len) {
+        off_t from = (off_t)(in_offset + done);
+        size_t piece = len - done < 0x40000000U ? (size_t)(len - done) : 0x40000000U;
+        ssize_t n = range ? copy_file_range(in_fd, &from, out_fd, NULL, piece, 0)
+                          : sendfile(out_fd, in_fd, &from, piece);
+        if (n > 0) {
+            done += (uint64_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        // Across file systems on older kernels, or where it is not supported
+        if (n < 0 && range && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) {
+            range = false;
+            continue;
+        }
+        break;
+    }
+    return done == 0 && len > 0 ? -1 : (int64_t)done;
+}
+
+// How often a reader without an inotify watch looks at the file again
+#define WATCH_POLL_NS 10000000ULL
+
+int zet_io_watch(const char* filename) {
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) return -1;
+    if (inotify_add_watch(fd, filename, IN_MODIFY | IN_CLOSE_WRITE) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int zet_io_watch_wait(int fd, uint64_t timeout_ns) {
+    if (fd < 0) {
+        uint64_t ns = timeout_ns && timeout_ns < WATCH_POLL_NS ? timeout_ns : WATCH_POLL_NS;
+        struct timespec ts = { .tv_sec = (time_t)(ns / 1000000000ULL), .tv_nsec = (long)(ns % 1000000000ULL) };
+        return nanosleep(&ts, NULL) == 0 && ns == WATCH_POLL_NS ? 0 : -1;
+    }
+
+    // Events queued since the last wait count: the write may have come
+    // between the read that found nothing and this call
+    struct pollfd pfd = { .fd = fd, .events = POLLIN, .revents = 0 };
+    int ms = -1;
+    if (timeout_ns) {
+        uint64_t rounded = (timeout_ns + 999999) / 1000000;
+        ms = rounded < INT32_MAX ? (int)rounded : INT32_MAX;
+    }
+    if (poll(&pfd, 1, ms) <= 0) return -1;
+
+    // Drain the queue; nothing in the events matters beyond their arrival
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (read(fd, events, sizeof(events)) > 0) {
+    }
+    return 0;
+}
+
+// io_uring. The kernel shares the queues through three mappings of the ring
+// file descriptor (two on kernels with IORING_FEAT_SINGLE_MMAP); heads and
+// tails are published with acquire/release ordering.
+
+int zet_uring_init(zet_uring_t* ring, unsigned entries) {
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) return -1;
+    ring->fd = fd;
+    ring->entries = params.sq_entries;
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single && ring->cq_ring_size > ring->sq_ring_size) ring->sq_ring_size = ring->cq_ring_size;
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        ring->sq_ring = NULL;
+        zet_uring_free(ring);
+        return -1;
+    }
+    if (single) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            ring->cq_ring = NULL;
+            zet_uring_free(ring);
+            return -1;
+        }
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe*)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                                            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        zet_uring_free(ring);
+        return -1;
+    }
+
+    uint8_t* sq = (uint8_t*)ring->sq_ring;
+    uint8_t* cq = (uint8_t*)ring->cq_ring;
+    ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    return 0;
+}
+
+void zet_uring_free(zet_uring_t* ring) {
+    if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring) munmap(ring->sq_ring, ring->sq_ring_size);
+    if (ring->fd >= 0) close(ring->fd);
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+// Queue one entry and hand it to the kernel
+static int submit(zet_uring_t* ring, const struct io_uring_sqe* sqe) {
+    unsigned tail = *ring->sq_tail;
+    if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->entries) return -1;
+    unsigned index = tail & *ring->sq_mask;
+    ring->sqes[index] = *sqe;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    for (;;) {
+        long ret = syscall(__NR_io_uring_enter, ring->fd, 1, 0, 0, NULL, 0);
+        if (ret == 1) return 0;
+        if (ret < 0 && errno == EINTR) continue;
+        return -1;
+    }
+}
+
+int zet_uring_writev(zet_uring_t* ring, int fd, const struct iovec* iov, uint64_t offset, uint64_t user_data) {
+    struct io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_WRITEV;
+    sqe.fd = fd;
+    sqe.off = offset;
+    sqe.addr = (uint64_t)(uintptr_t)iov;
+    sqe.len = 1;
+    sqe.user_data = user_data;
+    return submit(ring, &sqe);
+}
+
+int zet_uring_datasync(zet_uring_t* ring, int fd, uint64_t user_data) {
+    struct io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_FSYNC;
+    sqe.flags = IOSQE_IO_DRAIN;
+    sqe.fd = fd;
+    sqe.fsync_flags = IORING_FSYNC_DATASYNC;
+    sqe.user_data = user_data;
+    return submit(ring, &sqe);
+}
+
+int zet_uring_complete(zet_uring_t* ring, bool wait, uint64_t* user_data, int32_t* res) {
+    for (;;) {
+        unsigned head = *ring->cq_head;
+        if (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            const struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+            *user_data = cqe->user_data;
+            *res = cqe->res;
+            __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+            return 0;
+        }
+        if (!wait) return -1;
+        long ret = syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0 && errno != EINTR) return -1;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef ZET_IO_H
+#define ZET_IO_H
+
+// Linux file I/O behind the .zet writer's buffered output: O_DIRECT,
+// preallocation, and a minimal io_uring driven by raw system calls (no
+// liburing); and the inotify watch a following reader waits on. Internal to
+// the zet_format library.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+// Create or truncate a file for writing. With *direct set, O_DIRECT is tried
+// first; *direct is cleared if the file system refuses it (tmpfs, for one).
+int zet_io_open(const char* filename, bool* direct);
+
+// Reserve len bytes from offset on disk without changing the file size
+int zet_io_preallocate(int fd, uint64_t offset, uint64_t len);
+
+// Append len bytes of in_fd from in_offset at out_fd's file position, inside
+// the kernel: copy_file_range() (which can share extents on file systems that
+// support it), else sendfile(). Returns the bytes copied, short only if an
+// error stopped it; -1 with nothing copied if neither call can be used.
+int64_t zet_io_copy(int out_fd, int in_fd, uint64_t in_offset, uint64_t len);
+
+// Watch a file for writes: a non-blocking inotify descriptor, or -1 where
+// inotify is unavailable (some network and FUSE file systems never report)
+int zet_io_watch(const char* filename);
+
+// Wait until the watched file is written to, or without a watch for a short
+// polling interval, but no longer than timeout_ns (0: no limit). Returns 0 to
+// look again, -1 once the timeout passes or a signal arrives.
+int zet_io_watch_wait(int fd, uint64_t timeout_ns);
+
+typedef struct {
+    int fd;
+    unsigned entries;
+    // Submission queue
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+    // Completion queue
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+    // Mappings
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+} zet_uring_t;
+
+// Set up a ring; -1 if the kernel has no io_uring or does not allow it
+int zet_uring_init(zet_uring_t* ring, unsigned entries);
+void zet_uring_free(zet_uring_t* ring);
+
+// Submit a write of iov (which must stay valid until it completes) at offset
+int zet_uring_writev(zet_uring_t* ring, int fd, const struct iovec* iov, uint64_t offset, uint64_t user_data);
+
+// Submit an fdatasync() that starts once everything submitted before it is done
+int zet_uring_datasync(zet_uring_t* ring, int fd, uint64_t user_data);
+
+// Take one completion, waiting for it if wait is set. Returns -1 if there is
+// none (or the wait failed); res is the operation's result or -errno.
+int zet_uring_complete(zet_uring_t* ring, bool wait, uint64_t* user_data, int32_t* res);
+
+#endif // ZET_IO_H
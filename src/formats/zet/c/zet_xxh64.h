@@ -0,0 +1,13 @@
+#ifndef ZET_XXH64_H
+#define ZET_XXH64_H
+
+// XXH64, the 64-bit xxHash, by which writers spot repeated payloads (see
+// ZET_FLAG_DEDUP). Matches the reference implementation. Internal to the
+// zet_format library.
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint64_t zet_xxh64(const void* data, size_t len, uint64_t seed);
+
+#endif // ZET_XXH64_H
@@ -7,7 +7,7 @@ Provides classes for reading and writing .zet files.
 import ctypes
 import os
 from pathlib import Path
-from typing import Optional, Tuple
+from typing import List, Optional, Tuple
 import platform
 
 
@@ -41,7 +41,8 @@ class _ZetHeader(ctypes.Structure):
         ("magic", ctypes.c_char * 4),
         ("version", ctypes.c_uint32),
         ("start_time_ns", ctypes.c_uint64),
-        ("reserved", ctypes.c_uint8 * 16),
+        ("flags", ctypes.c_uint32),
+        ("reserved", ctypes.c_uint8 * 12),
     ]
 
 
@@ -64,11 +65,120 @@ class _ZetMessage(ctypes.Structure):
     ]
 
 
+class _ZetMessageView(ctypes.Structure):
+    _fields_ = [
+        ("sent_ns", ctypes.c_uint64),
+        ("received_ns", ctypes.c_uint64),
+        ("topic", ctypes.POINTER(ctypes.c_char)),
+        ("data", ctypes.c_void_p),
+        ("size", ctypes.c_size_t),
+    ]
+
+
+class _ZetWriterOptions(ctypes.Structure):
+    _fields_ = [
+        ("version", ctypes.c_uint32),
+        ("chunk_size", ctypes.c_size_t),
+        ("chunk_duration_ns", ctypes.c_uint64),
+        ("compression", ctypes.c_uint32),
+        ("compression_level", ctypes.c_int),
+        ("buffer_size", ctypes.c_size_t),
+        ("io", ctypes.c_uint32),
+        ("direct", ctypes.c_uint32),
+        ("preallocate_size", ctypes.c_uint64),
+        ("sync", ctypes.c_uint32),
+        ("sync_interval_ns", ctypes.c_uint64),
+        ("segment_size", ctypes.c_uint64),
+        ("segment_duration_ns", ctypes.c_uint64),
+        ("dedup_min_size", ctypes.c_uint32),
+    ]
+
+
+class _ZetReaderOptions(ctypes.Structure):
+    _fields_ = [
+        ("mmap", ctypes.c_uint32),
+        ("threads", ctypes.c_uint32),
+        ("read_ahead", ctypes.c_uint32),
+        ("follow", ctypes.c_uint32),
+        ("follow_timeout_ns", ctypes.c_uint64),
+    ]
+
+
+class _ZetRecoverResult(ctypes.Structure):
+    _fields_ = [
+        ("file_size", ctypes.c_uint64),
+        ("recovered_size", ctypes.c_uint64),
+        ("message_count", ctypes.c_uint64),
+        ("chunk_count", ctypes.c_uint64),
+        ("dropped_bytes", ctypes.c_uint64),
+        ("damaged_count", ctypes.c_uint32),
+        ("intact", ctypes.c_int),
+    ]
+
+
+class _ZetFilterOptions(ctypes.Structure):
+    _fields_ = [
+        ("topics", ctypes.POINTER(ctypes.c_char_p)),
+        ("topic_count", ctypes.c_size_t),
+        ("start_ns", ctypes.c_uint64),
+        ("end_ns", ctypes.c_uint64),
+        ("compression", ctypes.c_uint32),
+    ]
+
+
+class _ZetFilterResult(ctypes.Structure):
+    _fields_ = [
+        ("message_count", ctypes.c_uint64),
+        ("chunks_copied", ctypes.c_uint64),
+        ("chunks_rewritten", ctypes.c_uint64),
+        ("chunks_skipped", ctypes.c_uint64),
+        ("bytes_copied", ctypes.c_uint64),
+    ]
+
+
+class _ZetTopicSummary(ctypes.Structure):
+    _fields_ = [
+        ("topic", ctypes.POINTER(ctypes.c_char)),
+        ("message_count", ctypes.c_uint64),
+        ("payload_bytes", ctypes.c_uint64),
+        ("first_ns", ctypes.c_uint64),
+        ("last_ns", ctypes.c_uint64),
+        ("min_size", ctypes.c_uint32),
+        ("max_size", ctypes.c_uint32),
+        ("mean_size", ctypes.c_double),
+    ]
+
+
+class _ZetSummary(ctypes.Structure):
+    _fields_ = [
+        ("message_count", ctypes.c_uint64),
+        ("payload_bytes", ctypes.c_uint64),
+        ("start_ns", ctypes.c_uint64),
+        ("end_ns", ctypes.c_uint64),
+        ("topic_count", ctypes.c_size_t),
+        ("topics", ctypes.POINTER(_ZetTopicSummary)),
+    ]
+
+
+# Chunk compression (matches ZET_COMPRESSION_* in zet_format.h)
+_COMPRESSION = {None: 0, "none": 0, "lz4": 1, "zstd": 2}
+
+# Writer output and durability (match ZET_IO_* and ZET_SYNC_*)
+_IO = {"posix": 0, "uring": 1}
+_SYNC = {None: 0, "none": 0, "periodic": 1, "chunk": 2}
+
+# Why reading stopped (ZET_STATUS_*)
+_STATUS = {0: "ok", 1: "truncated", 2: "corrupt", 3: "error", 4: "pending"}
+
+
 # Define C function signatures
 # Writer API
 _lib.zet_writer_create.argtypes = [ctypes.c_char_p]
 _lib.zet_writer_create.restype = ctypes.c_void_p
 
+_lib.zet_writer_create_ex.argtypes = [ctypes.c_char_p, ctypes.POINTER(_ZetWriterOptions)]
+_lib.zet_writer_create_ex.restype = ctypes.c_void_p
+
 _lib.zet_writer_destroy.argtypes = [ctypes.c_void_p]
 _lib.zet_writer_destroy.restype = None
 
@@ -82,25 +192,97 @@ _lib.zet_writer_write_message.argtypes = [
 ]
 _lib.zet_writer_write_message.restype = ctypes.c_int
 
+_lib.zet_writer_write_batch.argtypes = [ctypes.c_void_p, ctypes.POINTER(_ZetMessageView), ctypes.c_size_t]
+_lib.zet_writer_write_batch.restype = ctypes.c_int
+
 _lib.zet_writer_flush.argtypes = [ctypes.c_void_p]
 _lib.zet_writer_flush.restype = None
 
+_lib.zet_writer_get_io.argtypes = [ctypes.c_void_p]
+_lib.zet_writer_get_io.restype = ctypes.c_uint32
+
 # Reader API
 _lib.zet_reader_create.argtypes = [ctypes.c_char_p]
 _lib.zet_reader_create.restype = ctypes.c_void_p
 
+_lib.zet_reader_create_mmap.argtypes = [ctypes.c_char_p]
+_lib.zet_reader_create_mmap.restype = ctypes.c_void_p
+
+_lib.zet_reader_create_ex.argtypes = [ctypes.c_char_p, ctypes.POINTER(_ZetReaderOptions)]
+_lib.zet_reader_create_ex.restype = ctypes.c_void_p
+
 _lib.zet_reader_destroy.argtypes = [ctypes.c_void_p]
 _lib.zet_reader_destroy.restype = None
 
 _lib.zet_reader_read_message.argtypes = [ctypes.c_void_p, ctypes.POINTER(_ZetMessage)]
 _lib.zet_reader_read_message.restype = ctypes.c_int
 
+_lib.zet_reader_read_view.argtypes = [ctypes.c_void_p, ctypes.POINTER(_ZetMessageView)]
+_lib.zet_reader_read_view.restype = ctypes.c_int
+
 _lib.zet_message_free.argtypes = [ctypes.POINTER(_ZetMessage)]
 _lib.zet_message_free.restype = None
 
 _lib.zet_reader_get_start_time.argtypes = [ctypes.c_void_p]
 _lib.zet_reader_get_start_time.restype = ctypes.c_uint64
 
+_lib.zet_reader_get_version.argtypes = [ctypes.c_void_p]
+_lib.zet_reader_get_version.restype = ctypes.c_uint32
+
+_lib.zet_reader_seek_time.argtypes = [ctypes.c_void_p, ctypes.c_uint64]
+_lib.zet_reader_seek_time.restype = ctypes.c_int
+
+_lib.zet_reader_set_topics.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_char_p), ctypes.c_size_t]
+_lib.zet_reader_set_topics.restype = ctypes.c_int
+
+_lib.zet_reader_get_status.argtypes = [ctypes.c_void_p]
+_lib.zet_reader_get_status.restype = ctypes.c_int
+
+_lib.zet_reader_get_summary.argtypes = [ctypes.c_void_p, ctypes.POINTER(_ZetSummary)]
+_lib.zet_reader_get_summary.restype = ctypes.c_int
+
+_lib.zet_merge_reader_create.argtypes = [ctypes.POINTER(ctypes.c_char_p), ctypes.c_size_t,
+                                         ctypes.POINTER(_ZetReaderOptions)]
+_lib.zet_merge_reader_create.restype = ctypes.c_void_p
+
+_lib.zet_merge_reader_destroy.argtypes = [ctypes.c_void_p]
+_lib.zet_merge_reader_destroy.restype = None
+
+_lib.zet_merge_reader_read_view.argtypes = [ctypes.c_void_p, ctypes.POINTER(_ZetMessageView)]
+_lib.zet_merge_reader_read_view.restype = ctypes.c_int
+
+_lib.zet_merge_reader_get_start_time.argtypes = [ctypes.c_void_p]
+_lib.zet_merge_reader_get_start_time.restype = ctypes.c_uint64
+
+_lib.zet_merge_reader_get_count.argtypes = [ctypes.c_void_p]
+_lib.zet_merge_reader_get_count.restype = ctypes.c_size_t
+
+_lib.zet_merge_reader_get_reader.argtypes = [ctypes.c_void_p, ctypes.c_size_t]
+_lib.zet_merge_reader_get_reader.restype = ctypes.c_void_p
+
+_lib.zet_merge_reader_get_path.argtypes = [ctypes.c_void_p, ctypes.c_size_t]
+_lib.zet_merge_reader_get_path.restype = ctypes.c_char_p
+
+_lib.zet_merge_reader_get_status.argtypes = [ctypes.c_void_p, ctypes.c_size_t]
+_lib.zet_merge_reader_get_status.restype = ctypes.c_int
+
+_lib.zet_merge_reader_seek_time.argtypes = [ctypes.c_void_p, ctypes.c_uint64]
+_lib.zet_merge_reader_seek_time.restype = ctypes.c_int
+
+_lib.zet_manifest_read.argtypes = [ctypes.c_char_p, ctypes.POINTER(ctypes.POINTER(ctypes.c_char_p)),
+                                   ctypes.POINTER(ctypes.c_size_t)]
+_lib.zet_manifest_read.restype = ctypes.c_int
+
+_lib.zet_manifest_free.argtypes = [ctypes.POINTER(ctypes.c_char_p), ctypes.c_size_t]
+_lib.zet_manifest_free.restype = None
+
+_lib.zet_recover.argtypes = [ctypes.c_char_p, ctypes.POINTER(_ZetRecoverResult)]
+_lib.zet_recover.restype = ctypes.c_int
+
+_lib.zet_filter.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.POINTER(_ZetFilterOptions),
+                            ctypes.POINTER(_ZetFilterResult)]
+_lib.zet_filter.restype = ctypes.c_int
+
 
 class ZetMessage:
     """A message read from a .zet file."""
@@ -118,15 +300,48 @@ class ZetMessage:
 class ZetWriter:
     """Writer for .zet format files."""
     
-    def __init__(self, filename: str):
+    def __init__(self, filename: str, version: int = 0, chunk_size: int = 0, chunk_duration_ns: int = 0,
+                 compression: Optional[str] = None, compression_level: int = 0, buffer_size: int = 0,
+                 io: str = "posix", direct: bool = False, preallocate_size: int = 0,
+                 sync: Optional[str] = None, sync_interval_ns: int = 0, segment_size: int = 0,
+                 segment_duration_ns: int = 0, dedup_min_size: int = 0):
         """
         Create a new .zet file for writing.
         
         Args:
             filename: Path to the .zet file to create
+            version: Format version to write (1 to 4, 0 for the default)
+            chunk_size: Bytes of records per chunk (version 2, 0 for the default)
+            chunk_duration_ns: Longest time span of a chunk (version 2, 0 for the default)
+            compression: Chunk compression, None, "lz4" or "zstd" (version 2)
+            compression_level: zstd compression level (0 for the default)
+            buffer_size: Write through a buffer of this many bytes instead of
+                stdio (0 for stdio)
+            io: "posix" or "uring" (falls back to "posix" where unavailable)
+            direct: Bypass the page cache with O_DIRECT where supported
+            preallocate_size: Reserve disk space this many bytes ahead of the data
+            sync: Durability, None, "periodic" or "chunk"
+            sync_interval_ns: Interval for "periodic" (0 for the default, 1 s)
+            segment_size: Rotate to a new segment file once about this many
+                bytes are written; filename then names the manifest listing
+                the segments (see read_manifest())
+            segment_duration_ns: ...or once a segment spans this much time
+            dedup_min_size: Store each payload of at least this many bytes
+                once, and its repeats as references (version 2, 0 for off)
         """
+        self._writer = None
+        if compression not in _COMPRESSION:
+            raise ValueError(f"Unknown compression {compression!r}")
+        if io not in _IO:
+            raise ValueError(f"Unknown io {io!r}")
+        if sync not in _SYNC:
+            raise ValueError(f"Unknown sync {sync!r}")
         self._filename = filename
-        self._writer = _lib.zet_writer_create(filename.encode('utf-8'))
+        options = _ZetWriterOptions(version, chunk_size, chunk_duration_ns,
+                                    _COMPRESSION[compression], compression_level, buffer_size,
+                                    _IO[io], int(direct), preallocate_size, _SYNC[sync], sync_interval_ns,
+                                    segment_size, segment_duration_ns, dedup_min_size)
+        self._writer = _lib.zet_writer_create_ex(filename.encode('utf-8'), ctypes.byref(options))
         if not self._writer:
             raise IOError(f"Failed to create ZET writer for {filename}")
     
@@ -155,11 +370,42 @@ class ZetWriter:
         if result != 0:
             raise IOError(f"Failed to write message to {self._filename}")
     
+    def write_batch(self, messages) -> None:
+        """
+        Write several messages with a single call into the C library.
+        
+        Args:
+            messages: Sequence of ZetMessage
+        """
+        if not self._writer:
+            raise RuntimeError("Writer is closed")
+        
+        views = (_ZetMessageView * len(messages))()
+        keep = []  # Encoded topics and payloads must outlive the call
+        for view, msg in zip(views, messages):
+            topic = msg.topic.encode('utf-8')
+            data = bytes(msg.data)
+            keep.append((topic, data))
+            view.sent_ns = msg.sent_ns
+            view.received_ns = msg.received_ns
+            view.topic = ctypes.cast(ctypes.c_char_p(topic), ctypes.POINTER(ctypes.c_char))
+            view.data = ctypes.cast(ctypes.c_char_p(data), ctypes.c_void_p)
+            view.size = len(data)
+        
+        if _lib.zet_writer_write_batch(self._writer, views, len(messages)) != 0:
+            raise IOError(f"Failed to write messages to {self._filename}")
+    
     def flush(self) -> None:
         """Flush the file buffer to disk."""
         if self._writer:
             _lib.zet_writer_flush(self._writer)
     
+    def get_io(self) -> str:
+        """Get the output backend actually in use, "posix" or "uring"."""
+        if not self._writer:
+            raise RuntimeError("Writer is closed")
+        return "uring" if _lib.zet_writer_get_io(self._writer) == _IO["uring"] else "posix"
+    
     def close(self) -> None:
         """Close the writer and flush all data."""
         if self._writer:
@@ -180,17 +426,38 @@ class ZetWriter:
 class ZetReader:
     """Reader for .zet format files."""
     
-    def __init__(self, filename: str):
+    def __init__(self, filename: str, use_mmap: bool = False, threads: int = 0, read_ahead: int = 0,
+                 topics: Optional[List[str]] = None, follow: bool = False, follow_timeout_ns: int = 0):
         """
         Open a .zet file for reading.
         
         Args:
             filename: Path to the .zet file to read
+            use_mmap: Map the file into memory instead of reading it, so
+                iter_views() can hand out payloads without copying them
+            threads: Threads reading and decompressing chunks ahead of the
+                caller (0 reads everything on the calling thread)
+            read_ahead: With threads, chunks in flight (0 for the default)
+            topics: Read only messages on these topics (None for every
+                topic). Chunks the file's topic filters rule out are not read.
+            follow: Read a recording still being written: at the end of what
+                is there, wait for more. Reading ends at the end of a closed
+                chunked file, or with status "pending" (read again to carry on).
+            follow_timeout_ns: With follow, stop after waiting this long for a
+                new message (0 waits until the writer closes the file)
         """
         self._filename = filename
-        self._reader = _lib.zet_reader_create(filename.encode('utf-8'))
+        self._topics = {}  # Interned C topic address -> decoded topic
+        self._view = _ZetMessageView()
+        options = _ZetReaderOptions(int(use_mmap), threads, read_ahead, int(follow), follow_timeout_ns)
+        self._reader = _lib.zet_reader_create_ex(filename.encode('utf-8'), ctypes.byref(options))
         if not self._reader:
             raise IOError(f"Failed to open ZET file {filename}")
+        if topics is not None:
+            names = [topic.encode('utf-8') for topic in topics]
+            if _lib.zet_reader_set_topics(self._reader, (ctypes.c_char_p * len(names))(*names), len(names)) != 0:
+                self.close()
+                raise IOError(f"Failed to set topics on {filename}")
     
     def read_message(self) -> Optional[ZetMessage]:
         """
@@ -202,22 +469,47 @@ class ZetReader:
         if not self._reader:
             raise RuntimeError("Reader is closed")
         
-        c_msg = _ZetMessage()
-        result = _lib.zet_reader_read_message(self._reader, ctypes.byref(c_msg))
-        
-        if result != 0:
+        # Read in place and copy the payload once, straight into bytes
+        view = self._view
+        if _lib.zet_reader_read_view(self._reader, ctypes.byref(view)) != 0:
             return None  # End of file or error
         
-        # Convert C message to Python
-        topic = ctypes.string_at(c_msg.topic).decode('utf-8')
-        data = ctypes.string_at(c_msg.data, c_msg.size)
+        data = ctypes.string_at(view.data, view.size) if view.size else b""
+        return ZetMessage(view.sent_ns, view.received_ns, self._topic(view), data)
+    
+    def iter_views(self):
+        """
+        Generator that yields messages whose data is a read-only memoryview
+        into the reader's buffers (or the file mapping) instead of bytes.
         
-        msg = ZetMessage(c_msg.sent_ns, c_msg.received_ns, topic, data)
+        A view is only valid until the generator advances; copy it with
+        bytes() to keep it.
         
-        # Free the C message memory
-        _lib.zet_message_free(ctypes.byref(c_msg))
+        Yields:
+            ZetMessage objects with memoryview data
+        """
+        if not self._reader:
+            raise RuntimeError("Reader is closed")
         
-        return msg
+        view = self._view
+        while _lib.zet_reader_read_view(self._reader, ctypes.byref(view)) == 0:
+            if view.size:
+                data = memoryview((ctypes.c_char * view.size).from_address(view.data)).cast('B').toreadonly()
+            else:
+                data = memoryview(b"")
+            yield ZetMessage(view.sent_ns, view.received_ns, self._topic(view), data)
+            try:
+                data.release()  # Stale views raise instead of reading reused memory
+            except BufferError:
+                pass  # Still exported (e.g. to numpy); the caller owns that risk
+    
+    def _topic(self, view: _ZetMessageView) -> str:
+        # Topics are interned by the reader, so each one is decoded once
+        address = ctypes.cast(view.topic, ctypes.c_void_p).value
+        topic = self._topics.get(address)
+        if topic is None:
+            topic = self._topics[address] = ctypes.string_at(view.topic).decode('utf-8')
+        return topic
     
     def get_start_time(self) -> int:
         """
@@ -231,6 +523,78 @@ class ZetReader:
         
         return _lib.zet_reader_get_start_time(self._reader)
     
+    def get_version(self) -> int:
+        """
+        Get the format version of the file.
+        
+        Returns:
+            1, 2, 3 or 4
+        """
+        if not self._reader:
+            raise RuntimeError("Reader is closed")
+        
+        return _lib.zet_reader_get_version(self._reader)
+    
+    def seek_time(self, time_ns: int) -> None:
+        """
+        Position the reader at the first message received at or after time_ns.
+        
+        Chunked (version 2 and later) files are seeked through their chunk
+        index; version 1 files are scanned.
+        
+        Args:
+            time_ns: Receive timestamp to seek to (nanoseconds)
+        """
+        if not self._reader:
+            raise RuntimeError("Reader is closed")
+        
+        if _lib.zet_reader_seek_time(self._reader, ctypes.c_uint64(time_ns)) != 0:
+            raise IOError(f"Failed to seek in {self._filename}")
+    
+    def get_status(self) -> str:
+        """
+        Get why the last read returned no message.
+        
+        Returns:
+            "ok" (clean end of file), "truncated" (torn tail or missing index,
+            see recover()), "corrupt", "error" or, following, "pending"
+        """
+        if not self._reader:
+            raise RuntimeError("Reader is closed")
+        
+        return _STATUS.get(_lib.zet_reader_get_status(self._reader), "error")
+    
+    def get_summary(self) -> Optional[dict]:
+        """
+        Get the summary the writer left at the end of the file, without
+        reading the messages.
+        
+        Returns:
+            A dict with message_count, payload_bytes, start_ns, end_ns,
+            duration_ns and topics (topic name to a dict of message_count,
+            payload_bytes, first_ns, last_ns, min_size, max_size and
+            mean_size), or None for version 1 files and files never closed
+        """
+        if not self._reader:
+            raise RuntimeError("Reader is closed")
+        
+        summary = _ZetSummary()
+        if _lib.zet_reader_get_summary(self._reader, ctypes.byref(summary)) != 0:
+            return None
+        topics = {}
+        for i in range(summary.topic_count):
+            entry = summary.topics[i]
+            stats = {name: getattr(entry, name) for name, _ in _ZetTopicSummary._fields_ if name != "topic"}
+            topics[ctypes.string_at(entry.topic).decode('utf-8')] = stats
+        return {
+            "message_count": summary.message_count,
+            "payload_bytes": summary.payload_bytes,
+            "start_ns": summary.start_ns,
+            "end_ns": summary.end_ns,
+            "duration_ns": summary.end_ns - summary.start_ns,
+            "topics": topics,
+        }
+    
     def read_all_messages(self):
         """
         Generator that yields all messages in the file.
@@ -263,3 +627,193 @@ class ZetReader:
     def __iter__(self):
         """Iterate over all messages in the file."""
         return self.read_all_messages()
+
+
+class ZetMergeReader:
+    """Reader for several .zet files as one timeline, in received time order."""
+    
+    def __init__(self, filenames: List[str], use_mmap: bool = False, threads: int = 0):
+        """
+        Open several .zet files (from several machines, or segments of one
+        recording) for merged reading. Ties keep the order of filenames. A
+        manifest stands for the segments it lists.
+        
+        Args:
+            filenames: Paths to the .zet files to read
+            use_mmap: Map each file into memory instead of reading it
+            threads: Per file, threads decompressing chunks ahead of the caller
+        """
+        self._filenames = list(filenames)
+        self._topics = {}  # Interned C topic address -> decoded topic
+        self._view = _ZetMessageView()
+        names = (ctypes.c_char_p * len(self._filenames))(*[f.encode('utf-8') for f in self._filenames])
+        options = _ZetReaderOptions(int(use_mmap), threads, 0)
+        self._reader = _lib.zet_merge_reader_create(names, len(self._filenames), ctypes.byref(options))
+        if not self._reader:
+            raise IOError(f"Failed to open ZET files {', '.join(self._filenames)}")
+    
+    def read_message(self) -> Optional[ZetMessage]:
+        """
+        Read the next message of any of the files.
+        
+        Returns:
+            ZetMessage if successful, None once every file has ended
+        """
+        if not self._reader:
+            raise RuntimeError("Reader is closed")
+        
+        view = self._view
+        if _lib.zet_merge_reader_read_view(self._reader, ctypes.byref(view)) != 0:
+            return None
+        
+        data = ctypes.string_at(view.data, view.size) if view.size else b""
+        return ZetMessage(view.sent_ns, view.received_ns, self._topic(view), data)
+    
+    def _topic(self, view: _ZetMessageView) -> str:
+        # Topics are interned across all of the files, so each one is decoded once
+        address = ctypes.cast(view.topic, ctypes.c_void_p).value
+        topic = self._topics.get(address)
+        if topic is None:
+            topic = self._topics[address] = ctypes.string_at(view.topic).decode('utf-8')
+        return topic
+    
+    def get_start_time(self) -> int:
+        """Get the earliest start time of the files, in nanoseconds."""
+        if not self._reader:
+            raise RuntimeError("Reader is closed")
+        
+        return _lib.zet_merge_reader_get_start_time(self._reader)
+    
+    def seek_time(self, time_ns: int) -> None:
+        """
+        Position every file at its first message received at or after time_ns.
+        
+        Args:
+            time_ns: Receive timestamp to seek to (nanoseconds)
+        """
+        if not self._reader:
+            raise RuntimeError("Reader is closed")
+        
+        if _lib.zet_merge_reader_seek_time(self._reader, ctypes.c_uint64(time_ns)) != 0:
+            raise IOError(f"Failed to seek in {', '.join(self._filenames)}")
+    
+    def get_paths(self) -> List[str]:
+        """
+        Get the files being merged, with each manifest replaced by its segments.
+        
+        Returns:
+            The paths, in the order get_statuses() reports on them
+        """
+        if not self._reader:
+            raise RuntimeError("Reader is closed")
+        
+        return [_lib.zet_merge_reader_get_path(self._reader, i).decode('utf-8')
+                for i in range(_lib.zet_merge_reader_get_count(self._reader))]
+    
+    def get_statuses(self) -> List[str]:
+        """
+        Get, per file (per segment, for a manifest), why it stopped returning
+        messages.
+        
+        Returns:
+            One of "ok", "truncated", "corrupt" or "error" per file of
+            get_paths(), as ZetReader.get_status()
+        """
+        if not self._reader:
+            raise RuntimeError("Reader is closed")
+        
+        return [_STATUS.get(_lib.zet_merge_reader_get_status(self._reader, i), "error")
+                for i in range(_lib.zet_merge_reader_get_count(self._reader))]
+    
+    def close(self) -> None:
+        """Close the reader and all of its files."""
+        if self._reader:
+            _lib.zet_merge_reader_destroy(self._reader)
+            self._reader = None
+    
+    def __enter__(self):
+        return self
+    
+    def __exit__(self, exc_type, exc_val, exc_tb):
+        self.close()
+        return False
+    
+    def __del__(self):
+        self.close()
+    
+    def __iter__(self):
+        """Iterate over the messages of all of the files."""
+        while True:
+            msg = self.read_message()
+            if msg is None:
+                break
+            yield msg
+
+
+def read_manifest(filename: str) -> Optional[List[str]]:
+    """
+    List the segments of a recording written with rotation.
+    
+    Args:
+        filename: Path to the manifest
+    
+    Returns:
+        The segment paths in order (segments since deleted are left out), or
+        None if the file is not a manifest
+    """
+    segments = ctypes.POINTER(ctypes.c_char_p)()
+    count = ctypes.c_size_t()
+    if _lib.zet_manifest_read(filename.encode('utf-8'), ctypes.byref(segments), ctypes.byref(count)) != 0:
+        return None
+    paths = [segments[i].decode('utf-8') for i in range(count.value)]
+    _lib.zet_manifest_free(segments, count)
+    return paths
+
+
+def recover(filename: str) -> dict:
+    """
+    Repair a recording in place after a crash: drop a torn tail, cut out
+    damaged chunks and write a fresh index. An intact file is left alone.
+    
+    Args:
+        filename: Path to the .zet file
+    
+    Returns:
+        The zet_recover_result_t fields as a dict (intact as a bool)
+    """
+    result = _ZetRecoverResult()
+    if _lib.zet_recover(filename.encode('utf-8'), ctypes.byref(result)) != 0:
+        raise IOError(f"Failed to recover {filename}")
+    fields = {name: getattr(result, name) for name, _ in _ZetRecoverResult._fields_}
+    fields["intact"] = bool(fields["intact"])
+    return fields
+
+
+def filter_file(input: str, output: str, topics: Optional[List[str]] = None, start_ns: int = 0,
+                end_ns: int = 0, compression: Optional[str] = None) -> dict:
+    """
+    Write the messages of a recording on the given topics and in the given
+    time range to a new file. Chunks kept whole are copied without being
+    re-encoded.
+    
+    Args:
+        input: Path to the .zet file to read
+        output: Path to write (not the input)
+        topics: Topics to keep (None for every topic)
+        start_ns: Keep messages received at or after this time
+        end_ns: Keep messages received at or before this time (0 for no end)
+        compression: None, "lz4" or "zstd" for the chunks that are re-encoded
+    
+    Returns:
+        The zet_filter_result_t fields as a dict
+    """
+    if compression not in _COMPRESSION:
+        raise ValueError(f"Unknown compression {compression!r}")
+    names = [topic.encode('utf-8') for topic in topics or []]
+    array = (ctypes.c_char_p * len(names))(*names)
+    options = _ZetFilterOptions(array if names else None, len(names), start_ns, end_ns, _COMPRESSION[compression])
+    result = _ZetFilterResult()
+    if _lib.zet_filter(input.encode('utf-8'), output.encode('utf-8'), ctypes.byref(options),
+                       ctypes.byref(result)) != 0:
+        raise IOError(f"Failed to filter {input} into {output}")
+    return {name: getattr(result, name) for name, _ in _ZetFilterResult._fields_}
@@ -5,7 +5,8 @@ import tempfile
 import unittest
 from pathlib import Path
 
-from src.formats.zet.python.zet_format import ZetWriter, ZetReader, ZetMessage
+from src.formats.zet.python.zet_format import (ZetWriter, ZetReader, ZetMergeReader, ZetMessage, filter_file,
+                                                read_manifest, recover)
 
 
 class TestZetFormat(unittest.TestCase):
@@ -185,6 +186,294 @@ class TestZetFormat(unittest.TestCase):
         with self.assertRaises(IOError):
             ZetWriter("/nonexistent_dir_12345/test.zet")
     
+    def test_seek_time(self):
+        """Test seeking to a time in a chunked file."""
+        with ZetWriter(self.temp_file, chunk_size=512) as writer:
+            for i in range(1000):
+                writer.write_message("seek/topic", str(i).encode(), received_ns=1000 + i * 10)
+        
+        with ZetReader(self.temp_file) as reader:
+            self.assertEqual(reader.get_version(), 4)
+            reader.seek_time(1000 + 617 * 10 - 5)
+            self.assertEqual(reader.read_message().data, b"617")
+            reader.seek_time(0)
+            self.assertEqual(reader.read_message().data, b"0")
+            reader.seek_time(10 ** 12)
+            self.assertIsNone(reader.read_message())
+    
+    def test_version1_seek(self):
+        """Test that version 1 files are still written, read and seekable."""
+        with ZetWriter(self.temp_file, version=1) as writer:
+            for i in range(10):
+                writer.write_message("v1/topic", bytes([i]), received_ns=100 + i)
+        
+        with ZetReader(self.temp_file) as reader:
+            self.assertEqual(reader.get_version(), 1)
+            reader.seek_time(105)
+            self.assertEqual([m.data for m in reader], [bytes([i]) for i in range(5, 10)])
+    
+    def test_compression(self):
+        """Test that compressed chunks read back and seek like plain ones."""
+        for compression in ("lz4", "zstd"):
+            with ZetWriter(self.temp_file, chunk_size=4096, compression=compression) as writer:
+                for i in range(2000):
+                    writer.write_message("sensor/imu", bytes(100) + i.to_bytes(4, 'little'), received_ns=1 + i)
+            self.assertLess(os.path.getsize(self.temp_file), 2000 * 100 // 4)
+            
+            with ZetReader(self.temp_file) as reader:
+                self.assertEqual(sum(1 for _ in reader), 2000)
+                reader.seek_time(1500)
+                self.assertEqual(reader.read_message().data[100:], (1499).to_bytes(4, 'little'))
+        
+        with self.assertRaises(ValueError):
+            ZetWriter(self.temp_file, compression="gzip")
+    
+    def test_channel_topics(self):
+        """Test that topics round trip through channel IDs and older versions."""
+        topics = [f"robot/arm_{i}/joint_states" for i in range(50)]
+        for version in (2, 3):
+            with ZetWriter(self.temp_file, version=version) as writer:
+                for i in range(500):
+                    writer.write_message(topics[i % 50], bytes(8), received_ns=i)
+            
+            with ZetReader(self.temp_file) as reader:
+                self.assertEqual(reader.get_version(), version)
+                self.assertEqual([m.topic for m in reader], [topics[i % 50] for i in range(500)])
+    
+    def test_mmap_reader(self):
+        """Test the mapped reader and zero-copy views."""
+        with ZetWriter(self.temp_file, chunk_size=1024) as writer:
+            for i in range(300):
+                writer.write_message(f"topic/{i % 3}", i.to_bytes(4, 'little') * 10, received_ns=i)
+            writer.write_message("topic/empty", b"", received_ns=300)
+        
+        with ZetReader(self.temp_file) as reader:
+            expected = [(m.topic, m.data, m.received_ns) for m in reader]
+        
+        with ZetReader(self.temp_file, use_mmap=True) as reader:
+            self.assertEqual([(m.topic, m.data, m.received_ns) for m in reader], expected)
+            
+            reader.seek_time(0)
+            views = []
+            for msg in reader.iter_views():
+                self.assertIsInstance(msg.data, memoryview)
+                self.assertTrue(msg.data.readonly)
+                views.append((msg.topic, bytes(msg.data), msg.received_ns))
+            self.assertEqual(views, expected)
+        
+        with self.assertRaises(IOError):
+            ZetReader("/tmp/nonexistent_file_12345.zet", use_mmap=True)
+    
+    def test_threaded_reader(self):
+        """Test that threaded readers return the same messages, also across a seek."""
+        with ZetWriter(self.temp_file, chunk_size=2048, compression="lz4") as writer:
+            for i in range(3000):
+                writer.write_message(f"topic/{i % 4}", i.to_bytes(4, 'little') * 8, received_ns=1 + i)
+        
+        with ZetReader(self.temp_file) as reader:
+            expected = [(m.topic, m.data, m.received_ns) for m in reader]
+        
+        for use_mmap in (False, True):
+            with ZetReader(self.temp_file, use_mmap=use_mmap, threads=3, read_ahead=4) as reader:
+                self.assertEqual([(m.topic, m.data, m.received_ns) for m in reader], expected)
+                reader.seek_time(2000)
+                self.assertEqual([m.received_ns for m in reader], [t for _, _, t in expected[1999:]])
+    
+    def test_merge_reader(self):
+        """Test that several files read back as one timeline."""
+        files = [self.temp_file, self.temp_file + ".b", self.temp_file + ".c"]
+        try:
+            for f, filename in enumerate(files):
+                with ZetWriter(filename, version=1 if f == 0 else 0, chunk_size=1024) as writer:
+                    for i in range(200):
+                        writer.write_message(f"robot{f}/odom", bytes([f, i]), received_ns=3 * i + f)
+            
+            with ZetMergeReader(files) as reader:
+                messages = list(reader)
+                self.assertEqual([m.received_ns for m in messages], list(range(600)))
+                self.assertEqual(messages[5].topic, "robot2/odom")
+                self.assertEqual(messages[5].data, bytes([2, 1]))
+                self.assertEqual(reader.get_statuses(), ["ok", "ok", "ok"])
+                
+                reader.seek_time(300)
+                self.assertEqual([m.received_ns for m in reader], list(range(300, 600)))
+            
+            with self.assertRaises(IOError):
+                ZetMergeReader([files[0], "/tmp/nonexistent_file_12345.zet"])
+        finally:
+            for filename in files[1:]:
+                if os.path.exists(filename):
+                    os.unlink(filename)
+    
+    def test_rotation(self):
+        """Test that a rotated recording lists its segments and reads as one."""
+        manifest = self.temp_file + "m"
+        segments = []
+        try:
+            with ZetWriter(manifest, segment_duration_ns=100) as writer:
+                for i in range(350):
+                    writer.write_message("sensor/imu", i.to_bytes(4, 'little'), received_ns=1 + i)
+            
+            segments = read_manifest(manifest)
+            self.assertEqual(len(segments), 4)
+            with ZetReader(segments[1]) as reader:
+                self.assertEqual([m.received_ns for m in reader], list(range(101, 201)))
+            with ZetMergeReader([manifest]) as reader:
+                self.assertEqual([m.received_ns for m in reader], list(range(1, 351)))
+                self.assertEqual(reader.get_paths(), segments)
+                self.assertEqual(reader.get_statuses(), ["ok"] * 4)
+            self.assertIsNone(read_manifest(segments[0]))
+        finally:
+            for filename in segments + [manifest]:
+                if os.path.exists(filename):
+                    os.unlink(filename)
+    
+    def test_filter(self):
+        """Test that filtering by topic and time keeps the right messages."""
+        output = self.temp_file + ".out"
+        try:
+            with ZetWriter(self.temp_file, chunk_size=1024, compression="lz4") as writer:
+                for i in range(2000):
+                    writer.write_message(f"filter/{i // 250 % 2}", i.to_bytes(4, 'little'), received_ns=1 + i)
+            
+            result = filter_file(self.temp_file, output, topics=["filter/1"])
+            self.assertEqual(result["message_count"], 1000)
+            self.assertGreater(result["chunks_copied"], 0)
+            with ZetReader(output) as reader:
+                self.assertEqual([m.received_ns for m in reader],
+                                 [1 + i for i in range(2000) if i // 250 % 2 == 1])
+            
+            filter_file(self.temp_file, output, start_ns=101, end_ns=600, compression="zstd")
+            with ZetReader(output) as reader:
+                self.assertEqual([m.received_ns for m in reader], list(range(101, 601)))
+            
+            with self.assertRaises(IOError):
+                filter_file(self.temp_file, self.temp_file)
+        finally:
+            if os.path.exists(output):
+                os.unlink(output)
+    
+    def test_topics(self):
+        """Test that a reader given topics returns only their messages."""
+        with ZetWriter(self.temp_file, chunk_size=4096) as writer:
+            for i in range(3000):
+                topic = "sensor/gps" if i % 300 == 0 else "camera/front"
+                writer.write_message(topic, i.to_bytes(4, 'little') * 100, received_ns=1 + i)
+        
+        for options in ({}, {"use_mmap": True, "threads": 2}):
+            with ZetReader(self.temp_file, topics=["sensor/gps"], **options) as reader:
+                messages = list(reader)
+            self.assertEqual([m.received_ns for m in messages], [1 + i for i in range(0, 3000, 300)])
+            self.assertTrue(all(m.topic == "sensor/gps" for m in messages))
+        with ZetReader(self.temp_file, topics=["sensor/gps", "camera/front"]) as reader:
+            self.assertEqual(len(list(reader)), 3000)
+    
+    def test_follow(self):
+        """Test that a following reader picks up messages as they are flushed."""
+        with ZetWriter(self.temp_file, chunk_size=4096) as writer:
+            writer.flush()
+            with ZetReader(self.temp_file, follow=True, follow_timeout_ns=20_000_000) as reader:
+                for start in (0, 100, 200):
+                    for i in range(start, start + 100):
+                        writer.write_message("follow/topic", i.to_bytes(4, 'little'), received_ns=1 + i)
+                    writer.flush()
+                    self.assertEqual([m.received_ns for m in reader], [1 + i for i in range(start, start + 100)])
+                    self.assertEqual(reader.get_status(), "pending")
+                writer.close()
+                self.assertIsNone(reader.read_message())
+                self.assertEqual(reader.get_status(), "ok")
+    
+    def test_dedup(self):
+        """Test that repeated payloads are stored once and read back whole."""
+        latched = [os.urandom(4096) for _ in range(3)]
+        for dedup_min_size in (0, 1024):
+            with ZetWriter(self.temp_file, chunk_size=16384, dedup_min_size=dedup_min_size) as writer:
+                for i in range(600):
+                    writer.write_message("dedup/map", latched[i // 200], received_ns=1 + i)
+            if dedup_min_size == 0:
+                plain_size = os.path.getsize(self.temp_file)
+        self.assertLess(os.path.getsize(self.temp_file) * 10, plain_size)
+        
+        with ZetReader(self.temp_file) as reader:
+            self.assertEqual([m.data for m in reader], [latched[i // 200] for i in range(600)])
+            self.assertEqual(reader.get_status(), "ok")
+            self.assertEqual(reader.get_summary()["payload_bytes"], 600 * 4096)
+        with self.assertRaises(IOError):
+            ZetWriter(self.temp_file, version=1, dedup_min_size=1024)
+    
+    def test_buffered_batches(self):
+        """Test that batches through the writer's own buffer read back in order."""
+        messages = [ZetMessage(i, 1000 + i, f"batch/{i % 4}", bytes([i % 256]) * (i % 300))
+                    for i in range(1000)]
+        with ZetWriter(self.temp_file, buffer_size=1 << 16) as writer:
+            writer.write_batch(messages[:10])
+            writer.write_batch([])
+            writer.write_batch(messages[10:])
+        
+        with ZetReader(self.temp_file) as reader:
+            self.assertEqual([(m.topic, m.data, m.sent_ns, m.received_ns) for m in reader],
+                             [(m.topic, m.data, m.sent_ns, m.received_ns) for m in messages])
+    
+    def test_io_options(self):
+        """Test that io_uring, O_DIRECT and sync options write the same records."""
+        messages = [ZetMessage(i, 1 + i, "io/topic", bytes([i % 256]) * 333) for i in range(3000)]
+        for options in ({"io": "uring"}, {"direct": True, "preallocate_size": 1 << 20},
+                        {"io": "uring", "direct": True, "sync": "chunk"}, {"sync": "periodic"}):
+            with ZetWriter(self.temp_file, chunk_size=8192, **options) as writer:
+                self.assertIn(writer.get_io(), ("posix", "uring"))
+                writer.write_batch(messages[:1000])
+                writer.flush()
+                writer.write_batch(messages[1000:])
+            
+            with ZetReader(self.temp_file) as reader:
+                self.assertEqual([(m.data, m.received_ns) for m in reader],
+                                 [(m.data, m.received_ns) for m in messages])
+        
+        with self.assertRaises(ValueError):
+            ZetWriter(self.temp_file, sync="always")
+    
+    def test_recover(self):
+        """Test that a torn recording reads as truncated and recovers to its whole chunks."""
+        with ZetWriter(self.temp_file, chunk_size=1024) as writer:
+            for i in range(1000):
+                writer.write_message("crash/topic", i.to_bytes(4, 'little'), received_ns=1 + i)
+        self.assertTrue(recover(self.temp_file)["intact"])
+        
+        os.truncate(self.temp_file, os.path.getsize(self.temp_file) // 2)
+        with ZetReader(self.temp_file) as reader:
+            count = sum(1 for _ in reader)
+            self.assertEqual(reader.get_status(), "truncated")
+        
+        result = recover(self.temp_file)
+        self.assertFalse(result["intact"])
+        self.assertEqual(result["message_count"], count)
+        with ZetReader(self.temp_file) as reader:
+            self.assertEqual([int.from_bytes(m.data, 'little') for m in reader], list(range(count)))
+            self.assertEqual(reader.get_status(), "ok")
+    
+    def test_summary(self):
+        """Test that a closed file describes its topics without reading messages."""
+        with ZetWriter(self.temp_file) as writer:
+            for i in range(300):
+                topic = "summary/fast" if i % 3 else "summary/slow"
+                writer.write_message(topic, b"x" * (1 + i % 10), received_ns=1000 + i)
+        
+        with ZetReader(self.temp_file) as reader:
+            summary = reader.get_summary()
+        self.assertEqual(summary["message_count"], 300)
+        self.assertEqual(summary["duration_ns"], 299)
+        self.assertEqual(list(summary["topics"]), ["summary/slow", "summary/fast"])
+        slow = summary["topics"]["summary/slow"]
+        self.assertEqual(slow["message_count"], 100)
+        self.assertEqual((slow["first_ns"], slow["last_ns"]), (1000, 1297))
+        self.assertEqual((slow["min_size"], slow["max_size"]), (1, 10))
+        self.assertAlmostEqual(slow["mean_size"], slow["payload_bytes"] / 100)
+        
+        with ZetWriter(self.temp_file, version=1) as writer:
+            writer.write_message("summary/v1", b"x")
+        with ZetReader(self.temp_file) as reader:
+            self.assertIsNone(reader.get_summary())
+    
     def test_message_repr(self):
         """Test ZetMessage string representation."""
         msg = ZetMessage(1000, 2000, "test/topic", b"test data")
@@ -0,0 +1,46 @@
+"""Bazel macro for schema-defined zeta messages."""
+
+load("@rules_cc//cc:defs.bzl", "cc_library")
+load("@rules_python//python:defs.bzl", "py_library")
+
+def zeta_message_library(name, srcs, visibility = None):
+    """Generates C, C++ and Python accessors for .zmsg schemas.
+
+    Creates:
+      <name>: cc_library exposing <name>.h (C) and <name>.hpp (C++)
+      <name>_py: py_library exposing the <name> module
+
+    Args:
+      name: Target name, also the base name of the generated files.
+      srcs: .zmsg schema files; all must share one package.
+      visibility: Visibility of the generated libraries.
+    """
+    c_header = name + ".h"
+    cpp_header = name + ".hpp"
+    py_module = name + ".py"
+    c_include = native.package_name() + "/" + c_header
+
+    native.genrule(
+        name = name + "_gen",
+        srcs = srcs,
+        outs = [c_header, cpp_header, py_module],
+        cmd = "$(execpath //src/schema:zschema) $(SRCS)" +
+              " --c $(location " + c_header + ")" +
+              " --cpp $(location " + cpp_header + ")" +
+              " --c-include " + c_include +
+              " --py $(location " + py_module + ")",
+        tools = ["//src/schema:zschema"],
+    )
+
+    cc_library(
+        name = name,
+        hdrs = [c_header, cpp_header],
+        deps = ["//src/schema:zeta_msg"],
+        visibility = visibility,
+    )
+
+    py_library(
+        name = name + "_py",
+        srcs = [py_module],
+        visibility = visibility,
+    )
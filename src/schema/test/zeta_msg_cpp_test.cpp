@@ -0,0 +1,40 @@
+#include "src/schema/test_messages.hpp"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+
+// Test the C++ wrappers over the generated C accessors
+void test_cpp_roundtrip() {
+    printf("Running test_cpp_roundtrip...\n");
+
+    alignas(8) uint8_t buf[256];
+    std::string_view frame = "imu_link";
+    zt::ImuBuilder builder;
+    assert(builder.init(buf, sizeof(buf), frame.size()));
+    builder.set_stamp_ns(99);
+    builder.set_accel(1, -9.81);
+    builder.set_valid(true);
+    memcpy(builder.frame_id_mut(), frame.data(), frame.size());
+
+    zt::ImuView view;
+    assert(view.init(buf, builder.size()));
+    assert(view.stamp_ns() == 99);
+    assert(view.accel(1) == -9.81);
+    assert(view.valid());
+    assert(view.frame_id() == frame);
+
+    zt::PointCloudView wrong;
+    assert(!wrong.init(buf, builder.size()));
+
+    printf("test_cpp_roundtrip PASSED\n");
+}
+
+int main() {
+    printf("Running zeta message C++ tests...\n\n");
+
+    test_cpp_roundtrip();
+
+    printf("\nAll tests PASSED!\n");
+    return 0;
+}
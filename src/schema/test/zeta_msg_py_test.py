@@ -0,0 +1,70 @@
+"""Tests for generated Python zeta message views."""
+
+import struct
+import sys
+import unittest
+
+from src.schema.test_messages import Imu, PointCloud
+
+
+class TestZetaMsg(unittest.TestCase):
+    """Test suite for generated message accessors."""
+
+    def test_imu_roundtrip(self):
+        """Test encoding and reading a message with fixed fields and a string."""
+        data = Imu.encode(stamp_ns=123, accel=(1.0, 2.0, 3.0), orientation=(0.0, 0.0, 0.0, 1.0),
+                          valid=True, frame_id="base_link")
+        self.assertEqual(len(data) % 8, 0)
+
+        msg = Imu(data)
+        self.assertEqual(msg.stamp_ns, 123)
+        self.assertEqual(msg.accel, (1.0, 2.0, 3.0))
+        self.assertEqual(msg.orientation[3], 1.0)
+        self.assertTrue(msg.valid)
+        self.assertEqual(msg.frame_id, "base_link")
+
+    def test_point_cloud_roundtrip(self):
+        """Test variable-length arrays and bytes."""
+        data = PointCloud.encode(seq=7, sensor=-2, xyz=[0.5, 1.5, 2.5], blob=b"\x01\x02", kind=3,
+                                 ids=[-1, 2**40])
+        msg = PointCloud(data)
+        self.assertEqual(msg.seq, 7)
+        self.assertEqual(msg.sensor, -2)
+        self.assertEqual(msg.kind, 3)
+        self.assertEqual(list(msg.xyz), [0.5, 1.5, 2.5])
+        self.assertEqual(bytes(msg.blob), b"\x01\x02")
+        self.assertEqual(list(msg.ids), [-1, 2**40])
+
+    def test_view_is_zero_copy(self):
+        """Test that array fields share memory with the buffer on little-endian hosts."""
+        buf = bytearray(PointCloud.encode(xyz=[1.0, 2.0]))
+        xyz = PointCloud(buf).xyz
+        if sys.byteorder != "little":
+            self.skipTest("arrays are copied on big-endian hosts")
+        self.assertIsInstance(xyz, memoryview)
+        struct.pack_into("<f", buf, PointCloud.FIXED_SIZE, 4.0)
+        self.assertEqual(xyz[0], 4.0)
+
+    def test_rejects_invalid(self):
+        """Test that mismatched schemas and truncated buffers are rejected."""
+        data = Imu.encode(frame_id="x")
+        with self.assertRaises(ValueError):
+            PointCloud(data)
+        with self.assertRaises(ValueError):
+            Imu(data[:16])
+        with self.assertRaises(ValueError):
+            Imu(b"not a zeta message at all, not at all" * 4)
+
+    def test_schema_hash_in_header(self):
+        """Test that the schema hash is readable from the header alone."""
+        data = PointCloud.encode()
+        magic, version, _flags, size, schema_hash = struct.unpack_from("<2sBBIQ", data, 0)
+        self.assertEqual(magic, b"ZM")
+        self.assertEqual(version, 1)
+        self.assertEqual(size, len(data))
+        self.assertEqual(schema_hash, PointCloud.SCHEMA_HASH)
+        self.assertNotEqual(PointCloud.SCHEMA_HASH, Imu.SCHEMA_HASH)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,153 @@
+#include "src/schema/test_messages.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+// Test a message with only fixed fields and a string
+void test_imu_roundtrip(void) {
+    printf("Running test_imu_roundtrip...\n");
+
+    _Alignas(8) uint8_t buf[256];
+    const char* frame = "base_link";
+    size_t size = zt_imu_encoded_size(strlen(frame));
+    assert(size % ZETA_MSG_VAR_ALIGN == 0);
+
+    zt_imu_builder_t builder;
+    assert(zt_imu_builder_init(&builder, buf, sizeof(buf), strlen(frame)) == 0);
+    assert(builder.size == size);
+    zt_imu_set_stamp_ns(&builder, 123456789012345ULL);
+    for (size_t i = 0; i < ZT_IMU_ACCEL_LEN; i++) {
+        zt_imu_set_accel(&builder, i, 1.5 * (double)(i + 1));
+    }
+    for (size_t i = 0; i < ZT_IMU_ORIENTATION_LEN; i++) {
+        zt_imu_set_orientation(&builder, i, 0.25f * (float)i);
+    }
+    zt_imu_set_valid(&builder, true);
+    memcpy(zt_imu_frame_id_mut(&builder), frame, strlen(frame));
+
+    zt_imu_view_t view;
+    assert(zt_imu_view_init(&view, buf, size) == 0);
+    assert(zt_imu_stamp_ns(&view) == 123456789012345ULL);
+    assert(zt_imu_accel(&view, 2) == 4.5);
+    assert(zt_imu_orientation(&view, 3) == 0.75f);
+    assert(zt_imu_valid(&view));
+
+    size_t len = 0;
+    const char* got = zt_imu_frame_id(&view, &len);
+    assert(len == strlen(frame));
+    assert(strcmp(got, frame) == 0); // NUL-terminated in place
+    assert(got >= (const char*)buf && got < (const char*)buf + size);
+
+    uint64_t hash = 0;
+    assert(zeta_msg_peek_schema_hash(buf, size, &hash) == 0);
+    assert(hash == ZT_IMU_SCHEMA_HASH);
+
+    printf("test_imu_roundtrip PASSED\n");
+}
+
+// Test variable-length arrays and bytes
+void test_point_cloud_roundtrip(void) {
+    printf("Running test_point_cloud_roundtrip...\n");
+
+    _Alignas(8) uint8_t buf[512];
+    const uint8_t blob[5] = {1, 2, 3, 4, 5};
+    zt_point_cloud_builder_t builder;
+    assert(zt_point_cloud_builder_init(&builder, buf, sizeof(buf), 6, sizeof(blob), 3) == 0);
+    zt_point_cloud_set_seq(&builder, 42);
+    zt_point_cloud_set_sensor(&builder, -7);
+    zt_point_cloud_set_kind(&builder, 9);
+    for (size_t i = 0; i < 6; i++) {
+        zt_point_cloud_set_xyz_at(&builder, i, (float)i * 0.5f);
+    }
+    memcpy(zt_point_cloud_blob_mut(&builder), blob, sizeof(blob));
+    for (size_t i = 0; i < 3; i++) {
+        zt_point_cloud_set_ids_at(&builder, i, -(int64_t)i * 1000000000000LL);
+    }
+
+    zt_point_cloud_view_t view;
+    assert(zt_point_cloud_view_init(&view, buf, builder.size) == 0);
+    assert(zt_point_cloud_seq(&view) == 42);
+    assert(zt_point_cloud_sensor(&view) == -7);
+    assert(zt_point_cloud_kind(&view) == 9);
+    assert(zt_point_cloud_xyz_count(&view) == 6);
+    assert(zt_point_cloud_xyz_at(&view, 5) == 2.5f);
+    assert(zt_point_cloud_ids_count(&view) == 3);
+    assert(zt_point_cloud_ids_at(&view, 2) == -2000000000000LL);
+
+    size_t len = 0;
+    const uint8_t* got = zt_point_cloud_blob(&view, &len);
+    assert(len == sizeof(blob));
+    assert(memcmp(got, blob, len) == 0);
+
+#if ZETA_MSG_LITTLE_ENDIAN
+    // Arrays are aligned, so they can be used in place
+    const float* xyz = zt_point_cloud_xyz(&view);
+    assert(((uintptr_t)xyz % sizeof(float)) == 0);
+    assert(xyz[4] == 2.0f);
+    const int64_t* ids = zt_point_cloud_ids(&view);
+    assert(((uintptr_t)ids % sizeof(int64_t)) == 0);
+#endif
+
+    printf("test_point_cloud_roundtrip PASSED\n");
+}
+
+// Test that malformed buffers are rejected
+void test_view_rejects_invalid(void) {
+    printf("Running test_view_rejects_invalid...\n");
+
+    _Alignas(8) uint8_t buf[512];
+    zt_point_cloud_builder_t builder;
+    assert(zt_point_cloud_builder_init(&builder, buf, sizeof(buf), 4, 0, 0) == 0);
+    size_t size = builder.size;
+
+    zt_point_cloud_view_t pc;
+    zt_imu_view_t imu;
+    assert(zt_point_cloud_view_init(&pc, buf, size) == 0);
+
+    // Wrong schema
+    assert(zt_imu_view_init(&imu, buf, size) != 0);
+
+    // Truncated
+    assert(zt_point_cloud_view_init(&pc, buf, ZETA_MSG_HEADER_SIZE) != 0);
+    assert(zt_point_cloud_view_init(&pc, buf, size - 8) != 0);
+
+    // Variable field pointing past the end
+    uint8_t bad[512];
+    memcpy(bad, buf, size);
+    zeta_msg_store_u32(bad + 28, 1000);
+    assert(zt_point_cloud_view_init(&pc, bad, size) != 0);
+
+    // String without its terminator, which would read past the buffer
+    _Alignas(8) uint8_t imu_buf[256];
+    zt_imu_builder_t imu_builder;
+    assert(zt_imu_builder_init(&imu_builder, imu_buf, sizeof(imu_buf), 4) == 0);
+    memcpy(zt_imu_frame_id_mut(&imu_builder), "base", 4);
+    assert(zt_imu_view_init(&imu, imu_buf, imu_builder.size) == 0);
+    uint32_t frame_offset = zeta_msg_load_u32(imu_buf + 68); // frame_id entry
+    imu_buf[frame_offset + 4] = 'x';
+    assert(zt_imu_view_init(&imu, imu_buf, imu_builder.size) != 0);
+    imu_buf[frame_offset + 4] = 0;
+    zeta_msg_store_u32(imu_buf + 72, (uint32_t)(imu_builder.size - frame_offset));
+    assert(zt_imu_view_init(&imu, imu_buf, imu_builder.size) != 0);
+
+    // Not a zeta message at all
+    memcpy(bad, "hello world, not a message", 26);
+    uint64_t hash;
+    assert(zeta_msg_peek_schema_hash(bad, 26, &hash) != 0);
+
+    // Builder capacity too small
+    assert(zt_point_cloud_builder_init(&builder, buf, 16, 4, 0, 0) != 0);
+
+    printf("test_view_rejects_invalid PASSED\n");
+}
+
+int main(void) {
+    printf("Running zeta message tests...\n\n");
+
+    test_imu_roundtrip();
+    test_point_cloud_roundtrip();
+    test_view_rejects_invalid();
+
+    printf("\nAll tests PASSED!\n");
+    return 0;
+}
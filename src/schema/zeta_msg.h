@@ -0,0 +1,170 @@
+#ifndef ZETA_MSG_H
+#define ZETA_MSG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Runtime support for schema-defined zeta messages (see zschema.py)
+//
+// Every generated message starts with a zeta_msg_header_t followed by a fixed
+// section (scalars and fixed arrays at naturally aligned offsets, plus one
+// (offset, count) entry per variable-length field) and then the variable
+// data, each field 8-byte aligned. All values are little-endian, so decoding is
+// pointer arithmetic plus, on big-endian hosts, a byte swap.
+
+#define ZETA_MSG_VERSION 1
+#define ZETA_MSG_HEADER_SIZE 16
+#define ZETA_MSG_VAR_ALIGN 8
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define ZETA_MSG_LITTLE_ENDIAN 0
+#else
+#define ZETA_MSG_LITTLE_ENDIAN 1
+#endif
+
+typedef struct {
+    uint8_t magic[2];     // "ZM"
+    uint8_t version;      // Layout version (1)
+    uint8_t flags;        // Reserved (0)
+    uint32_t size;        // Total message size in bytes, header included
+    uint64_t schema_hash; // FNV-1a 64 of the canonical schema definition
+} zeta_msg_header_t;
+
+// Little-endian loads and stores
+
+static inline uint16_t zeta_msg_load_u16(const uint8_t* p) {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+#if !ZETA_MSG_LITTLE_ENDIAN
+    v = __builtin_bswap16(v);
+#endif
+    return v;
+}
+
+static inline uint32_t zeta_msg_load_u32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+#if !ZETA_MSG_LITTLE_ENDIAN
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+static inline uint64_t zeta_msg_load_u64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if !ZETA_MSG_LITTLE_ENDIAN
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static inline float zeta_msg_load_f32(const uint8_t* p) {
+    uint32_t bits = zeta_msg_load_u32(p);
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+static inline double zeta_msg_load_f64(const uint8_t* p) {
+    uint64_t bits = zeta_msg_load_u64(p);
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+static inline void zeta_msg_store_u16(uint8_t* p, uint16_t v) {
+#if !ZETA_MSG_LITTLE_ENDIAN
+    v = __builtin_bswap16(v);
+#endif
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline void zeta_msg_store_u32(uint8_t* p, uint32_t v) {
+#if !ZETA_MSG_LITTLE_ENDIAN
+    v = __builtin_bswap32(v);
+#endif
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline void zeta_msg_store_u64(uint8_t* p, uint64_t v) {
+#if !ZETA_MSG_LITTLE_ENDIAN
+    v = __builtin_bswap64(v);
+#endif
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline void zeta_msg_store_f32(uint8_t* p, float v) {
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    zeta_msg_store_u32(p, bits);
+}
+
+static inline void zeta_msg_store_f64(uint8_t* p, double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    zeta_msg_store_u64(p, bits);
+}
+
+static inline size_t zeta_msg_align(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+// Read the schema hash if data looks like a zeta message (0 on success).
+// Used by tools that store payloads opaquely, such as the recorder.
+static inline int zeta_msg_peek_schema_hash(const void* data, size_t size, uint64_t* schema_hash) {
+    const uint8_t* p = (const uint8_t*)data;
+    if (!p || size < ZETA_MSG_HEADER_SIZE) return -1;
+    if (p[0] != 'Z' || p[1] != 'M' || p[2] != ZETA_MSG_VERSION) return -1;
+    if (zeta_msg_load_u32(p + 4) > size) return -1;
+    *schema_hash = zeta_msg_load_u64(p + 8);
+    return 0;
+}
+
+// Validate the header and fixed section of a received message (0 on success)
+static inline int zeta_msg_check(const uint8_t* p, size_t size, uint64_t schema_hash, size_t fixed_size) {
+    uint64_t hash;
+    if (zeta_msg_peek_schema_hash(p, size, &hash) != 0 || hash != schema_hash) return -1;
+    if (size < fixed_size || zeta_msg_load_u32(p + 4) < fixed_size) return -1;
+    return 0;
+}
+
+// Validate a variable-length field entry at entry_offset (0 on success)
+static inline int zeta_msg_check_var(const uint8_t* p, size_t size, size_t entry_offset, size_t elem_size) {
+    uint64_t offset = zeta_msg_load_u32(p + entry_offset);
+    uint64_t count = zeta_msg_load_u32(p + entry_offset + 4);
+    if (offset % ZETA_MSG_VAR_ALIGN != 0) return -1;
+    if (offset + count * elem_size > size) return -1;
+    return 0;
+}
+
+// Validate a string field entry, including the terminator the builder reserves
+// after it, so readers can treat the string as a C string (0 on success)
+static inline int zeta_msg_check_string(const uint8_t* p, size_t size, size_t entry_offset) {
+    if (zeta_msg_check_var(p, size, entry_offset, 1) != 0) return -1;
+    uint64_t end = (uint64_t)zeta_msg_load_u32(p + entry_offset) + zeta_msg_load_u32(p + entry_offset + 4);
+    if (end >= size || p[end] != 0) return -1;
+    return 0;
+}
+
+// Write the message header
+static inline void zeta_msg_init_header(uint8_t* p, size_t size, uint64_t schema_hash) {
+    p[0] = 'Z';
+    p[1] = 'M';
+    p[2] = ZETA_MSG_VERSION;
+    p[3] = 0;
+    zeta_msg_store_u32(p + 4, (uint32_t)size);
+    zeta_msg_store_u64(p + 8, schema_hash);
+}
+
+// Point the variable field entry at data_offset and return the next aligned
+// free offset (extra covers trailing bytes such as a string terminator)
+static inline size_t zeta_msg_place_var(uint8_t* p, size_t entry_offset, size_t data_offset,
+                                        size_t count, size_t elem_size, size_t extra) {
+    zeta_msg_store_u32(p + entry_offset, (uint32_t)data_offset);
+    zeta_msg_store_u32(p + entry_offset + 4, (uint32_t)count);
+    return zeta_msg_align(data_offset + count * elem_size + extra, ZETA_MSG_VAR_ALIGN);
+}
+
+#endif // ZETA_MSG_H
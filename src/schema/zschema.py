@@ -0,0 +1,654 @@
+"""
+zschema - code generator for schema-defined zeta messages.
+
+Reads .zmsg schema files and generates read-in-place accessor views (and
+builders) for C, C++ and Python. See zeta_msg.h for the wire layout.
+
+Schema syntax:
+
+    package sensors;            # optional, prefixes generated names
+
+    message Imu {
+        uint64 stamp_ns;
+        float64[3] accel;       # fixed-size array, stored inline
+        string frame_id;        # variable-length, stored after the fixed section
+    }
+
+Scalar types: bool, int8, uint8, int16, uint16, int32, uint32, int64, uint64,
+float32, float64. Variable-length fields: string, bytes and T[] of a scalar.
+"""
+
+import argparse
+import os
+import re
+import sys
+from dataclasses import dataclass, field
+from typing import List, Optional
+
+
+# type name -> (size, struct format, C type, C load/store suffix)
+SCALARS = {
+    "bool": (1, "?", "bool", "u8"),
+    "int8": (1, "b", "int8_t", "u8"),
+    "uint8": (1, "B", "uint8_t", "u8"),
+    "int16": (2, "h", "int16_t", "u16"),
+    "uint16": (2, "H", "uint16_t", "u16"),
+    "int32": (4, "i", "int32_t", "u32"),
+    "uint32": (4, "I", "uint32_t", "u32"),
+    "int64": (8, "q", "int64_t", "u64"),
+    "uint64": (8, "Q", "uint64_t", "u64"),
+    "float32": (4, "f", "float", "f32"),
+    "float64": (8, "d", "double", "f64"),
+}
+
+HEADER_SIZE = 16
+VAR_ALIGN = 8
+VAR_ENTRY_SIZE = 8  # uint32 offset + uint32 count
+
+
+class SchemaError(Exception):
+    pass
+
+
+@dataclass
+class Field:
+    name: str
+    type: str               # scalar name, "string" or "bytes"
+    array: Optional[int]    # None = scalar, 0 = variable array, N = fixed array
+    offset: int = 0
+
+    @property
+    def is_var(self) -> bool:
+        return self.type in ("string", "bytes") or self.array == 0
+
+    @property
+    def elem_type(self) -> str:
+        return "uint8" if self.type in ("string", "bytes") else self.type
+
+    @property
+    def elem_size(self) -> int:
+        return SCALARS[self.elem_type][0]
+
+    def canonical(self) -> str:
+        suffix = "" if self.array is None else ("[]" if self.array == 0 else f"[{self.array}]")
+        return f"{self.type}{suffix} {self.name}"
+
+
+@dataclass
+class Message:
+    name: str
+    package: str
+    fields: List[Field] = field(default_factory=list)
+    fixed_size: int = 0
+    schema_hash: int = 0
+
+    @property
+    def c_prefix(self) -> str:
+        snake = re.sub(r"(?<!^)(?=[A-Z])", "_", self.name).lower()
+        return f"{self.package}_{snake}" if self.package else snake
+
+    @property
+    def var_fields(self) -> List[Field]:
+        return [f for f in self.fields if f.is_var]
+
+
+# Parsing
+
+_TOKEN = re.compile(r"\s*(?:(#|//)[^\n]*|([A-Za-z_][A-Za-z0-9_]*)|(\d+)|(\S))")
+
+
+def _tokenize(text: str):
+    tokens = []
+    pos = 0
+    while pos < len(text):
+        m = _TOKEN.match(text, pos)
+        if not m or m.end() == pos:
+            break
+        pos = m.end()
+        if m.group(1):
+            continue
+        tok = m.group(2) or m.group(3) or m.group(4)
+        if tok:
+            tokens.append(tok)
+    return tokens
+
+
+def parse(text: str) -> List[Message]:
+    tokens = _tokenize(text)
+    pos = 0
+
+    def next_tok(expected: Optional[str] = None) -> str:
+        nonlocal pos
+        if pos >= len(tokens):
+            raise SchemaError(f"unexpected end of schema, expected {expected or 'token'}")
+        tok = tokens[pos]
+        if expected is not None and tok != expected:
+            raise SchemaError(f"expected '{expected}', got '{tok}'")
+        pos += 1
+        return tok
+
+    package = ""
+    messages = []
+    while pos < len(tokens):
+        kw = next_tok()
+        if kw == "package":
+            package = next_tok()
+            next_tok(";")
+        elif kw == "message":
+            msg = Message(next_tok(), package)
+            next_tok("{")
+            while tokens[pos] != "}":
+                type_name = next_tok()
+                if type_name not in SCALARS and type_name not in ("string", "bytes"):
+                    raise SchemaError(f"{msg.name}: unknown type '{type_name}'")
+                array = None
+                if tokens[pos] == "[":
+                    next_tok("[")
+                    if tokens[pos] == "]":
+                        array = 0
+                    else:
+                        array = int(next_tok())
+                        if array <= 0:
+                            raise SchemaError(f"{msg.name}: array size must be positive")
+                    next_tok("]")
+                    if type_name in ("string", "bytes"):
+                        raise SchemaError(f"{msg.name}: arrays of {type_name} are not supported")
+                name = next_tok()
+                next_tok(";")
+                if any(f.name == name for f in msg.fields):
+                    raise SchemaError(f"{msg.name}: duplicate field '{name}'")
+                msg.fields.append(Field(name, type_name, array))
+            next_tok("}")
+            _layout(msg)
+            messages.append(msg)
+        else:
+            raise SchemaError(f"expected 'package' or 'message', got '{kw}'")
+    return messages
+
+
+def _align(offset: int, alignment: int) -> int:
+    return (offset + alignment - 1) & ~(alignment - 1)
+
+
+def fnv1a64(data: bytes) -> int:
+    h = 0xcbf29ce484222325
+    for b in data:
+        h ^= b
+        h = (h * 0x100000001b3) & 0xFFFFFFFFFFFFFFFF
+    return h
+
+
+def _layout(msg: Message) -> None:
+    offset = HEADER_SIZE
+    for f in msg.fields:
+        if f.is_var:
+            offset = _align(offset, 4)
+            f.offset = offset
+            offset += VAR_ENTRY_SIZE
+        else:
+            offset = _align(offset, f.elem_size)
+            f.offset = offset
+            offset += f.elem_size * (f.array or 1)
+    msg.fixed_size = _align(offset, VAR_ALIGN)
+
+    qualified = f"{msg.package}.{msg.name}" if msg.package else msg.name
+    canonical = qualified + "{" + ";".join(f.canonical() for f in msg.fields) + "}"
+    msg.schema_hash = fnv1a64(canonical.encode("utf-8"))
+
+
+# C generation
+
+def _c_load(f: Field, addr: str) -> str:
+    c_type, suffix = SCALARS[f.elem_type][2], SCALARS[f.elem_type][3]
+    if suffix == "u8":
+        return f"({c_type})*({addr})"
+    if suffix in ("f32", "f64"):
+        return f"zeta_msg_load_{suffix}({addr})"
+    return f"({c_type})zeta_msg_load_{suffix}({addr})"
+
+
+def _c_store(f: Field, addr: str, value: str) -> str:
+    c_type, suffix = SCALARS[f.elem_type][2], SCALARS[f.elem_type][3]
+    if suffix == "u8":
+        return f"*({addr}) = (uint8_t)({value});"
+    if suffix in ("f32", "f64"):
+        return f"zeta_msg_store_{suffix}({addr}, {value});"
+    cast = {"u16": "uint16_t", "u32": "uint32_t", "u64": "uint64_t"}[suffix]
+    return f"zeta_msg_store_{suffix}({addr}, ({cast})({value}));"
+
+
+def _var_params(msg: Message) -> str:
+    params = [f"size_t {f.name}_count" for f in msg.var_fields]
+    return ", ".join(params) if params else "void"
+
+
+def generate_c(messages: List[Message], guard: str) -> str:
+    out = [
+        "// Generated by zschema.py - do not edit.",
+        f"#ifndef {guard}",
+        f"#define {guard}",
+        "",
+        "#include <stdbool.h>",
+        "#include <stddef.h>",
+        "#include <stdint.h>",
+        '#include "src/schema/zeta_msg.h"',
+        "",
+    ]
+    for msg in messages:
+        p = msg.c_prefix
+        P = p.upper()
+        out += [
+            f"// {msg.package + '.' if msg.package else ''}{msg.name}",
+            "",
+            f"#define {P}_SCHEMA_HASH 0x{msg.schema_hash:016x}ULL",
+            f"#define {P}_FIXED_SIZE {msg.fixed_size}",
+            "",
+            "typedef struct {",
+            "    const uint8_t* data;",
+            "    size_t size;",
+            f"}} {p}_view_t;",
+            "",
+            "typedef struct {",
+            "    uint8_t* data;",
+            "    size_t size;",
+            f"}} {p}_builder_t;",
+            "",
+            f"// Wrap a received buffer without copying (0 on success)",
+            f"static inline int {p}_view_init({p}_view_t* view, const void* data, size_t size) {{",
+            "    const uint8_t* p = (const uint8_t*)data;",
+            f"    if (zeta_msg_check(p, size, {P}_SCHEMA_HASH, {P}_FIXED_SIZE) != 0) return -1;",
+        ]
+        for f in msg.var_fields:
+            if f.type == "string":
+                out.append(f"    if (zeta_msg_check_string(p, size, {f.offset}) != 0) return -1;")
+            else:
+                out.append(f"    if (zeta_msg_check_var(p, size, {f.offset}, {f.elem_size}) != 0) return -1;")
+        out += [
+            "    view->data = p;",
+            "    view->size = size;",
+            "    return 0;",
+            "}",
+            "",
+        ]
+
+        # Read accessors
+        for f in msg.fields:
+            c_type = SCALARS[f.elem_type][2]
+            if f.type == "string":
+                out += [
+                    f"static inline const char* {p}_{f.name}(const {p}_view_t* view, size_t* len) {{",
+                    f"    if (len) *len = zeta_msg_load_u32(view->data + {f.offset + 4});",
+                    f"    return (const char*)(view->data + zeta_msg_load_u32(view->data + {f.offset}));",
+                    "}",
+                    "",
+                ]
+            elif f.type == "bytes":
+                out += [
+                    f"static inline const uint8_t* {p}_{f.name}(const {p}_view_t* view, size_t* len) {{",
+                    f"    if (len) *len = zeta_msg_load_u32(view->data + {f.offset + 4});",
+                    f"    return view->data + zeta_msg_load_u32(view->data + {f.offset});",
+                    "}",
+                    "",
+                ]
+            elif f.array == 0:
+                out += [
+                    f"static inline size_t {p}_{f.name}_count(const {p}_view_t* view) {{",
+                    f"    return zeta_msg_load_u32(view->data + {f.offset + 4});",
+                    "}",
+                    "",
+                    f"static inline {c_type} {p}_{f.name}_at(const {p}_view_t* view, size_t i) {{",
+                    f"    return {_c_load(f, f'view->data + zeta_msg_load_u32(view->data + {f.offset}) + i * {f.elem_size}')};",
+                    "}",
+                    "",
+                    "#if ZETA_MSG_LITTLE_ENDIAN",
+                    f"static inline const {c_type}* {p}_{f.name}(const {p}_view_t* view) {{",
+                    f"    return (const {c_type}*)(const void*)(view->data + zeta_msg_load_u32(view->data + {f.offset}));",
+                    "}",
+                    "#endif",
+                    "",
+                ]
+            elif f.array:
+                out += [
+                    f"#define {P}_{f.name.upper()}_LEN {f.array}",
+                    "",
+                    f"static inline {c_type} {p}_{f.name}(const {p}_view_t* view, size_t i) {{",
+                    f"    return {_c_load(f, f'view->data + {f.offset} + i * {f.elem_size}')};",
+                    "}",
+                    "",
+                ]
+            else:
+                out += [
+                    f"static inline {c_type} {p}_{f.name}(const {p}_view_t* view) {{",
+                    f"    return {_c_load(f, f'view->data + {f.offset}')};",
+                    "}",
+                    "",
+                ]
+
+        # Builder
+        out += [
+            f"// Encoded size for the given variable field lengths",
+            f"static inline size_t {p}_encoded_size({_var_params(msg)}) {{",
+            f"    size_t size = {P}_FIXED_SIZE;",
+        ]
+        for f in msg.var_fields:
+            extra = 1 if f.type == "string" else 0
+            out.append(f"    size = zeta_msg_align(size + {f.name}_count * {f.elem_size} + {extra}, ZETA_MSG_VAR_ALIGN);")
+        out += [
+            "    return size;",
+            "}",
+            "",
+            f"// Lay out a zeroed message in buf (0 on success); fill it with the setters",
+            f"static inline int {p}_builder_init({p}_builder_t* builder, void* buf, size_t capacity"
+            + "".join(f", size_t {f.name}_count" for f in msg.var_fields) + ") {",
+            f"    size_t size = {p}_encoded_size(" + ", ".join(f"{f.name}_count" for f in msg.var_fields) + ");",
+            "    if (!buf || capacity < size || size > UINT32_MAX) return -1;",
+            "    uint8_t* p = (uint8_t*)buf;",
+            "    memset(p, 0, size);",
+            f"    zeta_msg_init_header(p, size, {P}_SCHEMA_HASH);",
+        ]
+        if msg.var_fields:
+            out.append(f"    size_t next = {P}_FIXED_SIZE;")
+            for f in msg.var_fields:
+                extra = 1 if f.type == "string" else 0
+                out.append(f"    next = zeta_msg_place_var(p, {f.offset}, next, {f.name}_count, {f.elem_size}, {extra});")
+            out.append("    (void)next;")
+        out += [
+            "    builder->data = p;",
+            "    builder->size = size;",
+            "    return 0;",
+            "}",
+            "",
+        ]
+        for f in msg.fields:
+            c_type = SCALARS[f.elem_type][2]
+            if f.type in ("string", "bytes"):
+                ptr_type = "char" if f.type == "string" else "uint8_t"
+                out += [
+                    f"static inline {ptr_type}* {p}_{f.name}_mut({p}_builder_t* builder) {{",
+                    f"    return ({ptr_type}*)(builder->data + zeta_msg_load_u32(builder->data + {f.offset}));",
+                    "}",
+                    "",
+                ]
+            elif f.array == 0:
+                out += [
+                    f"static inline void {p}_set_{f.name}_at({p}_builder_t* builder, size_t i, {c_type} value) {{",
+                    f"    {_c_store(f, f'builder->data + zeta_msg_load_u32(builder->data + {f.offset}) + i * {f.elem_size}', 'value')}",
+                    "}",
+                    "",
+                ]
+            elif f.array:
+                out += [
+                    f"static inline void {p}_set_{f.name}({p}_builder_t* builder, size_t i, {c_type} value) {{",
+                    f"    {_c_store(f, f'builder->data + {f.offset} + i * {f.elem_size}', 'value')}",
+                    "}",
+                    "",
+                ]
+            else:
+                out += [
+                    f"static inline void {p}_set_{f.name}({p}_builder_t* builder, {c_type} value) {{",
+                    f"    {_c_store(f, f'builder->data + {f.offset}', 'value')}",
+                    "}",
+                    "",
+                ]
+
+    out += [f"#endif // {guard}", ""]
+    return "\n".join(out)
+
+
+# C++ generation (thin classes over the C accessors)
+
+def generate_cpp(messages: List[Message], guard: str, c_header: str) -> str:
+    out = [
+        "// Generated by zschema.py - do not edit.",
+        f"#ifndef {guard}",
+        f"#define {guard}",
+        "",
+        "#include <cstddef>",
+        "#include <cstdint>",
+        "#include <string_view>",
+        "",
+        'extern "C" {',
+        f'#include "{c_header}"',
+        "}",
+        "",
+    ]
+    package = messages[0].package if messages else ""
+    if package:
+        out += [f"namespace {package} {{", ""]
+    for msg in messages:
+        p = msg.c_prefix
+        out += [
+            f"class {msg.name}View {{",
+            "public:",
+            f"    static constexpr uint64_t kSchemaHash = 0x{msg.schema_hash:016x}ULL;",
+            "",
+            "    // Wrap a received buffer without copying; false if it is not a valid message",
+            f"    bool init(const void* data, size_t size) {{ return {p}_view_init(&view_, data, size) == 0; }}",
+            "",
+        ]
+        for f in msg.fields:
+            c_type = SCALARS[f.elem_type][2]
+            if f.type == "string":
+                out.append(f"    std::string_view {f.name}() const {{ size_t n; const char* s = {p}_{f.name}(&view_, &n); return std::string_view(s, n); }}")
+            elif f.type == "bytes":
+                out.append(f"    const uint8_t* {f.name}(size_t* len) const {{ return {p}_{f.name}(&view_, len); }}")
+            elif f.array == 0:
+                out.append(f"    size_t {f.name}_count() const {{ return {p}_{f.name}_count(&view_); }}")
+                out.append(f"    {c_type} {f.name}(size_t i) const {{ return {p}_{f.name}_at(&view_, i); }}")
+            elif f.array:
+                out.append(f"    {c_type} {f.name}(size_t i) const {{ return {p}_{f.name}(&view_, i); }}")
+            else:
+                out.append(f"    {c_type} {f.name}() const {{ return {p}_{f.name}(&view_); }}")
+        out += [
+            "",
+            "private:",
+            f"    {p}_view_t view_{{}};",
+            "};",
+            "",
+            f"class {msg.name}Builder {{",
+            "public:",
+            f"    bool init(void* buf, size_t capacity"
+            + "".join(f", size_t {f.name}_count" for f in msg.var_fields)
+            + f") {{ return {p}_builder_init(&builder_, buf, capacity"
+            + "".join(f", {f.name}_count" for f in msg.var_fields) + ") == 0; }",
+            "    size_t size() const { return builder_.size; }",
+            "",
+        ]
+        for f in msg.fields:
+            c_type = SCALARS[f.elem_type][2]
+            if f.type in ("string", "bytes"):
+                ptr_type = "char" if f.type == "string" else "uint8_t"
+                out.append(f"    {ptr_type}* {f.name}_mut() {{ return {p}_{f.name}_mut(&builder_); }}")
+            elif f.array == 0:
+                out.append(f"    void set_{f.name}(size_t i, {c_type} value) {{ {p}_set_{f.name}_at(&builder_, i, value); }}")
+            elif f.array:
+                out.append(f"    void set_{f.name}(size_t i, {c_type} value) {{ {p}_set_{f.name}(&builder_, i, value); }}")
+            else:
+                out.append(f"    void set_{f.name}({c_type} value) {{ {p}_set_{f.name}(&builder_, value); }}")
+        out += [
+            "",
+            "private:",
+            f"    {p}_builder_t builder_{{}};",
+            "};",
+            "",
+        ]
+    if package:
+        out += [f"}}  // namespace {package}", ""]
+    out += [f"#endif // {guard}", ""]
+    return "\n".join(out)
+
+
+# Python generation
+
+def generate_py(messages: List[Message]) -> str:
+    out = [
+        '"""Generated by zschema.py - do not edit."""',
+        "",
+        "import struct",
+        "import sys",
+        "",
+        "_HEADER = struct.Struct('<2sBBIQ')",
+        "_VAR_ENTRY = struct.Struct('<II')",
+        "_LITTLE_ENDIAN = sys.byteorder == 'little'",
+        "",
+        "",
+        "def _align(offset, alignment):",
+        "    return (offset + alignment - 1) & ~(alignment - 1)",
+        "",
+    ]
+    for msg in messages:
+        out += [
+            "",
+            f"class {msg.name}:",
+            f'    """Read-in-place view of a {msg.name} message."""',
+            "",
+            f"    SCHEMA_HASH = 0x{msg.schema_hash:016x}",
+            f"    FIXED_SIZE = {msg.fixed_size}",
+            "    __slots__ = ('_buf',)",
+            "",
+            "    def __init__(self, data):",
+            "        buf = memoryview(data).cast('B')",
+            "        if len(buf) < self.FIXED_SIZE:",
+            f"            raise ValueError('buffer too small for {msg.name}')",
+            "        magic, version, _flags, size, schema_hash = _HEADER.unpack_from(buf, 0)",
+            "        if magic != b'ZM' or version != 1 or schema_hash != self.SCHEMA_HASH or size > len(buf):",
+            f"            raise ValueError('not a {msg.name} message')",
+        ]
+        for f in msg.var_fields:
+            out += [
+                f"        off, count = _VAR_ENTRY.unpack_from(buf, {f.offset})",
+                f"        if off % 8 or off + count * {f.elem_size} > len(buf):",
+                f"            raise ValueError('corrupt {msg.name}.{f.name}')",
+            ]
+        out += ["        self._buf = buf", ""]
+
+        for f in msg.fields:
+            fmt = SCALARS[f.elem_type][1]
+            out += ["    @property", f"    def {f.name}(self):"]
+            if f.type == "string":
+                out += [
+                    f"        off, count = _VAR_ENTRY.unpack_from(self._buf, {f.offset})",
+                    "        return bytes(self._buf[off:off + count]).decode('utf-8')",
+                ]
+            elif f.type == "bytes":
+                out += [
+                    f"        off, count = _VAR_ENTRY.unpack_from(self._buf, {f.offset})",
+                    "        return self._buf[off:off + count]",
+                ]
+            elif f.array == 0:
+                out += [
+                    f"        off, count = _VAR_ENTRY.unpack_from(self._buf, {f.offset})",
+                ]
+                if f.elem_size > 1 and fmt != "?":
+                    out += [
+                        "        if _LITTLE_ENDIAN:",
+                        f"            return self._buf[off:off + count * {f.elem_size}].cast('{fmt}')",
+                        f"        return struct.unpack_from('<%d{fmt}' % count, self._buf, off)",
+                    ]
+                else:
+                    out += [f"        return struct.unpack_from('<%d{fmt}' % count, self._buf, off)"]
+            elif f.array:
+                out += [f"        return struct.unpack_from('<{f.array}{fmt}', self._buf, {f.offset})"]
+            else:
+                out += [f"        return struct.unpack_from('<{fmt}', self._buf, {f.offset})[0]"]
+            out.append("")
+
+        # Encoder
+        params = []
+        for f in msg.fields:
+            if f.type == "string":
+                params.append(f"{f.name}=''")
+            elif f.type == "bytes":
+                params.append(f"{f.name}=b''")
+            elif f.array is not None:
+                params.append(f"{f.name}=()")
+            else:
+                params.append(f"{f.name}={'False' if f.type == 'bool' else '0'}")
+        out += [
+            "    @staticmethod",
+            f"    def encode({', '.join(params)}):",
+            f'        """Encode a {msg.name} message to bytes."""',
+        ]
+        for f in msg.var_fields:
+            if f.type == "string":
+                out.append(f"        {f.name} = {f.name}.encode('utf-8')")
+            elif f.type == "bytes":
+                out.append(f"        {f.name} = bytes({f.name})")
+            else:
+                out.append(f"        {f.name} = tuple({f.name})")
+        out += [f"        size = {msg.fixed_size}", "        places = []"]
+        for f in msg.var_fields:
+            extra = 1 if f.type == "string" else 0
+            out += [
+                f"        places.append(size)",
+                f"        size = _align(size + len({f.name}) * {f.elem_size} + {extra}, 8)",
+            ]
+        out += [
+            "        buf = bytearray(size)",
+            f"        _HEADER.pack_into(buf, 0, b'ZM', 1, 0, size, 0x{msg.schema_hash:016x})",
+        ]
+        var_index = 0
+        for f in msg.fields:
+            fmt = SCALARS[f.elem_type][1]
+            if f.is_var:
+                out.append(f"        _VAR_ENTRY.pack_into(buf, {f.offset}, places[{var_index}], len({f.name}))")
+                if f.type in ("string", "bytes"):
+                    out.append(f"        buf[places[{var_index}]:places[{var_index}] + len({f.name})] = {f.name}")
+                else:
+                    out.append(f"        struct.pack_into('<%d{fmt}' % len({f.name}), buf, places[{var_index}], *{f.name})")
+                var_index += 1
+            elif f.array:
+                out += [
+                    f"        if len({f.name}) > {f.array}:",
+                    f"            raise ValueError('{f.name} holds at most {f.array} values')",
+                    f"        struct.pack_into('<%d{fmt}' % len({f.name}), buf, {f.offset}, *{f.name})",
+                ]
+            else:
+                out.append(f"        struct.pack_into('<{fmt}', buf, {f.offset}, {f.name})")
+        out += ["        return bytes(buf)", ""]
+    return "\n".join(out)
+
+
+def main(argv=None) -> int:
+    parser = argparse.ArgumentParser(description="Generate zeta message accessors from .zmsg schemas")
+    parser.add_argument("schemas", nargs="+", help="Input .zmsg files")
+    parser.add_argument("--c", dest="c_out", help="Output C header")
+    parser.add_argument("--cpp", dest="cpp_out", help="Output C++ header")
+    parser.add_argument("--c-include", help="Include path of the C header used by the C++ header")
+    parser.add_argument("--py", dest="py_out", help="Output Python module")
+    args = parser.parse_args(argv)
+
+    messages = []
+    try:
+        for path in args.schemas:
+            with open(path, "r", encoding="utf-8") as f:
+                messages += parse(f.read())
+    except SchemaError as e:
+        print(f"zschema: {e}", file=sys.stderr)
+        return 1
+
+    packages = {m.package for m in messages}
+    if len(packages) > 1:
+        print("zschema: all schemas of one library must share a package", file=sys.stderr)
+        return 1
+
+    # Guards follow the include path so they do not depend on the output tree
+    c_include = args.c_include or (os.path.basename(args.c_out) if args.c_out else "messages.h")
+
+    def guard_for(path: str) -> str:
+        return "ZETA_MSG_" + re.sub(r"[^A-Za-z0-9]", "_", path).upper()
+
+    if args.c_out:
+        with open(args.c_out, "w", encoding="utf-8") as f:
+            f.write(generate_c(messages, guard_for(c_include)))
+    if args.cpp_out:
+        with open(args.cpp_out, "w", encoding="utf-8") as f:
+            f.write(generate_cpp(messages, guard_for(c_include + "pp"), c_include))
+    if args.py_out:
+        with open(args.py_out, "w", encoding="utf-8") as f:
+            f.write(generate_py(messages))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())